@@ -0,0 +1,187 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef RECAST_PROFILER_H
+#define RECAST_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Recast.h"
+#include "RecastAlloc.h"
+
+struct duFileIO;
+class duBuildProfiler;
+
+/// A timed scope recorded by a profiler context.
+/// @see duProfilerContext
+struct duProfileEvent
+{
+	int64_t start;			///< The start time, relative to the last profiler reset. [Units: ns]
+	int64_t duration;		///< The duration, or -1 if the scope has not been stopped. [Units: ns]
+	size_t tempMemory;		///< The temporary arena memory allocated within the scope. [Units: bytes]
+	rcTimerLabel label;		///< The timer that measured the scope.
+	int parent;				///< The index of the enclosing event, or -1 for the root scope of a frame.
+	int depth;				///< The number of enclosing events.
+	int frame;				///< The index of the frame, i.e. the root scope, on the thread.
+	int tx;					///< The x-position of the tile of the frame, or -1. (See: rcContext::setTimerTile)
+	int ty;					///< The y-position of the tile of the frame, or -1. (See: rcContext::setTimerTile)
+	bool nested;			///< True if an enclosing scope was measured with the same timer.
+};
+
+/// Statistics of a timer, aggregated across the frames of all threads.
+/// The durations of the scopes of the timer are summed per frame, e.g. per tile.
+/// @see duBuildProfiler::getStats
+struct duProfileStats
+{
+	int count;				///< The number of frames that used the timer.
+	float total;			///< The total time. [Units: ms]
+	float mean;				///< The mean time per frame. [Units: ms]
+	float p50;				///< The median time per frame. [Units: ms]
+	float p90;				///< The 90th percentile of the time per frame. [Units: ms]
+	float p99;				///< The 99th percentile of the time per frame. [Units: ms]
+	float max;				///< The longest time of a frame. [Units: ms]
+	size_t maxTempMemory;	///< The most temporary arena memory allocated by a single scope. [Units: bytes]
+};
+
+/// A build context that records a timeline of nested timer scopes for one thread.
+///
+/// Every timer that is started while no other timer runs opens a new frame, such as
+/// the #RC_TIMER_BUILD_TILE scope of a tile. If the context has a temporary arena,
+/// the events also record the arena memory allocated within each scope.
+/// The context does not store log messages.
+/// @see duBuildProfiler
+class duProfilerContext : public rcContext
+{
+public:
+	duProfilerContext();
+	virtual ~duProfilerContext();
+
+	/// @return The number of recorded events.
+	int getEventCount() const { return (int)m_events.size(); }
+
+	/// @param[in]		i		The index of the event. [Limits: 0 <= value < #getEventCount]
+	/// @return The event, in the order the scopes were started.
+	const duProfileEvent& getEvent(const int i) const { return m_events[i]; }
+
+	/// @return The index of the thread of the context within its profiler.
+	int getThreadIndex() const { return m_threadIndex; }
+
+protected:
+	virtual void doResetTimers();
+	virtual void doStartTimer(const rcTimerLabel label);
+	virtual void doStopTimer(const rcTimerLabel label);
+	virtual int doGetAccumulatedTime(const rcTimerLabel label) const;
+	virtual void doSetTimerTile(const int tx, const int ty);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	duProfilerContext(const duProfilerContext&);
+	duProfilerContext& operator=(const duProfilerContext&);
+
+	friend class duBuildProfiler;
+
+	int64_t getTime() const;
+	size_t getTempMemory() const;
+
+	const duBuildProfiler* m_profiler;
+	int m_threadIndex;
+	rcPermVector<duProfileEvent> m_events;
+	rcPermVector<int> m_openEvents;
+	int64_t m_accTime[RC_MAX_TIMERS];
+	int m_frameCount;
+	int m_tileX;
+	int m_tileY;
+};
+
+/// Profiles Recast builds that run on several threads, such as #rcBuildNavMeshTiles.
+///
+/// The profiler owns a #duProfilerContext for each build thread. The contexts share the
+/// clock of the profiler, so that their timelines can be aggregated and exported together.
+///
+/// @code
+/// duBuildProfiler profiler;
+/// profiler.init(numThreads);
+/// params.threadContexts = profiler.getThreadContexts();
+/// rcBuildNavMeshTiles(&ctx, cfg, params, numThreads, tileSet);
+/// profiler.logSummary(ctx, 10);
+/// @endcode
+class duBuildProfiler
+{
+public:
+	duBuildProfiler();
+	~duBuildProfiler();
+
+	/// Creates the contexts of the build threads and resets the clock.
+	///  @param[in]		threadCount		The number of build threads. [Limit: >= 1]
+	///  @return True if the contexts were created.
+	bool init(const int threadCount);
+
+	/// Clears the events of all contexts and restarts the clock.
+	void reset();
+
+	/// @return The number of build threads.
+	int getThreadCount() const { return (int)m_contexts.size(); }
+
+	/// @param[in]		threadIndex		The index of the thread. [Limits: 0 <= value < #getThreadCount]
+	/// @return The context of the thread.
+	duProfilerContext* getThreadContext(const int threadIndex) { return static_cast<duProfilerContext*>(m_contexts[threadIndex]); }
+	const duProfilerContext* getThreadContext(const int threadIndex) const { return static_cast<const duProfilerContext*>(m_contexts[threadIndex]); }
+
+	/// Returns the contexts of all threads, e.g. for rcTileBuildParams::threadContexts.
+	/// @return The contexts. [Size: #getThreadCount]
+	rcContext** getThreadContexts() { return m_contexts.data(); }
+
+	/// Returns the time on the clock of the profiler.
+	/// @return The time since the profiler was last reset. [Units: ns]
+	int64_t getTime() const;
+
+	/// Aggregates the scopes of a timer across the frames of all threads.
+	///  @param[in]		label	The timer.
+	///  @param[out]	stats	The statistics of the timer.
+	///  @return False if the timer measured no scopes.
+	bool getStats(const rcTimerLabel label, duProfileStats& stats) const;
+
+	/// Writes the events of all threads in the Chrome trace event format,
+	/// which can be viewed with chrome://tracing or Perfetto.
+	///  @param[in]		io		The output.
+	///  @return True if the trace was written.
+	bool writeChromeTrace(duFileIO* io) const;
+
+	/// Logs the statistics of every used timer, followed by the slowest frames.
+	///  @param[in]		ctx			The context to log to.
+	///  @param[in]		maxFrames	The number of slowest frames to log.
+	void logSummary(rcContext& ctx, const int maxFrames) const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	duBuildProfiler(const duBuildProfiler&);
+	duBuildProfiler& operator=(const duBuildProfiler&);
+
+	void purge();
+
+	rcPermVector<rcContext*> m_contexts;
+	int64_t m_startTime;
+};
+
+/// Returns a readable name of a timer.
+///  @param[in]		label	The timer.
+///  @return The name of the timer.
+const char* duGetTimerLabelName(const rcTimerLabel label);
+
+#endif // RECAST_PROFILER_H
@@ -156,11 +156,11 @@ void duDebugDrawHeightfieldSolid(duDebugDraw* dd, const rcHeightfield& hf)
 		{
 			float fx = orig[0] + x*cs;
 			float fz = orig[2] + y*cs;
-			const rcSpan* s = hf.spans[x + y*w];
+			const rcSpan* s = rcGetFirstSpan(hf, x + y*w);
 			while (s)
 			{
 				duAppendBox(dd, fx, orig[1]+s->smin*ch, fz, fx+cs, orig[1] + s->smax*ch, fz+cs, fcol);
-				s = s->next;
+				s = rcGetNextSpan(hf, s);
 			}
 		}
 	}
@@ -189,7 +189,7 @@ void duDebugDrawHeightfieldWalkable(duDebugDraw* dd, const rcHeightfield& hf)
 		{
 			float fx = orig[0] + x*cs;
 			float fz = orig[2] + y*cs;
-			const rcSpan* s = hf.spans[x + y*w];
+			const rcSpan* s = rcGetFirstSpan(hf, x + y*w);
 			while (s)
 			{
 				if (s->area == RC_WALKABLE_AREA)
@@ -200,7 +200,7 @@ void duDebugDrawHeightfieldWalkable(duDebugDraw* dd, const rcHeightfield& hf)
 					fcol[0] = duMultCol(dd->areaToCol(s->area), 200);
 				
 				duAppendBox(dd, fx, orig[1]+s->smin*ch, fz, fx+cs, orig[1] + s->smax*ch, fz+cs, fcol);
-				s = s->next;
+				s = rcGetNextSpan(hf, s);
 			}
 		}
 	}
@@ -419,10 +419,13 @@ void duLogBuildTimes(rcContext& ctx, const int totalTimeUsec)
 	const float pc = 100.0f / totalTimeUsec;
  
 	ctx.log(RC_LOG_PROGRESS, "Build Times");
+	logLine(ctx, RC_TIMER_BUILD_TILE,				"- Build Tiles", pc);
 	logLine(ctx, RC_TIMER_RASTERIZE_TRIANGLES,		"- Rasterize", pc);
 	logLine(ctx, RC_TIMER_BUILD_COMPACTHEIGHTFIELD,	"- Build Compact", pc);
+	logLine(ctx, RC_TIMER_BUILD_NEIGHBOR_INDICES,	"- Build Neighbor Indices", pc);
 	logLine(ctx, RC_TIMER_FILTER_BORDER,				"- Filter Border", pc);
 	logLine(ctx, RC_TIMER_FILTER_WALKABLE,			"- Filter Walkable", pc);
+	logLine(ctx, RC_TIMER_FILTER_HEIGHTFIELD,		"- Filter Heightfield", pc);
 	logLine(ctx, RC_TIMER_ERODE_AREA,				"- Erode Area", pc);
 	logLine(ctx, RC_TIMER_MEDIAN_AREA,				"- Median Area", pc);
 	logLine(ctx, RC_TIMER_MARK_BOX_AREA,				"- Mark Box Area", pc);
@@ -0,0 +1,438 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Recast.h"
+#include "RecastAlloc.h"
+#include "RecastAssert.h"
+#include "RecastDump.h"
+#include "RecastProfiler.h"
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <time.h>
+#endif
+
+static int64_t getClockTime()
+{
+#if defined(_WIN32)
+	LARGE_INTEGER count;
+	LARGE_INTEGER frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (int64_t)((double)count.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + (int64_t)now.tv_nsec;
+#endif
+}
+
+static void ioprintf(duFileIO* io, const char* format, ...)
+{
+	char line[256];
+	va_list ap;
+	va_start(ap, format);
+	const int n = vsnprintf(line, sizeof(line), format, ap);
+	va_end(ap);
+	if (n > 0)
+		io->write(line, sizeof(char)*n);
+}
+
+static const char* const timerLabelNames[] =
+{
+	"Total",
+	"Temp",
+	"Rasterize",
+	"Build Compact",
+	"Build Contours",
+	"Trace Contours",
+	"Simplify Contours",
+	"Filter Border",
+	"Filter Walkable",
+	"Median Area",
+	"Filter Low Obstacles",
+	"Build Polymesh",
+	"Merge Polymeshes",
+	"Erode Area",
+	"Mark Box Area",
+	"Mark Cylinder Area",
+	"Mark Convex Area",
+	"Build Distance Field",
+	"Distance",
+	"Blur",
+	"Build Regions",
+	"Watershed",
+	"Expand",
+	"Find Basins",
+	"Filter Regions",
+	"Build Layers",
+	"Build Polymesh Detail",
+	"Merge Polymesh Details",
+	"Filter Heightfield",
+	"Build Neighbor Indices",
+	"Build Tile",
+};
+
+// Fails to compile if a timer label is added without a name.
+typedef char duTimerLabelNamesCheck[sizeof(timerLabelNames) / sizeof(timerLabelNames[0]) == RC_MAX_TIMERS ? 1 : -1];
+
+const char* duGetTimerLabelName(const rcTimerLabel label)
+{
+	return label >= 0 && label < RC_MAX_TIMERS ? timerLabelNames[label] : "Unknown";
+}
+
+duProfilerContext::duProfilerContext()
+: m_profiler(0)
+, m_threadIndex(0)
+, m_frameCount(0)
+, m_tileX(-1)
+, m_tileY(-1)
+{
+	doResetTimers();
+}
+
+duProfilerContext::~duProfilerContext()
+{
+}
+
+int64_t duProfilerContext::getTime() const
+{
+	return m_profiler ? m_profiler->getTime() : getClockTime();
+}
+
+size_t duProfilerContext::getTempMemory() const
+{
+	return m_tempArena ? m_tempArena->getUsedSize() : 0;
+}
+
+void duProfilerContext::doResetTimers()
+{
+	m_events.clear();
+	m_openEvents.clear();
+	m_frameCount = 0;
+	for (int i = 0; i < RC_MAX_TIMERS; ++i)
+	{
+		m_accTime[i] = -1;
+	}
+}
+
+void duProfilerContext::doStartTimer(const rcTimerLabel label)
+{
+	duProfileEvent event;
+	event.label = label;
+	event.parent = m_openEvents.empty() ? -1 : m_openEvents.back();
+	event.depth = (int)m_openEvents.size();
+	if (event.parent == -1)
+	{
+		m_frameCount++;
+	}
+	event.frame = m_frameCount - 1;
+	event.tx = event.parent == -1 ? m_tileX : m_events[event.parent].tx;
+	event.ty = event.parent == -1 ? m_tileY : m_events[event.parent].ty;
+	event.nested = false;
+	for (int i = 0; i < (int)m_openEvents.size(); ++i)
+	{
+		if (m_events[m_openEvents[i]].label == label)
+		{
+			event.nested = true;
+		}
+	}
+	event.duration = -1;
+	// Holds the arena usage at the start until the scope is stopped.
+	event.tempMemory = getTempMemory();
+	event.start = getTime();
+
+	m_events.push_back(event);
+	m_openEvents.push_back((int)m_events.size() - 1);
+}
+
+void duProfilerContext::doStopTimer(const rcTimerLabel label)
+{
+	const int64_t endTime = getTime();
+
+	// Find the innermost open scope of the timer. Scopes opened after it are not
+	// stopped properly, so they end with it.
+	int openIndex = (int)m_openEvents.size() - 1;
+	while (openIndex >= 0 && m_events[m_openEvents[openIndex]].label != label)
+	{
+		openIndex--;
+	}
+	if (openIndex < 0)
+	{
+		return;
+	}
+
+	const size_t tempMemory = getTempMemory();
+	for (int i = (int)m_openEvents.size() - 1; i >= openIndex; --i)
+	{
+		duProfileEvent& event = m_events[m_openEvents[i]];
+		event.duration = endTime - event.start;
+		event.tempMemory = tempMemory >= event.tempMemory ? tempMemory - event.tempMemory : 0;
+		if (!event.nested)
+		{
+			m_accTime[event.label] = (m_accTime[event.label] == -1 ? 0 : m_accTime[event.label]) + event.duration;
+		}
+	}
+	m_openEvents.resize(openIndex);
+}
+
+int duProfilerContext::doGetAccumulatedTime(const rcTimerLabel label) const
+{
+	return m_accTime[label] == -1 ? -1 : (int)(m_accTime[label] / 1000);
+}
+
+void duProfilerContext::doSetTimerTile(const int tx, const int ty)
+{
+	m_tileX = tx;
+	m_tileY = ty;
+}
+
+duBuildProfiler::duBuildProfiler()
+: m_startTime(getClockTime())
+{
+}
+
+duBuildProfiler::~duBuildProfiler()
+{
+	purge();
+}
+
+void duBuildProfiler::purge()
+{
+	for (int i = 0; i < (int)m_contexts.size(); ++i)
+	{
+		duProfilerContext* ctx = getThreadContext(i);
+		ctx->~duProfilerContext();
+		rcFree(ctx);
+	}
+	m_contexts.clear();
+}
+
+bool duBuildProfiler::init(const int threadCount)
+{
+	rcAssert(threadCount >= 1);
+	purge();
+
+	if (!m_contexts.reserve(threadCount))
+	{
+		return false;
+	}
+	for (int i = 0; i < threadCount; ++i)
+	{
+		void* mem = rcAlloc(sizeof(duProfilerContext), RC_ALLOC_PERM);
+		if (!mem)
+		{
+			purge();
+			return false;
+		}
+		duProfilerContext* ctx = ::new(rcNewTag(), mem) duProfilerContext;
+		ctx->m_profiler = this;
+		ctx->m_threadIndex = i;
+		m_contexts.push_back(ctx);
+	}
+
+	reset();
+	return true;
+}
+
+void duBuildProfiler::reset()
+{
+	for (int i = 0; i < (int)m_contexts.size(); ++i)
+	{
+		m_contexts[i]->resetTimers();
+	}
+	m_startTime = getClockTime();
+}
+
+int64_t duBuildProfiler::getTime() const
+{
+	return getClockTime() - m_startTime;
+}
+
+static int compareFloats(const void* va, const void* vb)
+{
+	const float a = *(const float*)va;
+	const float b = *(const float*)vb;
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/// Returns the nearest-rank percentile of sorted values.
+static float getPercentile(const rcTempVector<float>& sorted, const int percent)
+{
+	const int n = (int)sorted.size();
+	const int rank = (percent * n + 99) / 100;
+	return sorted[rcClamp(rank - 1, 0, n - 1)];
+}
+
+bool duBuildProfiler::getStats(const rcTimerLabel label, duProfileStats& stats) const
+{
+	memset(&stats, 0, sizeof(stats));
+
+	// The time of the timer in each frame.
+	rcTempVector<float> frameTimes;
+	for (int i = 0; i < (int)m_contexts.size(); ++i)
+	{
+		const duProfilerContext* ctx = getThreadContext(i);
+		int frame = -1;
+		for (int j = 0; j < ctx->getEventCount(); ++j)
+		{
+			const duProfileEvent& event = ctx->getEvent(j);
+			if (event.label != label || event.nested || event.duration < 0)
+			{
+				continue;
+			}
+			if (event.frame != frame)
+			{
+				frameTimes.push_back(0.0f);
+				frame = event.frame;
+			}
+			frameTimes.back() += (float)event.duration / 1000000.0f;
+			stats.maxTempMemory = rcMax(stats.maxTempMemory, event.tempMemory);
+		}
+	}
+	if (frameTimes.empty())
+	{
+		return false;
+	}
+
+	qsort(frameTimes.data(), frameTimes.size(), sizeof(float), compareFloats);
+
+	stats.count = (int)frameTimes.size();
+	for (int i = 0; i < stats.count; ++i)
+	{
+		stats.total += frameTimes[i];
+	}
+	stats.mean = stats.total / (float)stats.count;
+	stats.p50 = getPercentile(frameTimes, 50);
+	stats.p90 = getPercentile(frameTimes, 90);
+	stats.p99 = getPercentile(frameTimes, 99);
+	stats.max = frameTimes.back();
+	return true;
+}
+
+bool duBuildProfiler::writeChromeTrace(duFileIO* io) const
+{
+	if (!io)
+	{
+		printf("duBuildProfiler::writeChromeTrace: input IO is null.\n");
+		return false;
+	}
+	if (!io->isWriting())
+	{
+		printf("duBuildProfiler::writeChromeTrace: input IO not writing.\n");
+		return false;
+	}
+
+	ioprintf(io, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (int i = 0; i < (int)m_contexts.size(); ++i)
+	{
+		ioprintf(io, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Build thread %d\"}}",
+				 i > 0 ? ",\n" : "", i, i);
+	}
+	for (int i = 0; i < (int)m_contexts.size(); ++i)
+	{
+		const duProfilerContext* ctx = getThreadContext(i);
+		for (int j = 0; j < ctx->getEventCount(); ++j)
+		{
+			const duProfileEvent& event = ctx->getEvent(j);
+			if (event.duration < 0)
+			{
+				continue;
+			}
+			// The trace event times are in microseconds.
+			ioprintf(io, ",\n{\"name\":\"%s\",\"cat\":\"recast\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+					 "\"args\":{\"frame\":%d,\"tx\":%d,\"ty\":%d,\"tempMemory\":%lu}}",
+					 duGetTimerLabelName(event.label), i, (double)event.start / 1000.0, (double)event.duration / 1000.0,
+					 event.frame, event.tx, event.ty, (unsigned long)event.tempMemory);
+		}
+	}
+	ioprintf(io, "\n]}\n");
+	return true;
+}
+
+namespace
+{
+/// The root scope of a frame, for sorting the frames by duration.
+struct duFrameRef
+{
+	const duProfileEvent* event;
+	int threadIndex;
+};
+
+int compareFramesByDuration(const void* va, const void* vb)
+{
+	const duFrameRef* a = (const duFrameRef*)va;
+	const duFrameRef* b = (const duFrameRef*)vb;
+	if (a->event->duration != b->event->duration)
+	{
+		return a->event->duration > b->event->duration ? -1 : 1;
+	}
+	return a->event->start < b->event->start ? -1 : (a->event->start > b->event->start ? 1 : 0);
+}
+}
+
+void duBuildProfiler::logSummary(rcContext& ctx, const int maxFrames) const
+{
+	ctx.log(RC_LOG_PROGRESS, "Build Profile (frames, total, p50, p90, p99, max, temp memory)");
+	for (int i = 0; i < RC_MAX_TIMERS; ++i)
+	{
+		duProfileStats stats;
+		if (!getStats((rcTimerLabel)i, stats))
+		{
+			continue;
+		}
+		ctx.log(RC_LOG_PROGRESS, "- %s:\t%d\t%.2fms\t%.3fms\t%.3fms\t%.3fms\t%.3fms\t%luKB",
+				duGetTimerLabelName((rcTimerLabel)i), stats.count, stats.total, stats.p50, stats.p90, stats.p99, stats.max,
+				(unsigned long)((stats.maxTempMemory + 1023) / 1024));
+	}
+
+	rcTempVector<duFrameRef> frames;
+	for (int i = 0; i < (int)m_contexts.size(); ++i)
+	{
+		const duProfilerContext* threadCtx = getThreadContext(i);
+		for (int j = 0; j < threadCtx->getEventCount(); ++j)
+		{
+			const duProfileEvent& event = threadCtx->getEvent(j);
+			if (event.parent == -1 && event.duration >= 0)
+			{
+				const duFrameRef frame = { &event, i };
+				frames.push_back(frame);
+			}
+		}
+	}
+	if (frames.empty() || maxFrames <= 0)
+	{
+		return;
+	}
+	qsort(frames.data(), frames.size(), sizeof(duFrameRef), compareFramesByDuration);
+
+	ctx.log(RC_LOG_PROGRESS, "Slowest Frames");
+	const int n = rcMin(maxFrames, (int)frames.size());
+	for (int i = 0; i < n; ++i)
+	{
+		const duProfileEvent& event = *frames[i].event;
+		ctx.log(RC_LOG_PROGRESS, "- %s tile (%d,%d) on thread %d:\t%.3fms", duGetTimerLabelName(event.label),
+				event.tx, event.ty, frames[i].threadIndex, (double)event.duration / 1000000.0);
+	}
+}
@@ -99,7 +99,11 @@ static const int DT_MAX_AREAS = 64;
 enum dtTileFlags
 {
 	/// The navigation mesh owns the tile memory and is responsible for freeing it.
-	DT_TILE_FREE_DATA = 0x01
+	DT_TILE_FREE_DATA = 0x01,
+
+	/// The navigation mesh does not write to the tile memory, so it can be shared
+	/// or mapped read-only. The polygons and links are allocated separately instead.
+	DT_TILE_READONLY_DATA = 0x02
 };
 
 /// Vertex flags returned by dtNavMeshQuery::findStraightPath.
@@ -305,6 +309,7 @@ struct dtMeshTile
 	unsigned char* data;					///< The tile data. (Not directly accessed under normal situations.)
 	int dataSize;							///< Size of the tile data.
 	int flags;								///< Tile flags. (See: #dtTileFlags)
+	unsigned char* dynamicData;				///< The separately allocated polygons and links of a tile with read-only data, or null.
 	dtMeshTile* next;						///< The next free tile, or the next tile in the spatial grid.
 };
 
@@ -354,6 +359,12 @@ public:
 	///  @see dtCreateNavMeshData
 	dtStatus init(unsigned char* data, const int dataSize, const int flags);
 	
+	/// Initializes the navigation mesh with the tiles of another navigation mesh,
+	/// sharing their data.
+	///  @param[in]	source		The navigation mesh to share the tiles of.
+	/// @return The status flags for the operation.
+	dtStatus initShared(const dtNavMesh* source);
+	
 	/// The navigation mesh initialization params.
 	const dtNavMeshParams* getParams() const;
 
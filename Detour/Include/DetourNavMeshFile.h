@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#ifndef DETOURNAVMESHFILE_H
+#define DETOURNAVMESHFILE_H
+
+#include <stddef.h>
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+/// A magic number used to detect compatibility of navigation mesh files.
+static const int DT_NAVMESH_FILE_MAGIC = 'D'<<24 | 'N'<<16 | 'M'<<8 | 'F';
+
+/// A version number used to detect compatibility of navigation mesh files.
+static const int DT_NAVMESH_FILE_VERSION = 1;
+
+/// The alignment of the tile data within a navigation mesh file.
+static const int DT_NAVMESH_FILE_ALIGNMENT = 16;
+
+/// The header of a navigation mesh file.
+/// The header is followed by the tile index, and the tile data.
+/// @ingroup detour
+struct dtNavMeshFileHeader
+{
+	int magic;					///< Navigation mesh file magic number. (Used to identify the data format.)
+	int version;				///< Navigation mesh file format version number.
+	int tileCount;				///< The number of tiles in the file.
+	int tileRefSize;			///< The size of a tile reference, depends on #DT_POLYREF64.
+	dtNavMeshParams params;		///< The parameters of the navigation mesh.
+};
+
+/// An entry of the tile index of a navigation mesh file.
+/// @ingroup detour
+struct dtNavMeshFileTile
+{
+	unsigned int dataOffsetLow;		///< The low 32 bits of the offset of the tile data from the start of the file.
+	unsigned int dataOffsetHigh;	///< The high 32 bits of the offset of the tile data from the start of the file.
+	int dataSize;					///< The size of the tile data.
+	int reserved;
+	dtTileRef tileRef;				///< The reference of the tile when it was saved.
+};
+
+/// A navigation mesh file mapped into memory.
+/// @ingroup detour
+struct dtNavMeshFileMapping
+{
+	const unsigned char* data;	///< The mapped file data.
+	size_t dataSize;			///< The size of the file.
+	void* handle;				///< Platform specific handle of the mapping.
+};
+
+/// Writes the tiles of a navigation mesh into a file.
+///  @param[in]		mesh	The navigation mesh to save.
+///  @param[in]		path	The path of the file.
+/// @return The status flags for the operation.
+/// @ingroup detour
+dtStatus dtSaveNavMeshFile(const dtNavMesh* mesh, const char* path);
+
+/// Initializes a navigation mesh with the tiles of a navigation mesh file.
+///
+/// The tiles are added with #DT_TILE_READONLY_DATA and reference the file data in place.
+/// If the file cannot be loaded, the tiles that were already added are removed again.
+///  @param[in]		mesh		The navigation mesh to initialize.
+///  @param[in]		data		The file data. Must stay valid until the navigation mesh is freed.
+///  @param[in]		dataSize	The size of the file data.
+/// @return The status flags for the operation.
+/// @ingroup detour
+dtStatus dtInitNavMeshFromFile(dtNavMesh* mesh, const unsigned char* data, const size_t dataSize);
+
+/// Maps a navigation mesh file read-only into memory.
+///  @param[in]		path		The path of the file.
+///  @param[out]	mapping		The mapping of the file.
+/// @return The status flags for the operation.
+/// @ingroup detour
+dtStatus dtMapNavMeshFile(const char* path, dtNavMeshFileMapping* mapping);
+
+/// Unmaps a file mapped with #dtMapNavMeshFile.
+///  @param[in]		mapping		The mapping of the file.
+/// @ingroup detour
+void dtUnmapNavMeshFile(dtNavMeshFileMapping* mapping);
+
+#endif // DETOURNAVMESHFILE_H
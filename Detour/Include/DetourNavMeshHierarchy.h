@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURNAVMESHHIERARCHY_H
+#define DETOURNAVMESHHIERARCHY_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+class dtNavMeshQuery;
+class dtQueryFilter;
+
+/// A portal on the border of a tile, where a polygon touches a neighbour tile.
+/// @ingroup detour
+struct dtHierarchyPortal
+{
+	float pos[3];			///< The midpoint of the border edge.
+	unsigned int poly;		///< The index of the polygon within its tile.
+	unsigned char side;		///< The tile side the portal is on. (See: #dtOppositeTile)
+};
+
+/// The abstract graph of a single navigation mesh tile.
+/// @ingroup detour
+struct dtHierarchyTile
+{
+	dtTileRef ref;					///< The reference of the tile the graph was built from, or zero if empty.
+	dtHierarchyPortal* portals;		///< The portals, sorted by polygon index. [Size: #portalCount]
+	float* costs;					///< The costs between each pair of portals, or FLT_MAX if not connected
+									///< within the tile. [Size: #portalCount * #portalCount]
+	int portalCount;				///< The number of portals.
+};
+
+/// Provides hierarchical path planning over the tiles of a navigation mesh.
+///
+/// The hierarchy is an abstract graph with a node for each tile-border portal.
+/// Portals of the same tile are connected by precomputed costs. Portals of
+/// neighbouring tiles are connected by the tile links of the navigation mesh.
+/// @ingroup detour
+class dtNavMeshHierarchy
+{
+public:
+	dtNavMeshHierarchy();
+	~dtNavMeshHierarchy();
+
+	/// Initializes the hierarchy and builds the graph for all tiles in the navigation mesh.
+	///  @param[in]		nav			The navigation mesh to plan on.
+	///  @param[in]		filter		The filter used to calculate the portal costs.
+	///  @param[in]		maxNodes	Maximum number of abstract search nodes. [Limits: 0 < value <= #DT_MAX_NODES]
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const dtQueryFilter* filter, const int maxNodes);
+
+	/// Rebuilds the graph of the tiles that were added or removed since the last update.
+	///  @param[out]	updatedTileCount	The number of tiles that were rebuilt. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus update(int* updatedTileCount = 0);
+
+	/// Finds a path from the start polygon to the end polygon.
+	///  @param[in]		query		The query used to refine the route. Must use the same navigation mesh.
+	///  @param[in]		startRef	The reference id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.)
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	///  @param[out]	routeCount	The number of portals on the abstract route, or zero if the path
+	///  							was searched directly with dtNavMeshQuery::findPath. [opt]
+	/// @returns The status flags for the query.
+	dtStatus findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  dtPolyRef* path, int* pathCount, const int maxPath, int* routeCount = 0);
+
+	/// Gets the graph of the tile at the specified index.
+	///  @param[in]	i		The tile index. [Limit: 0 >= index < dtNavMesh::getMaxTiles()]
+	/// @return The tile graph.
+	const dtHierarchyTile* getTile(int i) const { return &m_tiles[i]; }
+
+	/// The total number of portals in the graph.
+	/// @return The number of portals.
+	int getPortalCount() const;
+
+	/// The number of bytes used by the graph and its search data.
+	/// @return The memory used.
+	int getMemUsed() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshHierarchy(const dtNavMeshHierarchy&);
+	dtNavMeshHierarchy& operator=(const dtNavMeshHierarchy&);
+
+	/// Makes sure the search data can handle a tile with the given number of polygons and portals.
+	dtStatus reserveTileSearch(const int polyCount, const int portalCount);
+
+	/// Frees the graph of a tile.
+	void clearTile(dtHierarchyTile& htile);
+
+	/// Builds the graph of a tile.
+	dtStatus buildTile(const dtMeshTile* tile, dtHierarchyTile& htile);
+
+	/// Runs a Dijkstra search from the position within the tile and returns the costs to reach its portals.
+	dtStatus calcPortalCosts(const dtMeshTile* tile, const dtHierarchyTile& htile,
+							 dtPolyRef startRef, const float* startPos, float* costs);
+
+	/// Returns the index of the portal of the polygon with the search node state, or -1 if there is none.
+	int findPortal(const dtHierarchyTile& htile, unsigned int poly, unsigned char state) const;
+
+	/// Adds or updates the abstract search node of a portal.
+	void openPortal(struct dtNode* parent, dtPolyRef ref, const dtHierarchyPortal& portal,
+					const float cost, const float* endPos, bool& outOfNodes);
+
+	const dtNavMesh* m_nav;				///< Pointer to navmesh data.
+	const dtQueryFilter* m_filter;		///< The filter used for the portal costs.
+
+	dtHierarchyTile* m_tiles;			///< The tile graphs, indexed like the navmesh tiles.
+	int m_maxTiles;						///< The number of tile graphs.
+
+	class dtNodePool* m_tileNodePool;	///< Node pool for searches within a tile.
+	class dtNodeQueue* m_tileOpenList;	///< Open list for searches within a tile.
+	class dtNodePool* m_nodePool;		///< Node pool for the abstract search.
+	class dtNodeQueue* m_openList;		///< Open list for the abstract search.
+
+	float* m_startCosts;				///< Costs from the start position to the portals of its tile.
+	float* m_endCosts;					///< Costs from the portals of the end tile to the end position.
+	int m_maxPortalCosts;				///< The size of the start and end cost arrays.
+};
+
+/// Allocates a hierarchy object using the Detour allocator.
+/// @return An allocated hierarchy object, or null on failure.
+/// @ingroup detour
+dtNavMeshHierarchy* dtAllocNavMeshHierarchy();
+
+/// Frees the specified hierarchy object using the Detour allocator.
+///  @param[in]		hierarchy		A hierarchy object allocated using #dtAllocNavMeshHierarchy
+/// @ingroup detour
+void dtFreeNavMeshHierarchy(dtNavMeshHierarchy* hierarchy);
+
+#endif // DETOURNAVMESHHIERARCHY_H
@@ -20,6 +20,7 @@
 #define DETOURNODE_H
 
 #include "DetourNavMesh.h"
+#include "DetourAssert.h"
 
 enum dtNodeFlags
 {
@@ -28,10 +29,26 @@ enum dtNodeFlags
 	DT_NODE_PARENT_DETACHED = 0x04 // parent of the node is not adjacent. Found using raycast.
 };
 
+// Define (or define in a build config) the following line to use 32bit node indices.
+// Needed for searches that visit more than 65535 nodes, at the cost of twice the
+// memory for the node pool hash chains. (See: dtNodePool::getMemUsed)
+//#define DT_NODEINDEX32 1
+
+#ifdef DT_NODEINDEX32
+typedef unsigned int dtNodeIndex;
+#else
 typedef unsigned short dtNodeIndex;
+#endif
 static const dtNodeIndex DT_NULL_IDX = (dtNodeIndex)~0;
 
 static const int DT_NODE_PARENT_BITS = 24;
+
+/// The maximum number of nodes in a node pool. Limited by the node index type and by dtNode::pidx.
+#ifdef DT_NODEINDEX32
+static const int DT_MAX_NODES = (1 << DT_NODE_PARENT_BITS) - 1;
+#else
+static const int DT_MAX_NODES = 0xffff;
+#endif
 static const int DT_NODE_STATE_BITS = 2;
 struct dtNode
 {
@@ -41,6 +58,7 @@ struct dtNode
 	unsigned int pidx : DT_NODE_PARENT_BITS;	///< Index to parent node.
 	unsigned int state : DT_NODE_STATE_BITS;	///< extra state information. A polyRef can have multiple nodes with different extra info. see DT_MAX_STATES_PER_NODE
 	unsigned int flags : 3;						///< Node flags. A combination of dtNodeFlags.
+	int heapIdx;								///< Position of the node in the open list heap. Only valid while the node is open.
 	dtPolyRef id;								///< Polygon ref the node corresponds to.
 };
 
@@ -51,6 +69,9 @@ class dtNodePool
 public:
 	dtNodePool(int maxNodes, int hashSize);
 	~dtNodePool();
+
+	// Removes all nodes from the pool. Hash buckets are stamped with a generation
+	// and stale buckets are treated as empty, so this does not touch the hash table.
 	void clear();
 
 	// Get a dtNode by ref and extra state information. If there is none then - allocate
@@ -82,13 +103,14 @@ public:
 		return sizeof(*this) +
 			sizeof(dtNode)*m_maxNodes +
 			sizeof(dtNodeIndex)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_hashSize;
+			sizeof(dtNodeIndex)*m_hashSize +
+			sizeof(unsigned int)*m_hashSize;
 	}
 	
 	inline int getMaxNodes() const { return m_maxNodes; }
 	
 	inline int getHashSize() const { return m_hashSize; }
-	inline dtNodeIndex getFirst(int bucket) const { return m_first[bucket]; }
+	inline dtNodeIndex getFirst(int bucket) const { return m_bucketGen[bucket] == m_generation ? m_first[bucket] : DT_NULL_IDX; }
 	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
 	inline int getNodeCount() const { return m_nodeCount; }
 	
@@ -100,9 +122,11 @@ private:
 	dtNode* m_nodes;
 	dtNodeIndex* m_first;
 	dtNodeIndex* m_next;
+	unsigned int* m_bucketGen;	///< The generation each bucket in #m_first was last written in.
 	const int m_maxNodes;
 	const int m_hashSize;
 	int m_nodeCount;
+	unsigned int m_generation;
 };
 
 class dtNodeQueue
@@ -129,16 +153,11 @@ public:
 		bubbleUp(m_size-1, node);
 	}
 	
+	/// Restores the heap order after the total cost of a queued node decreased.
 	inline void modify(dtNode* node)
 	{
-		for (int i = 0; i < m_size; ++i)
-		{
-			if (m_heap[i] == node)
-			{
-				bubbleUp(i, node);
-				return;
-			}
-		}
+		dtAssert(node->heapIdx >= 0 && node->heapIdx < m_size && m_heap[node->heapIdx] == node);
+		bubbleUp(node->heapIdx, node);
 	}
 	
 	inline bool empty() const { return m_size == 0; }
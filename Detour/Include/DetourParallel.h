@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPARALLEL_H
+#define DETOURPARALLEL_H
+
+/// A unit of work that is executed once for each item of a parallel loop.
+///
+/// Implementations must be safe to call concurrently for different item
+/// indices. Per-thread scratch data can be indexed with @p threadIndex, which
+/// is guaranteed to be unique among the threads running the same loop.
+/// @see dtTaskScheduler, dtParallelFor
+class dtParallelTask
+{
+public:
+	virtual ~dtParallelTask() {}
+
+	/// Processes a single item of the loop.
+	///  @param[in]		itemIndex	The index of the item to process. [Limits: 0 <= value < itemCount]
+	///  @param[in]		threadIndex	The index of the executing thread.
+	///  							[Limits: 0 <= value < dtTaskScheduler::getThreadCount()]
+	virtual void execute(int itemIndex, int threadIndex) = 0;
+};
+
+/// Provides an interface for running Detour work, such as crowd updates, on multiple threads.
+///
+/// Users with an existing job system can implement this interface to let
+/// Detour use it. Detour does not start threads itself; to use the thread pool
+/// of #rcAllocThreadPool, wrap it with #dtTaskSchedulerAdapter.
+///
+/// @ingroup detour
+class dtTaskScheduler
+{
+public:
+	virtual ~dtTaskScheduler() {}
+
+	/// The maximum number of threads that may run tasks concurrently,
+	/// including the calling thread.
+	///  @return The thread count. [Limit: >= 1]
+	virtual int getThreadCount() const = 0;
+
+	/// Runs the task for every item in the range [0, @p itemCount), and returns
+	/// once all of them have completed.
+	///  @param[in]		task		The task to run.
+	///  @param[in]		itemCount	The number of items to process.
+	virtual void parallelFor(dtParallelTask& task, int itemCount) = 0;
+};
+
+/// Runs Detour work on a scheduler with the same interface, such as the Recast thread pool.
+///
+/// The adapter does not take ownership of the scheduler.
+/// @code
+/// rcTaskScheduler* pool = rcAllocThreadPool(4);
+/// dtTaskSchedulerAdapter<rcTaskScheduler, rcParallelTask> scheduler(pool);
+/// crowd->setTaskScheduler(&scheduler);
+/// @endcode
+///
+/// @tparam		Scheduler	The scheduler type, which provides <tt>int getThreadCount() const</tt>
+/// 						and <tt>void parallelFor(Task& task, int itemCount)</tt>.
+/// @tparam		Task		The task interface of the scheduler, with a virtual
+/// 						<tt>void execute(int itemIndex, int threadIndex)</tt>.
+/// @ingroup detour
+template<class Scheduler, class Task>
+class dtTaskSchedulerAdapter : public dtTaskScheduler
+{
+public:
+	///  @param[in]		scheduler	The scheduler to run the tasks on.
+	explicit dtTaskSchedulerAdapter(Scheduler* scheduler) : m_scheduler(scheduler) {}
+
+	virtual int getThreadCount() const { return m_scheduler->getThreadCount(); }
+
+	virtual void parallelFor(dtParallelTask& task, int itemCount)
+	{
+		TaskAdapter adapter(task);
+		m_scheduler->parallelFor(adapter, itemCount);
+	}
+
+private:
+	class TaskAdapter : public Task
+	{
+	public:
+		explicit TaskAdapter(dtParallelTask& task) : m_task(task) {}
+		virtual void execute(int itemIndex, int threadIndex) { m_task.execute(itemIndex, threadIndex); }
+
+	private:
+		// Explicitly disabled copy constructor and copy assignment operator.
+		TaskAdapter(const TaskAdapter&);
+		TaskAdapter& operator=(const TaskAdapter&);
+
+		dtParallelTask& m_task;
+	};
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTaskSchedulerAdapter(const dtTaskSchedulerAdapter&);
+	dtTaskSchedulerAdapter& operator=(const dtTaskSchedulerAdapter&);
+
+	Scheduler* m_scheduler;
+};
+
+/// Returns the number of threads available to the scheduler.
+///  @param[in]		scheduler	The scheduler, or null for serial execution.
+///  @return The thread count. [Limit: >= 1]
+inline int dtGetThreadCount(const dtTaskScheduler* scheduler)
+{
+	return scheduler ? scheduler->getThreadCount() : 1;
+}
+
+/// Runs the task for every item in the range [0, @p itemCount).
+///
+/// If @p scheduler is null, the items are processed in order on the calling
+/// thread with a thread index of zero.
+///  @param[in]		scheduler	The scheduler to run the loop on, or null.
+///  @param[in]		task		The task to run.
+///  @param[in]		itemCount	The number of items to process.
+void dtParallelFor(dtTaskScheduler* scheduler, dtParallelTask& task, int itemCount);
+
+#endif // DETOURPARALLEL_H
@@ -216,6 +216,8 @@ dtNavMesh::~dtNavMesh()
 			m_tiles[i].data = 0;
 			m_tiles[i].dataSize = 0;
 		}
+		dtFree(m_tiles[i].dynamicData);
+		m_tiles[i].dynamicData = 0;
 	}
 	dtFree(m_posLookup);
 	dtFree(m_tiles);
@@ -291,6 +293,39 @@ dtStatus dtNavMesh::init(unsigned char* data, const int dataSize, const int flag
 	return addTile(data, dataSize, flags, 0, 0);
 }
 
+/// @par
+///
+/// The tiles are added with #DT_TILE_READONLY_DATA and keep their tile
+/// references, so polygon references are the same in both meshes. Each mesh
+/// has its own polygons and links, so tiles can be added, removed and
+/// modified independently, while the vertices, detail meshes and bounding
+/// volumes are shared.
+///
+/// The tile data must stay valid while it is used by this mesh. It is not
+/// freed by this mesh, so the source mesh, or whoever owns the data, must
+/// outlive it or the shared tiles must be removed first.
+dtStatus dtNavMesh::initShared(const dtNavMesh* source)
+{
+	if (!source)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	dtStatus status = init(source->getParams());
+	if (dtStatusFailed(status))
+		return status;
+	
+	for (int i = 0; i < source->m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = &source->m_tiles[i];
+		if (!tile->header || !tile->dataSize)
+			continue;
+		status = addTile(tile->data, tile->dataSize, DT_TILE_READONLY_DATA, source->getTileRef(tile), 0);
+		if (dtStatusFailed(status))
+			return status;
+	}
+	
+	return DT_SUCCESS;
+}
+
 /// @par
 ///
 /// @note The parameters are created automatically when the single tile
@@ -910,6 +945,12 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 /// should not be reused in other nav meshes until the tile has been successfully
 /// removed from this nav mesh.
 ///
+/// With #DT_TILE_READONLY_DATA the dynamic portion is instead allocated by the
+/// nav mesh: the polygons and links, and the vertices if the tile has off-mesh
+/// connections. The data itself is never written to, so it can be shared by
+/// several nav meshes or mapped read-only from a file, and must stay valid
+/// until the tile is removed.
+///
 /// @see dtCreateNavMeshData, #removeTile
 dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 							dtTileRef lastRef, dtTileRef* result)
@@ -931,6 +972,27 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	// Make sure the location is free.
 	if (getTileAt(header->x, header->y, header->layer))
 		return DT_FAILURE | DT_ALREADY_OCCUPIED;
+	
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
+	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
+	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	
+	// Read-only tiles get their own copy of the parts that are written to.
+	// Off-mesh connections snap their end points to the connected polygons.
+	unsigned char* dynamicData = 0;
+	const int dynamicVertsSize = header->offMeshConCount > 0 ? vertsSize : 0;
+	if (flags & DT_TILE_READONLY_DATA)
+	{
+		dynamicData = (unsigned char*)dtAlloc(polysSize + linksSize + dynamicVertsSize, DT_ALLOC_PERM);
+		if (!dynamicData)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
 		
 	// Allocate a tile.
 	dtMeshTile* tile = 0;
@@ -948,7 +1010,10 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		// Try to relocate the tile to specific index with same salt.
 		int tileIndex = (int)decodePolyIdTile((dtPolyRef)lastRef);
 		if (tileIndex >= m_maxTiles)
+		{
+			dtFree(dynamicData);
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
 		// Try to find the specific tile id from the free list.
 		dtMeshTile* target = &m_tiles[tileIndex];
 		dtMeshTile* prev = 0;
@@ -960,7 +1025,10 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		}
 		// Could not find the correct location.
 		if (tile != target)
+		{
+			dtFree(dynamicData);
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
 		// Remove from freelist
 		if (!prev)
 			m_nextFree = tile->next;
@@ -973,7 +1041,10 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 
 	// Make sure we could allocate a tile.
 	if (!tile)
+	{
+		dtFree(dynamicData);
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
 	
 	// Insert tile into the position lut.
 	int h = computeTileHash(header->x, header->y, m_tileLutMask);
@@ -981,16 +1052,6 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	m_posLookup[h] = tile;
 	
 	// Patch header pointers.
-	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
-	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
-	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
-	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
-	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
-	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
-	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
-	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
-	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
-	
 	unsigned char* d = data + headerSize;
 	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
 	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
@@ -1005,6 +1066,23 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	if (!bvtreeSize)
 		tile->bvTree = 0;
 
+	// Point the dynamic parts to the separate allocation.
+	tile->dynamicData = dynamicData;
+	if (dynamicData)
+	{
+		unsigned char* dd = dynamicData;
+		dtPoly* polys = dtGetThenAdvanceBufferPointer<dtPoly>(dd, polysSize);
+		memcpy(polys, tile->polys, polysSize);
+		tile->polys = polys;
+		tile->links = dtGetThenAdvanceBufferPointer<dtLink>(dd, linksSize);
+		if (dynamicVertsSize)
+		{
+			float* verts = dtGetThenAdvanceBufferPointer<float>(dd, dynamicVertsSize);
+			memcpy(verts, tile->verts, dynamicVertsSize);
+			tile->verts = verts;
+		}
+	}
+
 	// Build links freelist
 	tile->linksFreeList = 0;
 	tile->links[header->maxLinkCount-1].next = DT_NULL_LINK;
@@ -1309,6 +1387,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 		if (data) *data = tile->data;
 		if (dataSize) *dataSize = tile->dataSize;
 	}
+	dtFree(tile->dynamicData);
+	tile->dynamicData = 0;
 
 	tile->header = 0;
 	tile->flags = 0;
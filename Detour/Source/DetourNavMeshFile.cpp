@@ -0,0 +1,272 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+
+#include "DetourNavMeshFile.h"
+#include "DetourNavMesh.h"
+#include "DetourAlloc.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+static size_t alignFileOffset(const size_t offset)
+{
+	return (offset + DT_NAVMESH_FILE_ALIGNMENT-1) & ~(size_t)(DT_NAVMESH_FILE_ALIGNMENT-1);
+}
+
+static bool writePadding(FILE* fp, size_t& pos, const size_t offset)
+{
+	static const unsigned char zeros[DT_NAVMESH_FILE_ALIGNMENT] = { 0 };
+	const size_t n = offset - pos;
+	if (n > 0 && fwrite(zeros, 1, n, fp) != n)
+		return false;
+	pos = offset;
+	return true;
+}
+
+/// @par
+///
+/// The tiles are stored with their tile references, so the polygon references
+/// stay the same when the file is loaded. The tile data is stored as is, and
+/// is aligned to #DT_NAVMESH_FILE_ALIGNMENT bytes so it can be used in place.
+///
+/// The file uses the native byte order, and the size of the references
+/// depends on #DT_POLYREF64.
+///
+/// @see dtInitNavMeshFromFile
+dtStatus dtSaveNavMeshFile(const dtNavMesh* mesh, const char* path)
+{
+	if (!mesh || !path)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	dtNavMeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = DT_NAVMESH_FILE_MAGIC;
+	header.version = DT_NAVMESH_FILE_VERSION;
+	header.tileRefSize = (int)sizeof(dtTileRef);
+	memcpy(&header.params, mesh->getParams(), sizeof(dtNavMeshParams));
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (tile && tile->header && tile->dataSize)
+			header.tileCount++;
+	}
+	
+	dtNavMeshFileTile* index = 0;
+	if (header.tileCount > 0)
+	{
+		index = (dtNavMeshFileTile*)dtAlloc(sizeof(dtNavMeshFileTile)*header.tileCount, DT_ALLOC_TEMP);
+		if (!index)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		memset(index, 0, sizeof(dtNavMeshFileTile)*header.tileCount);
+	}
+	
+	// Lay out the tile data after the index.
+	size_t offset = alignFileOffset(sizeof(dtNavMeshFileHeader) + sizeof(dtNavMeshFileTile)*header.tileCount);
+	int n = 0;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize)
+			continue;
+		dtNavMeshFileTile& entry = index[n++];
+		entry.dataOffsetLow = (unsigned int)(offset & 0xffffffff);
+		entry.dataOffsetHigh = (unsigned int)((offset >> 16) >> 16);
+		entry.dataSize = tile->dataSize;
+		entry.tileRef = mesh->getTileRef(tile);
+		offset = alignFileOffset(offset + tile->dataSize);
+	}
+	
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+	{
+		dtFree(index);
+		return DT_FAILURE;
+	}
+	
+	bool ok = fwrite(&header, sizeof(dtNavMeshFileHeader), 1, fp) == 1;
+	if (ok && header.tileCount > 0)
+		ok = fwrite(index, sizeof(dtNavMeshFileTile), header.tileCount, fp) == (size_t)header.tileCount;
+	
+	size_t pos = sizeof(dtNavMeshFileHeader) + sizeof(dtNavMeshFileTile)*header.tileCount;
+	n = 0;
+	for (int i = 0; ok && i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize)
+			continue;
+		const dtNavMeshFileTile& entry = index[n++];
+		ok = writePadding(fp, pos, (size_t)entry.dataOffsetLow | (((size_t)entry.dataOffsetHigh << 16) << 16));
+		if (ok)
+			ok = fwrite(tile->data, 1, tile->dataSize, fp) == (size_t)tile->dataSize;
+		pos += tile->dataSize;
+	}
+	
+	dtFree(index);
+	if (fclose(fp) != 0)
+		ok = false;
+	
+	return ok ? DT_SUCCESS : DT_FAILURE;
+}
+
+/// @par
+///
+/// The navigation mesh only reads the file data, so the same data, for example
+/// a file mapped with #dtMapNavMeshFile, can be used by several navigation meshes
+/// and processes at the same time.
+///
+/// @see dtSaveNavMeshFile, dtMapNavMeshFile
+dtStatus dtInitNavMeshFromFile(dtNavMesh* mesh, const unsigned char* data, const size_t dataSize)
+{
+	if (!mesh || !data || dataSize < sizeof(dtNavMeshFileHeader))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const dtNavMeshFileHeader* header = (const dtNavMeshFileHeader*)data;
+	if (header->magic != DT_NAVMESH_FILE_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header->version != DT_NAVMESH_FILE_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (header->tileRefSize != (int)sizeof(dtTileRef) || header->tileCount < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (sizeof(dtNavMeshFileHeader) + sizeof(dtNavMeshFileTile)*(size_t)header->tileCount > dataSize)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	dtStatus status = mesh->init(&header->params);
+	if (dtStatusFailed(status))
+		return status;
+	
+	const dtNavMeshFileTile* index = (const dtNavMeshFileTile*)(data + sizeof(dtNavMeshFileHeader));
+	for (int i = 0; i < header->tileCount; ++i)
+	{
+		const dtNavMeshFileTile& entry = index[i];
+		
+		// An offset that does not fit in the address space cannot be within the data.
+		const size_t offset = (size_t)entry.dataOffsetLow | (((size_t)entry.dataOffsetHigh << 16) << 16);
+		if ((((offset >> 16) >> 16) & 0xffffffff) != entry.dataOffsetHigh ||
+			entry.dataSize <= 0 || offset > dataSize || (size_t)entry.dataSize > dataSize - offset)
+		{
+			status = DT_FAILURE | DT_INVALID_PARAM;
+			break;
+		}
+		
+		// The mesh does not write to read-only tile data.
+		unsigned char* tileData = const_cast<unsigned char*>(data + offset);
+		status = mesh->addTile(tileData, entry.dataSize, DT_TILE_READONLY_DATA, entry.tileRef, 0);
+		if (dtStatusFailed(status))
+			break;
+	}
+	
+	// Do not leave a partially loaded mesh that references the data.
+	if (dtStatusFailed(status))
+	{
+		for (int i = 0; i < mesh->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)mesh)->getTile(i);
+			if (tile->header)
+				mesh->removeTile(mesh->getTileRef(tile), 0, 0);
+		}
+		return status;
+	}
+	
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The file is mapped with shared, read-only pages, so processes that map
+/// the same file share a single copy of it in memory.
+///
+/// @see dtUnmapNavMeshFile, dtInitNavMeshFromFile
+dtStatus dtMapNavMeshFile(const char* path, dtNavMeshFileMapping* mapping)
+{
+	if (!path || !mapping)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	mapping->data = 0;
+	mapping->dataSize = 0;
+	mapping->handle = 0;
+	
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return DT_FAILURE;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || (unsigned long long)size.QuadPart > (size_t)-1)
+	{
+		CloseHandle(file);
+		return DT_FAILURE;
+	}
+	HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!map)
+		return DT_FAILURE;
+	void* mem = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	if (!mem)
+	{
+		CloseHandle(map);
+		return DT_FAILURE;
+	}
+	mapping->data = (const unsigned char*)mem;
+	mapping->dataSize = (size_t)size.QuadPart;
+	mapping->handle = map;
+#else
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return DT_FAILURE;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return DT_FAILURE;
+	}
+	void* mem = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED)
+		return DT_FAILURE;
+	mapping->data = (const unsigned char*)mem;
+	mapping->dataSize = (size_t)st.st_size;
+#endif
+	
+	return DT_SUCCESS;
+}
+
+void dtUnmapNavMeshFile(dtNavMeshFileMapping* mapping)
+{
+	if (!mapping || !mapping->data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(mapping->data);
+	CloseHandle((HANDLE)mapping->handle);
+#else
+	munmap(const_cast<unsigned char*>(mapping->data), mapping->dataSize);
+#endif
+	mapping->data = 0;
+	mapping->dataSize = 0;
+	mapping->handle = 0;
+}
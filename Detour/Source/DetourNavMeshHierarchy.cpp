@@ -0,0 +1,784 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <string.h>
+#include "DetourNavMeshHierarchy.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourNode.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <new>
+
+static const float H_SCALE = 0.999f; // Search heuristic scale.
+
+// The search node state of a portal. Tile border sides are 0, 2, 4 and 6,
+// so each polygon can have at most DT_MAX_STATES_PER_NODE portals.
+inline unsigned char portalState(const unsigned char side)
+{
+	return (unsigned char)((side >> 1) & (DT_MAX_STATES_PER_NODE - 1));
+}
+
+// Returns the point where a polygon is entered from its neighbour within the same tile.
+static void getLinkPoint(const dtMeshTile* tile, const dtPoly* poly, const dtPolyRef ref,
+						 const dtLink& link, const dtPoly* neighbourPoly, float* pt)
+{
+	if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		dtVcopy(pt, &tile->verts[poly->verts[link.edge]*3]);
+		return;
+	}
+
+	if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+	{
+		for (unsigned int i = neighbourPoly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			if (tile->links[i].ref == ref)
+			{
+				dtVcopy(pt, &tile->verts[neighbourPoly->verts[tile->links[i].edge]*3]);
+				return;
+			}
+		}
+		dtVcopy(pt, &tile->verts[neighbourPoly->verts[0]*3]);
+		return;
+	}
+
+	const float* va = &tile->verts[poly->verts[link.edge]*3];
+	const float* vb = &tile->verts[poly->verts[(link.edge+1) % (int)poly->vertCount]*3];
+	dtVlerp(pt, va, vb, 0.5f);
+}
+
+dtNavMeshHierarchy* dtAllocNavMeshHierarchy()
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshHierarchy), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshHierarchy;
+}
+
+void dtFreeNavMeshHierarchy(dtNavMeshHierarchy* hierarchy)
+{
+	if (!hierarchy) return;
+	hierarchy->~dtNavMeshHierarchy();
+	dtFree(hierarchy);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+/// @class dtNavMeshHierarchy
+///
+/// Long paths across many tiles are expensive for dtNavMeshQuery::findPath, which
+/// expands the polygons one at a time. The hierarchy first plans a coarse route
+/// over the tile-border portals, and then refines it with dtNavMeshQuery::findPath
+/// between consecutive portals, which only searches the tiles along the route.
+///
+/// The portals and costs of a tile depend only on the tile's own data, and the
+/// connections between tiles are read from the live navigation mesh links. So
+/// after tiles are added or removed, for example by a dtTileCache, only the
+/// changed tiles need to be rebuilt with #update. Tiles that have changed but
+/// have not been updated yet are left out of the abstract search.
+///
+/// The route is approximate: portals are placed at the border edge midpoints,
+/// and the costs from the end tile portals to the end position assume symmetric
+/// costs. Off-mesh connections that cross tile borders are not part of the graph.
+///
+/// @see dtNavMeshQuery
+
+dtNavMeshHierarchy::dtNavMeshHierarchy() :
+	m_nav(0),
+	m_filter(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_tileNodePool(0),
+	m_tileOpenList(0),
+	m_nodePool(0),
+	m_openList(0),
+	m_startCosts(0),
+	m_endCosts(0),
+	m_maxPortalCosts(0)
+{
+}
+
+dtNavMeshHierarchy::~dtNavMeshHierarchy()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		clearTile(m_tiles[i]);
+	dtFree(m_tiles);
+
+	if (m_tileNodePool)
+		m_tileNodePool->~dtNodePool();
+	if (m_tileOpenList)
+		m_tileOpenList->~dtNodeQueue();
+	if (m_nodePool)
+		m_nodePool->~dtNodePool();
+	if (m_openList)
+		m_openList->~dtNodeQueue();
+	dtFree(m_tileNodePool);
+	dtFree(m_tileOpenList);
+	dtFree(m_nodePool);
+	dtFree(m_openList);
+
+	dtFree(m_startCosts);
+	dtFree(m_endCosts);
+}
+
+/// @par
+///
+/// The @p filter pointer is stored and used for all later updates and path
+/// queries, so the portal costs stay consistent. It must not be freed while
+/// the hierarchy is in use.
+///
+/// This function can be used multiple times.
+dtStatus dtNavMeshHierarchy::init(const dtNavMesh* nav, const dtQueryFilter* filter, const int maxNodes)
+{
+	if (!nav || !filter || maxNodes <= 0 || maxNodes > DT_MAX_NODES)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	for (int i = 0; i < m_maxTiles; ++i)
+		clearTile(m_tiles[i]);
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+
+	m_nav = nav;
+	m_filter = filter;
+
+	const int maxTiles = nav->getMaxTiles();
+	m_tiles = (dtHierarchyTile*)dtAlloc(sizeof(dtHierarchyTile)*maxTiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_tiles, 0, sizeof(dtHierarchyTile)*maxTiles);
+	m_maxTiles = maxTiles;
+
+	if (!m_nodePool || m_nodePool->getMaxNodes() < maxNodes)
+	{
+		if (m_nodePool)
+		{
+			m_nodePool->~dtNodePool();
+			dtFree(m_nodePool);
+			m_nodePool = 0;
+		}
+		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(dtMax(1, maxNodes/4)));
+		if (!m_nodePool)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	if (!m_openList || m_openList->getCapacity() < maxNodes)
+	{
+		if (m_openList)
+		{
+			m_openList->~dtNodeQueue();
+			dtFree(m_openList);
+			m_openList = 0;
+		}
+		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes);
+		if (!m_openList)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	return update();
+}
+
+/// @par
+///
+/// Tiles are matched by their tile reference, which changes every time a tile
+/// is added or removed. Call this after modifying the navigation mesh, for
+/// example after dtTileCache::update reports that it is up to date.
+dtStatus dtNavMeshHierarchy::update(int* updatedTileCount)
+{
+	dtAssert(m_nav);
+
+	if (updatedTileCount)
+		*updatedTileCount = 0;
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		const dtTileRef ref = tile->header ? m_nav->getTileRef(tile) : 0;
+		if (ref == m_tiles[i].ref)
+			continue;
+
+		clearTile(m_tiles[i]);
+		if (ref)
+		{
+			dtStatus status = buildTile(tile, m_tiles[i]);
+			if (dtStatusFailed(status))
+				return status;
+		}
+
+		if (updatedTileCount)
+			(*updatedTileCount)++;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshHierarchy::reserveTileSearch(const int tilePolyCount, const int portalCount)
+{
+	const int polyCount = dtMax(1, tilePolyCount);
+
+	if (!m_tileNodePool || m_tileNodePool->getMaxNodes() < polyCount)
+	{
+		if (m_tileNodePool)
+		{
+			m_tileNodePool->~dtNodePool();
+			dtFree(m_tileNodePool);
+			m_tileNodePool = 0;
+		}
+		m_tileNodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(polyCount, dtNextPow2(dtMax(1, polyCount/4)));
+		if (!m_tileNodePool)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	if (!m_tileOpenList || m_tileOpenList->getCapacity() < polyCount)
+	{
+		if (m_tileOpenList)
+		{
+			m_tileOpenList->~dtNodeQueue();
+			dtFree(m_tileOpenList);
+			m_tileOpenList = 0;
+		}
+		m_tileOpenList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(polyCount);
+		if (!m_tileOpenList)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	if (m_maxPortalCosts < portalCount)
+	{
+		dtFree(m_startCosts);
+		dtFree(m_endCosts);
+		m_startCosts = (float*)dtAlloc(sizeof(float)*portalCount, DT_ALLOC_PERM);
+		m_endCosts = (float*)dtAlloc(sizeof(float)*portalCount, DT_ALLOC_PERM);
+		if (!m_startCosts || !m_endCosts)
+		{
+			m_maxPortalCosts = 0;
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		m_maxPortalCosts = portalCount;
+	}
+
+	return DT_SUCCESS;
+}
+
+void dtNavMeshHierarchy::clearTile(dtHierarchyTile& htile)
+{
+	dtFree(htile.portals);
+	dtFree(htile.costs);
+	memset(&htile, 0, sizeof(dtHierarchyTile));
+}
+
+dtStatus dtNavMeshHierarchy::buildTile(const dtMeshTile* tile, dtHierarchyTile& htile)
+{
+	const dtMeshHeader* header = tile->header;
+
+	// Count the portals. Each polygon gets one portal per tile side it touches.
+	int portalCount = 0;
+	for (int i = 0; i < header->polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+			continue;
+		unsigned char states = 0;
+		for (int j = 0; j < (int)poly->vertCount; ++j)
+		{
+			if ((poly->neis[j] & DT_EXT_LINK) == 0)
+				continue;
+			const unsigned char state = portalState((unsigned char)(poly->neis[j] & 0xff));
+			if (states & (1 << state))
+				continue;
+			states |= (unsigned char)(1 << state);
+			portalCount++;
+		}
+	}
+
+	dtStatus status = reserveTileSearch(header->polyCount, portalCount);
+	if (dtStatusFailed(status))
+		return status;
+
+	if (portalCount > 0)
+	{
+		htile.portals = (dtHierarchyPortal*)dtAlloc(sizeof(dtHierarchyPortal)*portalCount, DT_ALLOC_PERM);
+		htile.costs = (float*)dtAlloc(sizeof(float)*portalCount*portalCount, DT_ALLOC_PERM);
+		if (!htile.portals || !htile.costs)
+		{
+			clearTile(htile);
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+
+	// Place the portals at the border edge midpoints.
+	for (int i = 0; i < header->polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+			continue;
+		unsigned char states = 0;
+		for (int j = 0; j < (int)poly->vertCount; ++j)
+		{
+			if ((poly->neis[j] & DT_EXT_LINK) == 0)
+				continue;
+			const unsigned char side = (unsigned char)(poly->neis[j] & 0xff);
+			const unsigned char state = portalState(side);
+			if (states & (1 << state))
+				continue;
+			states |= (unsigned char)(1 << state);
+
+			dtHierarchyPortal& portal = htile.portals[htile.portalCount++];
+			const float* va = &tile->verts[poly->verts[j]*3];
+			const float* vb = &tile->verts[poly->verts[(j+1) % (int)poly->vertCount]*3];
+			dtVlerp(portal.pos, va, vb, 0.5f);
+			portal.poly = (unsigned int)i;
+			portal.side = side;
+		}
+	}
+	dtAssert(htile.portalCount == portalCount);
+
+	// Precompute the costs between the portals.
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+	for (int i = 0; i < portalCount; ++i)
+	{
+		const dtHierarchyPortal& portal = htile.portals[i];
+		const dtPolyRef ref = base | (dtPolyRef)portal.poly;
+		float* costs = &htile.costs[i*portalCount];
+		if (!m_filter->passFilter(ref, tile, &tile->polys[portal.poly]))
+		{
+			for (int j = 0; j < portalCount; ++j)
+				costs[j] = FLT_MAX;
+			continue;
+		}
+		calcPortalCosts(tile, htile, ref, portal.pos, costs);
+		costs[i] = 0;
+	}
+
+	htile.ref = m_nav->getTileRef(tile);
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshHierarchy::calcPortalCosts(const dtMeshTile* tile, const dtHierarchyTile& htile,
+											 dtPolyRef startRef, const float* startPos, float* costs)
+{
+	dtAssert(m_tileNodePool);
+	dtAssert(m_tileOpenList);
+
+	m_tileNodePool->clear();
+	m_tileOpenList->clear();
+
+	dtNode* startNode = m_tileNodePool->getNode(startRef);
+	dtVcopy(startNode->pos, startPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = 0;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	m_tileOpenList->push(startNode);
+
+	while (!m_tileOpenList->empty())
+	{
+		dtNode* bestNode = m_tileOpenList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+
+		const dtPolyRef bestRef = bestNode->id;
+		const dtPoly* bestPoly = &tile->polys[m_nav->decodePolyIdPoly(bestRef)];
+
+		dtPolyRef parentRef = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+		{
+			parentRef = m_tileNodePool->getNodeAtIdx(bestNode->pidx)->id;
+			parentPoly = &tile->polys[m_nav->decodePolyIdPoly(parentRef)];
+		}
+
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink& link = tile->links[i];
+
+			// Stay within the tile. Only links to other tiles have a side.
+			if (!link.ref || link.ref == parentRef || link.side != 0xff)
+				continue;
+
+			const dtPolyRef neighbourRef = link.ref;
+			const dtPoly* neighbourPoly = &tile->polys[m_nav->decodePolyIdPoly(neighbourRef)];
+			if (!m_filter->passFilter(neighbourRef, tile, neighbourPoly))
+				continue;
+
+			dtNode* neighbourNode = m_tileNodePool->getNode(neighbourRef);
+			if (!neighbourNode)
+				continue;
+
+			if (neighbourNode->flags == 0)
+				getLinkPoint(tile, bestPoly, neighbourRef, link, neighbourPoly, neighbourNode->pos);
+
+			const float cost = bestNode->cost + m_filter->getCost(bestNode->pos, neighbourNode->pos,
+																  parentRef, parentRef ? tile : 0, parentPoly,
+																  bestRef, tile, bestPoly,
+																  neighbourRef, tile, neighbourPoly);
+
+			if ((neighbourNode->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)) && cost >= neighbourNode->total)
+				continue;
+
+			neighbourNode->pidx = m_tileNodePool->getNodeIdx(bestNode);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+			neighbourNode->cost = cost;
+			neighbourNode->total = cost;
+
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				m_tileOpenList->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags |= DT_NODE_OPEN;
+				m_tileOpenList->push(neighbourNode);
+			}
+		}
+	}
+
+	// Finish the cost inside the portal polygons.
+	const dtPolyRef base = m_nav->getPolyRefBase(tile);
+	for (int i = 0; i < htile.portalCount; ++i)
+	{
+		const dtHierarchyPortal& portal = htile.portals[i];
+		const dtPolyRef ref = base | (dtPolyRef)portal.poly;
+		const dtNode* node = m_tileNodePool->findNode(ref, 0);
+		if (!node)
+		{
+			costs[i] = FLT_MAX;
+			continue;
+		}
+		costs[i] = node->cost + m_filter->getCost(node->pos, portal.pos,
+												  0, 0, 0,
+												  ref, tile, &tile->polys[portal.poly],
+												  0, 0, 0);
+	}
+
+	return DT_SUCCESS;
+}
+
+int dtNavMeshHierarchy::findPortal(const dtHierarchyTile& htile, unsigned int poly, unsigned char state) const
+{
+	// Binary search for the first portal of the polygon.
+	int lo = 0;
+	int hi = htile.portalCount;
+	while (lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if (htile.portals[mid].poly < poly)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (int i = lo; i < htile.portalCount && htile.portals[i].poly == poly; ++i)
+	{
+		if (portalState(htile.portals[i].side) == state)
+			return i;
+	}
+	return -1;
+}
+
+void dtNavMeshHierarchy::openPortal(dtNode* parent, dtPolyRef ref, const dtHierarchyPortal& portal,
+									const float cost, const float* endPos, bool& outOfNodes)
+{
+	dtNode* node = m_nodePool->getNode(ref, portalState(portal.side));
+	if (!node)
+	{
+		outOfNodes = true;
+		return;
+	}
+
+	const float total = cost + dtVdist(portal.pos, endPos)*H_SCALE;
+
+	// The node is already visited and the new result is worse, skip.
+	if ((node->flags & (DT_NODE_OPEN | DT_NODE_CLOSED)) && total >= node->total)
+		return;
+
+	dtVcopy(node->pos, portal.pos);
+	node->pidx = m_nodePool->getNodeIdx(parent);
+	node->id = ref;
+	node->flags = (node->flags & ~DT_NODE_CLOSED);
+	node->cost = cost;
+	node->total = total;
+
+	if (node->flags & DT_NODE_OPEN)
+	{
+		m_openList->modify(node);
+	}
+	else
+	{
+		node->flags |= DT_NODE_OPEN;
+		m_openList->push(node);
+	}
+}
+
+/// @par
+///
+/// The route over the portals is planned first, then each stretch of it
+/// within a tile is refined with dtNavMeshQuery::findPath, using the filter
+/// passed to #init. The node pool of @p query only needs to be large enough
+/// for a single tile.
+///
+/// If the start and end are in the same tile, or no route over the portals
+/// is found, the path is searched directly with dtNavMeshQuery::findPath,
+/// and @p routeCount is zero.
+///
+/// If a refined stretch of the route comes back partial, the path ends there
+/// and the result has the #DT_PARTIAL_RESULT flag.
+dtStatus dtNavMeshHierarchy::findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+									  const float* startPos, const float* endPos,
+									  dtPolyRef* path, int* pathCount, const int maxPath, int* routeCount)
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	if (routeCount)
+		*routeCount = 0;
+
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+
+	// Validate input
+	if (!query || query->getAttachedNavMesh() != m_nav ||
+		!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!path || maxPath <= 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	const unsigned int startTileIdx = m_nav->decodePolyIdTile(startRef);
+	const unsigned int endTileIdx = m_nav->decodePolyIdTile(endRef);
+	const dtMeshTile* startTile = m_nav->getTile((int)startTileIdx);
+	const dtMeshTile* endTile = m_nav->getTile((int)endTileIdx);
+	const dtHierarchyTile& startHTile = m_tiles[startTileIdx];
+	const dtHierarchyTile& endHTile = m_tiles[endTileIdx];
+
+	if (startTileIdx == endTileIdx ||
+		startHTile.ref != m_nav->getTileRef(startTile) ||
+		endHTile.ref != m_nav->getTileRef(endTile))
+	{
+		return query->findPath(startRef, endRef, startPos, endPos, m_filter, path, pathCount, maxPath);
+	}
+
+	calcPortalCosts(startTile, startHTile, startRef, startPos, m_startCosts);
+	calcPortalCosts(endTile, endHTile, endRef, endPos, m_endCosts);
+
+	m_nodePool->clear();
+	m_openList->clear();
+
+	bool outOfNodes = false;
+
+	const dtPolyRef startBase = m_nav->getPolyRefBase(startTile);
+	for (int i = 0; i < startHTile.portalCount; ++i)
+	{
+		if (m_startCosts[i] == FLT_MAX)
+			continue;
+		const dtHierarchyPortal& portal = startHTile.portals[i];
+		openPortal(0, startBase | (dtPolyRef)portal.poly, portal, m_startCosts[i], endPos, outOfNodes);
+	}
+
+	dtNode* goalNode = 0;
+	float goalCost = FLT_MAX;
+
+	while (!m_openList->empty())
+	{
+		// Remove node from open list and put it in closed list.
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+
+		// None of the remaining nodes can lead to a cheaper route.
+		if (bestNode->total >= goalCost)
+			break;
+
+		const dtPolyRef bestRef = bestNode->id;
+		const unsigned int bestTileIdx = m_nav->decodePolyIdTile(bestRef);
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+
+		const dtHierarchyTile& htile = m_tiles[bestTileIdx];
+		const int bestPortal = findPortal(htile, m_nav->decodePolyIdPoly(bestRef), (unsigned char)bestNode->state);
+		dtAssert(bestPortal != -1);
+
+		// Route from the portal to the end position.
+		if (bestTileIdx == endTileIdx && m_endCosts[bestPortal] != FLT_MAX)
+		{
+			const float cost = bestNode->cost + m_endCosts[bestPortal];
+			if (cost < goalCost)
+			{
+				goalCost = cost;
+				goalNode = bestNode;
+			}
+		}
+
+		// Portals of the same tile.
+		const dtPolyRef base = m_nav->getPolyRefBase(bestTile);
+		const float* costs = &htile.costs[bestPortal*htile.portalCount];
+		for (int i = 0; i < htile.portalCount; ++i)
+		{
+			if (i == bestPortal || costs[i] == FLT_MAX)
+				continue;
+			const dtHierarchyPortal& portal = htile.portals[i];
+			openPortal(bestNode, base | (dtPolyRef)portal.poly, portal, bestNode->cost + costs[i], endPos, outOfNodes);
+		}
+
+		// Portals of the neighbour tiles, across the links on the portal side.
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			const dtLink& link = bestTile->links[i];
+			if (!link.ref || link.side == 0xff || portalState(link.side) != bestNode->state)
+				continue;
+
+			const dtPolyRef neighbourRef = link.ref;
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+
+			// Skip tiles that have changed since the last update.
+			const dtHierarchyTile& neighbourHTile = m_tiles[m_nav->decodePolyIdTile(neighbourRef)];
+			if (neighbourHTile.ref != m_nav->getTileRef(neighbourTile))
+				continue;
+
+			if (!m_filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			const unsigned char neighbourState = portalState((unsigned char)dtOppositeTile(link.side));
+			const int neighbourPortal = findPortal(neighbourHTile, m_nav->decodePolyIdPoly(neighbourRef), neighbourState);
+			if (neighbourPortal == -1)
+				continue;
+
+			const dtHierarchyPortal& portal = neighbourHTile.portals[neighbourPortal];
+			const float cost = bestNode->cost + m_filter->getCost(bestNode->pos, portal.pos,
+																  0, 0, 0,
+																  bestRef, bestTile, bestPoly,
+																  neighbourRef, neighbourTile, neighbourPoly);
+			openPortal(bestNode, neighbourRef, portal, cost, endPos, outOfNodes);
+		}
+	}
+
+	if (!goalNode)
+		return query->findPath(startRef, endRef, startPos, endPos, m_filter, path, pathCount, maxPath);
+
+	// Reverse the route so it can be walked from the start.
+	dtNode* prev = 0;
+	dtNode* node = goalNode;
+	int portalCount = 0;
+	do
+	{
+		dtNode* next = m_nodePool->getNodeAtIdx(node->pidx);
+		node->pidx = m_nodePool->getNodeIdx(prev);
+		prev = node;
+		node = next;
+		portalCount++;
+	}
+	while (node);
+
+	if (routeCount)
+		*routeCount = portalCount;
+
+	// Refine the route. Stretches within a tile are searched on the navmesh,
+	// portals across a tile border are adjacent polygons.
+	dtStatus status = DT_SUCCESS;
+	path[0] = startRef;
+	int n = 1;
+	dtPolyRef curRef = startRef;
+	const float* curPos = startPos;
+	node = prev;
+
+	for (;;)
+	{
+		const dtPolyRef nextRef = node ? node->id : endRef;
+		const float* nextPos = node ? node->pos : endPos;
+
+		if (m_nav->decodePolyIdTile(nextRef) != m_nav->decodePolyIdTile(curRef))
+		{
+			if (n >= maxPath)
+			{
+				status |= DT_BUFFER_TOO_SMALL;
+				break;
+			}
+			path[n++] = nextRef;
+		}
+		else
+		{
+			// The stretch starts with the current polygon, which is already on the path.
+			int segCount = 0;
+			const dtStatus segStatus = query->findPath(curRef, nextRef, curPos, nextPos, m_filter,
+													   path + n - 1, &segCount, maxPath - n + 1);
+			if (dtStatusFailed(segStatus))
+			{
+				status |= DT_PARTIAL_RESULT;
+				break;
+			}
+			n += segCount - 1;
+			if (dtStatusDetail(segStatus, DT_PARTIAL_RESULT) || dtStatusDetail(segStatus, DT_BUFFER_TOO_SMALL))
+			{
+				status |= segStatus & DT_STATUS_DETAIL_MASK;
+				break;
+			}
+		}
+
+		if (!node)
+			break;
+		curRef = nextRef;
+		curPos = nextPos;
+		node = m_nodePool->getNodeAtIdx(node->pidx);
+	}
+
+	if (outOfNodes)
+		status |= DT_OUT_OF_NODES;
+
+	*pathCount = n;
+
+	return status;
+}
+
+int dtNavMeshHierarchy::getPortalCount() const
+{
+	int count = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+		count += m_tiles[i].portalCount;
+	return count;
+}
+
+int dtNavMeshHierarchy::getMemUsed() const
+{
+	int mem = sizeof(*this) + sizeof(dtHierarchyTile)*m_maxTiles;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const int portalCount = m_tiles[i].portalCount;
+		mem += sizeof(dtHierarchyPortal)*portalCount + sizeof(float)*portalCount*portalCount;
+	}
+	if (m_tileNodePool)
+		mem += m_tileNodePool->getMemUsed();
+	if (m_tileOpenList)
+		mem += m_tileOpenList->getMemUsed();
+	if (m_nodePool)
+		mem += m_nodePool->getMemUsed();
+	if (m_openList)
+		mem += m_openList->getMemUsed();
+	mem += 2 * sizeof(float)*m_maxPortalCosts;
+	return mem;
+}
@@ -52,25 +52,30 @@ dtNodePool::dtNodePool(int maxNodes, int hashSize) :
 	m_nodes(0),
 	m_first(0),
 	m_next(0),
+	m_bucketGen(0),
 	m_maxNodes(maxNodes),
 	m_hashSize(hashSize),
-	m_nodeCount(0)
+	m_nodeCount(0),
+	m_generation(1)
 {
 	dtAssert(dtNextPow2(m_hashSize) == (unsigned int)m_hashSize);
 	// pidx is special as 0 means "none" and 1 is the first node. For that reason
 	// we have 1 fewer nodes available than the number of values it can contain.
-	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_NULL_IDX && m_maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
+	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_MAX_NODES);
 
 	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
 	m_next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_maxNodes, DT_ALLOC_PERM);
 	m_first = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*hashSize, DT_ALLOC_PERM);
+	m_bucketGen = (unsigned int*)dtAlloc(sizeof(unsigned int)*hashSize, DT_ALLOC_PERM);
 
 	dtAssert(m_nodes);
 	dtAssert(m_next);
 	dtAssert(m_first);
+	dtAssert(m_bucketGen);
 
 	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
 	memset(m_next, 0xff, sizeof(dtNodeIndex)*m_maxNodes);
+	memset(m_bucketGen, 0, sizeof(unsigned int)*m_hashSize);
 }
 
 dtNodePool::~dtNodePool()
@@ -78,11 +83,18 @@ dtNodePool::~dtNodePool()
 	dtFree(m_nodes);
 	dtFree(m_next);
 	dtFree(m_first);
+	dtFree(m_bucketGen);
 }
 
 void dtNodePool::clear()
 {
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	m_generation++;
+	if (m_generation == 0)
+	{
+		// The counter wrapped around, old stamps could look current again.
+		memset(m_bucketGen, 0, sizeof(unsigned int)*m_hashSize);
+		m_generation = 1;
+	}
 	m_nodeCount = 0;
 }
 
@@ -90,7 +102,7 @@ unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNo
 {
 	int n = 0;
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
+	dtNodeIndex i = getFirst(bucket);
 	while (i != DT_NULL_IDX)
 	{
 		if (m_nodes[i].id == id)
@@ -108,7 +120,7 @@ unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNo
 dtNode* dtNodePool::findNode(dtPolyRef id, unsigned char state)
 {
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
+	dtNodeIndex i = getFirst(bucket);
 	while (i != DT_NULL_IDX)
 	{
 		if (m_nodes[i].id == id && m_nodes[i].state == state)
@@ -121,7 +133,7 @@ dtNode* dtNodePool::findNode(dtPolyRef id, unsigned char state)
 dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 {
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
+	dtNodeIndex i = getFirst(bucket);
 	dtNode* node = 0;
 	while (i != DT_NULL_IDX)
 	{
@@ -144,9 +156,11 @@ dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 	node->id = id;
 	node->state = state;
 	node->flags = 0;
+	node->heapIdx = -1;
 	
-	m_next[i] = m_first[bucket];
+	m_next[i] = getFirst(bucket);
 	m_first[bucket] = i;
+	m_bucketGen[bucket] = m_generation;
 	
 	return node;
 }
@@ -176,10 +190,12 @@ void dtNodeQueue::bubbleUp(int i, dtNode* node)
 	while ((i > 0) && (m_heap[parent]->total > node->total))
 	{
 		m_heap[i] = m_heap[parent];
+		m_heap[i]->heapIdx = i;
 		i = parent;
 		parent = (i-1)/2;
 	}
 	m_heap[i] = node;
+	node->heapIdx = i;
 }
 
 void dtNodeQueue::trickleDown(int i, dtNode* node)
@@ -193,6 +209,7 @@ void dtNodeQueue::trickleDown(int i, dtNode* node)
 			child++;
 		}
 		m_heap[i] = m_heap[child];
+		m_heap[i]->heapIdx = i;
 		i = child;
 		child = (i*2)+1;
 	}
@@ -26,6 +26,8 @@
 #include "DetourProximityGrid.h"
 #include "DetourPathQueue.h"
 
+class dtTaskScheduler;
+
 /// The maximum number of neighbors that a crowd agent can take into account
 /// for steering decisions.
 /// @ingroup crowd
@@ -227,10 +229,27 @@ class dtCrowd
 
 	dtNavMeshQuery* m_navquery;
 
+	dtTaskScheduler* m_scheduler;
+	int m_threadCount;
+	dtNavMeshQuery** m_threadNavqueries;
+	dtObstacleAvoidanceQuery** m_threadObstacleQueries;
+	int* m_threadVelocitySampleCounts;
+
 	void updateTopologyOptimization(dtCrowdAgent** agents, const int nagents, const float dt);
 	void updateMoveRequest(const float dt);
 	void checkPathValidity(dtCrowdAgent** agents, const int nagents, const float dt);
 
+	// Per-agent stages of update(), which may run concurrently for different agents.
+	friend class dtCrowdAgentTask;
+	void updateNeighbours(dtCrowdAgent* ag, dtCrowdAgent** agents, const int nagents, const int threadIndex);
+	void updateSteering(dtCrowdAgent* ag, const bool debugAgent, dtCrowdAgentDebugInfo* debug, const int threadIndex);
+	void planVelocity(dtCrowdAgent* ag, dtObstacleAvoidanceDebugData* vod, const int threadIndex);
+	void calcCollisionDisplacement(dtCrowdAgent* ag);
+	void moveAgent(dtCrowdAgent* ag, const float dt, const int threadIndex);
+
+	bool allocThreadQueries(const int threadCount);
+	void freeThreadQueries();
+
 	inline int getAgentIndex(const dtCrowdAgent* agent) const  { return (int)(agent - m_agents); }
 
 	bool requestMoveTargetReplan(const int idx, dtPolyRef ref, const float* pos);
@@ -316,6 +335,15 @@ public:
 	///  @param[in]		dt		The time, in seconds, to update the simulation. [Limit: > 0]
 	///  @param[out]	debug	A debug object to load with debug information. [Opt]
 	void update(const float dt, dtCrowdAgentDebugInfo* debug);
+
+	/// Sets the scheduler used to update the agents on multiple threads.
+	///  @param[in]		scheduler	The scheduler, or null to update the agents on the calling thread.
+	/// @return True if the per-thread queries were allocated successfully. The previous scheduler is kept on failure.
+	bool setTaskScheduler(dtTaskScheduler* scheduler);
+
+	/// Gets the scheduler used to update the agents.
+	/// @return The scheduler, or null if the agents are updated on the calling thread.
+	dtTaskScheduler* getTaskScheduler() const { return m_scheduler; }
 	
 	/// Gets the filter used by the crowd.
 	/// @return The filter used by the crowd.
@@ -26,6 +26,14 @@ static const unsigned int DT_PATHQ_INVALID = 0;
 
 typedef unsigned int dtPathQueueRef;
 
+class dtTaskScheduler;
+
+/// Queues path find requests and services them over several updates.
+///
+/// The queue grows as requests are added. Pending requests are serviced in
+/// order of priority by one or more navigation mesh queries, which can run
+/// on the threads of a task scheduler.
+/// @ingroup crowd
 class dtPathQueue
 {
 	struct PathQuery
@@ -41,34 +49,88 @@ class dtPathQueue
 		dtStatus status;
 		int keepAlive;
 		const dtQueryFilter* filter; ///< TODO: This is potentially dangerous!
+		/// Scheduling.
+		float priority;
+		unsigned int order;
+		unsigned int salt;
+	};
+	
+	struct PathWorker
+	{
+		dtNavMeshQuery* navquery;
+		int request;	///< Index of the request being serviced, or -1 if idle.
+		int iterCount;	///< Iterations left in the current update.
 	};
 	
-	static const int MAX_QUEUE = 8;
-	PathQuery m_queue[MAX_QUEUE];
-	dtPathQueueRef m_nextHandle;
+	static const int SLOT_BITS = 20;
+	static const int MAX_QUEUE = 1 << SLOT_BITS;
+	
+	PathQuery* m_queue;
+	int m_queueSize;
+	int* m_freeSlots;
+	int m_nfreeSlots;
+	int* m_pending;			///< Heap of pending request indices, highest priority first.
+	int m_npending;
+	unsigned int m_nextOrder;
 	int m_maxPathSize;
-	int m_queueHead;
-	dtNavMeshQuery* m_navquery;
+	int m_maxSearchNodeCount;
+	dtNavMesh* m_nav;
+	PathWorker* m_workers;
+	int* m_activeWorkers;
+	int m_nworkers;
 	
 	void purge();
+	bool grow();
+	void freeSlot(const int slot);
+	bool isHigherPriority(const int a, const int b) const;
+	void pushPending(const int slot);
+	int popPending();
+	int findSlot(dtPathQueueRef ref) const;
+	void serviceRequest(PathWorker& worker);
+	
+	friend class dtPathQueueTask;
 	
 public:
 	dtPathQueue();
 	~dtPathQueue();
 	
-	bool init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav);
+	/// Initializes the queue.
+	///  @param[in]		maxPathSize			The maximum number of polygons in a path result.
+	///  @param[in]		maxSearchNodeCount	The maximum number of search nodes of each query.
+	///  @param[in]		nav					The navigation mesh to plan on.
+	///  @param[in]		queryCount			The number of queries servicing the requests. [Limit: >= 1]
+	/// @return True if the initialization succeeded.
+	bool init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav, const int queryCount = 1);
 	
-	void update(const int maxIters);
+	/// Changes the number of queries servicing the requests.
+	/// Requests in progress on removed queries are started again.
+	///  @param[in]		queryCount	The number of queries. [Limit: >= 1]
+	/// @return True if the queries were allocated. The queries are not changed on failure.
+	bool setQueryCount(const int queryCount);
 	
+	/// Services the pending requests.
+	///  @param[in]		maxIters	The maximum number of pathfinder iterations each query can run.
+	///  @param[in]		scheduler	The scheduler to run the queries on, or null to run them on the calling thread.
+	void update(const int maxIters, dtTaskScheduler* scheduler = 0);
+	
+	/// Adds a path find request.
+	/// Requests with higher priority are serviced first, and requests with the
+	/// same priority are serviced in the order they were made.
+	/// @return The request reference, or #DT_PATHQ_INVALID if the queue is full.
 	dtPathQueueRef request(dtPolyRef startRef, dtPolyRef endRef,
 						   const float* startPos, const float* endPos, 
-						   const dtQueryFilter* filter);
+						   const dtQueryFilter* filter, const float priority = 0.0f);
 	
 	dtStatus getRequestStatus(dtPathQueueRef ref) const;
 	
+	/// Copies the path of a completed request and frees the request.
+	/// @return The status of the request, or #DT_FAILURE if the request does not exist or is not completed.
 	dtStatus getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath);
 	
-	inline const dtNavMeshQuery* getNavQuery() const { return m_navquery; }
+	/// The number of queries servicing the requests.
+	inline int getQueryCount() const { return m_nworkers; }
+	
+	inline const dtNavMeshQuery* getNavQuery(const int i = 0) const { return i < m_nworkers ? m_workers[i].navquery : 0; }
 
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
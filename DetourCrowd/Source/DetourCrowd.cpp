@@ -24,6 +24,7 @@
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourObstacleAvoidance.h"
+#include "DetourParallel.h"
 #include "DetourCommon.h"
 #include "DetourMath.h"
 #include "DetourAssert.h"
@@ -253,42 +254,6 @@ static int addToOptQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int n
 	return dtMin(nagents+1, maxAgents);
 }
 
-static int addToPathQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int nagents, const int maxAgents)
-{
-	// Insert neighbour based on greatest time.
-	int slot = 0;
-	if (!nagents)
-	{
-		slot = nagents;
-	}
-	else if (newag->targetReplanTime <= agents[nagents-1]->targetReplanTime)
-	{
-		if (nagents >= maxAgents)
-			return nagents;
-		slot = nagents;
-	}
-	else
-	{
-		int i;
-		for (i = 0; i < nagents; ++i)
-			if (newag->targetReplanTime >= agents[i]->targetReplanTime)
-				break;
-		
-		const int tgt = i+1;
-		const int n = dtMin(nagents-i, maxAgents-tgt);
-		
-		dtAssert(tgt+n <= maxAgents);
-		
-		if (n > 0)
-			memmove(&agents[tgt], &agents[i], sizeof(dtCrowdAgent*)*n);
-		slot = i;
-	}
-	
-	agents[slot] = newag;
-	
-	return dtMin(nagents+1, maxAgents);
-}
-
 
 /**
 @class dtCrowd
@@ -339,7 +304,12 @@ dtCrowd::dtCrowd() :
 	m_maxPathResult(0),
 	m_maxAgentRadius(0),
 	m_velocitySampleCount(0),
-	m_navquery(0)
+	m_navquery(0),
+	m_scheduler(0),
+	m_threadCount(0),
+	m_threadNavqueries(0),
+	m_threadObstacleQueries(0),
+	m_threadVelocitySampleCounts(0)
 {
 }
 
@@ -350,6 +320,8 @@ dtCrowd::~dtCrowd()
 
 void dtCrowd::purge()
 {
+	freeThreadQueries();
+
 	for (int i = 0; i < m_maxAgents; ++i)
 		m_agents[i].~dtCrowdAgent();
 	dtFree(m_agents);
@@ -458,9 +430,105 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 	if (dtStatusFailed(m_navquery->init(nav, MAX_COMMON_NODES)))
 		return false;
 	
+	return allocThreadQueries(dtGetThreadCount(m_scheduler));
+}
+
+/// @par
+///
+/// The per-agent stages of #update, such as steering, obstacle avoidance and
+/// collision resolution, are run with dtTaskScheduler::parallelFor. Each
+/// thread of the scheduler gets its own navigation mesh query and obstacle
+/// avoidance query. The agents are updated the same way regardless of the
+/// number of threads.
+///
+/// The path queue gets a query per thread as well, and services the queued
+/// path requests in parallel. Path validity checks, quick searches for new
+/// move requests and topology optimization still run on the calling thread.
+///
+/// The scheduler is kept when the crowd is re-initialized. It must not be
+/// freed while it is set.
+bool dtCrowd::setTaskScheduler(dtTaskScheduler* scheduler)
+{
+	// Keep the previous scheduler if the queries for the new one cannot be allocated.
+	if (m_navquery && !allocThreadQueries(dtGetThreadCount(scheduler)))
+		return false;
+	m_scheduler = scheduler;
+	return true;
+}
+
+static void freeThreadQueryArrays(dtNavMeshQuery** navqueries, dtObstacleAvoidanceQuery** obstacleQueries,
+								  int* velocitySampleCounts, const int threadCount)
+{
+	// The queries of the calling thread are the main queries of the crowd.
+	for (int i = 1; i < threadCount; ++i)
+	{
+		dtFreeNavMeshQuery(navqueries[i]);
+		dtFreeObstacleAvoidanceQuery(obstacleQueries[i]);
+	}
+	dtFree(navqueries);
+	dtFree(obstacleQueries);
+	dtFree(velocitySampleCounts);
+}
+
+bool dtCrowd::allocThreadQueries(const int threadCount)
+{
+	// Allocate the queries of every thread before replacing the current ones,
+	// so that the crowd is left unchanged on failure.
+	dtNavMeshQuery** navqueries = (dtNavMeshQuery**)dtAlloc(sizeof(dtNavMeshQuery*)*threadCount, DT_ALLOC_PERM);
+	dtObstacleAvoidanceQuery** obstacleQueries = (dtObstacleAvoidanceQuery**)dtAlloc(sizeof(dtObstacleAvoidanceQuery*)*threadCount, DT_ALLOC_PERM);
+	int* velocitySampleCounts = (int*)dtAlloc(sizeof(int)*threadCount, DT_ALLOC_PERM);
+	if (!navqueries || !obstacleQueries || !velocitySampleCounts)
+	{
+		dtFree(navqueries);
+		dtFree(obstacleQueries);
+		dtFree(velocitySampleCounts);
+		return false;
+	}
+	memset(navqueries, 0, sizeof(dtNavMeshQuery*)*threadCount);
+	memset(obstacleQueries, 0, sizeof(dtObstacleAvoidanceQuery*)*threadCount);
+	memset(velocitySampleCounts, 0, sizeof(int)*threadCount);
+
+	// The calling thread uses the main queries.
+	navqueries[0] = m_navquery;
+	obstacleQueries[0] = m_obstacleQuery;
+
+	bool ok = true;
+	for (int i = 1; i < threadCount && ok; ++i)
+	{
+		navqueries[i] = dtAllocNavMeshQuery();
+		ok = navqueries[i] && dtStatusSucceed(navqueries[i]->init(m_navquery->getAttachedNavMesh(), MAX_COMMON_NODES));
+		if (ok)
+		{
+			obstacleQueries[i] = dtAllocObstacleAvoidanceQuery();
+			ok = obstacleQueries[i] && obstacleQueries[i]->init(6, 8);
+		}
+	}
+
+	// Path requests are serviced by a query per thread.
+	if (!ok || !m_pathq.setQueryCount(threadCount))
+	{
+		freeThreadQueryArrays(navqueries, obstacleQueries, velocitySampleCounts, threadCount);
+		return false;
+	}
+
+	freeThreadQueries();
+	m_threadNavqueries = navqueries;
+	m_threadObstacleQueries = obstacleQueries;
+	m_threadVelocitySampleCounts = velocitySampleCounts;
+	m_threadCount = threadCount;
+
 	return true;
 }
 
+void dtCrowd::freeThreadQueries()
+{
+	freeThreadQueryArrays(m_threadNavqueries, m_threadObstacleQueries, m_threadVelocitySampleCounts, m_threadCount);
+	m_threadNavqueries = 0;
+	m_threadObstacleQueries = 0;
+	m_threadVelocitySampleCounts = 0;
+	m_threadCount = 0;
+}
+
 void dtCrowd::setObstacleAvoidanceParams(const int idx, const dtObstacleAvoidanceParams* params)
 {
 	if (idx >= 0 && idx < DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS)
@@ -676,10 +744,6 @@ int dtCrowd::getActiveAgents(dtCrowdAgent** agents, const int maxAgents)
 
 void dtCrowd::updateMoveRequest(const float /*dt*/)
 {
-	const int PATH_MAX_AGENTS = 8;
-	dtCrowdAgent* queue[PATH_MAX_AGENTS];
-	int nqueue = 0;
-	
 	// Fire off new requests.
 	for (int i = 0; i < m_maxAgents; ++i)
 	{
@@ -764,22 +828,17 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 		
 		if (ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE)
 		{
-			nqueue = addToPathQueue(ag, queue, nqueue, PATH_MAX_AGENTS);
+			// The agents that have waited the longest are serviced first.
+			ag->targetPathqRef = m_pathq.request(ag->corridor.getLastPoly(), ag->targetRef,
+												 ag->corridor.getTarget(), ag->targetPos, &m_filters[ag->params.queryFilterType],
+												 ag->targetReplanTime);
+			if (ag->targetPathqRef != DT_PATHQ_INVALID)
+				ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
 		}
 	}
-
-	for (int i = 0; i < nqueue; ++i)
-	{
-		dtCrowdAgent* ag = queue[i];
-		ag->targetPathqRef = m_pathq.request(ag->corridor.getLastPoly(), ag->targetRef,
-											 ag->corridor.getTarget(), ag->targetPos, &m_filters[ag->params.queryFilterType]);
-		if (ag->targetPathqRef != DT_PATHQ_INVALID)
-			ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
-	}
-
 	
 	// Update requests.
-	m_pathq.update(MAX_ITERS_PER_UPDATE);
+	m_pathq.update(MAX_ITERS_PER_UPDATE, m_scheduler);
 
 	dtStatus status;
 
@@ -1043,11 +1102,90 @@ void dtCrowd::checkPathValidity(dtCrowdAgent** agents, const int nagents, const
 	}
 }
 	
+/// The stages of dtCrowd::update that are run for every agent.
+enum dtCrowdAgentStage
+{
+	DT_CROWD_STAGE_NEIGHBOURS,
+	DT_CROWD_STAGE_STEERING,
+	DT_CROWD_STAGE_VELOCITY_PLANNING,
+	DT_CROWD_STAGE_INTEGRATE,
+	DT_CROWD_STAGE_COLLISION,
+	DT_CROWD_STAGE_DISPLACE,
+	DT_CROWD_STAGE_MOVE
+};
+
+/// Runs a stage of dtCrowd::update for each active agent.
+class dtCrowdAgentTask : public dtParallelTask
+{
+public:
+	dtCrowdAgentTask(dtCrowd* crowd, dtCrowdAgent** agents, const int nagents,
+					 const float dt, dtCrowdAgentDebugInfo* debug) :
+		m_crowd(crowd),
+		m_agents(agents),
+		m_nagents(nagents),
+		m_dt(dt),
+		m_debug(debug),
+		m_stage(DT_CROWD_STAGE_NEIGHBOURS)
+	{
+	}
+
+	void run(const dtCrowdAgentStage stage)
+	{
+		m_stage = stage;
+		dtParallelFor(m_crowd->m_scheduler, *this, m_nagents);
+	}
+
+	virtual void execute(int itemIndex, int threadIndex)
+	{
+		dtCrowdAgent* ag = m_agents[itemIndex];
+		const bool debugAgent = m_debug && m_debug->idx == itemIndex;
+
+		switch (m_stage)
+		{
+		case DT_CROWD_STAGE_NEIGHBOURS:
+			m_crowd->updateNeighbours(ag, m_agents, m_nagents, threadIndex);
+			break;
+		case DT_CROWD_STAGE_STEERING:
+			m_crowd->updateSteering(ag, debugAgent, m_debug, threadIndex);
+			break;
+		case DT_CROWD_STAGE_VELOCITY_PLANNING:
+			m_crowd->planVelocity(ag, debugAgent ? m_debug->vod : 0, threadIndex);
+			break;
+		case DT_CROWD_STAGE_INTEGRATE:
+			if (ag->state == DT_CROWDAGENT_STATE_WALKING)
+				integrate(ag, m_dt);
+			break;
+		case DT_CROWD_STAGE_COLLISION:
+			m_crowd->calcCollisionDisplacement(ag);
+			break;
+		case DT_CROWD_STAGE_DISPLACE:
+			if (ag->state == DT_CROWDAGENT_STATE_WALKING)
+				dtVadd(ag->npos, ag->npos, ag->disp);
+			break;
+		case DT_CROWD_STAGE_MOVE:
+			m_crowd->moveAgent(ag, m_dt, threadIndex);
+			break;
+		}
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtCrowdAgentTask(const dtCrowdAgentTask&);
+	dtCrowdAgentTask& operator=(const dtCrowdAgentTask&);
+
+	dtCrowd* m_crowd;
+	dtCrowdAgent** m_agents;
+	int m_nagents;
+	float m_dt;
+	dtCrowdAgentDebugInfo* m_debug;
+	dtCrowdAgentStage m_stage;
+};
+
 void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 {
 	m_velocitySampleCount = 0;
-	
-	const int debugIdx = debug ? debug->idx : -1;
+	for (int i = 0; i < m_threadCount; ++i)
+		m_threadVelocitySampleCounts[i] = 0;
 	
 	dtCrowdAgent** agents = m_activeAgents;
 	int nagents = getActiveAgents(agents, m_maxAgents);
@@ -1070,54 +1208,85 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 		const float r = ag->params.radius;
 		m_grid->addItem((unsigned short)i, p[0]-r, p[2]-r, p[0]+r, p[2]+r);
 	}
-	
+
+	// The remaining stages only modify the agent they are run for, so the
+	// agents of each stage can be updated in parallel.
+	dtCrowdAgentTask task(this, agents, nagents, dt, debug);
+
 	// Get nearby navmesh segments and agents to collide with.
-	for (int i = 0; i < nagents; ++i)
+	task.run(DT_CROWD_STAGE_NEIGHBOURS);
+
+	// Find next corner to steer to, trigger off-mesh connections and calculate steering.
+	task.run(DT_CROWD_STAGE_STEERING);
+
+	// Velocity planning.
+	task.run(DT_CROWD_STAGE_VELOCITY_PLANNING);
+
+	// Integrate.
+	task.run(DT_CROWD_STAGE_INTEGRATE);
+
+	// Handle collisions.
+	for (int iter = 0; iter < 4; ++iter)
 	{
-		dtCrowdAgent* ag = agents[i];
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
+		task.run(DT_CROWD_STAGE_COLLISION);
+		task.run(DT_CROWD_STAGE_DISPLACE);
+	}
 
-		// Update the collision boundary after certain distance has been passed or
-		// if it has become invalid.
-		const float updateThr = ag->params.collisionQueryRange*0.25f;
-		if (dtVdist2DSqr(ag->npos, ag->boundary.getCenter()) > dtSqr(updateThr) ||
-			!ag->boundary.isValid(m_navquery, &m_filters[ag->params.queryFilterType]))
-		{
-			ag->boundary.update(ag->corridor.getFirstPoly(), ag->npos, ag->params.collisionQueryRange,
-								m_navquery, &m_filters[ag->params.queryFilterType]);
-		}
-		// Query neighbour agents
-		ag->nneis = getNeighbours(ag->npos, ag->params.height, ag->params.collisionQueryRange,
-								  ag, ag->neis, DT_CROWDAGENT_MAX_NEIGHBOURS,
-								  agents, nagents, m_grid);
-		for (int j = 0; j < ag->nneis; j++)
-			ag->neis[j].idx = getAgentIndex(agents[ag->neis[j].idx]);
+	// Move along navmesh and update agents using off-mesh connection.
+	task.run(DT_CROWD_STAGE_MOVE);
+
+	for (int i = 0; i < m_threadCount; ++i)
+		m_velocitySampleCount += m_threadVelocitySampleCounts[i];
+}
+
+void dtCrowd::updateNeighbours(dtCrowdAgent* ag, dtCrowdAgent** agents, const int nagents, const int threadIndex)
+{
+	if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+		return;
+
+	dtNavMeshQuery* navquery = m_threadNavqueries[threadIndex];
+
+	// Update the collision boundary after certain distance has been passed or
+	// if it has become invalid.
+	const float updateThr = ag->params.collisionQueryRange*0.25f;
+	if (dtVdist2DSqr(ag->npos, ag->boundary.getCenter()) > dtSqr(updateThr) ||
+		!ag->boundary.isValid(navquery, &m_filters[ag->params.queryFilterType]))
+	{
+		ag->boundary.update(ag->corridor.getFirstPoly(), ag->npos, ag->params.collisionQueryRange,
+							navquery, &m_filters[ag->params.queryFilterType]);
 	}
-	
-	// Find next corner to steer to.
-	for (int i = 0; i < nagents; ++i)
+	// Query neighbour agents
+	ag->nneis = getNeighbours(ag->npos, ag->params.height, ag->params.collisionQueryRange,
+							  ag, ag->neis, DT_CROWDAGENT_MAX_NEIGHBOURS,
+							  agents, nagents, m_grid);
+	for (int j = 0; j < ag->nneis; j++)
+		ag->neis[j].idx = getAgentIndex(agents[ag->neis[j].idx]);
+}
+
+void dtCrowd::updateSteering(dtCrowdAgent* ag, const bool debugAgent, dtCrowdAgentDebugInfo* debug, const int threadIndex)
+{
+	if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+		return;
+	if (ag->targetState == DT_CROWDAGENT_TARGET_NONE)
+		return;
+
+	dtNavMeshQuery* navquery = m_threadNavqueries[threadIndex];
+
+	if (ag->targetState != DT_CROWDAGENT_TARGET_VELOCITY)
 	{
-		dtCrowdAgent* ag = agents[i];
-		
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
-			continue;
-		
 		// Find corners for steering
 		ag->ncorners = ag->corridor.findCorners(ag->cornerVerts, ag->cornerFlags, ag->cornerPolys,
-												DT_CROWDAGENT_MAX_CORNERS, m_navquery, &m_filters[ag->params.queryFilterType]);
+												DT_CROWDAGENT_MAX_CORNERS, navquery, &m_filters[ag->params.queryFilterType]);
 		
 		// Check to see if the corner after the next corner is directly visible,
 		// and short cut to there.
 		if ((ag->params.updateFlags & DT_CROWD_OPTIMIZE_VIS) && ag->ncorners > 0)
 		{
 			const float* target = &ag->cornerVerts[dtMin(1,ag->ncorners-1)*3];
-			ag->corridor.optimizePathVisibility(target, ag->params.pathOptimizationRange, m_navquery, &m_filters[ag->params.queryFilterType]);
+			ag->corridor.optimizePathVisibility(target, ag->params.pathOptimizationRange, navquery, &m_filters[ag->params.queryFilterType]);
 			
 			// Copy data for debug purposes.
-			if (debugIdx == i)
+			if (debugAgent)
 			{
 				dtVcopy(debug->optStart, ag->corridor.getPos());
 				dtVcopy(debug->optEnd, target);
@@ -1126,36 +1295,25 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 		else
 		{
 			// Copy data for debug purposes.
-			if (debugIdx == i)
+			if (debugAgent)
 			{
 				dtVset(debug->optStart, 0,0,0);
 				dtVset(debug->optEnd, 0,0,0);
 			}
 		}
-	}
-	
-	// Trigger off-mesh connections (depends on corners).
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
-		
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
-			continue;
-		
-		// Check 
+
+		// Trigger off-mesh connections (depends on corners).
 		const float triggerRadius = ag->params.radius*2.25f;
 		if (overOffmeshConnection(ag, triggerRadius))
 		{
 			// Prepare to off-mesh connection.
-			const int idx = (int)(ag - m_agents);
+			const int idx = getAgentIndex(ag);
 			dtCrowdAgentAnimation* anim = &m_agentAnims[idx];
 			
 			// Adjust the path over the off-mesh connection.
 			dtPolyRef refs[2];
 			if (ag->corridor.moveOverOffmeshConnection(ag->cornerPolys[ag->ncorners-1], refs,
-													   anim->startPos, anim->endPos, m_navquery))
+													   anim->startPos, anim->endPos, navquery))
 			{
 				dtVcopy(anim->initPos, ag->npos);
 				anim->polyRef = refs[1];
@@ -1166,7 +1324,7 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 				ag->state = DT_CROWDAGENT_STATE_OFFMESH;
 				ag->ncorners = 0;
 				ag->nneis = 0;
-				continue;
+				return;
 			}
 			else
 			{
@@ -1174,227 +1332,187 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 			}
 		}
 	}
-		
-	// Calculate steering.
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
 
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE)
-			continue;
-		
-		float dvel[3] = {0,0,0};
+	// Calculate steering.
+	float dvel[3] = {0,0,0};
 
-		if (ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
-		{
-			dtVcopy(dvel, ag->targetPos);
-			ag->desiredSpeed = dtVlen(ag->targetPos);
-		}
+	if (ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+	{
+		dtVcopy(dvel, ag->targetPos);
+		ag->desiredSpeed = dtVlen(ag->targetPos);
+	}
+	else
+	{
+		// Calculate steering direction.
+		if (ag->params.updateFlags & DT_CROWD_ANTICIPATE_TURNS)
+			calcSmoothSteerDirection(ag, dvel);
 		else
-		{
-			// Calculate steering direction.
-			if (ag->params.updateFlags & DT_CROWD_ANTICIPATE_TURNS)
-				calcSmoothSteerDirection(ag, dvel);
-			else
-				calcStraightSteerDirection(ag, dvel);
+			calcStraightSteerDirection(ag, dvel);
+		
+		// Calculate speed scale, which tells the agent to slowdown at the end of the path.
+		const float slowDownRadius = ag->params.radius*2;	// TODO: make less hacky.
+		const float speedScale = getDistanceToGoal(ag, slowDownRadius) / slowDownRadius;
 			
-			// Calculate speed scale, which tells the agent to slowdown at the end of the path.
-			const float slowDownRadius = ag->params.radius*2;	// TODO: make less hacky.
-			const float speedScale = getDistanceToGoal(ag, slowDownRadius) / slowDownRadius;
-				
-			ag->desiredSpeed = ag->params.maxSpeed;
-			dtVscale(dvel, dvel, ag->desiredSpeed * speedScale);
-		}
+		ag->desiredSpeed = ag->params.maxSpeed;
+		dtVscale(dvel, dvel, ag->desiredSpeed * speedScale);
+	}
 
-		// Separation
-		if (ag->params.updateFlags & DT_CROWD_SEPARATION)
+	// Separation
+	if (ag->params.updateFlags & DT_CROWD_SEPARATION)
+	{
+		const float separationDist = ag->params.collisionQueryRange; 
+		const float invSeparationDist = 1.0f / separationDist; 
+		const float separationWeight = ag->params.separationWeight;
+		
+		float w = 0;
+		float disp[3] = {0,0,0};
+		
+		for (int j = 0; j < ag->nneis; ++j)
 		{
-			const float separationDist = ag->params.collisionQueryRange; 
-			const float invSeparationDist = 1.0f / separationDist; 
-			const float separationWeight = ag->params.separationWeight;
+			const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
 			
-			float w = 0;
-			float disp[3] = {0,0,0};
+			float diff[3];
+			dtVsub(diff, ag->npos, nei->npos);
+			diff[1] = 0;
 			
-			for (int j = 0; j < ag->nneis; ++j)
-			{
-				const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
-				
-				float diff[3];
-				dtVsub(diff, ag->npos, nei->npos);
-				diff[1] = 0;
-				
-				const float distSqr = dtVlenSqr(diff);
-				if (distSqr < 0.00001f)
-					continue;
-				if (distSqr > dtSqr(separationDist))
-					continue;
-				const float dist = dtMathSqrtf(distSqr);
-				const float weight = separationWeight * (1.0f - dtSqr(dist*invSeparationDist));
-				
-				dtVmad(disp, disp, diff, weight/dist);
-				w += 1.0f;
-			}
+			const float distSqr = dtVlenSqr(diff);
+			if (distSqr < 0.00001f)
+				continue;
+			if (distSqr > dtSqr(separationDist))
+				continue;
+			const float dist = dtMathSqrtf(distSqr);
+			const float weight = separationWeight * (1.0f - dtSqr(dist*invSeparationDist));
 			
-			if (w > 0.0001f)
-			{
-				// Adjust desired velocity.
-				dtVmad(dvel, dvel, disp, 1.0f/w);
-				// Clamp desired velocity to desired speed.
-				const float speedSqr = dtVlenSqr(dvel);
-				const float desiredSqr = dtSqr(ag->desiredSpeed);
-				if (speedSqr > desiredSqr)
-					dtVscale(dvel, dvel, desiredSqr/speedSqr);
-			}
+			dtVmad(disp, disp, diff, weight/dist);
+			w += 1.0f;
 		}
 		
-		// Set the desired velocity.
-		dtVcopy(ag->dvel, dvel);
+		if (w > 0.0001f)
+		{
+			// Adjust desired velocity.
+			dtVmad(dvel, dvel, disp, 1.0f/w);
+			// Clamp desired velocity to desired speed.
+			const float speedSqr = dtVlenSqr(dvel);
+			const float desiredSqr = dtSqr(ag->desiredSpeed);
+			if (speedSqr > desiredSqr)
+				dtVscale(dvel, dvel, desiredSqr/speedSqr);
+		}
 	}
 	
-	// Velocity planning.	
-	for (int i = 0; i < nagents; ++i)
+	// Set the desired velocity.
+	dtVcopy(ag->dvel, dvel);
+}
+
+void dtCrowd::planVelocity(dtCrowdAgent* ag, dtObstacleAvoidanceDebugData* vod, const int threadIndex)
+{
+	if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+		return;
+	
+	if (ag->params.updateFlags & DT_CROWD_OBSTACLE_AVOIDANCE)
 	{
-		dtCrowdAgent* ag = agents[i];
+		dtObstacleAvoidanceQuery* obstacleQuery = m_threadObstacleQueries[threadIndex];
+		obstacleQuery->reset();
 		
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		
-		if (ag->params.updateFlags & DT_CROWD_OBSTACLE_AVOIDANCE)
+		// Add neighbours as obstacles.
+		for (int j = 0; j < ag->nneis; ++j)
 		{
-			m_obstacleQuery->reset();
-			
-			// Add neighbours as obstacles.
-			for (int j = 0; j < ag->nneis; ++j)
-			{
-				const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
-				m_obstacleQuery->addCircle(nei->npos, nei->params.radius, nei->vel, nei->dvel);
-			}
+			const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
+			obstacleQuery->addCircle(nei->npos, nei->params.radius, nei->vel, nei->dvel);
+		}
 
-			// Append neighbour segments as obstacles.
-			for (int j = 0; j < ag->boundary.getSegmentCount(); ++j)
-			{
-				const float* s = ag->boundary.getSegment(j);
-				if (dtTriArea2D(ag->npos, s, s+3) < 0.0f)
-					continue;
-				m_obstacleQuery->addSegment(s, s+3);
-			}
+		// Append neighbour segments as obstacles.
+		for (int j = 0; j < ag->boundary.getSegmentCount(); ++j)
+		{
+			const float* s = ag->boundary.getSegment(j);
+			if (dtTriArea2D(ag->npos, s, s+3) < 0.0f)
+				continue;
+			obstacleQuery->addSegment(s, s+3);
+		}
 
-			dtObstacleAvoidanceDebugData* vod = 0;
-			if (debugIdx == i) 
-				vod = debug->vod;
-			
-			// Sample new safe velocity.
-			bool adaptive = true;
-			int ns = 0;
+		// Sample new safe velocity.
+		bool adaptive = true;
+		int ns = 0;
 
-			const dtObstacleAvoidanceParams* params = &m_obstacleQueryParams[ag->params.obstacleAvoidanceType];
-				
-			if (adaptive)
-			{
-				ns = m_obstacleQuery->sampleVelocityAdaptive(ag->npos, ag->params.radius, ag->desiredSpeed,
-															 ag->vel, ag->dvel, ag->nvel, params, vod);
-			}
-			else
-			{
-				ns = m_obstacleQuery->sampleVelocityGrid(ag->npos, ag->params.radius, ag->desiredSpeed,
-														 ag->vel, ag->dvel, ag->nvel, params, vod);
-			}
-			m_velocitySampleCount += ns;
+		const dtObstacleAvoidanceParams* params = &m_obstacleQueryParams[ag->params.obstacleAvoidanceType];
+			
+		if (adaptive)
+		{
+			ns = obstacleQuery->sampleVelocityAdaptive(ag->npos, ag->params.radius, ag->desiredSpeed,
+													   ag->vel, ag->dvel, ag->nvel, params, vod);
 		}
 		else
 		{
-			// If not using velocity planning, new velocity is directly the desired velocity.
-			dtVcopy(ag->nvel, ag->dvel);
+			ns = obstacleQuery->sampleVelocityGrid(ag->npos, ag->params.radius, ag->desiredSpeed,
+												   ag->vel, ag->dvel, ag->nvel, params, vod);
 		}
+		m_threadVelocitySampleCounts[threadIndex] += ns;
 	}
-
-	// Integrate.
-	for (int i = 0; i < nagents; ++i)
+	else
 	{
-		dtCrowdAgent* ag = agents[i];
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		integrate(ag, dt);
+		// If not using velocity planning, new velocity is directly the desired velocity.
+		dtVcopy(ag->nvel, ag->dvel);
 	}
-	
-	// Handle collisions.
+}
+
+void dtCrowd::calcCollisionDisplacement(dtCrowdAgent* ag)
+{
 	static const float COLLISION_RESOLVE_FACTOR = 0.7f;
+
+	const int idx0 = getAgentIndex(ag);
 	
-	for (int iter = 0; iter < 4; ++iter)
-	{
-		for (int i = 0; i < nagents; ++i)
-		{
-			dtCrowdAgent* ag = agents[i];
-			const int idx0 = getAgentIndex(ag);
-			
-			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-				continue;
+	if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+		return;
 
-			dtVset(ag->disp, 0,0,0);
-			
-			float w = 0;
+	dtVset(ag->disp, 0,0,0);
+	
+	float w = 0;
 
-			for (int j = 0; j < ag->nneis; ++j)
-			{
-				const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
-				const int idx1 = getAgentIndex(nei);
+	for (int j = 0; j < ag->nneis; ++j)
+	{
+		const dtCrowdAgent* nei = &m_agents[ag->neis[j].idx];
+		const int idx1 = getAgentIndex(nei);
 
-				float diff[3];
-				dtVsub(diff, ag->npos, nei->npos);
-				diff[1] = 0;
-				
-				float dist = dtVlenSqr(diff);
-				if (dist > dtSqr(ag->params.radius + nei->params.radius))
-					continue;
-				dist = dtMathSqrtf(dist);
-				float pen = (ag->params.radius + nei->params.radius) - dist;
-				if (dist < 0.0001f)
-				{
-					// Agents on top of each other, try to choose diverging separation directions.
-					if (idx0 > idx1)
-						dtVset(diff, -ag->dvel[2],0,ag->dvel[0]);
-					else
-						dtVset(diff, ag->dvel[2],0,-ag->dvel[0]);
-					pen = 0.01f;
-				}
-				else
-				{
-					pen = (1.0f/dist) * (pen*0.5f) * COLLISION_RESOLVE_FACTOR;
-				}
-				
-				dtVmad(ag->disp, ag->disp, diff, pen);			
-				
-				w += 1.0f;
-			}
-			
-			if (w > 0.0001f)
-			{
-				const float iw = 1.0f / w;
-				dtVscale(ag->disp, ag->disp, iw);
-			}
-		}
+		float diff[3];
+		dtVsub(diff, ag->npos, nei->npos);
+		diff[1] = 0;
 		
-		for (int i = 0; i < nagents; ++i)
+		float dist = dtVlenSqr(diff);
+		if (dist > dtSqr(ag->params.radius + nei->params.radius))
+			continue;
+		dist = dtMathSqrtf(dist);
+		float pen = (ag->params.radius + nei->params.radius) - dist;
+		if (dist < 0.0001f)
 		{
-			dtCrowdAgent* ag = agents[i];
-			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-				continue;
-			
-			dtVadd(ag->npos, ag->npos, ag->disp);
+			// Agents on top of each other, try to choose diverging separation directions.
+			if (idx0 > idx1)
+				dtVset(diff, -ag->dvel[2],0,ag->dvel[0]);
+			else
+				dtVset(diff, ag->dvel[2],0,-ag->dvel[0]);
+			pen = 0.01f;
 		}
+		else
+		{
+			pen = (1.0f/dist) * (pen*0.5f) * COLLISION_RESOLVE_FACTOR;
+		}
+		
+		dtVmad(ag->disp, ag->disp, diff, pen);			
+		
+		w += 1.0f;
 	}
 	
-	for (int i = 0; i < nagents; ++i)
+	if (w > 0.0001f)
+	{
+		const float iw = 1.0f / w;
+		dtVscale(ag->disp, ag->disp, iw);
+	}
+}
+
+void dtCrowd::moveAgent(dtCrowdAgent* ag, const float dt, const int threadIndex)
+{
+	if (ag->state == DT_CROWDAGENT_STATE_WALKING)
 	{
-		dtCrowdAgent* ag = agents[i];
-		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
-			continue;
-		
 		// Move along navmesh.
-		ag->corridor.movePosition(ag->npos, m_navquery, &m_filters[ag->params.queryFilterType]);
+		ag->corridor.movePosition(ag->npos, m_threadNavqueries[threadIndex], &m_filters[ag->params.queryFilterType]);
 		// Get valid constrained position back.
 		dtVcopy(ag->npos, ag->corridor.getPos());
 
@@ -1404,46 +1522,39 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 			ag->corridor.reset(ag->corridor.getFirstPoly(), ag->npos);
 			ag->partial = false;
 		}
-
 	}
 	
 	// Update agents using off-mesh connection.
-	for (int i = 0; i < nagents; ++i)
-	{
-		dtCrowdAgent* ag = agents[i];
-		const int idx = (int)(ag - m_agents);
-		dtCrowdAgentAnimation* anim = &m_agentAnims[idx];
-		if (!anim->active)
-			continue;
-		
+	const int idx = getAgentIndex(ag);
+	dtCrowdAgentAnimation* anim = &m_agentAnims[idx];
+	if (!anim->active)
+		return;
 
-		anim->t += dt;
-		if (anim->t > anim->tmax)
-		{
-			// Reset animation
-			anim->active = false;
-			// Prepare agent for walking.
-			ag->state = DT_CROWDAGENT_STATE_WALKING;
-			continue;
-		}
-		
-		// Update position
-		const float ta = anim->tmax*0.15f;
-		const float tb = anim->tmax;
-		if (anim->t < ta)
-		{
-			const float u = tween(anim->t, 0.0, ta);
-			dtVlerp(ag->npos, anim->initPos, anim->startPos, u);
-		}
-		else
-		{
-			const float u = tween(anim->t, ta, tb);
-			dtVlerp(ag->npos, anim->startPos, anim->endPos, u);
-		}
-			
-		// Update velocity.
-		dtVset(ag->vel, 0,0,0);
-		dtVset(ag->dvel, 0,0,0);
+	anim->t += dt;
+	if (anim->t > anim->tmax)
+	{
+		// Reset animation
+		anim->active = false;
+		// Prepare agent for walking.
+		ag->state = DT_CROWDAGENT_STATE_WALKING;
+		return;
 	}
 	
+	// Update position
+	const float ta = anim->tmax*0.15f;
+	const float tb = anim->tmax;
+	if (anim->t < ta)
+	{
+		const float u = tween(anim->t, 0.0, ta);
+		dtVlerp(ag->npos, anim->initPos, anim->startPos, u);
+	}
+	else
+	{
+		const float u = tween(anim->t, ta, tb);
+		dtVlerp(ag->npos, anim->startPos, anim->endPos, u);
+	}
+		
+	// Update velocity.
+	dtVset(ag->vel, 0,0,0);
+	dtVset(ag->dvel, 0,0,0);
 }
@@ -16,22 +16,51 @@
 // 3. This notice may not be removed or altered from any source distribution.
 //
 
+
 #include <string.h>
 #include "DetourPathQueue.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
+#include "DetourParallel.h"
 #include "DetourAlloc.h"
 #include "DetourCommon.h"
 
 
+/// Services the requests of the active path queue queries.
+class dtPathQueueTask : public dtParallelTask
+{
+public:
+	dtPathQueueTask(dtPathQueue* pathq) : m_pathq(pathq) {}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		m_pathq->serviceRequest(m_pathq->m_workers[m_pathq->m_activeWorkers[itemIndex]]);
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPathQueueTask(const dtPathQueueTask&);
+	dtPathQueueTask& operator=(const dtPathQueueTask&);
+
+	dtPathQueue* m_pathq;
+};
+
+
 dtPathQueue::dtPathQueue() :
-	m_nextHandle(1),
+	m_queue(0),
+	m_queueSize(0),
+	m_freeSlots(0),
+	m_nfreeSlots(0),
+	m_pending(0),
+	m_npending(0),
+	m_nextOrder(0),
 	m_maxPathSize(0),
-	m_queueHead(0),
-	m_navquery(0)
+	m_maxSearchNodeCount(0),
+	m_nav(0),
+	m_workers(0),
+	m_activeWorkers(0),
+	m_nworkers(0)
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
-		m_queue[i].path = 0;
 }
 
 dtPathQueue::~dtPathQueue()
@@ -41,120 +70,320 @@ dtPathQueue::~dtPathQueue()
 
 void dtPathQueue::purge()
 {
-	dtFreeNavMeshQuery(m_navquery);
-	m_navquery = 0;
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
+	for (int i = 0; i < m_nworkers; ++i)
+		dtFreeNavMeshQuery(m_workers[i].navquery);
+	dtFree(m_workers);
+	m_workers = 0;
+	dtFree(m_activeWorkers);
+	m_activeWorkers = 0;
+	m_nworkers = 0;
+	
+	for (int i = 0; i < m_queueSize; ++i)
 		dtFree(m_queue[i].path);
-		m_queue[i].path = 0;
-	}
+	dtFree(m_queue);
+	m_queue = 0;
+	dtFree(m_freeSlots);
+	m_freeSlots = 0;
+	dtFree(m_pending);
+	m_pending = 0;
+	m_queueSize = 0;
+	m_nfreeSlots = 0;
+	m_npending = 0;
 }
 
-bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav)
+bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav, const int queryCount)
 {
 	purge();
 
-	m_navquery = dtAllocNavMeshQuery();
-	if (!m_navquery)
+	m_nav = nav;
+	m_maxPathSize = maxPathSize;
+	m_maxSearchNodeCount = maxSearchNodeCount;
+	m_nextOrder = 0;
+	
+	if (!setQueryCount(queryCount))
 		return false;
-	if (dtStatusFailed(m_navquery->init(nav, maxSearchNodeCount)))
+	
+	// Start with room for a few requests, the queue grows when needed.
+	if (!grow())
 		return false;
 	
-	m_maxPathSize = maxPathSize;
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	return true;
+}
+
+bool dtPathQueue::setQueryCount(const int queryCount)
+{
+	if (queryCount < 1 || !m_nav)
+		return false;
+	
+	PathWorker* workers = (PathWorker*)dtAlloc(sizeof(PathWorker)*queryCount, DT_ALLOC_PERM);
+	int* activeWorkers = (int*)dtAlloc(sizeof(int)*queryCount, DT_ALLOC_PERM);
+	if (!workers || !activeWorkers)
+	{
+		dtFree(workers);
+		dtFree(activeWorkers);
+		return false;
+	}
+	
+	// Create the new queries first, so that the queue is left unchanged on failure.
+	const int nkept = dtMin(m_nworkers, queryCount);
+	for (int i = nkept; i < queryCount; ++i)
+	{
+		workers[i].navquery = dtAllocNavMeshQuery();
+		workers[i].request = -1;
+		workers[i].iterCount = 0;
+		if (!workers[i].navquery || dtStatusFailed(workers[i].navquery->init(m_nav, m_maxSearchNodeCount)))
+		{
+			for (int j = nkept; j <= i; ++j)
+				dtFreeNavMeshQuery(workers[j].navquery);
+			dtFree(workers);
+			dtFree(activeWorkers);
+			return false;
+		}
+	}
+	
+	// Restart the requests of the queries that are removed.
+	for (int i = queryCount; i < m_nworkers; ++i)
 	{
+		PathWorker& worker = m_workers[i];
+		if (worker.request != -1)
+		{
+			m_queue[worker.request].status = 0;
+			pushPending(worker.request);
+		}
+		dtFreeNavMeshQuery(worker.navquery);
+	}
+	
+	if (nkept > 0)
+		memcpy(workers, m_workers, sizeof(PathWorker)*nkept);
+	
+	dtFree(m_workers);
+	m_workers = workers;
+	dtFree(m_activeWorkers);
+	m_activeWorkers = activeWorkers;
+	m_nworkers = queryCount;
+	
+	return true;
+}
+
+bool dtPathQueue::grow()
+{
+	static const int MIN_QUEUE = 8;
+	
+	if (m_queueSize >= MAX_QUEUE)
+		return false;
+	const int newSize = dtMin(dtMax(MIN_QUEUE, m_queueSize*2), MAX_QUEUE);
+	
+	PathQuery* queue = (PathQuery*)dtAlloc(sizeof(PathQuery)*newSize, DT_ALLOC_PERM);
+	int* freeSlots = (int*)dtAlloc(sizeof(int)*newSize, DT_ALLOC_PERM);
+	int* pending = (int*)dtAlloc(sizeof(int)*newSize, DT_ALLOC_PERM);
+	if (!queue || !freeSlots || !pending)
+	{
+		dtFree(queue);
+		dtFree(freeSlots);
+		dtFree(pending);
+		return false;
+	}
+	
+	if (m_queueSize > 0)
+		memcpy(queue, m_queue, sizeof(PathQuery)*m_queueSize);
+	if (m_nfreeSlots > 0)
+		memcpy(freeSlots, m_freeSlots, sizeof(int)*m_nfreeSlots);
+	if (m_npending > 0)
+		memcpy(pending, m_pending, sizeof(int)*m_npending);
+	
+	dtFree(m_queue);
+	m_queue = queue;
+	dtFree(m_freeSlots);
+	m_freeSlots = freeSlots;
+	dtFree(m_pending);
+	m_pending = pending;
+	
+	// Allocate the paths of all the new slots before adding any of them, so that
+	// a failed allocation leaves the queue at its old size.
+	const int oldSize = m_queueSize;
+	for (int i = oldSize; i < newSize; ++i)
+	{
+		memset(&m_queue[i], 0, sizeof(PathQuery));
 		m_queue[i].ref = DT_PATHQ_INVALID;
 		m_queue[i].path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_maxPathSize, DT_ALLOC_PERM);
 		if (!m_queue[i].path)
+		{
+			for (int j = oldSize; j < i; ++j)
+			{
+				dtFree(m_queue[j].path);
+				m_queue[j].path = 0;
+			}
 			return false;
+		}
 	}
+	m_queueSize = newSize;
 	
-	m_queueHead = 0;
+	// Add the new slots to the free list so that the lowest index is used first.
+	for (int i = newSize-1; i >= oldSize; --i)
+		m_freeSlots[m_nfreeSlots++] = i;
 	
 	return true;
 }
 
-void dtPathQueue::update(const int maxIters)
+void dtPathQueue::freeSlot(const int slot)
 {
-	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+	m_queue[slot].ref = DT_PATHQ_INVALID;
+	m_queue[slot].status = 0;
+	m_freeSlots[m_nfreeSlots++] = slot;
+}
+
+bool dtPathQueue::isHigherPriority(const int a, const int b) const
+{
+	const PathQuery& qa = m_queue[a];
+	const PathQuery& qb = m_queue[b];
+	if (qa.priority != qb.priority)
+		return qa.priority > qb.priority;
+	// First come, first served. The difference handles wrap around of the order counter.
+	return (int)(qa.order - qb.order) < 0;
+}
 
-	// Update path request until there is nothing to update
-	// or upto maxIters pathfinder iterations has been consumed.
-	int iterCount = maxIters;
+void dtPathQueue::pushPending(const int slot)
+{
+	int i = m_npending++;
+	while (i > 0)
+	{
+		const int parent = (i-1)/2;
+		if (!isHigherPriority(slot, m_pending[parent]))
+			break;
+		m_pending[i] = m_pending[parent];
+		i = parent;
+	}
+	m_pending[i] = slot;
+}
+
+int dtPathQueue::popPending()
+{
+	const int result = m_pending[0];
+	const int last = m_pending[--m_npending];
+	int i = 0;
+	for (;;)
+	{
+		int child = i*2+1;
+		if (child >= m_npending)
+			break;
+		if (child+1 < m_npending && isHigherPriority(m_pending[child+1], m_pending[child]))
+			child++;
+		if (!isHigherPriority(m_pending[child], last))
+			break;
+		m_pending[i] = m_pending[child];
+		i = child;
+	}
+	if (m_npending > 0)
+		m_pending[i] = last;
+	return result;
+}
+
+int dtPathQueue::findSlot(dtPathQueueRef ref) const
+{
+	if (ref == DT_PATHQ_INVALID)
+		return -1;
+	const int slot = (int)(ref & (MAX_QUEUE-1));
+	if (slot >= m_queueSize || m_queue[slot].ref != ref)
+		return -1;
+	return slot;
+}
+
+void dtPathQueue::serviceRequest(PathWorker& worker)
+{
+	PathQuery& q = m_queue[worker.request];
+	dtNavMeshQuery* navquery = worker.navquery;
 	
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	// Handle query start.
+	if (q.status == 0)
 	{
-		PathQuery& q = m_queue[m_queueHead % MAX_QUEUE];
-		
-		// Skip inactive requests.
+		q.status = navquery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, q.filter);
+	}
+	// Handle query in progress.
+	if (dtStatusInProgress(q.status))
+	{
+		int iters = 0;
+		q.status = navquery->updateSlicedFindPath(worker.iterCount, &iters);
+		worker.iterCount -= iters;
+	}
+	if (dtStatusSucceed(q.status))
+	{
+		q.status = navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
+	}
+	
+	if (!dtStatusInProgress(q.status))
+		worker.request = -1;
+}
+
+/// @par
+///
+/// Each query services one request at a time, and takes the next pending
+/// request once it completes, until it has used up its iterations. The
+/// queries are run in rounds, and pending requests are handed out between
+/// the rounds, so the requests are serviced the same way regardless of the
+/// number of threads.
+void dtPathQueue::update(const int maxIters, dtTaskScheduler* scheduler)
+{
+	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+
+	// If the path result has not been read in few frames, free the slot.
+	for (int i = 0; i < m_queueSize; ++i)
+	{
+		PathQuery& q = m_queue[i];
 		if (q.ref == DT_PATHQ_INVALID)
-		{
-			m_queueHead++;
 			continue;
-		}
-		
-		// Handle completed request.
 		if (dtStatusSucceed(q.status) || dtStatusFailed(q.status))
 		{
-			// If the path result has not been read in few frames, free the slot.
 			q.keepAlive++;
 			if (q.keepAlive > MAX_KEEP_ALIVE)
-			{
-				q.ref = DT_PATHQ_INVALID;
-				q.status = 0;
-			}
-			
-			m_queueHead++;
-			continue;
+				freeSlot(i);
 		}
-		
-		// Handle query start.
-		if (q.status == 0)
-		{
-			q.status = m_navquery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, q.filter);
-		}		
-		// Handle query in progress.
-		if (dtStatusInProgress(q.status))
-		{
-			int iters = 0;
-			q.status = m_navquery->updateSlicedFindPath(iterCount, &iters);
-			iterCount -= iters;
-		}
-		if (dtStatusSucceed(q.status))
+	}
+	
+	// Update path requests until there is nothing to update
+	// or each query has consumed upto maxIters pathfinder iterations.
+	for (int i = 0; i < m_nworkers; ++i)
+		m_workers[i].iterCount = maxIters;
+	
+	dtPathQueueTask task(this);
+	for (;;)
+	{
+		int nactive = 0;
+		for (int i = 0; i < m_nworkers; ++i)
 		{
-			q.status = m_navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
+			PathWorker& worker = m_workers[i];
+			if (worker.iterCount <= 0)
+				continue;
+			if (worker.request == -1 && m_npending > 0)
+				worker.request = popPending();
+			if (worker.request != -1)
+				m_activeWorkers[nactive++] = i;
 		}
-
-		if (iterCount <= 0)
+		if (!nactive)
 			break;
-
-		m_queueHead++;
+		
+		if (nactive == 1)
+			serviceRequest(m_workers[m_activeWorkers[0]]);
+		else
+			dtParallelFor(scheduler, task, nactive);
 	}
 }
 
 dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
 									const float* startPos, const float* endPos,
-									const dtQueryFilter* filter)
+									const dtQueryFilter* filter, const float priority)
 {
 	// Find empty slot
-	int slot = -1;
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
-		if (m_queue[i].ref == DT_PATHQ_INVALID)
-		{
-			slot = i;
-			break;
-		}
-	}
-	// Could not find slot.
-	if (slot == -1)
+	if (!m_nfreeSlots && !grow())
 		return DT_PATHQ_INVALID;
-	
-	dtPathQueueRef ref = m_nextHandle++;
-	if (m_nextHandle == DT_PATHQ_INVALID) m_nextHandle++;
+	const int slot = m_freeSlots[--m_nfreeSlots];
 	
 	PathQuery& q = m_queue[slot];
-	q.ref = ref;
+	
+	// The salt makes the references of reused slots unique.
+	q.salt = (q.salt + 1) & ((1u << (32 - SLOT_BITS)) - 1);
+	if (q.salt == 0) q.salt++;
+	q.ref = (q.salt << SLOT_BITS) | (unsigned int)slot;
+	
 	dtVcopy(q.startPos, startPos);
 	q.startRef = startRef;
 	dtVcopy(q.endPos, endPos);
@@ -164,37 +393,39 @@ dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
 	q.npath = 0;
 	q.filter = filter;
 	q.keepAlive = 0;
+	q.priority = priority;
+	q.order = m_nextOrder++;
 	
-	return ref;
+	pushPending(slot);
+	
+	return q.ref;
 }
 
 dtStatus dtPathQueue::getRequestStatus(dtPathQueueRef ref) const
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
-		if (m_queue[i].ref == ref)
-			return m_queue[i].status;
-	}
-	return DT_FAILURE;
+	const int slot = findSlot(ref);
+	if (slot == -1)
+		return DT_FAILURE;
+	return m_queue[slot].status;
 }
 
 dtStatus dtPathQueue::getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath)
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
-		if (m_queue[i].ref == ref)
-		{
-			PathQuery& q = m_queue[i];
-			dtStatus details = q.status & DT_STATUS_DETAIL_MASK;
-			// Free request for reuse.
-			q.ref = DT_PATHQ_INVALID;
-			q.status = 0;
-			// Copy path
-			int n = dtMin(q.npath, maxPath);
-			memcpy(path, q.path, sizeof(dtPolyRef)*n);
-			*pathSize = n;
-			return details | DT_SUCCESS;
-		}
-	}
-	return DT_FAILURE;
+	const int slot = findSlot(ref);
+	if (slot == -1)
+		return DT_FAILURE;
+	
+	PathQuery& q = m_queue[slot];
+	// The request is still queued or serviced by a query.
+	if (q.status == 0 || dtStatusInProgress(q.status))
+		return DT_FAILURE;
+	
+	dtStatus details = q.status & DT_STATUS_DETAIL_MASK;
+	// Copy path
+	int n = dtMin(q.npath, maxPath);
+	memcpy(path, q.path, sizeof(dtPolyRef)*n);
+	*pathSize = n;
+	// Free request for reuse.
+	freeSlot(slot);
+	return details | DT_SUCCESS;
 }
@@ -6,6 +6,8 @@
 typedef unsigned int dtObstacleRef;
 typedef unsigned int dtCompressedTileRef;
 
+class dtTaskScheduler;
+
 /// Flags for addTile
 enum dtCompressedTileFlags
 {
@@ -155,6 +157,11 @@ public:
 	///  							otherwise another call will continue processing obstacle requests and tile rebuilds.
 	dtStatus update(const float dt, class dtNavMesh* navmesh, bool* upToDate = 0);
 	
+	/// Sets the scheduler used to rebuild tiles in parallel.
+	///  @param[in]		scheduler	The scheduler, or null to rebuild the tiles on the calling thread.
+	///  @param[in]		tallocs		An allocator for each thread of the scheduler. [Size: dtTaskScheduler::getThreadCount()]
+	dtStatus setTaskScheduler(dtTaskScheduler* scheduler, struct dtTileCacheAlloc** tallocs);
+	
 	dtStatus buildNavMeshTilesAt(const int tx, const int ty, class dtNavMesh* navmesh);
 	
 	dtStatus buildNavMeshTile(const dtCompressedTileRef ref, class dtNavMesh* navmesh);
@@ -222,6 +229,27 @@ private:
 		dtObstacleRef ref;
 	};
 	
+	struct TileBuildResult
+	{
+		dtCompressedTileRef ref;
+		unsigned char* navData;
+		int navDataSize;
+		dtStatus status;
+	};
+	
+	/// Builds the navmesh data of a tile using the given allocator.
+	dtStatus buildNavMeshTileData(const dtCompressedTileRef ref, struct dtTileCacheAlloc* talloc,
+								  unsigned char** navData, int* navDataSize) const;
+	
+	/// Replaces the navmesh tile at the location of the compressed tile with the new data.
+	dtStatus commitNavMeshTile(const dtCompressedTileRef ref, unsigned char* navData, const int navDataSize,
+							   class dtNavMesh* navmesh);
+	
+	/// Removes the rebuilt tile from the pending lists of the obstacles.
+	void updateObstacleStates(const dtCompressedTileRef ref);
+	
+	friend class dtTileCacheBuildTask;
+	
 	int m_tileLutSize;						///< Tile hash lookup size (must be pot).
 	int m_tileLutMask;						///< Tile hash lookup mask.
 	
@@ -248,6 +276,10 @@ private:
 	static const int MAX_UPDATE = 64;
 	dtCompressedTileRef m_update[MAX_UPDATE];
 	int m_nupdate;
+	
+	dtTaskScheduler* m_scheduler;
+	dtTileCacheAlloc** m_threadTallocs;		///< Allocator for each thread of the scheduler.
+	TileBuildResult m_results[MAX_UPDATE];	///< Tiles built in parallel, waiting to be committed.
 };
 
 dtTileCache* dtAllocTileCache();
@@ -6,6 +6,7 @@
 #include "DetourMath.h"
 #include "DetourAlloc.h"
 #include "DetourAssert.h"
+#include "DetourParallel.h"
 #include <string.h>
 #include <new>
 
@@ -60,6 +61,29 @@ struct NavMeshTileBuildContext
 };
 
 
+/// Builds the navmesh data of the pending tiles of a tile cache.
+class dtTileCacheBuildTask : public dtParallelTask
+{
+public:
+	dtTileCacheBuildTask(dtTileCache* tc) : m_tc(tc) {}
+	
+	virtual void execute(int itemIndex, int threadIndex)
+	{
+		dtTileCache::TileBuildResult& res = m_tc->m_results[itemIndex];
+		res.ref = m_tc->m_update[itemIndex];
+		res.status = m_tc->buildNavMeshTileData(res.ref, m_tc->m_threadTallocs[threadIndex],
+												&res.navData, &res.navDataSize);
+	}
+	
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileCacheBuildTask(const dtTileCacheBuildTask&);
+	dtTileCacheBuildTask& operator=(const dtTileCacheBuildTask&);
+	
+	dtTileCache* m_tc;
+};
+
+
 dtTileCache::dtTileCache() :
 	m_tileLutSize(0),
 	m_tileLutMask(0),
@@ -74,7 +98,9 @@ dtTileCache::dtTileCache() :
 	m_obstacles(0),
 	m_nextFreeObstacle(0),
 	m_nreqs(0),
-	m_nupdate(0)
+	m_nupdate(0),
+	m_scheduler(0),
+	m_threadTallocs(0)
 {
 	memset(&m_params, 0, sizeof(m_params));
 	memset(m_reqs, 0, sizeof(ObstacleRequest) * MAX_REQUESTS);
@@ -96,6 +122,8 @@ dtTileCache::~dtTileCache()
 	m_posLookup = 0;
 	dtFree(m_tiles);
 	m_tiles = 0;
+	dtFree(m_threadTallocs);
+	m_threadTallocs = 0;
 	m_nreqs = 0;
 	m_nupdate = 0;
 }
@@ -582,7 +610,25 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 	
 	dtStatus status = DT_SUCCESS;
 	// Process updates
-	if (m_nupdate)
+	if (m_nupdate && m_scheduler)
+	{
+		// Build all pending tiles in parallel, then add them to the navmesh in order.
+		dtTileCacheBuildTask task(this);
+		dtParallelFor(m_scheduler, task, m_nupdate);
+		
+		for (int i = 0; i < m_nupdate; ++i)
+		{
+			TileBuildResult& res = m_results[i];
+			dtStatus tileStatus = res.status;
+			if (dtStatusSucceed(tileStatus))
+				tileStatus = commitNavMeshTile(res.ref, res.navData, res.navDataSize, navmesh);
+			if (dtStatusFailed(tileStatus) && !dtStatusFailed(status))
+				status = tileStatus;
+			updateObstacleStates(res.ref);
+		}
+		m_nupdate = 0;
+	}
+	else if (m_nupdate)
 	{
 		// Build mesh
 		const dtCompressedTileRef ref = m_update[0];
@@ -591,52 +637,96 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 		if (m_nupdate > 0)
 			memmove(m_update, m_update+1, m_nupdate*sizeof(dtCompressedTileRef));
 
-		// Update obstacle states.
-		for (int i = 0; i < m_params.maxObstacles; ++i)
+		updateObstacleStates(ref);
+	}
+	
+	if (upToDate)
+		*upToDate = m_nupdate == 0 && m_nreqs == 0;
+
+	return status;
+}
+
+
+void dtTileCache::updateObstacleStates(const dtCompressedTileRef ref)
+{
+	for (int i = 0; i < m_params.maxObstacles; ++i)
+	{
+		dtTileCacheObstacle* ob = &m_obstacles[i];
+		if (ob->state == DT_OBSTACLE_PROCESSING || ob->state == DT_OBSTACLE_REMOVING)
 		{
-			dtTileCacheObstacle* ob = &m_obstacles[i];
-			if (ob->state == DT_OBSTACLE_PROCESSING || ob->state == DT_OBSTACLE_REMOVING)
+			// Remove handled tile from pending list.
+			for (int j = 0; j < (int)ob->npending; j++)
 			{
-				// Remove handled tile from pending list.
-				for (int j = 0; j < (int)ob->npending; j++)
+				if (ob->pending[j] == ref)
 				{
-					if (ob->pending[j] == ref)
-					{
-						ob->pending[j] = ob->pending[(int)ob->npending-1];
-						ob->npending--;
-						break;
-					}
+					ob->pending[j] = ob->pending[(int)ob->npending-1];
+					ob->npending--;
+					break;
 				}
-				
-				// If all pending tiles processed, change state.
-				if (ob->npending == 0)
+			}
+			
+			// If all pending tiles processed, change state.
+			if (ob->npending == 0)
+			{
+				if (ob->state == DT_OBSTACLE_PROCESSING)
 				{
-					if (ob->state == DT_OBSTACLE_PROCESSING)
-					{
-						ob->state = DT_OBSTACLE_PROCESSED;
-					}
-					else if (ob->state == DT_OBSTACLE_REMOVING)
-					{
-						ob->state = DT_OBSTACLE_EMPTY;
-						// Update salt, salt should never be zero.
-						ob->salt = (ob->salt+1) & ((1<<16)-1);
-						if (ob->salt == 0)
-							ob->salt++;
-						// Return obstacle to free list.
-						ob->next = m_nextFreeObstacle;
-						m_nextFreeObstacle = ob;
-					}
+					ob->state = DT_OBSTACLE_PROCESSED;
+				}
+				else if (ob->state == DT_OBSTACLE_REMOVING)
+				{
+					ob->state = DT_OBSTACLE_EMPTY;
+					// Update salt, salt should never be zero.
+					ob->salt = (ob->salt+1) & ((1<<16)-1);
+					if (ob->salt == 0)
+						ob->salt++;
+					// Return obstacle to free list.
+					ob->next = m_nextFreeObstacle;
+					m_nextFreeObstacle = ob;
 				}
 			}
 		}
 	}
-	
-	if (upToDate)
-		*upToDate = m_nupdate == 0 && m_nreqs == 0;
-
-	return status;
 }
 
+/// @par
+///
+/// When a scheduler is set, #update builds all pending tiles at once. Each
+/// tile is built on a scheduler thread using the allocator of that thread,
+/// and the results are added to the navigation mesh on the calling thread.
+/// The compressor and the mesh process must be safe to call from multiple
+/// threads.
+///
+/// The allocators are not owned by the tile cache and must stay valid while
+/// the scheduler is set.
+dtStatus dtTileCache::setTaskScheduler(dtTaskScheduler* scheduler, dtTileCacheAlloc** tallocs)
+{
+	dtFree(m_threadTallocs);
+	m_threadTallocs = 0;
+	m_scheduler = 0;
+	
+	if (!scheduler)
+		return DT_SUCCESS;
+	if (!tallocs)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const int threadCount = scheduler->getThreadCount();
+	m_threadTallocs = (dtTileCacheAlloc**)dtAlloc(sizeof(dtTileCacheAlloc*)*threadCount, DT_ALLOC_PERM);
+	if (!m_threadTallocs)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		if (!tallocs[i])
+		{
+			dtFree(m_threadTallocs);
+			m_threadTallocs = 0;
+			return DT_FAILURE | DT_INVALID_PARAM;
+		}
+		m_threadTallocs[i] = tallocs[i];
+	}
+	m_scheduler = scheduler;
+	
+	return DT_SUCCESS;
+}
 
 dtStatus dtTileCache::buildNavMeshTilesAt(const int tx, const int ty, dtNavMesh* navmesh)
 {
@@ -656,9 +746,24 @@ dtStatus dtTileCache::buildNavMeshTilesAt(const int tx, const int ty, dtNavMesh*
 
 dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh* navmesh)
 {	
-	dtAssert(m_talloc);
+	unsigned char* navData = 0;
+	int navDataSize = 0;
+	dtStatus status = buildNavMeshTileData(ref, m_talloc, &navData, &navDataSize);
+	if (dtStatusFailed(status))
+		return status;
+	
+	return commitNavMeshTile(ref, navData, navDataSize, navmesh);
+}
+
+dtStatus dtTileCache::buildNavMeshTileData(const dtCompressedTileRef ref, dtTileCacheAlloc* talloc,
+										   unsigned char** navData, int* navDataSize) const
+{	
+	dtAssert(talloc);
 	dtAssert(m_tcomp);
 	
+	*navData = 0;
+	*navDataSize = 0;
+	
 	unsigned int idx = decodeTileIdTile(ref);
 	if (idx > (unsigned int)m_params.maxTiles)
 		return DT_FAILURE | DT_INVALID_PARAM;
@@ -667,14 +772,14 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	if (tile->salt != salt)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
-	m_talloc->reset();
+	talloc->reset();
 	
-	NavMeshTileBuildContext bc(m_talloc);
+	NavMeshTileBuildContext bc(talloc);
 	const int walkableClimbVx = (int)(m_params.walkableClimb / m_params.ch);
 	dtStatus status;
 	
 	// Decompress tile layer data. 
-	status = dtDecompressTileCacheLayer(m_talloc, m_tcomp, tile->data, tile->dataSize, &bc.layer);
+	status = dtDecompressTileCacheLayer(talloc, m_tcomp, tile->data, tile->dataSize, &bc.layer);
 	if (dtStatusFailed(status))
 		return status;
 	
@@ -705,32 +810,28 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	}
 	
 	// Build navmesh
-	status = dtBuildTileCacheRegions(m_talloc, *bc.layer, walkableClimbVx);
+	status = dtBuildTileCacheRegions(talloc, *bc.layer, walkableClimbVx);
 	if (dtStatusFailed(status))
 		return status;
 	
-	bc.lcset = dtAllocTileCacheContourSet(m_talloc);
+	bc.lcset = dtAllocTileCacheContourSet(talloc);
 	if (!bc.lcset)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	status = dtBuildTileCacheContours(m_talloc, *bc.layer, walkableClimbVx,
+	status = dtBuildTileCacheContours(talloc, *bc.layer, walkableClimbVx,
 									  m_params.maxSimplificationError, *bc.lcset);
 	if (dtStatusFailed(status))
 		return status;
 	
-	bc.lmesh = dtAllocTileCachePolyMesh(m_talloc);
+	bc.lmesh = dtAllocTileCachePolyMesh(talloc);
 	if (!bc.lmesh)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	status = dtBuildTileCachePolyMesh(m_talloc, *bc.lcset, *bc.lmesh);
+	status = dtBuildTileCachePolyMesh(talloc, *bc.lcset, *bc.lmesh);
 	if (dtStatusFailed(status))
 		return status;
 	
-	// Early out if the mesh tile is empty.
+	// Early out if the mesh tile is empty, the existing tile is removed on commit.
 	if (!bc.lmesh->npolys)
-	{
-		// Remove existing tile.
-		navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
 		return DT_SUCCESS;
-	}
 	
 	dtNavMeshCreateParams params;
 	memset(&params, 0, sizeof(params));
@@ -758,11 +859,17 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 		m_tmproc->process(&params, bc.lmesh->areas, bc.lmesh->flags);
 	}
 	
-	unsigned char* navData = 0;
-	int navDataSize = 0;
-	if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
+	if (!dtCreateNavMeshData(&params, navData, navDataSize))
 		return DT_FAILURE;
+	
+	return DT_SUCCESS;
+}
 
+dtStatus dtTileCache::commitNavMeshTile(const dtCompressedTileRef ref, unsigned char* navData, const int navDataSize,
+										dtNavMesh* navmesh)
+{
+	const dtCompressedTile* tile = &m_tiles[decodeTileIdTile(ref)];
+	
 	// Remove existing tile.
 	navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
 
@@ -770,7 +877,7 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	if (navData)
 	{
 		// Let the navmesh own the data.
-		status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
+		dtStatus status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
 		if (dtStatusFailed(status))
 		{
 			dtFree(navData);
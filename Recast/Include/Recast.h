@@ -25,6 +25,9 @@ static const float RC_PI = 3.14159265f;
 /// Used to ignore unused function parameters and silence any compiler warnings.
 template<class T> void rcIgnoreUnused(const T&) { }
 
+class rcTaskScheduler;
+class rcTempArena;
+
 /// Recast log categories.
 /// @see rcContext
 enum rcLogCategory
@@ -94,6 +97,12 @@ enum rcTimerLabel
 	RC_TIMER_BUILD_POLYMESHDETAIL,
 	/// The time to merge polygon mesh details. (See: #rcMergePolyMeshDetails)
 	RC_TIMER_MERGE_POLYMESHDETAIL,
+	/// The time to apply the fused heightfield filters. (See: #rcFilterHeightfield)
+	RC_TIMER_FILTER_HEIGHTFIELD,
+	/// The time to build the neighbor span indices of a compact heightfield. (See: #rcBuildNeighborIndices)
+	RC_TIMER_BUILD_NEIGHBOR_INDICES,
+	/// The time to build a single tile of a tiled navigation mesh. (See: #rcBuildNavMeshTiles)
+	RC_TIMER_BUILD_TILE,
 	/// The maximum number of timers.  (Used for iterating timers.)
 	RC_MAX_TIMERS
 };
@@ -116,7 +125,7 @@ class rcContext
 public:
 	/// Constructor.
 	///  @param[in]		state	TRUE if the logging and performance timers should be enabled.  [Default: true]
-	inline rcContext(bool state = true) : m_logEnabled(state), m_timerEnabled(state) {}
+	inline rcContext(bool state = true) : m_logEnabled(state), m_timerEnabled(state), m_scheduler(0), m_tempArena(0) {}
 	virtual ~rcContext() {}
 
 	/// Enables or disables logging.
@@ -158,6 +167,37 @@ public:
 	/// @return The accumulated time of the timer, or -1 if timers are disabled or the timer has never been started.
 	inline int getAccumulatedTime(const rcTimerLabel label) const { return m_timerEnabled ? doGetAccumulatedTime(label) : -1; }
 
+	/// Sets the task scheduler that the build functions may use to split their work across threads.
+	///
+	/// The build results are the same with or without a scheduler. Logging and timers are only
+	/// used from the calling thread. The context does not take ownership of the scheduler.
+	/// While a scheduler is set, the build functions call #rcAlloc and #rcFree concurrently,
+	/// so the functions set with #rcAllocSetCustom must be thread-safe.
+	///  @param[in]		scheduler	The scheduler to use, or null to build on the calling thread only.
+	inline void setTaskScheduler(rcTaskScheduler* scheduler) { m_scheduler = scheduler; }
+
+	/// Returns the task scheduler used by the build functions.
+	/// @return The scheduler, or null if the build runs on the calling thread only.
+	inline rcTaskScheduler* getTaskScheduler() const { return m_scheduler; }
+
+	/// Sets the tile that the following timers measure, so that the build times can be
+	/// reported per tile.
+	///  @param[in]		tx		The x-position of the tile, or -1 if the timers do not measure a tile.
+	///  @param[in]		ty		The y-position of the tile, or -1 if the timers do not measure a tile.
+	inline void setTimerTile(const int tx, const int ty) { if (m_timerEnabled) doSetTimerTile(tx, ty); }
+
+	/// Sets the arena that serves the temporary allocations of the build functions.
+	///
+	/// The arena must have a block for each thread of the task scheduler. Reset it between
+	/// builds, e.g. after each tile, once the build functions have returned.
+	/// The context does not take ownership of the arena.
+	///  @param[in]		arena	The arena to use, or null to allocate from the heap.
+	inline void setTempArena(rcTempArena* arena) { m_tempArena = arena; }
+
+	/// Returns the arena that serves the temporary allocations of the build functions.
+	/// @return The arena, or null if the build functions allocate from the heap.
+	inline rcTempArena* getTempArena() const { return m_tempArena; }
+
 protected:
 	/// Clears all log entries.
 	virtual void doResetLog();
@@ -183,12 +223,23 @@ protected:
 	/// @param[in]		label	The category of the timer.
 	/// @return The accumulated time of the timer, or -1 if timers are disabled or the timer has never been started.
 	virtual int doGetAccumulatedTime(const rcTimerLabel label) const { rcIgnoreUnused(label); return -1; }
+
+	/// Sets the tile that the following timers measure.
+	/// @param[in]		tx		The x-position of the tile, or -1.
+	/// @param[in]		ty		The y-position of the tile, or -1.
+	virtual void doSetTimerTile(const int tx, const int ty) { rcIgnoreUnused(tx); rcIgnoreUnused(ty); }
 	
 	/// True if logging is enabled.
 	bool m_logEnabled;
 
 	/// True if the performance timers are enabled.
 	bool m_timerEnabled;
+
+	/// The scheduler used by the build functions, or null.
+	rcTaskScheduler* m_scheduler;
+
+	/// The arena for the temporary allocations of the build functions, or null.
+	rcTempArena* m_tempArena;
 };
 
 /// A helper to first start a timer and then stop it when this helper goes out of scope.
@@ -211,6 +262,27 @@ private:
 	const rcTimerLabel m_label;
 };
 
+/// A helper to make the temporary arena of the context current on the calling thread
+/// while this helper is in scope. The build functions use it on entry.
+/// @see rcContext::setTempArena
+class rcScopedTempArena
+{
+public:
+	/// Makes the arena of the context current, unless the context has no arena.
+	///  @param[in]		ctx		The context to use.
+	rcScopedTempArena(rcContext* ctx);
+	~rcScopedTempArena();
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcScopedTempArena(const rcScopedTempArena&);
+	rcScopedTempArena& operator=(const rcScopedTempArena&);
+
+	rcTempArena* m_prevArena;
+	int m_prevIndex;
+	bool m_changed;
+};
+
 /// Specifies a configuration to use when performing Recast builds.
 /// @ingroup recast
 struct rcConfig
@@ -289,14 +361,24 @@ static const int RC_SPAN_MAX_HEIGHT = (1 << RC_SPAN_HEIGHT_BITS) - 1;
 /// @see rcSpanPool
 static const int RC_SPANS_PER_POOL = 2048;
 
+#ifdef RC_SPAN_INDEX32
+/// The span index used to mark the end of a span list.
+/// @see rcSpan::next, rcHeightfield::spans
+static const unsigned int RC_NULL_SPAN = 0xffffffff;
+#endif
+
 /// Represents a span in a heightfield.
-/// @see rcHeightfield
+/// @see rcHeightfield, rcGetFirstSpan, rcGetNextSpan
 struct rcSpan
 {
 	unsigned int smin : RC_SPAN_HEIGHT_BITS; ///< The lower limit of the span. (Inclusive) [Limit: < #smax]
 	unsigned int smax : RC_SPAN_HEIGHT_BITS; ///< The upper limit of the span. (Exclusive) [Limit: <= #RC_SPAN_MAX_HEIGHT]
 	unsigned int area : 6;                   ///< The area id assigned to the span.
+#ifdef RC_SPAN_INDEX32
+	unsigned int next;                       ///< The index of the next span higher up in column, or #RC_NULL_SPAN.
+#else
 	rcSpan* next;                            ///< The next span higher up in column.
+#endif
 };
 
 /// A memory pool used for quick allocation of spans within a heightfield.
@@ -308,6 +390,11 @@ struct rcSpanPool
 };
 
 /// A dynamic heightfield representing obstructed space.
+///
+/// By default the spans are allocated from a list of span pools and linked with pointers.
+/// If #RC_SPAN_INDEX32 is defined, the spans are stored in a single contiguous array and
+/// linked with 32 bit indices instead, which halves the size of a span on 64 bit platforms.
+/// Use #rcGetFirstSpan and #rcGetNextSpan to walk the span columns with either storage.
 /// @ingroup recast
 struct rcHeightfield
 {
@@ -320,11 +407,21 @@ struct rcHeightfield
 	float bmax[3];		///< The maximum bounds in world space. [(x, y, z)]
 	float cs;			///< The size of each cell. (On the xz-plane.)
 	float ch;			///< The height of each cell. (The minimum increment along the y-axis.)
+#ifdef RC_SPAN_INDEX32
+	unsigned int* spans;	///< The index of the lowest span of each column, or #RC_NULL_SPAN. [Size: width*height]
+
+	// Contiguous storage for rcSpan instances.
+	rcSpan* spanArena;		///< The span storage. [Size: #spanArenaSize]
+	int spanArenaSize;		///< The number of spans the span storage can hold.
+	int spanArenaCount;		///< The number of spans of the storage that have been handed out.
+	unsigned int freelist;	///< The index of the next free span, or #RC_NULL_SPAN.
+#else
 	rcSpan** spans;		///< Heightfield of spans (width*height).
 
 	// memory pool for rcSpan instances.
 	rcSpanPool* pools;	///< Linked list of span pools.
 	rcSpan* freelist;	///< The next free span.
+#endif
 
 private:
 	// Explicitly-disabled copy constructor and copy assignment operator.
@@ -332,6 +429,34 @@ private:
 	rcHeightfield& operator=(const rcHeightfield&);
 };
 
+/// Returns the lowest span of a heightfield column.
+///  @param[in]		heightfield		The heightfield.
+///  @param[in]		columnIndex		The index of the column. [Limits: 0 <= value < width * height]
+///  @return The span, or null if the column is empty.
+inline rcSpan* rcGetFirstSpan(const rcHeightfield& heightfield, const int columnIndex)
+{
+#ifdef RC_SPAN_INDEX32
+	const unsigned int spanIndex = heightfield.spans[columnIndex];
+	return spanIndex != RC_NULL_SPAN ? &heightfield.spanArena[spanIndex] : 0;
+#else
+	return heightfield.spans[columnIndex];
+#endif
+}
+
+/// Returns the next span higher up in the column of a span.
+///  @param[in]		heightfield		The heightfield the span belongs to.
+///  @param[in]		span			The span.
+///  @return The next span, or null if @p span is the highest span of its column.
+inline rcSpan* rcGetNextSpan(const rcHeightfield& heightfield, const rcSpan* span)
+{
+#ifdef RC_SPAN_INDEX32
+	return span->next != RC_NULL_SPAN ? &heightfield.spanArena[span->next] : 0;
+#else
+	rcIgnoreUnused(heightfield);
+	return span->next;
+#endif
+}
+
 /// Provides information on the content of a cell column in a compact heightfield. 
 struct rcCompactCell
 {
@@ -358,6 +483,7 @@ struct rcCompactHeightfield
 	int width;					///< The width of the heightfield. (Along the x-axis in cell units.)
 	int height;					///< The height of the heightfield. (Along the z-axis in cell units.)
 	int spanCount;				///< The number of spans in the heightfield.
+	int maxSpans;				///< The number of allocated spans.
 	int walkableHeight;			///< The walkable height used during the build of the field.  (See: rcConfig::walkableHeight)
 	int walkableClimb;			///< The walkable climb used during the build of the field. (See: rcConfig::walkableClimb)
 	int borderSize;				///< The AABB border size used during the build of the field. (See: rcConfig::borderSize)
@@ -368,9 +494,10 @@ struct rcCompactHeightfield
 	float cs;					///< The size of each cell. (On the xz-plane.)
 	float ch;					///< The height of each cell. (The minimum increment along the y-axis.)
 	rcCompactCell* cells;		///< Array of cells. [Size: #width*#height]
-	rcCompactSpan* spans;		///< Array of spans. [Size: #spanCount]
+	rcCompactSpan* spans;		///< Array of spans. [Size: #maxSpans]
 	unsigned short* dist;		///< Array containing border distance data. [Size: #spanCount]
-	unsigned char* areas;		///< Array containing area id data. [Size: #spanCount]
+	unsigned char* areas;		///< Array containing area id data. [Size: #maxSpans]
+	int* neighbors;				///< Optional array of the neighbor span indices of each span, or -1 if not connected. [Size: 4 * #spanCount] (See: #rcBuildNeighborIndices)
 	
 private:
 	// Explicitly-disabled copy constructor and copy assignment operator.
@@ -618,6 +745,15 @@ enum rcBuildContoursFlags
 	RC_CONTOUR_TESS_AREA_EDGES = 0x02	///< Tessellate edges between areas during contour simplification.
 };
 
+/// Heightfield filters applied by #rcFilterHeightfield.
+enum rcFilterFlags
+{
+	RC_FILTER_LOW_HANGING_OBSTACLES = 0x01,		///< Apply #rcFilterLowHangingWalkableObstacles.
+	RC_FILTER_LEDGE_SPANS = 0x02,				///< Apply #rcFilterLedgeSpans.
+	RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS = 0x04,	///< Apply #rcFilterWalkableLowHeightSpans.
+	RC_FILTER_ALL = 0x07						///< Apply all of the filters.
+};
+
 /// Applied to the region id field of contour vertices in order to extract the region id.
 /// The region id field of a vertex may have several flags applied to it.  So the
 /// fields value can't be used directly.
@@ -688,6 +824,16 @@ template<class T> inline T rcClamp(T value, T minInclusive, T maxInclusive)
 ///  @return The square root of the vlaue.
 float rcSqrt(float x);
 
+/// Enables or disables the SIMD code paths of Recast at runtime.
+/// The SIMD paths produce the same results as the scalar code, so this is mostly useful for testing
+/// and profiling. Has no effect if Recast was built without SIMD support. (See: #RC_DISABLE_SIMD)
+///  @param[in]		enabled		True to use the SIMD code paths when available.
+void rcSetSimdEnabled(bool enabled);
+
+/// Returns true if the SIMD code paths are compiled in and enabled.
+///  @return True if the SIMD code paths are in use.
+bool rcIsSimdEnabled();
+
 /// @}
 /// @name Vector helper functions.
 /// @{
@@ -834,6 +980,10 @@ void rcCalcGridSize(const float* minBounds, const float* maxBounds, float cellSi
 
 /// Initializes a new heightfield.
 /// See the #rcConfig documentation for more information on the configuration parameters.
+///
+/// The heightfield may have been initialized before, e.g. when building tiles one after another.
+/// All of its spans are removed, but the span storage is kept for reuse, and so is the column
+/// array as long as the new field does not have more columns than the previous one.
 /// 
 /// @see rcAllocHeightfield, rcHeightfield
 /// @ingroup recast
@@ -941,6 +1091,9 @@ bool rcRasterizeTriangle(rcContext* context,
 /// Rasterizes an indexed triangle mesh into the specified heightfield.
 ///
 /// Spans will only be added for triangles that overlap the heightfield grid.
+///
+/// If the context has a task scheduler, bands of heightfield rows are rasterized in parallel.
+/// The resulting heightfield is the same as with a serial build.
 /// 
 /// @see rcHeightfield
 /// @ingroup recast
@@ -962,6 +1115,9 @@ bool rcRasterizeTriangles(rcContext* context,
 /// Rasterizes an indexed triangle mesh into the specified heightfield.
 ///
 /// Spans will only be added for triangles that overlap the heightfield grid.
+///
+/// If the context has a task scheduler, bands of heightfield rows are rasterized in parallel.
+/// The resulting heightfield is the same as with a serial build.
 /// 
 /// @see rcHeightfield
 /// @ingroup recast
@@ -985,6 +1141,9 @@ bool rcRasterizeTriangles(rcContext* context,
 /// Expects each triangle to be specified as three sequential vertices of 3 floats.
 ///
 /// Spans will only be added for triangles that overlap the heightfield grid.
+///
+/// If the context has a task scheduler, bands of heightfield rows are rasterized in parallel.
+/// The resulting heightfield is the same as with a serial build.
 /// 
 /// @see rcHeightfield
 /// @ingroup recast
@@ -1054,6 +1213,26 @@ void rcFilterLedgeSpans(rcContext* context, int walkableHeight, int walkableClim
 /// @param[in,out]	heightfield		A fully built heightfield.  (All spans have been added.)
 void rcFilterWalkableLowHeightSpans(rcContext* context, int walkableHeight, rcHeightfield& heightfield);
 
+/// Applies the selected heightfield filters in a single pass over the heightfield.
+///
+/// The result is the same as calling #rcFilterLowHangingWalkableObstacles, #rcFilterLedgeSpans and
+/// #rcFilterWalkableLowHeightSpans in that order, for the filters selected by @p filterFlags.
+/// The filters only change the area of a span based on the spans of its own column and the
+/// geometry of its neighbours, so each column is filtered once, and the rows are split into bands
+/// that run in parallel on the task scheduler of the context.
+///
+/// @see rcHeightfield, rcConfig, rcFilterFlags
+/// @ingroup recast
+///
+/// @param[in,out]	context			The build context to use during the operation.
+/// @param[in]		filterFlags		The filters to apply. (See: #rcFilterFlags)
+/// @param[in]		walkableHeight	Minimum floor to 'ceiling' height that will still allow the floor area to 
+/// 								be considered walkable. [Limit: >= 3] [Units: vx]
+/// @param[in]		walkableClimb	Maximum ledge height that is considered to still be traversable. 
+/// 								[Limit: >=0] [Units: vx]
+/// @param[in,out]	heightfield		A fully built heightfield.  (All spans have been added.)
+void rcFilterHeightfield(rcContext* context, int filterFlags, int walkableHeight, int walkableClimb, rcHeightfield& heightfield);
+
 /// Returns the number of spans contained in the specified heightfield.
 ///  @ingroup recast
 ///  @param[in,out]	context		The build context to use during the operation.
@@ -1074,6 +1253,9 @@ int rcGetHeightFieldSpanCount(rcContext* context, const rcHeightfield& heightfie
 ///
 /// See the #rcConfig documentation for more information on the configuration parameters.
 ///
+/// If the compact heightfield was built before, its arrays are reused when they are large enough
+/// for the new field. (See: rcCompactHeightfield::maxSpans)
+///
 /// @see rcAllocCompactHeightfield, rcHeightfield, rcCompactHeightfield, rcConfig
 /// @ingroup recast
 /// 
@@ -1088,6 +1270,21 @@ int rcGetHeightFieldSpanCount(rcContext* context, const rcHeightfield& heightfie
 bool rcBuildCompactHeightfield(rcContext* context, int walkableHeight, int walkableClimb,
 							   const rcHeightfield& heightfield, rcCompactHeightfield& compactHeightfield);
 
+/// Builds the optional neighbor span indices of a compact heightfield. (See: rcCompactHeightfield::neighbors)
+///
+/// The erosion, distance field, region, contour and detail mesh builds read the neighbor
+/// of a span from the index array when it is present, instead of decoding the connection
+/// of the span. The array takes 16 bytes per span. It stays valid until the field is
+/// rebuilt by #rcBuildCompactHeightfield, which frees it.
+///
+/// @see rcCompactHeightfield, rcBuildCompactHeightfield, rcGetNeighborSpan
+/// @ingroup recast
+///
+/// @param[in,out]	context				The build context to use during the operation.
+/// @param[in,out]	compactHeightfield	The compact heightfield to add the neighbor indices to.
+/// @returns True if the operation completed successfully.
+bool rcBuildNeighborIndices(rcContext* context, rcCompactHeightfield& compactHeightfield);
+
 /// Erodes the walkable area within the heightfield by the specified radius.
 /// 
 /// Basically, any spans that are closer to a boundary or obstruction than the specified radius 
@@ -1266,6 +1463,30 @@ inline int rcGetDirOffsetY(int direction)
 	return offset[direction & 0x03];
 }
 
+/// Gets the index of the span connected to a span in the specified direction.
+/// Reads rcCompactHeightfield::neighbors if it was built, and decodes the connection of the span otherwise.
+/// @param[in]		chf			The compact heightfield.
+/// @param[in]		x			The x-position of the cell of the span.
+/// @param[in]		z			The z-position of the cell of the span.
+/// @param[in]		spanIndex	The index of the span.
+/// @param[in]		direction	The direction. [Limits: 0 <= value < 4]
+/// @return The index of the neighbor span, or -1 if the span is not connected in the direction.
+inline int rcGetNeighborSpan(const rcCompactHeightfield& chf, int x, int z, int spanIndex, int direction)
+{
+	if (chf.neighbors)
+	{
+		return chf.neighbors[spanIndex * 4 + direction];
+	}
+	const int con = rcGetCon(chf.spans[spanIndex], direction);
+	if (con == RC_NOT_CONNECTED)
+	{
+		return -1;
+	}
+	const int neighborX = x + rcGetDirOffsetX(direction);
+	const int neighborZ = z + rcGetDirOffsetY(direction);
+	return (int)chf.cells[neighborX + neighborZ * chf.width].index + con;
+}
+
 /// Gets the direction for the specified offset. One of x and y should be 0.
 /// @param[in]		offsetX		The x offset. [Limits: -1 <= value <= 1]
 /// @param[in]		offsetZ		The z offset. [Limits: -1 <= value <= 1]
@@ -45,6 +45,8 @@ typedef void* (rcAllocFunc)(size_t size, rcAllocHint hint);
 typedef void (rcFreeFunc)(void* ptr);
 
 /// Sets the base custom allocation functions to be used by Recast.
+/// The functions must be thread-safe if the builds run on several threads, such as with
+/// rcContext::setTaskScheduler or #rcBuildNavMeshTiles.
 /// @param[in]    allocFunc  The memory allocation function to be used by #rcAlloc
 /// @param[in]    freeFunc   The memory de-allocation function to be used by #rcFree
 /// @see rcAlloc, rcFree
@@ -60,6 +62,9 @@ void* rcAlloc(size_t size, rcAllocHint hint);
 /// Deallocates a memory block.  If @p ptr is NULL, this does nothing.
 /// @warning This function leaves the value of @p ptr unchanged.  So it still
 /// points to the same (now invalid) location, and not to null.
+/// @warning Memory that #rcAlloc took from an rcTempArena may only be freed while the same
+/// arena is current on the calling thread. Otherwise it is passed to the free function set
+/// with #rcAllocSetCustom, which is undefined behavior.
 /// @param[in]    ptr  A pointer to a memory block previously allocated using #rcAlloc.
 /// @see rcAlloc, rcAllocSetCustom
 void rcFree(void* ptr);
@@ -388,4 +393,98 @@ private:
 	rcScopedDelete& operator=(const rcScopedDelete&);
 };
 
+/// A memory arena for the temporary allocations of builds, such as the build of a single tile.
+///
+/// The arena reserves one block of memory for each thread that may build with it.
+/// While the arena is current on a thread, the #RC_ALLOC_TEMP allocations of the thread
+/// are bump allocated from the block of the thread, and freeing them does nothing.
+/// #reset releases all of them at once. Allocations that do not fit in the block fall back
+/// to the functions set with #rcAllocSetCustom.
+///
+/// #rcFree only recognizes the memory of the arena that is current on the calling thread,
+/// so the #RC_ALLOC_TEMP memory allocated while the arena is current must be freed before
+/// the arena stops being current, or not at all. Any thread that has the arena current may
+/// free it, regardless of the block it came from.
+///
+/// Attach the arena to the build context with rcContext::setTempArena to make it current
+/// while the Recast build functions run. Their parallel loops use the block of the thread
+/// index given by the task scheduler.
+/// @see rcSetThreadTempArena
+class rcTempArena
+{
+public:
+	rcTempArena();
+	~rcTempArena();
+
+	/// Allocates the blocks of the arena. Any previous blocks are freed.
+	///  @param[in]		threadCount		The number of threads that may allocate from the arena at once,
+	///  								including the calling thread. [Limit: >= 1]
+	///  @param[in]		blockSize		The size of the block of each thread. [Units: bytes]
+	///  @return True if the blocks were allocated.
+	bool init(int threadCount, size_t blockSize);
+
+	/// Releases all allocations. Must not be called while a build uses the arena.
+	void reset();
+
+	/// Allocates memory from the block of a thread.
+	///  @param[in]		size			The size of the allocation. [Units: bytes]
+	///  @param[in]		threadIndex		The index of the block to allocate from.
+	///  @return The allocated memory, or null if the block is full or does not exist.
+	void* alloc(size_t size, int threadIndex);
+
+	/// Checks whether the memory was allocated from the arena.
+	///  @param[in]		ptr		The memory to check.
+	///  @return True if @p ptr points to one of the blocks of the arena.
+	bool owns(const void* ptr) const
+	{
+		return m_data && (const unsigned char*)ptr >= m_data && (const unsigned char*)ptr < m_data + m_threadCount * m_blockSize;
+	}
+
+	/// @return The number of blocks of the arena.
+	int getThreadCount() const { return m_threadCount; }
+
+	/// @return The size of each block. [Units: bytes]
+	size_t getBlockSize() const { return m_blockSize; }
+
+	/// Returns the memory currently allocated from the blocks, which only grows until #reset.
+	///  @return The memory used by all blocks. [Units: bytes]
+	size_t getUsedSize() const;
+
+	/// Returns the largest amount of memory used in any block since the arena was initialized.
+	/// Use it to size the blocks, so that the allocations do not fall back to the heap.
+	///  @return The peak usage of the blocks. [Units: bytes]
+	size_t getPeakSize() const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcTempArena(const rcTempArena&);
+	rcTempArena& operator=(const rcTempArena&);
+
+	void purge();
+
+	/// The usage of one block, padded so that the threads do not share cache lines.
+	struct Block
+	{
+		size_t used;
+		size_t peak;
+		unsigned char pad[64 - 2 * sizeof(size_t)];
+	};
+
+	unsigned char* m_data;
+	Block* m_blocks;
+	int m_threadCount;
+	size_t m_blockSize;
+};
+
+/// Makes an arena serve the temporary allocations of the calling thread.
+///  @param[in]		arena			The arena to use, or null to allocate from the heap.
+///  @param[in]		threadIndex		The block of the arena to allocate from.
+/// @see rcGetThreadTempArena
+void rcSetThreadTempArena(rcTempArena* arena, int threadIndex);
+
+/// Returns the arena that serves the temporary allocations of the calling thread.
+///  @param[out]	threadIndex		The block of the arena that the thread allocates from, or null.
+///  @return The arena, or null if the thread allocates from the heap.
+rcTempArena* rcGetThreadTempArena(int* threadIndex = 0);
+
 #endif
\ No newline at end of file
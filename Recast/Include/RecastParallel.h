@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef RECASTPARALLEL_H
+#define RECASTPARALLEL_H
+
+/// A unit of work that is executed once for each item of a parallel loop.
+///
+/// Implementations must be safe to call concurrently for different item
+/// indices. Per-thread scratch data can be indexed with @p threadIndex, which
+/// is guaranteed to be unique among the threads running the same loop.
+/// @see rcTaskScheduler, rcParallelFor
+class rcParallelTask
+{
+public:
+	virtual ~rcParallelTask() {}
+
+	/// Processes a single item of the loop.
+	///  @param[in]		itemIndex	The index of the item to process. [Limits: 0 <= value < itemCount]
+	///  @param[in]		threadIndex	The index of the executing thread.
+	///  							[Limits: 0 <= value < rcTaskScheduler::getThreadCount()]
+	virtual void execute(int itemIndex, int threadIndex) = 0;
+};
+
+/// Provides an interface for running Recast build work on multiple threads.
+///
+/// Users with an existing job system can implement this interface to let
+/// Recast use it. Otherwise #rcAllocThreadPool creates a simple scheduler
+/// backed by native threads.
+///
+/// @ingroup recast
+class rcTaskScheduler
+{
+public:
+	virtual ~rcTaskScheduler() {}
+
+	/// The maximum number of threads that may run tasks concurrently,
+	/// including the calling thread.
+	///  @return The thread count. [Limit: >= 1]
+	virtual int getThreadCount() const = 0;
+
+	/// Runs the task for every item in the range [0, @p itemCount), and returns
+	/// once all of them have completed.
+	///  @param[in]		task		The task to run.
+	///  @param[in]		itemCount	The number of items to process.
+	virtual void parallelFor(rcParallelTask& task, int itemCount) = 0;
+};
+
+/// Creates a task scheduler that runs work on a pool of native threads.
+///
+/// The calling thread participates in every parallel loop, so a pool of
+/// @p numThreads threads starts <tt>numThreads - 1</tt> worker threads.
+/// Nested calls to rcTaskScheduler::parallelFor from inside a running task
+/// are executed serially on the calling thread.
+///
+/// @ingroup recast
+///  @param[in]		numThreads	The total number of threads to use. [Limit: >= 1]
+///  @return The scheduler, or null on failure.
+/// @see rcFreeThreadPool
+rcTaskScheduler* rcAllocThreadPool(int numThreads);
+
+/// Stops the worker threads and frees a scheduler created with #rcAllocThreadPool.
+///  @param[in]		threadPool	The scheduler to free.
+/// @ingroup recast
+void rcFreeThreadPool(rcTaskScheduler* threadPool);
+
+/// Returns the number of threads available to the scheduler.
+///  @param[in]		scheduler	The scheduler, or null for serial execution.
+///  @return The thread count. [Limit: >= 1]
+inline int rcGetThreadCount(const rcTaskScheduler* scheduler)
+{
+	return scheduler ? scheduler->getThreadCount() : 1;
+}
+
+/// Runs the task for every item in the range [0, @p itemCount).
+///
+/// If @p scheduler is null, the items are processed in order on the calling
+/// thread with a thread index of zero.
+///  @param[in]		scheduler	The scheduler to run the loop on, or null.
+///  @param[in]		task		The task to run.
+///  @param[in]		itemCount	The number of items to process.
+void rcParallelFor(rcTaskScheduler* scheduler, rcParallelTask& task, int itemCount);
+
+#endif // RECASTPARALLEL_H
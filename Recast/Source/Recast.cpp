@@ -19,6 +19,8 @@
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
+#include "RecastParallel.h"
+#include "RecastSimd.h"
 
 #include <math.h>
 #include <string.h>
@@ -55,6 +57,26 @@ float rcSqrt(float x)
 	return sqrtf(x);
 }
 
+#ifdef RC_SIMD_SSE2
+static bool sSimdEnabled = true;
+#else
+static bool sSimdEnabled = false;
+#endif
+
+void rcSetSimdEnabled(bool enabled)
+{
+#ifdef RC_SIMD_SSE2
+	sSimdEnabled = enabled;
+#else
+	rcIgnoreUnused(enabled);
+#endif
+}
+
+bool rcIsSimdEnabled()
+{
+	return sSimdEnabled;
+}
+
 void rcContext::log(const rcLogCategory category, const char* format, ...)
 {
 	if (!m_logEnabled)
@@ -83,6 +105,29 @@ void rcContext::doResetLog()
 	// Defined out of line to fix the weak v-tables warning
 }
 
+rcScopedTempArena::rcScopedTempArena(rcContext* ctx)
+: m_prevArena(0)
+, m_prevIndex(0)
+, m_changed(false)
+{
+	rcTempArena* arena = ctx->getTempArena();
+	m_prevArena = rcGetThreadTempArena(&m_prevIndex);
+	// Keep the block of a thread that already uses the arena, e.g. in a parallel loop.
+	if (arena && arena != m_prevArena)
+	{
+		rcSetThreadTempArena(arena, 0);
+		m_changed = true;
+	}
+}
+
+rcScopedTempArena::~rcScopedTempArena()
+{
+	if (m_changed)
+	{
+		rcSetThreadTempArena(m_prevArena, m_prevIndex);
+	}
+}
+
 rcHeightfield* rcAllocHeightfield()
 {
 	return rcNew<rcHeightfield>(RC_ALLOC_PERM);
@@ -101,8 +146,15 @@ rcHeightfield::rcHeightfield()
 , cs()
 , ch()
 , spans()
+#ifdef RC_SPAN_INDEX32
+, spanArena()
+, spanArenaSize()
+, spanArenaCount()
+, freelist(RC_NULL_SPAN)
+#else
 , pools()
 , freelist()
+#endif
 {
 }
 
@@ -110,6 +162,10 @@ rcHeightfield::~rcHeightfield()
 {
 	// Delete span array.
 	rcFree(spans);
+#ifdef RC_SPAN_INDEX32
+	// Delete span storage.
+	rcFree(spanArena);
+#else
 	// Delete span pools.
 	while (pools)
 	{
@@ -117,6 +173,7 @@ rcHeightfield::~rcHeightfield()
 		rcFree(pools);
 		pools = next;
 	}
+#endif
 }
 
 rcCompactHeightfield* rcAllocCompactHeightfield()
@@ -133,6 +190,7 @@ rcCompactHeightfield::rcCompactHeightfield()
 : width()
 , height()
 , spanCount()
+, maxSpans()
 , walkableHeight()
 , walkableClimb()
 , borderSize()
@@ -146,6 +204,7 @@ rcCompactHeightfield::rcCompactHeightfield()
 , spans()
 , dist()
 , areas()
+, neighbors()
 {
 }
 
@@ -155,6 +214,7 @@ rcCompactHeightfield::~rcCompactHeightfield()
 	rcFree(spans);
 	rcFree(dist);
 	rcFree(areas);
+	rcFree(neighbors);
 }
 
 rcHeightfieldLayerSet* rcAllocHeightfieldLayerSet()
@@ -309,18 +369,58 @@ bool rcCreateHeightfield(rcContext* context, rcHeightfield& heightfield, int siz
 {
 	rcIgnoreUnused(context);
 
+	// Keep the column array of a previously created field if it is large enough.
+	const int numColumns = sizeX * sizeZ;
+	if (heightfield.spans != NULL && numColumns > heightfield.width * heightfield.height)
+	{
+		rcFree(heightfield.spans);
+		heightfield.spans = NULL;
+	}
+
 	heightfield.width = sizeX;
 	heightfield.height = sizeZ;
 	rcVcopy(heightfield.bmin, minBounds);
 	rcVcopy(heightfield.bmax, maxBounds);
 	heightfield.cs = cellSize;
 	heightfield.ch = cellHeight;
-	heightfield.spans = (rcSpan**)rcAlloc(sizeof(rcSpan*) * heightfield.width * heightfield.height, RC_ALLOC_PERM);
-	if (!heightfield.spans)
+#ifdef RC_SPAN_INDEX32
+	if (heightfield.spans == NULL)
 	{
-		return false;
+		heightfield.spans = (unsigned int*)rcAlloc(sizeof(unsigned int) * numColumns, RC_ALLOC_PERM);
+		if (!heightfield.spans)
+		{
+			return false;
+		}
+	}
+	// RC_NULL_SPAN has all bits set.
+	memset(heightfield.spans, 0xff, sizeof(unsigned int) * numColumns);
+
+	// Release all spans, keeping the storage.
+	heightfield.spanArenaCount = 0;
+	heightfield.freelist = RC_NULL_SPAN;
+#else
+	if (heightfield.spans == NULL)
+	{
+		heightfield.spans = (rcSpan**)rcAlloc(sizeof(rcSpan*) * numColumns, RC_ALLOC_PERM);
+		if (!heightfield.spans)
+		{
+			return false;
+		}
+	}
+	memset(heightfield.spans, 0, sizeof(rcSpan*) * numColumns);
+
+	// Put the spans of all existing pools back to the free list.
+	rcSpan* freeList = NULL;
+	for (rcSpanPool* pool = heightfield.pools; pool != NULL; pool = pool->next)
+	{
+		for (int i = RC_SPANS_PER_POOL - 1; i >= 0; --i)
+		{
+			pool->items[i].next = freeList;
+			freeList = &pool->items[i];
+		}
 	}
-	memset(heightfield.spans, 0, sizeof(rcSpan*) * heightfield.width * heightfield.height);
+	heightfield.freelist = freeList;
+#endif
 	return true;
 }
 
@@ -389,7 +489,7 @@ int rcGetHeightFieldSpanCount(rcContext* context, const rcHeightfield& heightfie
 	int spanCount = 0;
 	for (int columnIndex = 0; columnIndex < numCols; ++columnIndex)
 	{
-		for (rcSpan* span = heightfield.spans[columnIndex]; span != NULL; span = span->next)
+		for (const rcSpan* span = rcGetFirstSpan(heightfield, columnIndex); span != NULL; span = rcGetNextSpan(heightfield, span))
 		{
 			if (span->area != RC_NULL_AREA)
 			{
@@ -400,16 +500,141 @@ int rcGetHeightFieldSpanCount(rcContext* context, const rcHeightfield& heightfie
 	return spanCount;
 }
 
+/// The number of row bands each thread processes when connecting the spans of a compact heightfield.
+static const int CONNECT_BANDS_PER_THREAD = 4;
+
+/// Finds the neighbour connections of the spans in a range of rows.
+/// @return The largest layer index of a connection that did not fit in a span, or 0.
+static int connectSpanRows(rcCompactHeightfield& compactHeightfield, const int walkableHeight, const int walkableClimb,
+                           const int z0, const int z1)
+{
+	const int MAX_LAYERS = RC_NOT_CONNECTED - 1;
+	const int xSize = compactHeightfield.width;
+	const int zSize = compactHeightfield.height;
+	const int zStride = xSize; // for readability
+	const rcCompactCell* cells = compactHeightfield.cells;
+	rcCompactSpan* spans = compactHeightfield.spans;
+
+	int maxLayerIndex = 0;
+	for (int z = z0; z < z1; ++z)
+	{
+		for (int x = 0; x < xSize; ++x)
+		{
+			const rcCompactCell& cell = cells[x + z * zStride];
+			if (cell.count == 0)
+			{
+				continue;
+			}
+
+			// Look up the neighbour cells once for all spans of the column, NULL if out of bounds.
+			const rcCompactCell* neighborCells[4];
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				const int neighborX = x + rcGetDirOffsetX(dir);
+				const int neighborZ = z + rcGetDirOffsetY(dir);
+				const bool inBounds = neighborX >= 0 && neighborZ >= 0 && neighborX < xSize && neighborZ < zSize;
+				neighborCells[dir] = inBounds ? &cells[neighborX + neighborZ * zStride] : NULL;
+			}
+
+			for (int i = (int)cell.index, ni = (int)(cell.index + cell.count); i < ni; ++i)
+			{
+				rcCompactSpan& span = spans[i];
+				const int spanBot = (int)span.y;
+				const int spanTop = spanBot + (int)span.h;
+
+				// Gather the connections and write them to the span at once.
+				unsigned int con = 0;
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					const unsigned int shift = (unsigned int)dir * 6;
+					int neighborLayer = RC_NOT_CONNECTED;
+					const rcCompactCell* neighborCell = neighborCells[dir];
+					if (neighborCell != NULL)
+					{
+						// Iterate over all neighbour spans and check if any of the is
+						// accessible from current cell.
+						for (int k = (int)neighborCell->index, nk = (int)(neighborCell->index + neighborCell->count); k < nk; ++k)
+						{
+							const rcCompactSpan& neighborSpan = spans[k];
+							const int neighborBot = (int)neighborSpan.y;
+							const int bot = rcMax(spanBot, neighborBot);
+							const int top = rcMin(spanTop, neighborBot + (int)neighborSpan.h);
+
+							// Check that the gap between the spans is walkable,
+							// and that the climb height between the gaps is not too high.
+							if ((top - bot) >= walkableHeight && rcAbs(neighborBot - spanBot) <= walkableClimb)
+							{
+								// Mark direction as walkable.
+								const int layerIndex = k - (int)neighborCell->index;
+								if (layerIndex > MAX_LAYERS)
+								{
+									maxLayerIndex = rcMax(maxLayerIndex, layerIndex);
+									continue;
+								}
+								neighborLayer = layerIndex;
+								break;
+							}
+						}
+					}
+					con |= (unsigned int)neighborLayer << shift;
+				}
+				span.con = con;
+			}
+		}
+	}
+	return maxLayerIndex;
+}
+
+/// Connects the spans of every other band of rows, starting from the given band.
+class rcConnectSpansBandTask : public rcParallelTask
+{
+public:
+	rcConnectSpansBandTask(rcCompactHeightfield& compactHeightfield, const int walkableHeight, const int walkableClimb,
+	                       const int bandHeight, const int firstBand, const int bandStep, int* maxLayerIndices)
+	: m_compactHeightfield(compactHeightfield)
+	, m_walkableHeight(walkableHeight)
+	, m_walkableClimb(walkableClimb)
+	, m_bandHeight(bandHeight)
+	, m_firstBand(firstBand)
+	, m_bandStep(bandStep)
+	, m_maxLayerIndices(maxLayerIndices)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		const int band = m_firstBand + itemIndex * m_bandStep;
+		const int z0 = band * m_bandHeight;
+		m_maxLayerIndices[band] = connectSpanRows(m_compactHeightfield, m_walkableHeight, m_walkableClimb, z0,
+		                                          rcMin(z0 + m_bandHeight, m_compactHeightfield.height));
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcConnectSpansBandTask(const rcConnectSpansBandTask&);
+	rcConnectSpansBandTask& operator=(const rcConnectSpansBandTask&);
+
+	rcCompactHeightfield& m_compactHeightfield;
+	const int m_walkableHeight;
+	const int m_walkableClimb;
+	const int m_bandHeight;
+	const int m_firstBand;
+	const int m_bandStep;
+	int* m_maxLayerIndices;
+};
+
 bool rcBuildCompactHeightfield(rcContext* context, const int walkableHeight, const int walkableClimb,
                                const rcHeightfield& heightfield, rcCompactHeightfield& compactHeightfield)
 {
 	rcAssert(context);
 
 	rcScopedTimer timer(context, RC_TIMER_BUILD_COMPACTHEIGHTFIELD);
+	rcScopedTempArena tempArena(context);
 
 	const int xSize = heightfield.width;
 	const int zSize = heightfield.height;
 	const int spanCount = rcGetHeightFieldSpanCount(context, heightfield);
+	const int previousNumCells = compactHeightfield.width * compactHeightfield.height;
 
 	// Fill in header.
 	compactHeightfield.width = xSize;
@@ -423,26 +648,55 @@ bool rcBuildCompactHeightfield(rcContext* context, const int walkableHeight, con
 	compactHeightfield.bmax[1] += walkableHeight * heightfield.ch;
 	compactHeightfield.cs = heightfield.cs;
 	compactHeightfield.ch = heightfield.ch;
-	compactHeightfield.cells = (rcCompactCell*)rcAlloc(sizeof(rcCompactCell) * xSize * zSize, RC_ALLOC_PERM);
-	if (!compactHeightfield.cells)
+
+	// Keep the arrays of a previously built field if they are large enough.
+	if (compactHeightfield.cells != NULL && xSize * zSize > previousNumCells)
 	{
-		context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.cells' (%d)", xSize * zSize);
-		return false;
+		rcFree(compactHeightfield.cells);
+		compactHeightfield.cells = NULL;
 	}
-	memset(compactHeightfield.cells, 0, sizeof(rcCompactCell) * xSize * zSize);
-	compactHeightfield.spans = (rcCompactSpan*)rcAlloc(sizeof(rcCompactSpan) * spanCount, RC_ALLOC_PERM);
-	if (!compactHeightfield.spans)
+	if (spanCount > compactHeightfield.maxSpans || compactHeightfield.spans == NULL || compactHeightfield.areas == NULL)
 	{
-		context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.spans' (%d)", spanCount);
-		return false;
+		rcFree(compactHeightfield.spans);
+		rcFree(compactHeightfield.areas);
+		compactHeightfield.spans = NULL;
+		compactHeightfield.areas = NULL;
+		compactHeightfield.maxSpans = 0;
 	}
-	memset(compactHeightfield.spans, 0, sizeof(rcCompactSpan) * spanCount);
-	compactHeightfield.areas = (unsigned char*)rcAlloc(sizeof(unsigned char) * spanCount, RC_ALLOC_PERM);
-	if (!compactHeightfield.areas)
+	// The distance field and the neighbor indices belong to the previous field,
+	// they are rebuilt by rcBuildDistanceField and rcBuildNeighborIndices.
+	rcFree(compactHeightfield.dist);
+	compactHeightfield.dist = NULL;
+	rcFree(compactHeightfield.neighbors);
+	compactHeightfield.neighbors = NULL;
+
+	if (compactHeightfield.cells == NULL)
 	{
-		context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.areas' (%d)", spanCount);
-		return false;
+		compactHeightfield.cells = (rcCompactCell*)rcAlloc(sizeof(rcCompactCell) * xSize * zSize, RC_ALLOC_PERM);
+		if (!compactHeightfield.cells)
+		{
+			context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.cells' (%d)", xSize * zSize);
+			return false;
+		}
+	}
+	memset(compactHeightfield.cells, 0, sizeof(rcCompactCell) * xSize * zSize);
+	if (compactHeightfield.spans == NULL)
+	{
+		compactHeightfield.spans = (rcCompactSpan*)rcAlloc(sizeof(rcCompactSpan) * spanCount, RC_ALLOC_PERM);
+		if (!compactHeightfield.spans)
+		{
+			context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.spans' (%d)", spanCount);
+			return false;
+		}
+		compactHeightfield.areas = (unsigned char*)rcAlloc(sizeof(unsigned char) * spanCount, RC_ALLOC_PERM);
+		if (!compactHeightfield.areas)
+		{
+			context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Out of memory 'chf.areas' (%d)", spanCount);
+			return false;
+		}
+		compactHeightfield.maxSpans = spanCount;
 	}
+	memset(compactHeightfield.spans, 0, sizeof(rcCompactSpan) * spanCount);
 	memset(compactHeightfield.areas, RC_NULL_AREA, sizeof(unsigned char) * spanCount);
 
 	const int MAX_HEIGHT = 0xffff;
@@ -452,7 +706,7 @@ bool rcBuildCompactHeightfield(rcContext* context, const int walkableHeight, con
 	const int numColumns = xSize * zSize;
 	for (int columnIndex = 0; columnIndex < numColumns; ++columnIndex)
 	{
-		const rcSpan* span = heightfield.spans[columnIndex];
+		const rcSpan* span = rcGetFirstSpan(heightfield, columnIndex);
 			
 		// If there are no spans at this cell, just leave the data to index=0, count=0.
 		if (span == NULL)
@@ -464,12 +718,13 @@ bool rcBuildCompactHeightfield(rcContext* context, const int walkableHeight, con
 		cell.index = currentCellIndex;
 		cell.count = 0;
 
-		for (; span != NULL; span = span->next)
+		for (; span != NULL; span = rcGetNextSpan(heightfield, span))
 		{
 			if (span->area != RC_NULL_AREA)
 			{
+				const rcSpan* nextSpan = rcGetNextSpan(heightfield, span);
 				const int bot = (int)span->smax;
-				const int top = span->next ? (int)span->next->smin : MAX_HEIGHT;
+				const int top = nextSpan ? (int)nextSpan->smin : MAX_HEIGHT;
 				compactHeightfield.spans[currentCellIndex].y = (unsigned short)rcClamp(bot, 0, 0xffff);
 				compactHeightfield.spans[currentCellIndex].h = (unsigned char)rcClamp(top - bot, 0, 0xff);
 				compactHeightfield.areas[currentCellIndex] = span->area;
@@ -482,7 +737,61 @@ bool rcBuildCompactHeightfield(rcContext* context, const int walkableHeight, con
 	// Find neighbour connections.
 	const int MAX_LAYERS = RC_NOT_CONNECTED - 1;
 	int maxLayerIndex = 0;
+	rcTaskScheduler* scheduler = context->getTaskScheduler();
+	const int threadCount = rcGetThreadCount(scheduler);
+	if (threadCount <= 1 || zSize <= 1)
+	{
+		maxLayerIndex = connectSpanRows(compactHeightfield, walkableHeight, walkableClimb, 0, zSize);
+	}
+	else
+	{
+		const int bandHeight = (zSize + threadCount * CONNECT_BANDS_PER_THREAD - 1) / (threadCount * CONNECT_BANDS_PER_THREAD);
+		const int bandCount = (zSize + bandHeight - 1) / bandHeight;
+		rcTempVector<int> maxLayerIndices;
+		maxLayerIndices.resize(bandCount, 0);
+
+		// The connections share their word with the span heights that the neighbouring rows read,
+		// so neighbouring bands are not connected at the same time: the even bands go first, then the odd bands.
+		rcConnectSpansBandTask evenTask(compactHeightfield, walkableHeight, walkableClimb, bandHeight, 0, 2, maxLayerIndices.data());
+		rcParallelFor(scheduler, evenTask, (bandCount + 1) / 2);
+		rcConnectSpansBandTask oddTask(compactHeightfield, walkableHeight, walkableClimb, bandHeight, 1, 2, maxLayerIndices.data());
+		rcParallelFor(scheduler, oddTask, bandCount / 2);
+
+		for (int band = 0; band < bandCount; ++band)
+		{
+			maxLayerIndex = rcMax(maxLayerIndex, maxLayerIndices[band]);
+		}
+	}
+
+	if (maxLayerIndex > MAX_LAYERS)
+	{
+		context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Heightfield has too many layers %d (max: %d)",
+		         maxLayerIndex, MAX_LAYERS);
+	}
+
+	return true;
+}
+
+bool rcBuildNeighborIndices(rcContext* context, rcCompactHeightfield& compactHeightfield)
+{
+	rcAssert(context);
+
+	rcScopedTimer timer(context, RC_TIMER_BUILD_NEIGHBOR_INDICES);
+
+	const int xSize = compactHeightfield.width;
+	const int zSize = compactHeightfield.height;
 	const int zStride = xSize; // for readability
+
+	// Decode the connections with the array cleared, so that it is rebuilt from the spans.
+	rcFree(compactHeightfield.neighbors);
+	compactHeightfield.neighbors = NULL;
+	int* neighbors = (int*)rcAlloc(sizeof(int) * 4 * compactHeightfield.spanCount, RC_ALLOC_PERM);
+	if (!neighbors)
+	{
+		context->log(RC_LOG_ERROR, "rcBuildNeighborIndices: Out of memory 'neighbors' (%d)", compactHeightfield.spanCount * 4);
+		return false;
+	}
+
 	for (int z = 0; z < zSize; ++z)
 	{
 		for (int x = 0; x < xSize; ++x)
@@ -490,53 +799,14 @@ bool rcBuildCompactHeightfield(rcContext* context, const int walkableHeight, con
 			const rcCompactCell& cell = compactHeightfield.cells[x + z * zStride];
 			for (int i = (int)cell.index, ni = (int)(cell.index + cell.count); i < ni; ++i)
 			{
-				rcCompactSpan& span = compactHeightfield.spans[i];
-
 				for (int dir = 0; dir < 4; ++dir)
 				{
-					rcSetCon(span, dir, RC_NOT_CONNECTED);
-					const int neighborX = x + rcGetDirOffsetX(dir);
-					const int neighborZ = z + rcGetDirOffsetY(dir);
-					// First check that the neighbour cell is in bounds.
-					if (neighborX < 0 || neighborZ < 0 || neighborX >= xSize || neighborZ >= zSize)
-					{
-						continue;
-					}
-
-					// Iterate over all neighbour spans and check if any of the is
-					// accessible from current cell.
-					const rcCompactCell& neighborCell = compactHeightfield.cells[neighborX + neighborZ * zStride];
-					for (int k = (int)neighborCell.index, nk = (int)(neighborCell.index + neighborCell.count); k < nk; ++k)
-					{
-						const rcCompactSpan& neighborSpan = compactHeightfield.spans[k];
-						const int bot = rcMax(span.y, neighborSpan.y);
-						const int top = rcMin(span.y + span.h, neighborSpan.y + neighborSpan.h);
-
-						// Check that the gap between the spans is walkable,
-						// and that the climb height between the gaps is not too high.
-						if ((top - bot) >= walkableHeight && rcAbs((int)neighborSpan.y - (int)span.y) <= walkableClimb)
-						{
-							// Mark direction as walkable.
-							const int layerIndex = k - (int)neighborCell.index;
-							if (layerIndex < 0 || layerIndex > MAX_LAYERS)
-							{
-								maxLayerIndex = rcMax(maxLayerIndex, layerIndex);
-								continue;
-							}
-							rcSetCon(span, dir, layerIndex);
-							break;
-						}
-					}
+					neighbors[i * 4 + dir] = rcGetNeighborSpan(compactHeightfield, x, z, i, dir);
 				}
 			}
 		}
 	}
 
-	if (maxLayerIndex > MAX_LAYERS)
-	{
-		context->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Heightfield has too many layers %d (max: %d)",
-		         maxLayerIndex, MAX_LAYERS);
-	}
-
+	compactHeightfield.neighbors = neighbors;
 	return true;
 }
@@ -18,6 +18,12 @@
 
 #include "RecastAlloc.h"
 
+#if defined(_MSC_VER)
+#	define RC_THREAD_LOCAL __declspec(thread)
+#else
+#	define RC_THREAD_LOCAL __thread
+#endif
+
 static void* rcAllocDefault(size_t size, rcAllocHint)
 {
 	return malloc(size);
@@ -37,8 +43,20 @@ void rcAllocSetCustom(rcAllocFunc* allocFunc, rcFreeFunc* freeFunc)
 	sRecastFreeFunc = freeFunc ? freeFunc : rcFreeDefault;
 }
 
+// The arena serving the temporary allocations of the thread, and the block it allocates from.
+static RC_THREAD_LOCAL rcTempArena* sThreadTempArena = NULL;
+static RC_THREAD_LOCAL int sThreadTempArenaIndex = 0;
+
 void* rcAlloc(size_t size, rcAllocHint hint)
 {
+	if (hint == RC_ALLOC_TEMP && sThreadTempArena != NULL)
+	{
+		void* ptr = sThreadTempArena->alloc(size, sThreadTempArenaIndex);
+		if (ptr != NULL)
+		{
+			return ptr;
+		}
+	}
 	return sRecastAllocFunc(size, hint);
 }
 
@@ -46,6 +64,135 @@ void rcFree(void* ptr)
 {
 	if (ptr != NULL)
 	{
+		// The arena memory is released all at once by rcTempArena::reset.
+		if (sThreadTempArena != NULL && sThreadTempArena->owns(ptr))
+		{
+			return;
+		}
 		sRecastFreeFunc(ptr);
 	}
 }
+
+void rcSetThreadTempArena(rcTempArena* arena, int threadIndex)
+{
+	sThreadTempArena = arena;
+	sThreadTempArenaIndex = threadIndex;
+}
+
+rcTempArena* rcGetThreadTempArena(int* threadIndex)
+{
+	if (threadIndex)
+	{
+		*threadIndex = sThreadTempArenaIndex;
+	}
+	return sThreadTempArena;
+}
+
+/// The alignment of the arena allocations, which matches that of malloc on common platforms.
+static const size_t RC_TEMP_ARENA_ALIGN = 16;
+
+rcTempArena::rcTempArena()
+: m_data(NULL)
+, m_blocks(NULL)
+, m_threadCount(0)
+, m_blockSize(0)
+{
+}
+
+rcTempArena::~rcTempArena()
+{
+	purge();
+}
+
+void rcTempArena::purge()
+{
+	// Bypass rcFree, which ignores the arena memory while the arena is current.
+	if (m_data != NULL)
+	{
+		sRecastFreeFunc(m_data);
+	}
+	if (m_blocks != NULL)
+	{
+		sRecastFreeFunc(m_blocks);
+	}
+	m_data = NULL;
+	m_blocks = NULL;
+	m_threadCount = 0;
+	m_blockSize = 0;
+}
+
+bool rcTempArena::init(int threadCount, size_t blockSize)
+{
+	rcAssert(threadCount >= 1);
+	purge();
+
+	blockSize = (blockSize + RC_TEMP_ARENA_ALIGN - 1) & ~(RC_TEMP_ARENA_ALIGN - 1);
+	m_data = (unsigned char*)sRecastAllocFunc(blockSize * threadCount, RC_ALLOC_PERM);
+	m_blocks = (Block*)sRecastAllocFunc(sizeof(Block) * threadCount, RC_ALLOC_PERM);
+	if (m_data == NULL || m_blocks == NULL)
+	{
+		purge();
+		return false;
+	}
+	m_threadCount = threadCount;
+	m_blockSize = blockSize;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		m_blocks[i].used = 0;
+		m_blocks[i].peak = 0;
+	}
+	return true;
+}
+
+void rcTempArena::reset()
+{
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		m_blocks[i].used = 0;
+	}
+}
+
+void* rcTempArena::alloc(size_t size, int threadIndex)
+{
+	if (threadIndex < 0 || threadIndex >= m_threadCount)
+	{
+		return NULL;
+	}
+	Block& block = m_blocks[threadIndex];
+	// Zero sized allocations still get a unique address inside the block.
+	const size_t alignedSize = ((size > 0 ? size : 1) + RC_TEMP_ARENA_ALIGN - 1) & ~(RC_TEMP_ARENA_ALIGN - 1);
+	if (alignedSize > m_blockSize - block.used)
+	{
+		return NULL;
+	}
+	void* ptr = m_data + (size_t)threadIndex * m_blockSize + block.used;
+	block.used += alignedSize;
+	if (block.used > block.peak)
+	{
+		block.peak = block.used;
+	}
+	return ptr;
+}
+
+size_t rcTempArena::getUsedSize() const
+{
+	size_t used = 0;
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		used += m_blocks[i].used;
+	}
+	return used;
+}
+
+size_t rcTempArena::getPeakSize() const
+{
+	size_t peak = 0;
+	for (int i = 0; i < m_threadCount; ++i)
+	{
+		if (m_blocks[i].peak > peak)
+		{
+			peak = m_blocks[i].peak;
+		}
+	}
+	return peak;
+}
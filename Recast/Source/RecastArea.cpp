@@ -72,6 +72,36 @@ static bool pointInPoly(int numVerts, const float* verts, const float* point)
 	return inPoly;
 }
 
+/// Lowers the boundary distance of a span to the distance of its neighbor in the direction, plus 2,
+/// and to the distance of the diagonal neighbor one step further in the previous direction, plus 3.
+static void lowerBoundaryDistance(const rcCompactHeightfield& compactHeightfield, unsigned char* distanceToBoundary,
+                                  const int x, const int z, const int spanIndex, const int direction)
+{
+	const int aIndex = rcGetNeighborSpan(compactHeightfield, x, z, spanIndex, direction);
+	if (aIndex < 0)
+	{
+		return;
+	}
+	unsigned char newDistance = (unsigned char)rcMin((int)distanceToBoundary[aIndex] + 2, 255);
+	if (newDistance < distanceToBoundary[spanIndex])
+	{
+		distanceToBoundary[spanIndex] = newDistance;
+	}
+
+	const int aX = x + rcGetDirOffsetX(direction);
+	const int aZ = z + rcGetDirOffsetY(direction);
+	const int bIndex = rcGetNeighborSpan(compactHeightfield, aX, aZ, aIndex, (direction + 3) & 0x3);
+	if (bIndex < 0)
+	{
+		return;
+	}
+	newDistance = (unsigned char)rcMin((int)distanceToBoundary[bIndex] + 3, 255);
+	if (newDistance < distanceToBoundary[spanIndex])
+	{
+		distanceToBoundary[spanIndex] = newDistance;
+	}
+}
+
 bool rcErodeWalkableArea(rcContext* context, const int erosionRadius, rcCompactHeightfield& compactHeightfield)
 {
 	rcAssert(context != NULL);
@@ -81,6 +111,7 @@ bool rcErodeWalkableArea(rcContext* context, const int erosionRadius, rcCompactH
 	const int& zStride = xSize; // For readability
 
 	rcScopedTimer timer(context, RC_TIMER_ERODE_AREA);
+	rcScopedTempArena tempArena(context);
 
 	unsigned char* distanceToBoundary = (unsigned char*)rcAlloc(sizeof(unsigned char) * compactHeightfield.spanCount,
 	                                                            RC_ALLOC_TEMP);
@@ -104,22 +135,16 @@ bool rcErodeWalkableArea(rcContext* context, const int erosionRadius, rcCompactH
 					distanceToBoundary[spanIndex] = 0;
 					continue;
 				}
-				const rcCompactSpan& span = compactHeightfield.spans[spanIndex];
-
 				// Check that there is a non-null adjacent span in each of the 4 cardinal directions.
 				int neighborCount = 0;
 				for (int direction = 0; direction < 4; ++direction)
 				{
-					const int neighborConnection = rcGetCon(span, direction);
-					if (neighborConnection == RC_NOT_CONNECTED)
+					const int neighborSpanIndex = rcGetNeighborSpan(compactHeightfield, x, z, spanIndex, direction);
+					if (neighborSpanIndex < 0)
 					{
 						break;
 					}
 					
-					const int neighborX = x + rcGetDirOffsetX(direction);
-					const int neighborZ = z + rcGetDirOffsetY(direction);
-					const int neighborSpanIndex = (int)compactHeightfield.cells[neighborX + neighborZ * zStride].index + neighborConnection;
-					
 					if (compactHeightfield.areas[neighborSpanIndex] == RC_NULL_AREA)
 					{
 						break;
@@ -136,8 +161,6 @@ bool rcErodeWalkableArea(rcContext* context, const int erosionRadius, rcCompactH
 		}
 	}
 	
-	unsigned char newDistance;
-	
 	// Pass 1
 	for (int z = 0; z < zSize; ++z)
 	{
@@ -147,60 +170,10 @@ bool rcErodeWalkableArea(rcContext* context, const int erosionRadius, rcCompactH
 			const int maxSpanIndex = (int)(cell.index + cell.count);
 			for (int spanIndex = (int)cell.index; spanIndex < maxSpanIndex; ++spanIndex)
 			{
-				const rcCompactSpan& span = compactHeightfield.spans[spanIndex];
-
-				if (rcGetCon(span, 0) != RC_NOT_CONNECTED)
-				{
-					// (-1,0)
-					const int aX = x + rcGetDirOffsetX(0);
-					const int aY = z + rcGetDirOffsetY(0);
-					const int aIndex = (int)compactHeightfield.cells[aX + aY * xSize].index + rcGetCon(span, 0);
-					const rcCompactSpan& aSpan = compactHeightfield.spans[aIndex];
-					newDistance = (unsigned char)rcMin((int)distanceToBoundary[aIndex] + 2, 255);
-					if (newDistance < distanceToBoundary[spanIndex])
-					{
-						distanceToBoundary[spanIndex] = newDistance;
-					}
-
-					// (-1,-1)
-					if (rcGetCon(aSpan, 3) != RC_NOT_CONNECTED)
-					{
-						const int bX = aX + rcGetDirOffsetX(3);
-						const int bY = aY + rcGetDirOffsetY(3);
-						const int bIndex = (int)compactHeightfield.cells[bX + bY * xSize].index + rcGetCon(aSpan, 3);
-						newDistance = (unsigned char)rcMin((int)distanceToBoundary[bIndex] + 3, 255);
-						if (newDistance < distanceToBoundary[spanIndex])
-						{
-							distanceToBoundary[spanIndex] = newDistance;
-						}
-					}
-				}
-				if (rcGetCon(span, 3) != RC_NOT_CONNECTED)
-				{
-					// (0,-1)
-					const int aX = x + rcGetDirOffsetX(3);
-					const int aY = z + rcGetDirOffsetY(3);
-					const int aIndex = (int)compactHeightfield.cells[aX + aY * xSize].index + rcGetCon(span, 3);
-					const rcCompactSpan& aSpan = compactHeightfield.spans[aIndex];
-					newDistance = (unsigned char)rcMin((int)distanceToBoundary[aIndex] + 2, 255);
-					if (newDistance < distanceToBoundary[spanIndex])
-					{
-						distanceToBoundary[spanIndex] = newDistance;
-					}
-
-					// (1,-1)
-					if (rcGetCon(aSpan, 2) != RC_NOT_CONNECTED)
-					{
-						const int bX = aX + rcGetDirOffsetX(2);
-						const int bY = aY + rcGetDirOffsetY(2);
-						const int bIndex = (int)compactHeightfield.cells[bX + bY * xSize].index + rcGetCon(aSpan, 2);
-						newDistance = (unsigned char)rcMin((int)distanceToBoundary[bIndex] + 3, 255);
-						if (newDistance < distanceToBoundary[spanIndex])
-						{
-							distanceToBoundary[spanIndex] = newDistance;
-						}
-					}
-				}
+				// (-1,0) and (-1,-1)
+				lowerBoundaryDistance(compactHeightfield, distanceToBoundary, x, z, spanIndex, 0);
+				// (0,-1) and (1,-1)
+				lowerBoundaryDistance(compactHeightfield, distanceToBoundary, x, z, spanIndex, 3);
 			}
 		}
 	}
@@ -214,60 +187,10 @@ bool rcErodeWalkableArea(rcContext* context, const int erosionRadius, rcCompactH
 			const int maxSpanIndex = (int)(cell.index + cell.count);
 			for (int spanIndex = (int)cell.index; spanIndex < maxSpanIndex; ++spanIndex)
 			{
-				const rcCompactSpan& span = compactHeightfield.spans[spanIndex];
-
-				if (rcGetCon(span, 2) != RC_NOT_CONNECTED)
-				{
-					// (1,0)
-					const int aX = x + rcGetDirOffsetX(2);
-					const int aY = z + rcGetDirOffsetY(2);
-					const int aIndex = (int)compactHeightfield.cells[aX + aY * xSize].index + rcGetCon(span, 2);
-					const rcCompactSpan& aSpan = compactHeightfield.spans[aIndex];
-					newDistance = (unsigned char)rcMin((int)distanceToBoundary[aIndex] + 2, 255);
-					if (newDistance < distanceToBoundary[spanIndex])
-					{
-						distanceToBoundary[spanIndex] = newDistance;
-					}
-
-					// (1,1)
-					if (rcGetCon(aSpan, 1) != RC_NOT_CONNECTED)
-					{
-						const int bX = aX + rcGetDirOffsetX(1);
-						const int bY = aY + rcGetDirOffsetY(1);
-						const int bIndex = (int)compactHeightfield.cells[bX + bY * xSize].index + rcGetCon(aSpan, 1);
-						newDistance = (unsigned char)rcMin((int)distanceToBoundary[bIndex] + 3, 255);
-						if (newDistance < distanceToBoundary[spanIndex])
-						{
-							distanceToBoundary[spanIndex] = newDistance;
-						}
-					}
-				}
-				if (rcGetCon(span, 1) != RC_NOT_CONNECTED)
-				{
-					// (0,1)
-					const int aX = x + rcGetDirOffsetX(1);
-					const int aY = z + rcGetDirOffsetY(1);
-					const int aIndex = (int)compactHeightfield.cells[aX + aY * xSize].index + rcGetCon(span, 1);
-					const rcCompactSpan& aSpan = compactHeightfield.spans[aIndex];
-					newDistance = (unsigned char)rcMin((int)distanceToBoundary[aIndex] + 2, 255);
-					if (newDistance < distanceToBoundary[spanIndex])
-					{
-						distanceToBoundary[spanIndex] = newDistance;
-					}
-
-					// (-1,1)
-					if (rcGetCon(aSpan, 0) != RC_NOT_CONNECTED)
-					{
-						const int bX = aX + rcGetDirOffsetX(0);
-						const int bY = aY + rcGetDirOffsetY(0);
-						const int bIndex = (int)compactHeightfield.cells[bX + bY * xSize].index + rcGetCon(aSpan, 0);
-						newDistance = (unsigned char)rcMin((int)distanceToBoundary[bIndex] + 3, 255);
-						if (newDistance < distanceToBoundary[spanIndex])
-						{
-							distanceToBoundary[spanIndex] = newDistance;
-						}
-					}
-				}
+				// (1,0) and (1,1)
+				lowerBoundaryDistance(compactHeightfield, distanceToBoundary, x, z, spanIndex, 2);
+				// (0,1) and (-1,1)
+				lowerBoundaryDistance(compactHeightfield, distanceToBoundary, x, z, spanIndex, 1);
 			}
 		}
 	}
@@ -295,6 +218,7 @@ bool rcMedianFilterWalkableArea(rcContext* context, rcCompactHeightfield& compac
 	const int zStride = xSize; // For readability
 
 	rcScopedTimer timer(context, RC_TIMER_MEDIAN_AREA);
+	rcScopedTempArena tempArena(context);
 
 	unsigned char* areas = (unsigned char*)rcAlloc(sizeof(unsigned char) * compactHeightfield.spanCount, RC_ALLOC_TEMP);
 	if (!areas)
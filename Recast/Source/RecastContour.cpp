@@ -23,6 +23,7 @@
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
+#include "RecastParallel.h"
 
 
 static int getCornerHeight(int x, int y, int i, int dir,
@@ -39,40 +40,36 @@ static int getCornerHeight(int x, int y, int i, int dir,
 	// border vertices which are in between two areas to be removed.
 	regs[0] = chf.spans[i].reg | (chf.areas[i] << 16);
 	
-	if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+	const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+	if (ai >= 0)
 	{
 		const int ax = x + rcGetDirOffsetX(dir);
 		const int ay = y + rcGetDirOffsetY(dir);
-		const int ai = (int)chf.cells[ax+ay*chf.width].index + rcGetCon(s, dir);
 		const rcCompactSpan& as = chf.spans[ai];
 		ch = rcMax(ch, (int)as.y);
 		regs[1] = chf.spans[ai].reg | (chf.areas[ai] << 16);
-		if (rcGetCon(as, dirp) != RC_NOT_CONNECTED)
+		const int ai2 = rcGetNeighborSpan(chf, ax, ay, ai, dirp);
+		if (ai2 >= 0)
 		{
-			const int ax2 = ax + rcGetDirOffsetX(dirp);
-			const int ay2 = ay + rcGetDirOffsetY(dirp);
-			const int ai2 = (int)chf.cells[ax2+ay2*chf.width].index + rcGetCon(as, dirp);
 			const rcCompactSpan& as2 = chf.spans[ai2];
 			ch = rcMax(ch, (int)as2.y);
 			regs[2] = chf.spans[ai2].reg | (chf.areas[ai2] << 16);
 		}
 	}
-	if (rcGetCon(s, dirp) != RC_NOT_CONNECTED)
+	const int bi = rcGetNeighborSpan(chf, x, y, i, dirp);
+	if (bi >= 0)
 	{
-		const int ax = x + rcGetDirOffsetX(dirp);
-		const int ay = y + rcGetDirOffsetY(dirp);
-		const int ai = (int)chf.cells[ax+ay*chf.width].index + rcGetCon(s, dirp);
-		const rcCompactSpan& as = chf.spans[ai];
-		ch = rcMax(ch, (int)as.y);
-		regs[3] = chf.spans[ai].reg | (chf.areas[ai] << 16);
-		if (rcGetCon(as, dir) != RC_NOT_CONNECTED)
+		const int bx = x + rcGetDirOffsetX(dirp);
+		const int by = y + rcGetDirOffsetY(dirp);
+		const rcCompactSpan& bs = chf.spans[bi];
+		ch = rcMax(ch, (int)bs.y);
+		regs[3] = chf.spans[bi].reg | (chf.areas[bi] << 16);
+		const int bi2 = rcGetNeighborSpan(chf, bx, by, bi, dir);
+		if (bi2 >= 0)
 		{
-			const int ax2 = ax + rcGetDirOffsetX(dir);
-			const int ay2 = ay + rcGetDirOffsetY(dir);
-			const int ai2 = (int)chf.cells[ax2+ay2*chf.width].index + rcGetCon(as, dir);
-			const rcCompactSpan& as2 = chf.spans[ai2];
-			ch = rcMax(ch, (int)as2.y);
-			regs[2] = chf.spans[ai2].reg | (chf.areas[ai2] << 16);
+			const rcCompactSpan& bs2 = chf.spans[bi2];
+			ch = rcMax(ch, (int)bs2.y);
+			regs[2] = chf.spans[bi2].reg | (chf.areas[bi2] << 16);
 		}
 	}
 
@@ -132,12 +129,9 @@ static void walkContour(int x, int y, int i,
 				case 2: px++; break;
 			}
 			int r = 0;
-			const rcCompactSpan& s = chf.spans[i];
-			if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+			const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+			if (ai >= 0)
 			{
-				const int ax = x + rcGetDirOffsetX(dir);
-				const int ay = y + rcGetDirOffsetY(dir);
-				const int ai = (int)chf.cells[ax+ay*chf.width].index + rcGetCon(s, dir);
 				r = (int)chf.spans[ai].reg;
 				if (area != chf.areas[ai])
 					isAreaBorder = true;
@@ -156,22 +150,14 @@ static void walkContour(int x, int y, int i,
 		}
 		else
 		{
-			int ni = -1;
-			const int nx = x + rcGetDirOffsetX(dir);
-			const int ny = y + rcGetDirOffsetY(dir);
-			const rcCompactSpan& s = chf.spans[i];
-			if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-			{
-				const rcCompactCell& nc = chf.cells[nx+ny*chf.width];
-				ni = (int)nc.index + rcGetCon(s, dir);
-			}
+			const int ni = rcGetNeighborSpan(chf, x, y, i, dir);
 			if (ni == -1)
 			{
 				// Should not happen.
 				return;
 			}
-			x = nx;
-			y = ny;
+			x += rcGetDirOffsetX(dir);
+			y += rcGetDirOffsetY(dir);
 			i = ni;
 			dir = (dir+3) & 0x3;	// Rotate CCW
 		}
@@ -206,12 +192,16 @@ static float distancePtSeg(const int x, const int z,
 	return dx*dx + dz*dz;
 }
 
-static void simplifyContour(rcTempVector<int>& points, rcTempVector<int>& simplified,
+/// Simplifies the raw contour @p points into @p simplified.
+///
+/// While points are added, the simplified contour is kept in @p work as a circular linked list
+/// of [x, y, z, raw index, next] entries, so that adding a point does not move the points after it.
+static void simplifyContour(const int* points, const int pn, rcTempVector<int>& simplified, rcTempVector<int>& work,
 							const float maxError, const int maxEdgeLen, const int buildFlags)
 {
 	// Add initial points.
 	bool hasConnections = false;
-	for (int i = 0; i < points.size(); i += 4)
+	for (int i = 0; i < pn*4; i += 4)
 	{
 		if ((points[i+3] & RC_CONTOUR_REG_MASK) != 0)
 		{
@@ -224,9 +214,9 @@ static void simplifyContour(rcTempVector<int>& points, rcTempVector<int>& simpli
 	{
 		// The contour has some portals to other regions.
 		// Add a new point to every location where the region changes.
-		for (int i = 0, ni = static_cast<int>(points.size()) / 4; i < ni; ++i)
+		for (int i = 0; i < pn; ++i)
 		{
-			int ii = (i+1) % ni;
+			int ii = (i+1) % pn;
 			const bool differentRegs = (points[i*4+3] & RC_CONTOUR_REG_MASK) != (points[ii*4+3] & RC_CONTOUR_REG_MASK);
 			const bool areaBorders = (points[i*4+3] & RC_AREA_BORDER) != (points[ii*4+3] & RC_AREA_BORDER);
 			if (differentRegs || areaBorders)
@@ -252,7 +242,7 @@ static void simplifyContour(rcTempVector<int>& points, rcTempVector<int>& simpli
 		int ury = points[1];
 		int urz = points[2];
 		int uri = 0;
-		for (int i = 0; i < points.size(); i += 4)
+		for (int i = 0; i < pn*4; i += 4)
 		{
 			int x = points[i+0];
 			int y = points[i+1];
@@ -283,20 +273,30 @@ static void simplifyContour(rcTempVector<int>& points, rcTempVector<int>& simpli
 		simplified.push_back(uri);
 	}
 	
+	const int sn = static_cast<int>(simplified.size()) / 4;
+	work.clear();
+	for (int i = 0; i < sn; ++i)
+	{
+		work.push_back(simplified[i*4+0]);
+		work.push_back(simplified[i*4+1]);
+		work.push_back(simplified[i*4+2]);
+		work.push_back(simplified[i*4+3]);
+		work.push_back((i+1) % sn);
+	}
+	
 	// Add points until all raw points are within
 	// error tolerance to the simplified shape.
-	const int pn = static_cast<int>(points.size()) / 4;
-	for (int i = 0; i < simplified.size()/4; )
+	for (int i = 0; ; )
 	{
-		int ii = (i+1) % (simplified.size()/4);
+		int ii = work[i*5+4];
 		
-		int ax = simplified[i*4+0];
-		int az = simplified[i*4+2];
-		int ai = simplified[i*4+3];
+		int ax = work[i*5+0];
+		int az = work[i*5+2];
+		int ai = work[i*5+3];
 
-		int bx = simplified[ii*4+0];
-		int bz = simplified[ii*4+2];
-		int bi = simplified[ii*4+3];
+		int bx = work[ii*5+0];
+		int bz = work[ii*5+2];
+		int bi = work[ii*5+3];
 
 		// Find maximum deviation from the segment.
 		float maxd = 0;
@@ -342,42 +342,37 @@ static void simplifyContour(rcTempVector<int>& points, rcTempVector<int>& simpli
 		// add new point, else continue to next segment.
 		if (maxi != -1 && maxd > (maxError*maxError))
 		{
-			// Add space for the new point.
-			simplified.resize(simplified.size()+4);
-			const int n = static_cast<int>(simplified.size()) / 4;
-			for (int j = n-1; j > i; --j)
-			{
-				simplified[j*4+0] = simplified[(j-1)*4+0];
-				simplified[j*4+1] = simplified[(j-1)*4+1];
-				simplified[j*4+2] = simplified[(j-1)*4+2];
-				simplified[j*4+3] = simplified[(j-1)*4+3];
-			}
-			// Add the point.
-			simplified[(i+1)*4+0] = points[maxi*4+0];
-			simplified[(i+1)*4+1] = points[maxi*4+1];
-			simplified[(i+1)*4+2] = points[maxi*4+2];
-			simplified[(i+1)*4+3] = maxi;
+			// Add the point after the current one.
+			const int n = static_cast<int>(work.size()) / 5;
+			work.push_back(points[maxi*4+0]);
+			work.push_back(points[maxi*4+1]);
+			work.push_back(points[maxi*4+2]);
+			work.push_back(maxi);
+			work.push_back(ii);
+			work[i*5+4] = n;
 		}
 		else
 		{
-			++i;
+			i = ii;
+			if (i == 0)
+				break;
 		}
 	}
 	
 	// Split too long edges.
 	if (maxEdgeLen > 0 && (buildFlags & (RC_CONTOUR_TESS_WALL_EDGES|RC_CONTOUR_TESS_AREA_EDGES)) != 0)
 	{
-		for (int i = 0; i < simplified.size()/4; )
+		for (int i = 0; ; )
 		{
-			const int ii = (i+1) % (simplified.size()/4);
+			const int ii = work[i*5+4];
 			
-			const int ax = simplified[i*4+0];
-			const int az = simplified[i*4+2];
-			const int ai = simplified[i*4+3];
+			const int ax = work[i*5+0];
+			const int az = work[i*5+2];
+			const int ai = work[i*5+3];
 			
-			const int bx = simplified[ii*4+0];
-			const int bz = simplified[ii*4+2];
-			const int bi = simplified[ii*4+3];
+			const int bx = work[ii*5+0];
+			const int bz = work[ii*5+2];
+			const int bi = work[ii*5+3];
 			
 			// Find maximum deviation from the segment.
 			int maxi = -1;
@@ -416,29 +411,37 @@ static void simplifyContour(rcTempVector<int>& points, rcTempVector<int>& simpli
 			// add new point, else continue to next segment.
 			if (maxi != -1)
 			{
-				// Add space for the new point.
-				simplified.resize(simplified.size()+4);
-				const int n = static_cast<int>(simplified.size()) / 4;
-				for (int j = n-1; j > i; --j)
-				{
-					simplified[j*4+0] = simplified[(j-1)*4+0];
-					simplified[j*4+1] = simplified[(j-1)*4+1];
-					simplified[j*4+2] = simplified[(j-1)*4+2];
-					simplified[j*4+3] = simplified[(j-1)*4+3];
-				}
-				// Add the point.
-				simplified[(i+1)*4+0] = points[maxi*4+0];
-				simplified[(i+1)*4+1] = points[maxi*4+1];
-				simplified[(i+1)*4+2] = points[maxi*4+2];
-				simplified[(i+1)*4+3] = maxi;
+				// Add the point after the current one.
+				const int n = static_cast<int>(work.size()) / 5;
+				work.push_back(points[maxi*4+0]);
+				work.push_back(points[maxi*4+1]);
+				work.push_back(points[maxi*4+2]);
+				work.push_back(maxi);
+				work.push_back(ii);
+				work[i*5+4] = n;
 			}
 			else
 			{
-				++i;
+				i = ii;
+				if (i == 0)
+					break;
 			}
 		}
 	}
 	
+	// Store the points in contour order.
+	simplified.clear();
+	for (int i = 0; ; )
+	{
+		simplified.push_back(work[i*5+0]);
+		simplified.push_back(work[i*5+1]);
+		simplified.push_back(work[i*5+2]);
+		simplified.push_back(work[i*5+3]);
+		i = work[i*5+4];
+		if (i == 0)
+			break;
+	}
+	
 	for (int i = 0; i < simplified.size()/4; ++i)
 	{
 		// The edge vertex flag is take from the current raw point,
@@ -532,26 +535,6 @@ static bool vequal(const int* a, const int* b)
 	return a[0] == b[0] && a[2] == b[2];
 }
 
-static bool intersectSegContour(const int* d0, const int* d1, int i, int n, const int* verts)
-{
-	// For each edge (k,k+1) of P
-	for (int k = 0; k < n; k++)
-	{
-		int k1 = next(k, n);
-		// Skip edges incident to i.
-		if (i == k || i == k1)
-			continue;
-		const int* p0 = &verts[k * 4];
-		const int* p1 = &verts[k1 * 4];
-		if (vequal(d0, p0) || vequal(d1, p0) || vequal(d0, p1) || vequal(d1, p1))
-			continue;
-		
-		if (intersect(d0, d1, p0, p1))
-			return true;
-	}
-	return false;
-}
-
 static bool	inCone(int i, int n, const int* verts, const int* pj)
 {
 	const int* pi = &verts[i * 4];
@@ -571,25 +554,27 @@ static void removeDegenerateSegments(rcTempVector<int>& simplified)
 {
 	// Remove adjacent vertices which are equal on xz-plane,
 	// or else the triangulator will get confused.
-	int npts = static_cast<int>(simplified.size()) / 4;
-	for (int i = 0; i < npts; ++i)
+	// The vertex after a removed vertex is kept without checking it against its next vertex.
+	const int npts = static_cast<int>(simplified.size()) / 4;
+	int nout = 0;
+	for (int i = 0; i < npts; )
 	{
-		int ni = next(i, npts);
-		
-		if (vequal(&simplified[i*4], &simplified[ni*4]))
+		// The last vertex is checked against the first vertex that was kept.
+		const int ni = i+1 < npts ? i+1 : (nout > 0 ? 0 : i);
+		const bool degenerate = vequal(&simplified[i*4], &simplified[ni*4]);
+		// Degenerate segment, remove.
+		const int keep = degenerate ? i+1 : i;
+		if (keep < npts)
 		{
-			// Degenerate segment, remove.
-			for (int j = i; j < simplified.size()/4-1; ++j)
-			{
-				simplified[j*4+0] = simplified[(j+1)*4+0];
-				simplified[j*4+1] = simplified[(j+1)*4+1];
-				simplified[j*4+2] = simplified[(j+1)*4+2];
-				simplified[j*4+3] = simplified[(j+1)*4+3];
-			}
-			simplified.resize(simplified.size()-4);
-			npts--;
+			simplified[nout*4+0] = simplified[keep*4+0];
+			simplified[nout*4+1] = simplified[keep*4+1];
+			simplified[nout*4+2] = simplified[keep*4+2];
+			simplified[nout*4+3] = simplified[keep*4+3];
+			nout++;
 		}
+		i = keep+1;
 	}
+	simplified.resize(nout*4);
 }
 
 
@@ -637,10 +622,19 @@ static bool mergeContours(rcContour& ca, rcContour& cb, int ia, int ib)
 	return true;
 }
 
+/// The result of merging a hole into the outline of its region.
+enum rcHoleMergeResult
+{
+	RC_HOLE_MERGED = 0,			///< The hole was merged into the outline.
+	RC_HOLE_NO_MERGE_POINTS,	///< No diagonal between the outline and the hole was found.
+	RC_HOLE_MERGE_FAILED,		///< The merged contour could not be allocated.
+};
+
 struct rcContourHole
 {
 	rcContour* contour;
 	int minx, minz, leftmost;
+	rcHoleMergeResult result;
 };
 
 struct rcContourRegion
@@ -648,6 +642,7 @@ struct rcContourRegion
 	rcContour* outline;
 	rcContourHole* holes;
 	int nholes;
+	bool outOfMemory;
 };
 
 struct rcPotentialDiagonal
@@ -656,6 +651,119 @@ struct rcPotentialDiagonal
 	int dist;
 };
 
+/// A uniform grid of the contour edges of a region, used to test the hole merge diagonals
+/// against the nearby edges only.
+class rcContourEdgeGrid
+{
+public:
+	rcContourEdgeGrid(const int minx, const int minz, const int maxx, const int maxz, const int edgeCount)
+	: m_minx(minx)
+	, m_minz(minz)
+	, m_stamp(0)
+	{
+		// Aim for about one edge per cell.
+		const int sizeX = maxx - minx + 1;
+		const int sizeZ = maxz - minz + 1;
+		m_cellSize = rcMax(1, (int)ceilf(sqrtf((float)sizeX * (float)sizeZ / (float)rcMax(edgeCount, 1))));
+		m_width = sizeX / m_cellSize + 1;
+		m_height = sizeZ / m_cellSize + 1;
+		m_cells.resize(m_width * m_height, -1);
+	}
+
+	/// Adds the edge from @p a to @p b.
+	///  @param[in]		owner	The contour the edge belongs to, see #removeOwner.
+	void addEdge(const int* a, const int* b, const int owner)
+	{
+		const int edge = static_cast<int>(m_owners.size());
+		for (int i = 0; i < 3; ++i)
+			m_verts.push_back(a[i]);
+		for (int i = 0; i < 3; ++i)
+			m_verts.push_back(b[i]);
+		m_owners.push_back(owner);
+		m_stamps.push_back(0);
+		
+		int x0, z0, x1, z1;
+		getCellRange(a, b, x0, z0, x1, z1);
+		for (int z = z0; z <= z1; ++z)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				const int cell = x + z*m_width;
+				m_entryEdges.push_back(edge);
+				m_entryNext.push_back(m_cells[cell]);
+				m_cells[cell] = static_cast<int>(m_entryEdges.size()) - 1;
+			}
+		}
+	}
+	
+	/// Excludes the edges of @p owner from the intersection tests.
+	void removeOwner(const int owner)
+	{
+		if (owner >= m_removed.size())
+			m_removed.resize(owner+1, false);
+		m_removed[owner] = true;
+	}
+	
+	/// Returns true if the segment from @p d0 to @p d1 intersects any of the edges,
+	/// ignoring the edges that share a vertex with the segment.
+	bool intersectSegment(const int* d0, const int* d1)
+	{
+		m_stamp++;
+		int x0, z0, x1, z1;
+		getCellRange(d0, d1, x0, z0, x1, z1);
+		for (int z = z0; z <= z1; ++z)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				for (int entry = m_cells[x + z*m_width]; entry != -1; entry = m_entryNext[entry])
+				{
+					const int edge = m_entryEdges[entry];
+					if (m_stamps[edge] == m_stamp)
+						continue;
+					m_stamps[edge] = m_stamp;
+					const int owner = m_owners[edge];
+					if (owner < m_removed.size() && m_removed[owner])
+						continue;
+					const int* p0 = &m_verts[edge*6];
+					const int* p1 = &m_verts[edge*6+3];
+					if (vequal(d0, p0) || vequal(d1, p0) || vequal(d0, p1) || vequal(d1, p1))
+						continue;
+					if (intersect(d0, d1, p0, p1))
+						return true;
+				}
+			}
+		}
+		return false;
+	}
+
+private:
+	void getCellRange(const int* a, const int* b, int& x0, int& z0, int& x1, int& z1) const
+	{
+		x0 = rcClamp((rcMin(a[0], b[0]) - m_minx) / m_cellSize, 0, m_width-1);
+		z0 = rcClamp((rcMin(a[2], b[2]) - m_minz) / m_cellSize, 0, m_height-1);
+		x1 = rcClamp((rcMax(a[0], b[0]) - m_minx) / m_cellSize, 0, m_width-1);
+		z1 = rcClamp((rcMax(a[2], b[2]) - m_minz) / m_cellSize, 0, m_height-1);
+	}
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcContourEdgeGrid(const rcContourEdgeGrid&);
+	rcContourEdgeGrid& operator=(const rcContourEdgeGrid&);
+
+	int m_minx;
+	int m_minz;
+	int m_cellSize;
+	int m_width;
+	int m_height;
+	int m_stamp;
+	rcTempVector<int> m_cells;			///< The first entry of each cell.
+	rcTempVector<int> m_entryEdges;		///< The edge of each entry.
+	rcTempVector<int> m_entryNext;		///< The next entry in the same cell.
+	rcTempVector<int> m_verts;			///< The end points of each edge. [(x, y, z) * 2 * edge count]
+	rcTempVector<int> m_owners;			///< The contour of each edge.
+	rcTempVector<int> m_stamps;			///< The last test that visited each edge.
+	rcTempVector<bool> m_removed;		///< The contours that are excluded from the tests.
+};
+
 // Finds the lowest leftmost vertex of a contour.
 static void findLeftMostVertex(rcContour* contour, int* minx, int* minz, int* leftmost)
 {
@@ -693,23 +801,62 @@ static int compareHoles(const void* va, const void* vb)
 		if (a->minx > b->minx)
 			return 1;
 	}
+	// Keep the contour order for equal holes, regardless of the qsort implementation.
+	if (a->contour < b->contour)
+		return -1;
+	if (a->contour > b->contour)
+		return 1;
 	return 0;
 }
 
 
-static int compareDiagDist(const void* va, const void* vb)
+// Returns true if diagonal a is shorter than b, or has a lower vertex index at the same length.
+inline bool diagLess(const rcPotentialDiagonal& a, const rcPotentialDiagonal& b)
 {
-	const rcPotentialDiagonal* a = (const rcPotentialDiagonal*)va;
-	const rcPotentialDiagonal* b = (const rcPotentialDiagonal*)vb;
-	if (a->dist < b->dist)
-		return -1;
-	if (a->dist > b->dist)
-		return 1;
-	return 0;
+	return a.dist < b.dist || (a.dist == b.dist && a.vert < b.vert);
+}
+
+static void siftDownDiag(rcPotentialDiagonal* diags, const int ndiags, int i)
+{
+	for (;;)
+	{
+		const int left = i*2+1;
+		if (left >= ndiags)
+			return;
+		int child = left;
+		if (left+1 < ndiags && diagLess(diags[left+1], diags[left]))
+			child = left+1;
+		if (!diagLess(diags[child], diags[i]))
+			return;
+		rcSwap(diags[child], diags[i]);
+		i = child;
+	}
+}
+
+// Orders the diagonals into a min heap, so that they can be visited from the shortest one
+// without sorting all of them, since one of the first few is usually chosen.
+static void makeDiagHeap(rcPotentialDiagonal* diags, const int ndiags)
+{
+	for (int i = ndiags/2-1; i >= 0; --i)
+		siftDownDiag(diags, ndiags, i);
+}
+
+// Removes the shortest diagonal from the heap and returns it.
+static rcPotentialDiagonal popDiagHeap(rcPotentialDiagonal* diags, const int ndiags)
+{
+	const rcPotentialDiagonal shortest = diags[0];
+	diags[0] = diags[ndiags-1];
+	siftDownDiag(diags, ndiags-1, 0);
+	return shortest;
 }
 
 
-static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
+/// Merges the holes of a region into its outline.
+///
+/// Does not log, so that regions can be merged in parallel. The result of each hole is stored
+/// in rcContourHole::result, and rcContourRegion::outOfMemory is set if no hole could be merged
+/// because of a failed allocation.
+static void mergeRegionHoles(rcContourRegion& region)
 {
 	// Sort holes from left to right.
 	for (int i = 0; i < region.nholes; i++)
@@ -724,12 +871,38 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 	rcScopedDelete<rcPotentialDiagonal> diags((rcPotentialDiagonal*)rcAlloc(sizeof(rcPotentialDiagonal)*maxVerts, RC_ALLOC_TEMP));
 	if (!diags)
 	{
-		ctx->log(RC_LOG_WARNING, "mergeRegionHoles: Failed to allocated diags %d.", maxVerts);
+		region.outOfMemory = true;
 		return;
 	}
 	
 	rcContour* outline = region.outline;
 	
+	// The diagonals are tested against the edges of the outline and the holes that have not been
+	// processed yet. The outline is owner 0 and hole i is owner i+1. The holes that are merged
+	// stay in the grid as a part of the outline.
+	int minx = outline->verts[0];
+	int minz = outline->verts[2];
+	int maxx = minx;
+	int maxz = minz;
+	for (int i = 0; i <= region.nholes; i++)
+	{
+		const rcContour* cont = i == 0 ? outline : region.holes[i-1].contour;
+		for (int j = 0; j < cont->nverts; j++)
+		{
+			minx = rcMin(minx, cont->verts[j*4+0]);
+			minz = rcMin(minz, cont->verts[j*4+2]);
+			maxx = rcMax(maxx, cont->verts[j*4+0]);
+			maxz = rcMax(maxz, cont->verts[j*4+2]);
+		}
+	}
+	rcContourEdgeGrid grid(minx, minz, maxx, maxz, maxVerts + region.nholes);
+	for (int i = 0; i <= region.nholes; i++)
+	{
+		const rcContour* cont = i == 0 ? outline : region.holes[i-1].contour;
+		for (int j = 0; j < cont->nverts; j++)
+			grid.addEdge(&cont->verts[j*4], &cont->verts[next(j, cont->nverts)*4], i);
+	}
+	
 	// Merge holes into the outline one by one.
 	for (int i = 0; i < region.nholes; i++)
 	{
@@ -760,20 +933,18 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 					ndiags++;
 				}
 			}
-			// Sort potential diagonals by distance, we want to make the connection as short as possible.
-			qsort(diags, ndiags, sizeof(rcPotentialDiagonal), compareDiagDist);
+			// Visit potential diagonals by distance, we want to make the connection as short as possible.
+			makeDiagHeap(diags, ndiags);
 			
 			// Find a diagonal that is not intersecting the outline not the remaining holes.
 			index = -1;
-			for (int j = 0; j < ndiags; j++)
+			for (int j = ndiags; j > 0; j--)
 			{
-				const int* pt = &outline->verts[diags[j].vert*4];
-				bool intersect = intersectSegContour(pt, corner, diags[i].vert, outline->nverts, outline->verts);
-				for (int k = i; k < region.nholes && !intersect; k++)
-					intersect |= intersectSegContour(pt, corner, -1, region.holes[k].contour->nverts, region.holes[k].contour->verts);
-				if (!intersect)
+				const rcPotentialDiagonal diag = popDiagHeap(diags, j);
+				const int* pt = &outline->verts[diag.vert*4];
+				if (!grid.intersectSegment(pt, corner))
 				{
-					index = diags[j].vert;
+					index = diag.vert;
 					break;
 				}
 			}
@@ -786,17 +957,288 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 		
 		if (index == -1)
 		{
-			ctx->log(RC_LOG_WARNING, "mergeHoles: Failed to find merge points for %p and %p.", region.outline, hole);
+			region.holes[i].result = RC_HOLE_NO_MERGE_POINTS;
+			grid.removeOwner(i+1);
 			continue;
 		}
+		
+		// The merged contour connects the outline and the hole along the diagonal.
+		int diagonal[6];
+		memcpy(&diagonal[0], &outline->verts[index*4], sizeof(int)*3);
+		memcpy(&diagonal[3], &hole->verts[bestVertex*4], sizeof(int)*3);
 		if (!mergeContours(*region.outline, *hole, index, bestVertex))
 		{
-			ctx->log(RC_LOG_WARNING, "mergeHoles: Failed to merge contours %p and %p.", region.outline, hole);
+			region.holes[i].result = RC_HOLE_MERGE_FAILED;
+			grid.removeOwner(i+1);
 			continue;
 		}
+		region.holes[i].result = RC_HOLE_MERGED;
+		grid.addEdge(&diagonal[0], &diagonal[3], 0);
+	}
+}
+
+/// Merges the holes of a set of regions into their outlines.
+class rcMergeRegionHolesTask : public rcParallelTask
+{
+public:
+	rcMergeRegionHolesTask(rcContourRegion* regions, const int* regionIds)
+	: m_regions(regions)
+	, m_regionIds(regionIds)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		mergeRegionHoles(m_regions[m_regionIds[itemIndex]]);
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcMergeRegionHolesTask(const rcMergeRegionHolesTask&);
+	rcMergeRegionHolesTask& operator=(const rcMergeRegionHolesTask&);
+
+	rcContourRegion* m_regions;
+	const int* m_regionIds;
+};
+
+/// The number of row bands each thread processes when marking the contour boundaries.
+static const int CONTOUR_BANDS_PER_THREAD = 4;
+
+/// Marks the edges of the spans in the rows [y0, y1) that are not connected to the same region.
+static void markContourBoundaries(const rcCompactHeightfield& chf, unsigned char* flags, const int y0, const int y1)
+{
+	const int w = chf.width;
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const rcCompactCell& c = chf.cells[x+y*w];
+			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			{
+				unsigned char res = 0;
+				if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
+				{
+					flags[i] = 0;
+					continue;
+				}
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					unsigned short r = 0;
+					const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+					if (ai >= 0)
+						r = chf.spans[ai].reg;
+					if (r == chf.spans[i].reg)
+						res |= (1 << dir);
+				}
+				flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
+			}
+		}
+	}
+}
+
+/// Marks the contour boundaries of a band of rows.
+class rcMarkContourBoundaryTask : public rcParallelTask
+{
+public:
+	rcMarkContourBoundaryTask(const rcCompactHeightfield& chf, unsigned char* flags, const int bandHeight)
+	: m_chf(chf)
+	, m_flags(flags)
+	, m_bandHeight(bandHeight)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		const int y0 = itemIndex * m_bandHeight;
+		markContourBoundaries(m_chf, m_flags, y0, rcMin(y0 + m_bandHeight, m_chf.height));
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcMarkContourBoundaryTask(const rcMarkContourBoundaryTask&);
+	rcMarkContourBoundaryTask& operator=(const rcMarkContourBoundaryTask&);
+
+	const rcCompactHeightfield& m_chf;
+	unsigned char* m_flags;
+	const int m_bandHeight;
+};
+
+/// A span on the boundary of a region.
+struct rcBoundarySpan
+{
+	int x;
+	int y;
+	int index;
+};
+
+/// A traced contour before it is added to the contour set.
+struct rcTracedContour
+{
+	int span;			///< The span the contour was traced from.
+	int* rverts;		///< The raw vertices, or null if they could not be allocated.
+	int nrverts;
+	int* verts;			///< The simplified vertices, or null if the contour is dropped.
+	int nverts;
+	unsigned short reg;
+	unsigned char area;
+};
+
+/// Per-thread scratch data of the contour tasks.
+struct rcContourThreadData
+{
+	rcTempVector<int> verts;
+	rcTempVector<int> simplified;
+	rcTempVector<int> work;
+	rcTempVector<rcTracedContour> contours;
+};
+
+static int compareTracedContours(const void* va, const void* vb)
+{
+	const rcTracedContour* a = (const rcTracedContour*)va;
+	const rcTracedContour* b = (const rcTracedContour*)vb;
+	if (a->span < b->span)
+		return -1;
+	if (a->span > b->span)
+		return 1;
+	return 0;
+}
+
+static void freeTracedContours(rcTempVector<rcTracedContour>& contours)
+{
+	for (int i = 0; i < contours.size(); ++i)
+	{
+		rcFree(contours[i].rverts);
+		rcFree(contours[i].verts);
 	}
+	contours.clear();
 }
 
+/// Traces the contours of a region.
+///
+/// The walks only visit the spans of the traced region, so regions can be traced in parallel.
+/// The boundary spans of a region are visited in scan order, which finds the same contours as
+/// visiting all spans in scan order.
+class rcTraceContoursTask : public rcParallelTask
+{
+public:
+	rcTraceContoursTask(const rcCompactHeightfield& chf, unsigned char* flags, const rcBoundarySpan* boundarySpans,
+						const int* regionFirstSpans, const int* regionIds, rcContourThreadData* threads)
+	: m_chf(chf)
+	, m_flags(flags)
+	, m_boundarySpans(boundarySpans)
+	, m_regionFirstSpans(regionFirstSpans)
+	, m_regionIds(regionIds)
+	, m_threads(threads)
+	{
+	}
+
+	virtual void execute(int itemIndex, int threadIndex)
+	{
+		rcContourThreadData& thread = m_threads[threadIndex];
+		const int reg = m_regionIds[itemIndex];
+		for (int j = m_regionFirstSpans[reg]; j < m_regionFirstSpans[reg+1]; ++j)
+		{
+			const rcBoundarySpan& bs = m_boundarySpans[j];
+			const int i = bs.index;
+			if (m_flags[i] == 0 || m_flags[i] == 0xf)
+			{
+				m_flags[i] = 0;
+				continue;
+			}
+			
+			thread.verts.clear();
+			walkContour(bs.x, bs.y, i, m_chf, m_flags, thread.verts);
+			
+			rcTracedContour cont;
+			cont.span = i;
+			cont.nrverts = static_cast<int>(thread.verts.size()) / 4;
+			cont.rverts = (int*)rcAlloc(sizeof(int)*cont.nrverts*4, RC_ALLOC_PERM);
+			if (cont.rverts)
+				memcpy(cont.rverts, &thread.verts[0], sizeof(int)*cont.nrverts*4);
+			cont.verts = 0;
+			cont.nverts = 0;
+			cont.reg = m_chf.spans[i].reg;
+			cont.area = m_chf.areas[i];
+			thread.contours.push_back(cont);
+		}
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcTraceContoursTask(const rcTraceContoursTask&);
+	rcTraceContoursTask& operator=(const rcTraceContoursTask&);
+
+	const rcCompactHeightfield& m_chf;
+	unsigned char* m_flags;
+	const rcBoundarySpan* m_boundarySpans;
+	const int* m_regionFirstSpans;
+	const int* m_regionIds;
+	rcContourThreadData* m_threads;
+};
+
+/// Simplifies the traced contours and removes the border offset from their vertices.
+class rcSimplifyContoursTask : public rcParallelTask
+{
+public:
+	rcSimplifyContoursTask(rcTracedContour* contours, rcContourThreadData* threads, const float maxError,
+						   const int maxEdgeLen, const int buildFlags, const int borderSize)
+	: m_contours(contours)
+	, m_threads(threads)
+	, m_maxError(maxError)
+	, m_maxEdgeLen(maxEdgeLen)
+	, m_buildFlags(buildFlags)
+	, m_borderSize(borderSize)
+	{
+	}
+
+	virtual void execute(int itemIndex, int threadIndex)
+	{
+		rcContourThreadData& thread = m_threads[threadIndex];
+		rcTracedContour& cont = m_contours[itemIndex];
+		if (!cont.rverts)
+			return;
+		
+		thread.simplified.clear();
+		simplifyContour(cont.rverts, cont.nrverts, thread.simplified, thread.work, m_maxError, m_maxEdgeLen, m_buildFlags);
+		removeDegenerateSegments(thread.simplified);
+		
+		cont.nverts = static_cast<int>(thread.simplified.size()) / 4;
+		if (cont.nverts < 3)
+			return;
+		cont.verts = (int*)rcAlloc(sizeof(int)*cont.nverts*4, RC_ALLOC_PERM);
+		if (!cont.verts)
+			return;
+		memcpy(cont.verts, &thread.simplified[0], sizeof(int)*cont.nverts*4);
+		if (m_borderSize > 0)
+		{
+			// If the heightfield was build with bordersize, remove the offset.
+			for (int j = 0; j < cont.nverts; ++j)
+			{
+				int* v = &cont.verts[j*4];
+				v[0] -= m_borderSize;
+				v[2] -= m_borderSize;
+			}
+			for (int j = 0; j < cont.nrverts; ++j)
+			{
+				int* v = &cont.rverts[j*4];
+				v[0] -= m_borderSize;
+				v[2] -= m_borderSize;
+			}
+		}
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcSimplifyContoursTask(const rcSimplifyContoursTask&);
+	rcSimplifyContoursTask& operator=(const rcSimplifyContoursTask&);
+
+	rcTracedContour* m_contours;
+	rcContourThreadData* m_threads;
+	const float m_maxError;
+	const int m_maxEdgeLen;
+	const int m_buildFlags;
+	const int m_borderSize;
+};
 
 /// @par
 ///
@@ -808,6 +1250,9 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 ///
 /// Setting @p maxEdgeLength to zero will disabled the edge length feature.
 ///
+/// The regions are traced, simplified and have their holes merged in parallel if the context
+/// has a task scheduler. The contour set is the same for any number of threads.
+///
 /// See the #rcConfig documentation for more information on the configuration parameters.
 ///
 /// @see rcAllocContourSet, rcCompactHeightfield, rcContourSet, rcConfig
@@ -820,8 +1265,11 @@ bool rcBuildContours(rcContext* ctx, const rcCompactHeightfield& chf,
 	const int w = chf.width;
 	const int h = chf.height;
 	const int borderSize = chf.borderSize;
+	rcTaskScheduler* scheduler = ctx->getTaskScheduler();
+	const int threadCount = rcGetThreadCount(scheduler);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_CONTOURS);
+	rcScopedTempArena tempArena(ctx);
 	
 	rcVcopy(cset.bmin, chf.bmin);
 	rcVcopy(cset.bmax, chf.bmax);
@@ -854,146 +1302,139 @@ bool rcBuildContours(rcContext* ctx, const rcCompactHeightfield& chf,
 		return false;
 	}
 	
-	ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+	rcTempVector<rcContourThreadData> threads(threadCount);
+	rcTempVector<rcTracedContour> contours;
 	
-	// Mark boundaries.
-	for (int y = 0; y < h; ++y)
 	{
-		for (int x = 0; x < w; ++x)
+		rcScopedTimer timerTrace(ctx, RC_TIMER_BUILD_CONTOURS_TRACE);
+		
+		// Mark boundaries.
+		const int bandCount = rcMin(h, threadCount * CONTOUR_BANDS_PER_THREAD);
+		if (bandCount > 0)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			rcMarkContourBoundaryTask task(chf, flags, (h + bandCount - 1) / bandCount);
+			rcParallelFor(scheduler, task, bandCount);
+		}
+		
+		// Group the boundary spans by region, in scan order.
+		const int nregions = chf.maxRegions+1;
+		rcTempVector<int> regionFirstSpans(nregions+1, 0);
+		for (int i = 0; i < chf.spanCount; ++i)
+		{
+			if (flags[i] != 0 && flags[i] != 0xf)
+				regionFirstSpans[chf.spans[i].reg+1]++;
+		}
+		rcTempVector<int> regionIds;
+		for (int i = 0; i < nregions; ++i)
+		{
+			if (regionFirstSpans[i+1] > 0)
+				regionIds.push_back(i);
+			regionFirstSpans[i+1] += regionFirstSpans[i];
+		}
+		rcTempVector<rcBoundarySpan> boundarySpans(regionFirstSpans[nregions]);
+		rcTempVector<int> regionNextSpans(regionFirstSpans.data(), regionFirstSpans.data() + nregions);
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
 			{
-				unsigned char res = 0;
-				const rcCompactSpan& s = chf.spans[i];
-				if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
-				{
-					flags[i] = 0;
-					continue;
-				}
-				for (int dir = 0; dir < 4; ++dir)
+				const rcCompactCell& c = chf.cells[x+y*w];
+				for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 				{
-					unsigned short r = 0;
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						r = chf.spans[ai].reg;
-					}
-					if (r == chf.spans[i].reg)
-						res |= (1 << dir);
+					if (flags[i] == 0 || flags[i] == 0xf)
+						continue;
+					rcBoundarySpan& bs = boundarySpans[regionNextSpans[chf.spans[i].reg]++];
+					bs.x = x;
+					bs.y = y;
+					bs.index = i;
 				}
-				flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
 			}
 		}
+		
+		rcTraceContoursTask task(chf, flags, boundarySpans.data(), regionFirstSpans.data(), regionIds.data(), threads.data());
+		rcParallelFor(scheduler, task, regionIds.size());
+		
+		// Put the contours in the order they are found in a scan over all spans.
+		int ncontours = 0;
+		for (int i = 0; i < threadCount; ++i)
+			ncontours += threads[i].contours.size();
+		contours.reserve(ncontours);
+		for (int i = 0; i < threadCount; ++i)
+		{
+			for (int j = 0; j < threads[i].contours.size(); ++j)
+				contours.push_back(threads[i].contours[j]);
+			threads[i].contours.clear();
+		}
+		if (contours.size() > 1)
+			qsort(contours.data(), contours.size(), sizeof(rcTracedContour), compareTracedContours);
 	}
 	
-	ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+	for (int i = 0; i < contours.size(); ++i)
+	{
+		if (!contours[i].rverts)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'rverts' (%d).", contours[i].nrverts);
+			freeTracedContours(contours);
+			return false;
+		}
+	}
 	
-	rcTempVector<int> verts(256);
-	rcTempVector<int> simplified(64);
+	{
+		rcScopedTimer timerSimplify(ctx, RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
+		
+		rcSimplifyContoursTask task(contours.data(), threads.data(), maxError, maxEdgeLen, buildFlags, borderSize);
+		rcParallelFor(scheduler, task, contours.size());
+	}
 	
-	for (int y = 0; y < h; ++y)
+	// Store region->contour remap info.
+	// Create contours.
+	int nkept = 0;
+	for (int i = 0; i < contours.size(); ++i)
 	{
-		for (int x = 0; x < w; ++x)
+		if (contours[i].nverts < 3)
+			continue;
+		if (!contours[i].verts)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				if (flags[i] == 0 || flags[i] == 0xf)
-				{
-					flags[i] = 0;
-					continue;
-				}
-				const unsigned short reg = chf.spans[i].reg;
-				if (!reg || (reg & RC_BORDER_REG))
-					continue;
-				const unsigned char area = chf.areas[i];
-				
-				verts.clear();
-				simplified.clear();
-				
-				ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
-				walkContour(x, y, i, chf, flags, verts);
-				ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
-				
-				ctx->startTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
-				simplifyContour(verts, simplified, maxError, maxEdgeLen, buildFlags);
-				removeDegenerateSegments(simplified);
-				ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
-				
-				
-				// Store region->contour remap info.
-				// Create contour.
-				if (simplified.size()/4 >= 3)
-				{
-					if (cset.nconts >= maxContours)
-					{
-						// Allocate more contours.
-						// This happens when a region has holes.
-						const int oldMax = maxContours;
-						maxContours *= 2;
-						rcContour* newConts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
-						for (int j = 0; j < cset.nconts; ++j)
-						{
-							newConts[j] = cset.conts[j];
-							// Reset source pointers to prevent data deletion.
-							cset.conts[j].verts = 0;
-							cset.conts[j].rverts = 0;
-						}
-						rcFree(cset.conts);
-						cset.conts = newConts;
-						
-						ctx->log(RC_LOG_WARNING, "rcBuildContours: Expanding max contours from %d to %d.", oldMax, maxContours);
-					}
-					
-					rcContour* cont = &cset.conts[cset.nconts++];
-					
-					cont->nverts = static_cast<int>(simplified.size()) / 4;
-					cont->verts = (int*)rcAlloc(sizeof(int)*cont->nverts*4, RC_ALLOC_PERM);
-					if (!cont->verts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'verts' (%d).", cont->nverts);
-						return false;
-					}
-					memcpy(cont->verts, &simplified[0], sizeof(int)*cont->nverts*4);
-					if (borderSize > 0)
-					{
-						// If the heightfield was build with bordersize, remove the offset.
-						for (int j = 0; j < cont->nverts; ++j)
-						{
-							int* v = &cont->verts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
-					}
-					
-					cont->nrverts = static_cast<int>(verts.size()) / 4;
-					cont->rverts = static_cast<int*>(rcAlloc(sizeof(int) * cont->nrverts * 4, RC_ALLOC_PERM));
-					if (!cont->rverts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'rverts' (%d).", cont->nrverts);
-						return false;
-					}
-					memcpy(cont->rverts, &verts[0], sizeof(int)*cont->nrverts*4);
-					if (borderSize > 0)
-					{
-						// If the heightfield was build with bordersize, remove the offset.
-						for (int j = 0; j < cont->nrverts; ++j)
-						{
-							int* v = &cont->rverts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
-					}
-					
-					cont->reg = reg;
-					cont->area = area;
-				}
-			}
+			ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'verts' (%d).", contours[i].nverts);
+			freeTracedContours(contours);
+			return false;
 		}
+		nkept++;
 	}
+	if (nkept > maxContours)
+	{
+		// Allocate more contours.
+		// This happens when a region has holes.
+		while (maxContours < nkept)
+		{
+			const int oldMax = maxContours;
+			maxContours *= 2;
+			ctx->log(RC_LOG_WARNING, "rcBuildContours: Expanding max contours from %d to %d.", oldMax, maxContours);
+		}
+		rcFree(cset.conts);
+		cset.conts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
+		if (!cset.conts)
+		{
+			freeTracedContours(contours);
+			return false;
+		}
+	}
+	for (int i = 0; i < contours.size(); ++i)
+	{
+		rcTracedContour& traced = contours[i];
+		if (traced.nverts < 3)
+		{
+			rcFree(traced.rverts);
+			continue;
+		}
+		rcContour* cont = &cset.conts[cset.nconts++];
+		cont->verts = traced.verts;
+		cont->nverts = traced.nverts;
+		cont->rverts = traced.rverts;
+		cont->nrverts = traced.nrverts;
+		cont->reg = traced.reg;
+		cont->area = traced.area;
+	}
+	contours.clear();
 	
 	// Merge holes if needed.
 	if (cset.nconts > 0)
@@ -1070,6 +1511,15 @@ bool rcBuildContours(rcContext* ctx, const rcCompactHeightfield& chf,
 			}
 			
 			// Finally merge each regions holes into the outline.
+			rcTempVector<int> mergeRegionIds;
+			for (int i = 0; i < nregions; i++)
+			{
+				if (regions[i].nholes && regions[i].outline)
+					mergeRegionIds.push_back(i);
+			}
+			rcMergeRegionHolesTask task(regions, mergeRegionIds.data());
+			rcParallelFor(scheduler, task, mergeRegionIds.size());
+			
 			for (int i = 0; i < nregions; i++)
 			{
 				rcContourRegion& reg = regions[i];
@@ -1077,7 +1527,21 @@ bool rcBuildContours(rcContext* ctx, const rcCompactHeightfield& chf,
 				
 				if (reg.outline)
 				{
-					mergeRegionHoles(ctx, reg);
+					if (reg.outOfMemory)
+					{
+						int maxVerts = reg.outline->nverts;
+						for (int j = 0; j < reg.nholes; j++)
+							maxVerts += reg.holes[j].contour->nverts;
+						ctx->log(RC_LOG_WARNING, "mergeRegionHoles: Failed to allocated diags %d.", maxVerts);
+						continue;
+					}
+					for (int j = 0; j < reg.nholes; j++)
+					{
+						if (reg.holes[j].result == RC_HOLE_NO_MERGE_POINTS)
+							ctx->log(RC_LOG_WARNING, "mergeHoles: Failed to find merge points for %p and %p.", reg.outline, reg.holes[j].contour);
+						else if (reg.holes[j].result == RC_HOLE_MERGE_FAILED)
+							ctx->log(RC_LOG_WARNING, "mergeHoles: Failed to merge contours %p and %p.", reg.outline, reg.holes[j].contour);
+					}
 				}
 				else
 				{
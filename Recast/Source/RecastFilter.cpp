@@ -18,6 +18,7 @@
 
 #include "Recast.h"
 #include "RecastAssert.h"
+#include "RecastParallel.h"
 
 #include <stdlib.h>
 
@@ -44,7 +45,7 @@ void rcFilterLowHangingWalkableObstacles(rcContext* context, const int walkableC
 			unsigned char previousAreaID = RC_NULL_AREA;
 
 			// For each span in the column...
-			for (rcSpan* span = heightfield.spans[x + z * xSize]; span != NULL; previousSpan = span, span = span->next)
+			for (rcSpan* span = rcGetFirstSpan(heightfield, x + z * xSize); span != NULL; previousSpan = span, span = rcGetNextSpan(heightfield, span))
 			{
 				const bool walkable = span->area != RC_NULL_AREA;
 
@@ -64,6 +65,98 @@ void rcFilterLowHangingWalkableObstacles(rcContext* context, const int walkableC
 	}
 }
 
+/// Checks whether a span is next to a ledge, or on a slope that is too steep to walk on.
+/// Only the geometry of the spans is read, not their areas.
+static bool isLedgeSpan(const rcHeightfield& heightfield, const int x, const int z, const rcSpan* span,
+						const int walkableHeight, const int walkableClimb)
+{
+	const int xSize = heightfield.width;
+	const int zSize = heightfield.height;
+
+	const rcSpan* nextSpan = rcGetNextSpan(heightfield, span);
+	const int floor = (int)(span->smax);
+	const int ceiling = nextSpan ? (int)(nextSpan->smin) : MAX_HEIGHTFIELD_HEIGHT;
+
+	// The difference between this walkable area and the lowest neighbor walkable area.
+	// This is the difference between the current span and all neighbor spans that have
+	// enough space for an agent to move between, but not accounting at all for surface slope.
+	int lowestNeighborFloorDifference = MAX_HEIGHTFIELD_HEIGHT;
+
+	// Min and max height of accessible neighbours.
+	int lowestTraversableNeighborFloor = span->smax;
+	int highestTraversableNeighborFloor = span->smax;
+
+	for (int direction = 0; direction < 4; ++direction)
+	{
+		const int neighborX = x + rcGetDirOffsetX(direction);
+		const int neighborZ = z + rcGetDirOffsetY(direction);
+
+		// Skip neighbours which are out of bounds.
+		if (neighborX < 0 || neighborZ < 0 || neighborX >= xSize || neighborZ >= zSize)
+		{
+			lowestNeighborFloorDifference = -walkableClimb - 1;
+			break;
+		}
+
+		const rcSpan* neighborSpan = rcGetFirstSpan(heightfield, neighborX + neighborZ * xSize);
+
+		// The most we can step down to the neighbor is the walkableClimb distance.
+		// Start with the area under the neighbor span
+		int neighborCeiling = neighborSpan ? (int)neighborSpan->smin : MAX_HEIGHTFIELD_HEIGHT;
+
+		// Skip neighbour if the gap between the spans is too small.
+		if (rcMin(ceiling, neighborCeiling) - floor >= walkableHeight)
+		{
+			lowestNeighborFloorDifference = (-walkableClimb - 1);
+			break;
+		}
+
+		// For each span in the neighboring column...
+		for (; neighborSpan != NULL; neighborSpan = rcGetNextSpan(heightfield, neighborSpan))
+		{
+			const rcSpan* nextNeighborSpan = rcGetNextSpan(heightfield, neighborSpan);
+			const int neighborFloor = (int)neighborSpan->smax;
+			neighborCeiling = nextNeighborSpan ? (int)nextNeighborSpan->smin : MAX_HEIGHTFIELD_HEIGHT;
+
+			// Only consider neighboring areas that have enough overlap to be potentially traversable.
+			if (rcMin(ceiling, neighborCeiling) - rcMax(floor, neighborFloor) < walkableHeight)
+			{
+				// No space to traverse between them.
+				continue;
+			}
+
+			const int neighborFloorDifference = neighborFloor - floor;
+			lowestNeighborFloorDifference = rcMin(lowestNeighborFloorDifference, neighborFloorDifference);
+
+			// Find min/max accessible neighbor height.
+			// Only consider neighbors that are at most walkableClimb away.
+			if (rcAbs(neighborFloorDifference) <= walkableClimb)
+			{
+				// There is space to move to the neighbor cell and the slope isn't too much.
+				lowestTraversableNeighborFloor = rcMin(lowestTraversableNeighborFloor, neighborFloor);
+				highestTraversableNeighborFloor = rcMax(highestTraversableNeighborFloor, neighborFloor);
+			}
+			else if (neighborFloorDifference < -walkableClimb)
+			{
+				// We already know this will be considered a ledge span so we can early-out
+				break;
+			}
+		}
+	}
+
+	// The current span is close to a ledge if the magnitude of the drop to any neighbour span is greater than the walkableClimb distance.
+	// That is, there is a gap that is large enough to let an agent move between them, but the drop (surface slope) is too large to allow it.
+	// (If this is the case, then biggestNeighborStepDown will be negative, so compare against the negative walkableClimb as a means of checking
+	// the magnitude of the delta)
+	if (lowestNeighborFloorDifference < -walkableClimb)
+	{
+		return true;
+	}
+
+	// If the difference between all neighbor floors is too large, this is a steep slope, so mark the span as an unwalkable ledge.
+	return highestTraversableNeighborFloor - lowestTraversableNeighborFloor > walkableClimb;
+}
+
 void rcFilterLedgeSpans(rcContext* context, const int walkableHeight, const int walkableClimb, rcHeightfield& heightfield)
 {
 	rcAssert(context);
@@ -78,7 +171,7 @@ void rcFilterLedgeSpans(rcContext* context, const int walkableHeight, const int
 	{
 		for (int x = 0; x < xSize; ++x)
 		{
-			for (rcSpan* span = heightfield.spans[x + z * xSize]; span; span = span->next)
+			for (rcSpan* span = rcGetFirstSpan(heightfield, x + z * xSize); span; span = rcGetNextSpan(heightfield, span))
 			{
 				// Skip non-walkable spans.
 				if (span->area == RC_NULL_AREA)
@@ -86,85 +179,7 @@ void rcFilterLedgeSpans(rcContext* context, const int walkableHeight, const int
 					continue;
 				}
 
-				const int floor = (int)(span->smax);
-				const int ceiling = span->next ? (int)(span->next->smin) : MAX_HEIGHTFIELD_HEIGHT;
-
-				// The difference between this walkable area and the lowest neighbor walkable area.
-				// This is the difference between the current span and all neighbor spans that have
-				// enough space for an agent to move between, but not accounting at all for surface slope.
-				int lowestNeighborFloorDifference = MAX_HEIGHTFIELD_HEIGHT;
-
-				// Min and max height of accessible neighbours.
-				int lowestTraversableNeighborFloor = span->smax;
-				int highestTraversableNeighborFloor = span->smax;
-
-				for (int direction = 0; direction < 4; ++direction)
-				{
-					const int neighborX = x + rcGetDirOffsetX(direction);
-					const int neighborZ = z + rcGetDirOffsetY(direction);
-
-					// Skip neighbours which are out of bounds.
-					if (neighborX < 0 || neighborZ < 0 || neighborX >= xSize || neighborZ >= zSize)
-					{
-						lowestNeighborFloorDifference = -walkableClimb - 1;
-						break;
-					}
-
-					const rcSpan* neighborSpan = heightfield.spans[neighborX + neighborZ * xSize];
-
-					// The most we can step down to the neighbor is the walkableClimb distance.
-					// Start with the area under the neighbor span
-					int neighborCeiling = neighborSpan ? (int)neighborSpan->smin : MAX_HEIGHTFIELD_HEIGHT;
-
-					// Skip neighbour if the gap between the spans is too small.
-					if (rcMin(ceiling, neighborCeiling) - floor >= walkableHeight)
-					{
-						lowestNeighborFloorDifference = (-walkableClimb - 1);
-						break;
-					}
-
-					// For each span in the neighboring column...
-					for (; neighborSpan != NULL; neighborSpan = neighborSpan->next)
-					{
-						const int neighborFloor = (int)neighborSpan->smax;
-						neighborCeiling = neighborSpan->next ? (int)neighborSpan->next->smin : MAX_HEIGHTFIELD_HEIGHT;
-
-						// Only consider neighboring areas that have enough overlap to be potentially traversable.
-						if (rcMin(ceiling, neighborCeiling) - rcMax(floor, neighborFloor) < walkableHeight)
-						{
-							// No space to traverse between them.
-							continue;
-						}
-
-						const int neighborFloorDifference = neighborFloor - floor;
-						lowestNeighborFloorDifference = rcMin(lowestNeighborFloorDifference, neighborFloorDifference);
-
-						// Find min/max accessible neighbor height.
-						// Only consider neighbors that are at most walkableClimb away.
-						if (rcAbs(neighborFloorDifference) <= walkableClimb)
-						{
-							// There is space to move to the neighbor cell and the slope isn't too much.
-							lowestTraversableNeighborFloor = rcMin(lowestTraversableNeighborFloor, neighborFloor);
-							highestTraversableNeighborFloor = rcMax(highestTraversableNeighborFloor, neighborFloor);
-						}
-						else if (neighborFloorDifference < -walkableClimb)
-						{
-							// We already know this will be considered a ledge span so we can early-out
-							break;
-						}
-					}
-				}
-
-				// The current span is close to a ledge if the magnitude of the drop to any neighbour span is greater than the walkableClimb distance.
-				// That is, there is a gap that is large enough to let an agent move between them, but the drop (surface slope) is too large to allow it.
-				// (If this is the case, then biggestNeighborStepDown will be negative, so compare against the negative walkableClimb as a means of checking
-				// the magnitude of the delta)
-				if (lowestNeighborFloorDifference < -walkableClimb)
-				{
-					span->area = RC_NULL_AREA;
-				}
-				// If the difference between all neighbor floors is too large, this is a steep slope, so mark the span as an unwalkable ledge.
-				else if (highestTraversableNeighborFloor - lowestTraversableNeighborFloor > walkableClimb)
+				if (isLedgeSpan(heightfield, x, z, span, walkableHeight, walkableClimb))
 				{
 					span->area = RC_NULL_AREA;
 				}
@@ -187,10 +202,11 @@ void rcFilterWalkableLowHeightSpans(rcContext* context, const int walkableHeight
 	{
 		for (int x = 0; x < xSize; ++x)
 		{
-			for (rcSpan* span = heightfield.spans[x + z*xSize]; span; span = span->next)
+			for (rcSpan* span = rcGetFirstSpan(heightfield, x + z*xSize); span; span = rcGetNextSpan(heightfield, span))
 			{
+				const rcSpan* nextSpan = rcGetNextSpan(heightfield, span);
 				const int floor = (int)(span->smax);
-				const int ceiling = span->next ? (int)(span->next->smin) : MAX_HEIGHTFIELD_HEIGHT;
+				const int ceiling = nextSpan ? (int)(nextSpan->smin) : MAX_HEIGHTFIELD_HEIGHT;
 				if (ceiling - floor < walkableHeight)
 				{
 					span->area = RC_NULL_AREA;
@@ -199,3 +215,132 @@ void rcFilterWalkableLowHeightSpans(rcContext* context, const int walkableHeight
 		}
 	}
 }
+
+/// The number of row bands each thread processes in #rcFilterHeightfield.
+static const int FILTER_BANDS_PER_THREAD = 4;
+
+/// Applies the selected filters to the columns of a range of rows.
+static void filterRows(const rcHeightfield& heightfield, const int filterFlags, const int walkableHeight,
+					   const int walkableClimb, const int z0, const int z1)
+{
+	const int xSize = heightfield.width;
+
+	for (int z = z0; z < z1; ++z)
+	{
+		for (int x = 0; x < xSize; ++x)
+		{
+			const rcSpan* previousSpan = NULL;
+			bool previousWasWalkable = false;
+			unsigned char previousAreaID = RC_NULL_AREA;
+
+			for (rcSpan* span = rcGetFirstSpan(heightfield, x + z * xSize); span != NULL; previousSpan = span, span = rcGetNextSpan(heightfield, span))
+			{
+				// The low hanging obstacle filter uses the areas of the column before the other filters.
+				if (filterFlags & RC_FILTER_LOW_HANGING_OBSTACLES)
+				{
+					const bool walkable = span->area != RC_NULL_AREA;
+					if (!walkable && previousWasWalkable && (int)span->smax - (int)previousSpan->smax <= walkableClimb)
+					{
+						span->area = previousAreaID;
+					}
+					previousWasWalkable = walkable;
+					previousAreaID = span->area;
+				}
+
+				// The other filters only clear walkable spans. Check the cheaper one first.
+				if (span->area == RC_NULL_AREA)
+				{
+					continue;
+				}
+				if (filterFlags & RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS)
+				{
+					const rcSpan* nextSpan = rcGetNextSpan(heightfield, span);
+					const int floor = (int)(span->smax);
+					const int ceiling = nextSpan ? (int)(nextSpan->smin) : MAX_HEIGHTFIELD_HEIGHT;
+					if (ceiling - floor < walkableHeight)
+					{
+						span->area = RC_NULL_AREA;
+						continue;
+					}
+				}
+				if ((filterFlags & RC_FILTER_LEDGE_SPANS) && isLedgeSpan(heightfield, x, z, span, walkableHeight, walkableClimb))
+				{
+					span->area = RC_NULL_AREA;
+				}
+			}
+		}
+	}
+}
+
+/// Filters every other band of rows, starting from the given band.
+class rcFilterBandTask : public rcParallelTask
+{
+public:
+	rcFilterBandTask(const rcHeightfield& heightfield, const int filterFlags, const int walkableHeight,
+					 const int walkableClimb, const int bandHeight, const int firstBand, const int bandStep)
+	: m_heightfield(heightfield)
+	, m_filterFlags(filterFlags)
+	, m_walkableHeight(walkableHeight)
+	, m_walkableClimb(walkableClimb)
+	, m_bandHeight(bandHeight)
+	, m_firstBand(firstBand)
+	, m_bandStep(bandStep)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		const int z0 = (m_firstBand + itemIndex * m_bandStep) * m_bandHeight;
+		filterRows(m_heightfield, m_filterFlags, m_walkableHeight, m_walkableClimb, z0,
+				   rcMin(z0 + m_bandHeight, m_heightfield.height));
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcFilterBandTask(const rcFilterBandTask&);
+	rcFilterBandTask& operator=(const rcFilterBandTask&);
+
+	const rcHeightfield& m_heightfield;
+	const int m_filterFlags;
+	const int m_walkableHeight;
+	const int m_walkableClimb;
+	const int m_bandHeight;
+	const int m_firstBand;
+	const int m_bandStep;
+};
+
+void rcFilterHeightfield(rcContext* context, const int filterFlags, const int walkableHeight, const int walkableClimb,
+						 rcHeightfield& heightfield)
+{
+	rcAssert(context);
+
+	rcScopedTimer timer(context, RC_TIMER_FILTER_HEIGHTFIELD);
+
+	const int zSize = heightfield.height;
+	rcTaskScheduler* scheduler = context->getTaskScheduler();
+	const int threadCount = rcGetThreadCount(scheduler);
+	if (threadCount <= 1 || zSize <= 1)
+	{
+		filterRows(heightfield, filterFlags, walkableHeight, walkableClimb, 0, zSize);
+		return;
+	}
+
+	const int bandHeight = (zSize + threadCount * FILTER_BANDS_PER_THREAD - 1) / (threadCount * FILTER_BANDS_PER_THREAD);
+	const int bandCount = (zSize + bandHeight - 1) / bandHeight;
+
+	if (filterFlags & RC_FILTER_LEDGE_SPANS)
+	{
+		// The ledge filter reads the spans of the neighbouring rows, and the span area shares its
+		// word with the span heights, so neighbouring bands are not filtered at the same time:
+		// the even bands go first, then the odd bands.
+		rcFilterBandTask evenTask(heightfield, filterFlags, walkableHeight, walkableClimb, bandHeight, 0, 2);
+		rcParallelFor(scheduler, evenTask, (bandCount + 1) / 2);
+		rcFilterBandTask oddTask(heightfield, filterFlags, walkableHeight, walkableClimb, bandHeight, 1, 2);
+		rcParallelFor(scheduler, oddTask, bandCount / 2);
+	}
+	else
+	{
+		rcFilterBandTask task(heightfield, filterFlags, walkableHeight, walkableClimb, bandHeight, 0, 1);
+		rcParallelFor(scheduler, task, bandCount);
+	}
+}
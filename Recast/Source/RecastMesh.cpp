@@ -122,21 +122,31 @@ static bool buildMeshAdjacency(unsigned short* polys, const int npolys,
 }
 
 
-static const int VERTEX_BUCKET_COUNT = (1<<12);
+static const int MIN_VERTEX_BUCKET_COUNT = (1<<6);
 
-inline int computeVertexHash(int x, int y, int z)
+// Returns the number of vertex hash buckets for about one vertex per bucket.
+// The count is a power of two, so that the hash can be masked into a bucket.
+static int getVertexBucketCount(const int maxVertices)
+{
+	int count = MIN_VERTEX_BUCKET_COUNT;
+	while (count < maxVertices)
+		count <<= 1;
+	return count;
+}
+
+inline int computeVertexHash(int x, int y, int z, const int bucketCount)
 {
 	const unsigned int h1 = 0x8da6b343; // Large multiplicative constants;
 	const unsigned int h2 = 0xd8163841; // here arbitrarily chosen primes
 	const unsigned int h3 = 0xcb1ab31f;
 	unsigned int n = h1 * x + h2 * y + h3 * z;
-	return (int)(n & (VERTEX_BUCKET_COUNT-1));
+	return (int)(n & (bucketCount-1));
 }
 
 static unsigned short addVertex(unsigned short x, unsigned short y, unsigned short z,
-								unsigned short* verts, int* firstVert, int* nextVert, int& nv)
+								unsigned short* verts, int* firstVert, const int bucketCount, int* nextVert, int& nv)
 {
-	int bucket = computeVertexHash(x, 0, z);
+	int bucket = computeVertexHash(x, 0, z, bucketCount);
 	int i = firstVert[bucket];
 	
 	while (i != -1)
@@ -229,28 +239,177 @@ static bool vequal(const int* a, const int* b)
 	return a[0] == b[0] && a[2] == b[2];
 }
 
+struct rcEar
+{
+	int len;	///< The squared length of the diagonal that clips the ear.
+	int vert;	///< The vertex before the clipped vertex.
+	int stamp;	///< The ear stamp of the vertex when the ear was added.
+};
+
+// Returns true if ear a should be clipped before b. Ties go to the vertex that comes first
+// in the polygon, since clipping vertices does not change the order of the remaining ones.
+inline bool earBefore(const rcEar& a, const rcEar& b)
+{
+	return a.len < b.len || (a.len == b.len && a.vert < b.vert);
+}
+
+/// Triangulates simple polygons by clipping the ear with the shortest diagonal first.
+///
+/// The polygon is kept as a linked list, the ears in a heap and the polygon edges in a uniform grid,
+/// so that clipping an ear only revisits the ears next to it, and testing a diagonal only visits
+/// the nearby edges. The triangles are the same as when searching all the vertices for the
+/// shortest ear and testing the diagonals against all the edges.
+class rcTriangulator
+{
+public:
+	rcTriangulator() : m_verts(0), m_indices(0), m_stamp(0) {}
+
+	/// Triangulates a polygon.
+	///  @param[in]		n			The number of vertices in the polygon.
+	///  @param[in]		verts		The vertices. [(x, y, z, r) * vertex count]
+	///  @param[in]		indices		The polygon, as indices into @p verts. [Size: @p n]
+	///  @param[out]	tris		The triangles, as indices into @p verts. [Size: (@p n - 2) * 3]
+	///  @returns The number of triangles, negated if the polygon could not be fully triangulated.
+	int triangulate(const int n, const int* verts, const int* indices, int* tris);
+
+private:
+	const int* vert(const int i) const { return &m_verts[m_indices[i] * 4]; }
+
+	int diagonalLength(const int i, const int j) const
+	{
+		const int* p0 = vert(i);
+		const int* p2 = vert(j);
+		const int dx = p2[0] - p0[0];
+		const int dy = p2[2] - p0[2];
+		return dx*dx + dy*dy;
+	}
+
+	void initEdgeGrid(const int n);
+	void addEdge(const int i);
+	bool diagonalie(const int i, const int j, const bool loose);
+	bool inCone(const int i, const int j, const bool loose) const;
+	bool diagonal(const int i, const int j, const bool loose)
+	{
+		return inCone(i, j, loose) && diagonalie(i, j, loose);
+	}
+
+	void updateEar(const int i);
+	int popEar();
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcTriangulator(const rcTriangulator&);
+	rcTriangulator& operator=(const rcTriangulator&);
+
+	const int* m_verts;
+	const int* m_indices;
+	rcTempVector<int> m_prev;			///< The previous vertex of each vertex, or -1 once clipped.
+	rcTempVector<int> m_next;			///< The next vertex of each vertex, or -1 once clipped.
+	rcTempVector<bool> m_removable;		///< True if the neighbours of the vertex form a diagonal.
+	rcTempVector<int> m_earStamps;		///< Changed whenever the ear after the vertex changes.
+	rcTempVector<rcEar> m_ears;			///< The ears, as a min heap.
+
+	int m_minx;
+	int m_minz;
+	int m_cellSize;
+	int m_width;
+	int m_height;
+	int m_stamp;
+	rcTempVector<int> m_cells;			///< The first entry of each cell.
+	rcTempVector<int> m_entryEdges;		///< The edge of each entry, as the vertex the edge starts from.
+	rcTempVector<int> m_entryNext;		///< The next entry in the same cell.
+	rcTempVector<int> m_edgeStamps;		///< The last test that visited each edge.
+};
+
+void rcTriangulator::initEdgeGrid(const int n)
+{
+	int minx = vert(0)[0], minz = vert(0)[2];
+	int maxx = minx, maxz = minz;
+	for (int i = 1; i < n; ++i)
+	{
+		const int* v = vert(i);
+		minx = rcMin(minx, v[0]);
+		minz = rcMin(minz, v[2]);
+		maxx = rcMax(maxx, v[0]);
+		maxz = rcMax(maxz, v[2]);
+	}
+	
+	// Aim for about one edge per cell.
+	const int sizeX = maxx - minx + 1;
+	const int sizeZ = maxz - minz + 1;
+	m_minx = minx;
+	m_minz = minz;
+	m_cellSize = rcMax(1, (int)ceilf(sqrtf((float)sizeX * (float)sizeZ / (float)n)));
+	m_width = sizeX / m_cellSize + 1;
+	m_height = sizeZ / m_cellSize + 1;
+	m_cells.assign(m_width * m_height, -1);
+	m_entryEdges.clear();
+	m_entryNext.clear();
+	m_edgeStamps.assign(n, m_stamp);
+	
+	for (int i = 0; i < n; ++i)
+		addEdge(i);
+}
+
+// Adds the edge from vertex i to the next vertex to the grid. The entries of the edges
+// that were replaced by clipping ears are left in place, and skipped by the tests.
+void rcTriangulator::addEdge(const int i)
+{
+	const int* a = vert(i);
+	const int* b = vert(m_next[i]);
+	const int x0 = (rcMin(a[0], b[0]) - m_minx) / m_cellSize;
+	const int z0 = (rcMin(a[2], b[2]) - m_minz) / m_cellSize;
+	const int x1 = (rcMax(a[0], b[0]) - m_minx) / m_cellSize;
+	const int z1 = (rcMax(a[2], b[2]) - m_minz) / m_cellSize;
+	for (int z = z0; z <= z1; ++z)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			const int cell = x + z*m_width;
+			m_entryEdges.push_back(i);
+			m_entryNext.push_back(m_cells[cell]);
+			m_cells[cell] = m_entryEdges.size() - 1;
+		}
+	}
+}
+
 // Returns T iff (v_i, v_j) is a proper internal *or* external
 // diagonal of P, *ignoring edges incident to v_i and v_j*.
-static bool diagonalie(int i, int j, int n, const int* verts, int* indices)
+// The loose test only rejects proper intersections.
+bool rcTriangulator::diagonalie(const int i, const int j, const bool loose)
 {
-	const int* d0 = &verts[(indices[i] & 0x0fffffff) * 4];
-	const int* d1 = &verts[(indices[j] & 0x0fffffff) * 4];
+	const int* d0 = vert(i);
+	const int* d1 = vert(j);
 	
-	// For each edge (k,k+1) of P
-	for (int k = 0; k < n; k++)
+	m_stamp++;
+	const int x0 = rcClamp((rcMin(d0[0], d1[0]) - m_minx) / m_cellSize, 0, m_width-1);
+	const int z0 = rcClamp((rcMin(d0[2], d1[2]) - m_minz) / m_cellSize, 0, m_height-1);
+	const int x1 = rcClamp((rcMax(d0[0], d1[0]) - m_minx) / m_cellSize, 0, m_width-1);
+	const int z1 = rcClamp((rcMax(d0[2], d1[2]) - m_minz) / m_cellSize, 0, m_height-1);
+	for (int z = z0; z <= z1; ++z)
 	{
-		int k1 = next(k, n);
-		// Skip edges incident to i or j
-		if (!((k == i) || (k1 == i) || (k == j) || (k1 == j)))
+		for (int x = x0; x <= x1; ++x)
 		{
-			const int* p0 = &verts[(indices[k] & 0x0fffffff) * 4];
-			const int* p1 = &verts[(indices[k1] & 0x0fffffff) * 4];
-
-			if (vequal(d0, p0) || vequal(d1, p0) || vequal(d0, p1) || vequal(d1, p1))
-				continue;
-			
-			if (intersect(d0, d1, p0, p1))
-				return false;
+			for (int entry = m_cells[x + z*m_width]; entry != -1; entry = m_entryNext[entry])
+			{
+				// For each edge (k,k+1) of P
+				const int k = m_entryEdges[entry];
+				const int k1 = m_next[k];
+				if (k1 == -1 || m_edgeStamps[k] == m_stamp)
+					continue;
+				m_edgeStamps[k] = m_stamp;
+				
+				// Skip edges incident to i or j
+				if ((k == i) || (k1 == i) || (k == j) || (k1 == j))
+					continue;
+				
+				const int* p0 = vert(k);
+				const int* p1 = vert(k1);
+				if (vequal(d0, p0) || vequal(d1, p0) || vequal(d0, p1) || vequal(d1, p1))
+					continue;
+				
+				if (loose ? intersectProp(d0, d1, p0, p1) : intersect(d0, d1, p0, p1))
+					return false;
+			}
 		}
 	}
 	return true;
@@ -258,113 +417,120 @@ static bool diagonalie(int i, int j, int n, const int* verts, int* indices)
 
 // Returns true iff the diagonal (i,j) is strictly internal to the 
 // polygon P in the neighborhood of the i endpoint.
-static bool	inCone(int i, int j, int n, const int* verts, int* indices)
+// The loose test also accepts diagonals that are collinear with the edges at i.
+bool rcTriangulator::inCone(const int i, const int j, const bool loose) const
 {
-	const int* pi = &verts[(indices[i] & 0x0fffffff) * 4];
-	const int* pj = &verts[(indices[j] & 0x0fffffff) * 4];
-	const int* pi1 = &verts[(indices[next(i, n)] & 0x0fffffff) * 4];
-	const int* pin1 = &verts[(indices[prev(i, n)] & 0x0fffffff) * 4];
+	const int* pi = vert(i);
+	const int* pj = vert(j);
+	const int* pi1 = vert(m_next[i]);
+	const int* pin1 = vert(m_prev[i]);
 
 	// If P[i] is a convex vertex [ i+1 left or on (i-1,i) ].
 	if (leftOn(pin1, pi, pi1))
+	{
+		if (loose)
+			return leftOn(pi, pj, pin1) && leftOn(pj, pi, pi1);
 		return left(pi, pj, pin1) && left(pj, pi, pi1);
+	}
 	// Assume (i-1,i,i+1) not collinear.
 	// else P[i] is reflex.
 	return !(leftOn(pi, pj, pi1) && leftOn(pj, pi, pin1));
 }
 
-// Returns T iff (v_i, v_j) is a proper internal
-// diagonal of P.
-static bool diagonal(int i, int j, int n, const int* verts, int* indices)
+// Replaces the ear that clips the vertex after i.
+void rcTriangulator::updateEar(const int i)
 {
-	return inCone(i, j, n, verts, indices) && diagonalie(i, j, n, verts, indices);
+	m_earStamps[i]++;
+	const int i1 = m_next[i];
+	if (!m_removable[i1])
+		return;
+	
+	rcEar ear;
+	ear.len = diagonalLength(i, m_next[i1]);
+	ear.vert = i;
+	ear.stamp = m_earStamps[i];
+	
+	// Sift up.
+	m_ears.push_back(ear);
+	int child = m_ears.size() - 1;
+	while (child > 0)
+	{
+		const int parent = (child-1) / 2;
+		if (!earBefore(m_ears[child], m_ears[parent]))
+			break;
+		rcSwap(m_ears[child], m_ears[parent]);
+		child = parent;
+	}
 }
 
-
-static bool diagonalieLoose(int i, int j, int n, const int* verts, int* indices)
+// Removes the ears from the heap until a current one is found, and returns its vertex, or -1 if there are no ears.
+int rcTriangulator::popEar()
 {
-	const int* d0 = &verts[(indices[i] & 0x0fffffff) * 4];
-	const int* d1 = &verts[(indices[j] & 0x0fffffff) * 4];
-	
-	// For each edge (k,k+1) of P
-	for (int k = 0; k < n; k++)
+	while (!m_ears.empty())
 	{
-		int k1 = next(k, n);
-		// Skip edges incident to i or j
-		if (!((k == i) || (k1 == i) || (k == j) || (k1 == j)))
+		const rcEar ear = m_ears[0];
+		m_ears[0] = m_ears.back();
+		m_ears.pop_back();
+		
+		// Sift down.
+		const int nears = m_ears.size();
+		int i = 0;
+		for (;;)
 		{
-			const int* p0 = &verts[(indices[k] & 0x0fffffff) * 4];
-			const int* p1 = &verts[(indices[k1] & 0x0fffffff) * 4];
-			
-			if (vequal(d0, p0) || vequal(d1, p0) || vequal(d0, p1) || vequal(d1, p1))
-				continue;
-			
-			if (intersectProp(d0, d1, p0, p1))
-				return false;
+			const int left = i*2+1;
+			if (left >= nears)
+				break;
+			int child = left;
+			if (left+1 < nears && earBefore(m_ears[left+1], m_ears[left]))
+				child = left+1;
+			if (!earBefore(m_ears[child], m_ears[i]))
+				break;
+			rcSwap(m_ears[child], m_ears[i]);
+			i = child;
 		}
+		
+		if (ear.stamp == m_earStamps[ear.vert])
+			return ear.vert;
 	}
-	return true;
+	return -1;
 }
 
-static bool	inConeLoose(int i, int j, int n, const int* verts, int* indices)
+int rcTriangulator::triangulate(const int n, const int* verts, const int* indices, int* tris)
 {
-	const int* pi = &verts[(indices[i] & 0x0fffffff) * 4];
-	const int* pj = &verts[(indices[j] & 0x0fffffff) * 4];
-	const int* pi1 = &verts[(indices[next(i, n)] & 0x0fffffff) * 4];
-	const int* pin1 = &verts[(indices[prev(i, n)] & 0x0fffffff) * 4];
+	m_verts = verts;
+	m_indices = indices;
 	
-	// If P[i] is a convex vertex [ i+1 left or on (i-1,i) ].
-	if (leftOn(pin1, pi, pi1))
-		return leftOn(pi, pj, pin1) && leftOn(pj, pi, pi1);
-	// Assume (i-1,i,i+1) not collinear.
-	// else P[i] is reflex.
-	return !(leftOn(pi, pj, pi1) && leftOn(pj, pi, pin1));
-}
-
-static bool diagonalLoose(int i, int j, int n, const int* verts, int* indices)
-{
-	return inConeLoose(i, j, n, verts, indices) && diagonalieLoose(i, j, n, verts, indices);
-}
-
-
-static int triangulate(int n, const int* verts, int* indices, int* tris)
-{
-	int ntris = 0;
-	int* dst = tris;
+	m_prev.resize(n);
+	m_next.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		m_prev[i] = prev(i, n);
+		m_next[i] = next(i, n);
+	}
+	initEdgeGrid(n);
 	
-	// The last bit of the index is used to indicate if the vertex can be removed.
+	// A vertex can be removed if its neighbours form a diagonal.
+	m_removable.resize(n);
 	for (int i = 0; i < n; i++)
 	{
 		int i1 = next(i, n);
 		int i2 = next(i1, n);
-		if (diagonal(i, i2, n, verts, indices))
-			indices[i1] |= 0x80000000;
+		m_removable[i1] = diagonal(i, i2, false);
 	}
 	
-	while (n > 3)
+	m_earStamps.assign(n, 0);
+	m_ears.clear();
+	for (int i = 0; i < n; i++)
+		updateEar(i);
+	
+	int ntris = 0;
+	int* dst = tris;
+	int first = 0;
+	int nleft = n;
+	
+	while (nleft > 3)
 	{
-		int minLen = -1;
-		int mini = -1;
-		for (int i = 0; i < n; i++)
-		{
-			int i1 = next(i, n);
-			if (indices[i1] & 0x80000000)
-			{
-				const int* p0 = &verts[(indices[i] & 0x0fffffff) * 4];
-				const int* p2 = &verts[(indices[next(i1, n)] & 0x0fffffff) * 4];
-				
-				int dx = p2[0] - p0[0];
-				int dy = p2[2] - p0[2];
-				int len = dx*dx + dy*dy;
-				
-				if (minLen < 0 || len < minLen)
-				{
-					minLen = len;
-					mini = i;
-				}
-			}
-		}
-		
+		int mini = popEar();
 		if (mini == -1)
 		{
 			// We might get here because the contour has overlapping segments, like this:
@@ -375,20 +541,14 @@ static int triangulate(int n, const int* verts, int* indices, int* tris)
 			//  :   :     :     :
 			// We'll try to recover by loosing up the inCone test a bit so that a diagonal
 			// like A-B or C-D can be found and we can continue.
-			minLen = -1;
-			mini = -1;
-			for (int i = 0; i < n; i++)
+			int minLen = -1;
+			for (int k = 0, i = first; k < nleft; k++, i = m_next[i])
 			{
-				int i1 = next(i, n);
-				int i2 = next(i1, n);
-				if (diagonalLoose(i, i2, n, verts, indices))
+				int i1 = m_next[i];
+				int i2 = m_next[i1];
+				if (diagonal(i, i2, true))
 				{
-					const int* p0 = &verts[(indices[i] & 0x0fffffff) * 4];
-					const int* p2 = &verts[(indices[next(i2, n)] & 0x0fffffff) * 4];
-					int dx = p2[0] - p0[0];
-					int dy = p2[2] - p0[2];
-					int len = dx*dx + dy*dy;
-					
+					int len = diagonalLength(i, m_next[i2]);
 					if (minLen < 0 || len < minLen)
 					{
 						minLen = len;
@@ -405,37 +565,36 @@ static int triangulate(int n, const int* verts, int* indices, int* tris)
 		}
 		
 		int i = mini;
-		int i1 = next(i, n);
-		int i2 = next(i1, n);
+		int i1 = m_next[i];
+		int i2 = m_next[i1];
 		
-		*dst++ = indices[i] & 0x0fffffff;
-		*dst++ = indices[i1] & 0x0fffffff;
-		*dst++ = indices[i2] & 0x0fffffff;
+		*dst++ = indices[i];
+		*dst++ = indices[i1];
+		*dst++ = indices[i2];
 		ntris++;
 		
-		// Removes P[i1] by copying P[i+1]...P[n-1] left one index.
-		n--;
-		for (int k = i1; k < n; k++)
-			indices[k] = indices[k+1];
+		// Removes P[i1].
+		m_next[i] = i2;
+		m_prev[i2] = i;
+		m_prev[i1] = -1;
+		m_next[i1] = -1;
+		m_earStamps[i1]++;
+		if (i1 == first)
+			first = i2;
+		nleft--;
+		addEdge(i);
 		
-		if (i1 >= n) i1 = 0;
-		i = prev(i1,n);
 		// Update diagonal flags.
-		if (diagonal(prev(i, n), i1, n, verts, indices))
-			indices[i] |= 0x80000000;
-		else
-			indices[i] &= 0x0fffffff;
-		
-		if (diagonal(i, next(i1, n), n, verts, indices))
-			indices[i1] |= 0x80000000;
-		else
-			indices[i1] &= 0x0fffffff;
+		m_removable[i] = diagonal(m_prev[i], i2, false);
+		m_removable[i2] = diagonal(i, m_next[i2], false);
+		updateEar(m_prev[i]);
+		updateEar(i);
 	}
 	
 	// Append the remaining triangle.
-	*dst++ = indices[0] & 0x0fffffff;
-	*dst++ = indices[1] & 0x0fffffff;
-	*dst++ = indices[2] & 0x0fffffff;
+	*dst++ = indices[first];
+	*dst++ = indices[m_next[first]];
+	*dst++ = indices[m_next[m_next[first]]];
 	ntris++;
 	
 	return ntris;
@@ -455,7 +614,7 @@ inline bool uleft(const unsigned short* a, const unsigned short* b, const unsign
 		   ((int)c[0] - (int)a[0]) * ((int)b[2] - (int)a[2]) < 0;
 }
 
-static int getPolyMergeValue(unsigned short* pa, unsigned short* pb,
+static int getPolyMergeValue(const unsigned short* pa, const unsigned short* pb,
 							 const unsigned short* verts, int& ea, int& eb,
 							 const int nvp)
 {
@@ -539,6 +698,243 @@ static void mergePolyVerts(unsigned short* pa, unsigned short* pb, int ea, int e
 }
 
 
+struct rcMergeCandidate
+{
+	int value;		///< The merge value, see getPolyMergeValue.
+	int pa, pb;		///< The polygon indices, pa < pb.
+	int ida, idb;	///< The polygon ids.
+	int stampa;		///< The stamp of polygon ida when the candidate was added.
+	int stampb;		///< The stamp of polygon idb when the candidate was added.
+};
+
+// Returns true if candidate a should be merged before b. Ties go to the lowest polygon indices,
+// like when comparing all pairs of polygons in order.
+inline bool mergeBefore(const rcMergeCandidate& a, const rcMergeCandidate& b)
+{
+	if (a.value != b.value)
+		return a.value > b.value;
+	if (a.pa != b.pa)
+		return a.pa < b.pa;
+	return a.pb < b.pb;
+}
+
+/// Finds the polygons to merge, in the same order as comparing all pairs of polygons after each merge.
+///
+/// Only polygons that share an edge can be merged, so the candidates are found through a hash of the
+/// polygon edges and kept in a heap. After a merge, only the candidates of the merged polygon and of
+/// the polygon that is moved into the place of the removed one are added again.
+/// The polygons are identified by ids that stay the same when they are moved, and each id has a stamp
+/// that changes whenever the polygon changes or moves, which invalidates its old candidates and edges.
+/// The edges of a moved polygon are added again with the new stamp.
+class rcPolyMergeQueue
+{
+public:
+	rcPolyMergeQueue() : m_polys(0), m_verts(0), m_nvp(0), m_bucketShift(0) {}
+	
+	/// Adds the merge candidates of the polygons.
+	///  @param[in]		polys		The polygons. [Size: @p npolys * @p nvp]
+	///  @param[in]		npolys		The number of polygons.
+	///  @param[in]		verts		The mesh vertices the polygons refer to.
+	///  @param[in]		nvp			The maximum number of vertices per polygon.
+	void init(const unsigned short* polys, const int npolys, const unsigned short* verts, const int nvp);
+	
+	/// Finds the best polygons to merge.
+	///  @returns False if no polygons can be merged.
+	bool findBestMerge(int& pa, int& pb, int& ea, int& eb);
+	
+	/// Updates the candidates after polygon @p pb was merged into @p pa and the last polygon was moved into
+	/// the place of @p pb.
+	///  @param[in]		npolys		The number of polygons after the merge.
+	void polygonsMerged(const int pa, const int pb, const int npolys);
+
+private:
+	const unsigned short* poly(const int p) const { return &m_polys[p*m_nvp]; }
+	void addEdges(const int p);
+	void addCandidates(const int p, const int minOther);
+	
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcPolyMergeQueue(const rcPolyMergeQueue&);
+	rcPolyMergeQueue& operator=(const rcPolyMergeQueue&);
+	
+	const unsigned short* m_polys;
+	const unsigned short* m_verts;
+	int m_nvp;
+	int m_bucketShift;
+	rcTempVector<int> m_polyIds;			///< The id of the polygon at each index.
+	rcTempVector<int> m_polyIndices;		///< The index of the polygon with each id.
+	rcTempVector<int> m_stamps;				///< The stamp of each id.
+	rcTempVector<int> m_buckets;			///< The first edge in each bucket.
+	rcTempVector<unsigned int> m_edgeKeys;	///< The sorted vertices of each edge, packed into one key.
+	rcTempVector<int> m_edgeIds;			///< The polygon of each edge.
+	rcTempVector<int> m_edgeStamps;			///< The stamp of the polygon when the edge was added.
+	rcTempVector<int> m_edgeNext;			///< The next edge in the same bucket.
+	rcTempVector<rcMergeCandidate> m_candidates;	///< The candidates, as a heap with the best one first.
+};
+
+inline unsigned int getEdgeKey(unsigned short va, unsigned short vb)
+{
+	if (va > vb)
+		rcSwap(va, vb);
+	return ((unsigned int)va << 16) | vb;
+}
+
+void rcPolyMergeQueue::init(const unsigned short* polys, const int npolys, const unsigned short* verts, const int nvp)
+{
+	m_polys = polys;
+	m_verts = verts;
+	m_nvp = nvp;
+	
+	m_polyIds.resize(npolys);
+	m_polyIndices.resize(npolys);
+	m_stamps.assign(npolys, 0);
+	for (int i = 0; i < npolys; ++i)
+	{
+		m_polyIds[i] = i;
+		m_polyIndices[i] = i;
+	}
+	
+	// About one edge per bucket, the merged polygons add a few more.
+	int bucketCount = 1;
+	m_bucketShift = 32;
+	while (bucketCount < npolys*3)
+	{
+		bucketCount <<= 1;
+		m_bucketShift--;
+	}
+	m_buckets.assign(bucketCount, -1);
+	m_edgeKeys.clear();
+	m_edgeIds.clear();
+	m_edgeStamps.clear();
+	m_edgeNext.clear();
+	m_candidates.clear();
+	
+	for (int i = 0; i < npolys; ++i)
+		addEdges(i);
+	for (int i = 0; i < npolys; ++i)
+		addCandidates(i, i);
+}
+
+void rcPolyMergeQueue::addEdges(const int p)
+{
+	const unsigned short* pp = poly(p);
+	const int id = m_polyIds[p];
+	const int nv = countPolyVerts(pp, m_nvp);
+	for (int i = 0; i < nv; ++i)
+	{
+		const unsigned int key = getEdgeKey(pp[i], pp[(i+1) % nv]);
+		// The high bits of a multiplicative hash are the best mixed ones.
+		const int bucket = m_bucketShift < 32 ? (int)((key * 0x9e3779b1u) >> m_bucketShift) : 0;
+		m_edgeKeys.push_back(key);
+		m_edgeIds.push_back(id);
+		m_edgeStamps.push_back(m_stamps[id]);
+		m_edgeNext.push_back(m_buckets[bucket]);
+		m_buckets[bucket] = m_edgeKeys.size() - 1;
+	}
+}
+
+// Adds the candidates of polygon p with the polygons sharing an edge with it
+// and an index larger than minOther.
+void rcPolyMergeQueue::addCandidates(const int p, const int minOther)
+{
+	const unsigned short* pp = poly(p);
+	const int id = m_polyIds[p];
+	const int nv = countPolyVerts(pp, m_nvp);
+	for (int i = 0; i < nv; ++i)
+	{
+		const unsigned int key = getEdgeKey(pp[i], pp[(i+1) % nv]);
+		const int bucket = m_bucketShift < 32 ? (int)((key * 0x9e3779b1u) >> m_bucketShift) : 0;
+		for (int edge = m_buckets[bucket]; edge != -1; edge = m_edgeNext[edge])
+		{
+			const int other = m_edgeIds[edge];
+			if (m_edgeKeys[edge] != key || other == id || m_edgeStamps[edge] != m_stamps[other])
+				continue;
+			const int q = m_polyIndices[other];
+			if (q <= minOther)
+				continue;
+			
+			rcMergeCandidate cand;
+			cand.pa = rcMin(p, q);
+			cand.pb = rcMax(p, q);
+			int ea, eb;
+			cand.value = getPolyMergeValue(poly(cand.pa), poly(cand.pb), m_verts, ea, eb, m_nvp);
+			if (cand.value <= 0)
+				continue;
+			cand.ida = m_polyIds[cand.pa];
+			cand.idb = m_polyIds[cand.pb];
+			cand.stampa = m_stamps[cand.ida];
+			cand.stampb = m_stamps[cand.idb];
+			
+			// Sift up.
+			m_candidates.push_back(cand);
+			int child = m_candidates.size() - 1;
+			while (child > 0)
+			{
+				const int parent = (child-1) / 2;
+				if (!mergeBefore(m_candidates[child], m_candidates[parent]))
+					break;
+				rcSwap(m_candidates[child], m_candidates[parent]);
+				child = parent;
+			}
+		}
+	}
+}
+
+bool rcPolyMergeQueue::findBestMerge(int& pa, int& pb, int& ea, int& eb)
+{
+	while (!m_candidates.empty())
+	{
+		const rcMergeCandidate cand = m_candidates[0];
+		m_candidates[0] = m_candidates.back();
+		m_candidates.pop_back();
+		
+		// Sift down.
+		const int ncands = m_candidates.size();
+		int i = 0;
+		for (;;)
+		{
+			const int left = i*2+1;
+			if (left >= ncands)
+				break;
+			int child = left;
+			if (left+1 < ncands && mergeBefore(m_candidates[left+1], m_candidates[left]))
+				child = left+1;
+			if (!mergeBefore(m_candidates[child], m_candidates[i]))
+				break;
+			rcSwap(m_candidates[child], m_candidates[i]);
+			i = child;
+		}
+		
+		if (cand.stampa != m_stamps[cand.ida] || cand.stampb != m_stamps[cand.idb])
+			continue;
+		
+		pa = cand.pa;
+		pb = cand.pb;
+		getPolyMergeValue(poly(pa), poly(pb), m_verts, ea, eb, m_nvp);
+		return true;
+	}
+	return false;
+}
+
+void rcPolyMergeQueue::polygonsMerged(const int pa, const int pb, const int npolys)
+{
+	const int ida = m_polyIds[pa];
+	const int idb = m_polyIds[pb];
+	m_stamps[ida]++;
+	m_stamps[idb]++;
+	addEdges(pa);
+	
+	if (pb != npolys)
+	{
+		const int idLast = m_polyIds[npolys];
+		m_polyIds[pb] = idLast;
+		m_polyIndices[idLast] = pb;
+		m_stamps[idLast]++;
+		addEdges(pb);
+		addCandidates(pb, -1);
+	}
+	addCandidates(pa, -1);
+}
+
 static void pushFront(int v, int* arr, int& an)
 {
 	an++;
@@ -844,7 +1240,8 @@ static bool removeVertex(rcContext* ctx, rcPolyMesh& mesh, const unsigned short
 	}
 
 	// Triangulate the hole.
-	int ntris = triangulate(nhole, &tverts[0], &thole[0], tris);
+	rcTriangulator triangulator;
+	int ntris = triangulator.triangulate(nhole, &tverts[0], &thole[0], tris);
 	if (ntris < 0)
 	{
 		ntris = -ntris;
@@ -902,32 +1299,13 @@ static bool removeVertex(rcContext* ctx, rcPolyMesh& mesh, const unsigned short
 	// Merge polygons.
 	if (nvp > 3)
 	{
+		rcPolyMergeQueue mergeQueue;
+		mergeQueue.init(polys, npolys, mesh.verts, nvp);
 		for (;;)
 		{
 			// Find best polygons to merge.
-			int bestMergeVal = 0;
 			int bestPa = 0, bestPb = 0, bestEa = 0, bestEb = 0;
-			
-			for (int j = 0; j < npolys-1; ++j)
-			{
-				unsigned short* pj = &polys[j*nvp];
-				for (int k = j+1; k < npolys; ++k)
-				{
-					unsigned short* pk = &polys[k*nvp];
-					int ea, eb;
-					int v = getPolyMergeValue(pj, pk, mesh.verts, ea, eb, nvp);
-					if (v > bestMergeVal)
-					{
-						bestMergeVal = v;
-						bestPa = j;
-						bestPb = k;
-						bestEa = ea;
-						bestEb = eb;
-					}
-				}
-			}
-			
-			if (bestMergeVal > 0)
+			if (mergeQueue.findBestMerge(bestPa, bestPb, bestEa, bestEb))
 			{
 				// Found best, merge.
 				unsigned short* pa = &polys[bestPa*nvp];
@@ -942,6 +1320,7 @@ static bool removeVertex(rcContext* ctx, rcPolyMesh& mesh, const unsigned short
 				pregs[bestPb] = pregs[npolys-1];
 				pareas[bestPb] = pareas[npolys-1];
 				npolys--;
+				mergeQueue.polygonsMerged(bestPa, bestPb, npolys);
 			}
 			else
 			{
@@ -983,6 +1362,7 @@ bool rcBuildPolyMesh(rcContext* ctx, const rcContourSet& cset, const int nvp, rc
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_POLYMESH);
+	rcScopedTempArena tempArena(ctx);
 
 	rcVcopy(mesh.bmin, cset.bmin);
 	rcVcopy(mesh.bmax, cset.bmax);
@@ -1060,13 +1440,14 @@ bool rcBuildPolyMesh(rcContext* ctx, const rcContourSet& cset, const int nvp, rc
 	}
 	memset(nextVert, 0, sizeof(int)*maxVertices);
 	
-	rcScopedDelete<int> firstVert((int*)rcAlloc(sizeof(int)*VERTEX_BUCKET_COUNT, RC_ALLOC_TEMP));
+	const int bucketCount = getVertexBucketCount(maxVertices);
+	rcScopedDelete<int> firstVert((int*)rcAlloc(sizeof(int)*bucketCount, RC_ALLOC_TEMP));
 	if (!firstVert)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMesh: Out of memory 'firstVert' (%d).", VERTEX_BUCKET_COUNT);
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMesh: Out of memory 'firstVert' (%d).", bucketCount);
 		return false;
 	}
-	for (int i = 0; i < VERTEX_BUCKET_COUNT; ++i)
+	for (int i = 0; i < bucketCount; ++i)
 		firstVert[i] = -1;
 	
 	rcScopedDelete<int> indices((int*)rcAlloc(sizeof(int)*maxVertsPerCont, RC_ALLOC_TEMP));
@@ -1089,6 +1470,8 @@ bool rcBuildPolyMesh(rcContext* ctx, const rcContourSet& cset, const int nvp, rc
 	}
 	unsigned short* tmpPoly = &polys[maxVertsPerCont*nvp];
 
+	rcTriangulator triangulator;
+	rcPolyMergeQueue mergeQueue;
 	for (int i = 0; i < cset.nconts; ++i)
 	{
 		rcContour& cont = cset.conts[i];
@@ -1101,7 +1484,7 @@ bool rcBuildPolyMesh(rcContext* ctx, const rcContourSet& cset, const int nvp, rc
 		for (int j = 0; j < cont.nverts; ++j)
 			indices[j] = j;
 			
-		int ntris = triangulate(cont.nverts, cont.verts, &indices[0], &tris[0]);
+		int ntris = triangulator.triangulate(cont.nverts, cont.verts, &indices[0], &tris[0]);
 		if (ntris <= 0)
 		{
 			// Bad triangulation, should not happen.
@@ -1124,7 +1507,7 @@ bool rcBuildPolyMesh(rcContext* ctx, const rcContourSet& cset, const int nvp, rc
 		{
 			const int* v = &cont.verts[j*4];
 			indices[j] = addVertex((unsigned short)v[0], (unsigned short)v[1], (unsigned short)v[2],
-								   mesh.verts, firstVert, nextVert, mesh.nverts);
+								   mesh.verts, firstVert, bucketCount, nextVert, mesh.nverts);
 			if (v[3] & RC_BORDER_VERTEX)
 			{
 				// This vertex should be removed.
@@ -1152,32 +1535,12 @@ bool rcBuildPolyMesh(rcContext* ctx, const rcContourSet& cset, const int nvp, rc
 		// Merge polygons.
 		if (nvp > 3)
 		{
+			mergeQueue.init(polys, npolys, mesh.verts, nvp);
 			for(;;)
 			{
 				// Find best polygons to merge.
-				int bestMergeVal = 0;
 				int bestPa = 0, bestPb = 0, bestEa = 0, bestEb = 0;
-				
-				for (int j = 0; j < npolys-1; ++j)
-				{
-					unsigned short* pj = &polys[j*nvp];
-					for (int k = j+1; k < npolys; ++k)
-					{
-						unsigned short* pk = &polys[k*nvp];
-						int ea, eb;
-						int v = getPolyMergeValue(pj, pk, mesh.verts, ea, eb, nvp);
-						if (v > bestMergeVal)
-						{
-							bestMergeVal = v;
-							bestPa = j;
-							bestPb = k;
-							bestEa = ea;
-							bestEb = eb;
-						}
-					}
-				}
-				
-				if (bestMergeVal > 0)
+				if (mergeQueue.findBestMerge(bestPa, bestPb, bestEa, bestEb))
 				{
 					// Found best, merge.
 					unsigned short* pa = &polys[bestPa*nvp];
@@ -1187,6 +1550,7 @@ bool rcBuildPolyMesh(rcContext* ctx, const rcContourSet& cset, const int nvp, rc
 					if (pb != lastPoly)
 						memcpy(pb, lastPoly, sizeof(unsigned short)*nvp);
 					npolys--;
+					mergeQueue.polygonsMerged(bestPa, bestPb, npolys);
 				}
 				else
 				{
@@ -1305,6 +1669,7 @@ bool rcMergePolyMeshes(rcContext* ctx, rcPolyMesh** meshes, const int nmeshes, r
 		return true;
 
 	rcScopedTimer timer(ctx, RC_TIMER_MERGE_POLYMESH);
+	rcScopedTempArena tempArena(ctx);
 
 	mesh.nvp = meshes[0]->nvp;
 	mesh.cs = meshes[0]->cs;
@@ -1373,13 +1738,14 @@ bool rcMergePolyMeshes(rcContext* ctx, rcPolyMesh** meshes, const int nmeshes, r
 	}
 	memset(nextVert, 0, sizeof(int)*maxVerts);
 	
-	rcScopedDelete<int> firstVert((int*)rcAlloc(sizeof(int)*VERTEX_BUCKET_COUNT, RC_ALLOC_TEMP));
+	const int bucketCount = getVertexBucketCount(maxVerts);
+	rcScopedDelete<int> firstVert((int*)rcAlloc(sizeof(int)*bucketCount, RC_ALLOC_TEMP));
 	if (!firstVert)
 	{
-		ctx->log(RC_LOG_ERROR, "rcMergePolyMeshes: Out of memory 'firstVert' (%d).", VERTEX_BUCKET_COUNT);
+		ctx->log(RC_LOG_ERROR, "rcMergePolyMeshes: Out of memory 'firstVert' (%d).", bucketCount);
 		return false;
 	}
-	for (int i = 0; i < VERTEX_BUCKET_COUNT; ++i)
+	for (int i = 0; i < bucketCount; ++i)
 		firstVert[i] = -1;
 
 	rcScopedDelete<unsigned short> vremap((unsigned short*)rcAlloc(sizeof(unsigned short)*maxVertsPerMesh, RC_ALLOC_PERM));
@@ -1407,7 +1773,7 @@ bool rcMergePolyMeshes(rcContext* ctx, rcPolyMesh** meshes, const int nmeshes, r
 		{
 			unsigned short* v = &pmesh->verts[j*3];
 			vremap[j] = addVertex(v[0]+ox, v[1], v[2]+oz,
-								  mesh.verts, firstVert, nextVert, mesh.nverts);
+								  mesh.verts, firstVert, bucketCount, nextVert, mesh.nverts);
 		}
 		
 		for (int j = 0; j < pmesh->npolys; ++j)
@@ -24,6 +24,7 @@
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
+#include "RecastParallel.h"
 
 
 static const unsigned RC_UNSET_HEIGHT = 0xffff;
@@ -31,8 +32,7 @@ static const unsigned RC_UNSET_HEIGHT = 0xffff;
 struct rcHeightPatch
 {
 	inline rcHeightPatch() : data(0), xmin(0), ymin(0), width(0), height(0) {}
-	inline ~rcHeightPatch() { rcFree(data); }
-	unsigned short* data;
+	unsigned short* data;	///< The heights, owned by the caller. [Size: width * height]
 	int xmin, ymin, width, height;
 };
 
@@ -92,29 +92,47 @@ static bool circumCircle(const float* p1, const float* p2, const float* p3,
 	return false;
 }
 
-static float distPtTri(const float* p, const float* a, const float* b, const float* c)
+// The parts of the barycentric coordinates that only depend on the triangle,
+// so that they are computed once for all the points tested against it.
+struct rcPtTriSetup
 {
-	float v0[3], v1[3], v2[3];
-	rcVsub(v0, c,a);
-	rcVsub(v1, b,a);
-	rcVsub(v2, p,a);
+	const float* a;
+	float v0[3];
+	float v1[3];
+	float dot00;
+	float dot01;
+	float dot11;
+	float invDenom;
+};
+
+static void setupPtTri(const float* a, const float* b, const float* c, rcPtTriSetup& tri)
+{
+	tri.a = a;
+	rcVsub(tri.v0, c,a);
+	rcVsub(tri.v1, b,a);
+	tri.dot00 = vdot2(tri.v0, tri.v0);
+	tri.dot01 = vdot2(tri.v0, tri.v1);
+	tri.dot11 = vdot2(tri.v1, tri.v1);
+	tri.invDenom = 1.0f / (tri.dot00 * tri.dot11 - tri.dot01 * tri.dot01);
+}
+
+static float distPtTri(const float* p, const rcPtTriSetup& tri)
+{
+	float v2[3];
+	rcVsub(v2, p,tri.a);
 	
-	const float dot00 = vdot2(v0, v0);
-	const float dot01 = vdot2(v0, v1);
-	const float dot02 = vdot2(v0, v2);
-	const float dot11 = vdot2(v1, v1);
-	const float dot12 = vdot2(v1, v2);
+	const float dot02 = vdot2(tri.v0, v2);
+	const float dot12 = vdot2(tri.v1, v2);
 	
 	// Compute barycentric coordinates
-	const float invDenom = 1.0f / (dot00 * dot11 - dot01 * dot01);
-	const float u = (dot11 * dot02 - dot01 * dot12) * invDenom;
-	float v = (dot00 * dot12 - dot01 * dot02) * invDenom;
+	const float u = (tri.dot11 * dot02 - tri.dot01 * dot12) * tri.invDenom;
+	float v = (tri.dot00 * dot12 - tri.dot01 * dot02) * tri.invDenom;
 	
 	// If point lies inside the triangle, return interpolated y-coord.
 	static const float EPS = 1e-4f;
 	if (u >= -EPS && v >= -EPS && (u+v) <= 1+EPS)
 	{
-		const float y = a[1] + v0[1]*u + v1[1]*v;
+		const float y = tri.a[1] + tri.v0[1]*u + tri.v1[1]*v;
 		return fabsf(y-p[1]);
 	}
 	return FLT_MAX;
@@ -165,15 +183,12 @@ static float distancePtSeg2d(const float* pt, const float* p, const float* q)
 	return dx*dx + dz*dz;
 }
 
-static float distToTriMesh(const float* p, const float* verts, const int /*nverts*/, const int* tris, const int ntris)
+static float distToTriMesh(const float* p, const rcPtTriSetup* tris, const int ntris)
 {
 	float dmin = FLT_MAX;
 	for (int i = 0; i < ntris; ++i)
 	{
-		const float* va = &verts[tris[i*4+0]*3];
-		const float* vb = &verts[tris[i*4+1]*3];
-		const float* vc = &verts[tris[i*4+2]*3];
-		float d = distPtTri(p, va,vb,vc);
+		float d = distPtTri(p, tris[i]);
 		if (d < dmin)
 			dmin = d;
 	}
@@ -286,9 +301,19 @@ enum EdgeValues
 	EV_HULL = -2
 };
 
-static int findEdge(const int* edges, int nedges, int s, int t)
+// The edges of the triangulation are hashed by their vertices, in either order.
+// The edge hash holds the first edge of each bucket followed by the next edge of each edge.
+static int getEdgeBucket(int s, int t, const int bucketMask)
 {
-	for (int i = 0; i < nedges; i++)
+	const unsigned int a = (unsigned int)rcMin(s, t);
+	const unsigned int b = (unsigned int)rcMax(s, t);
+	return (int)((a * 73856093u) ^ (b * 19349663u)) & bucketMask;
+}
+
+static int findEdge(const int* edges, const int* edgeHash, const int bucketMask, int s, int t)
+{
+	const int* nextEdge = &edgeHash[bucketMask+1];
+	for (int i = edgeHash[getEdgeBucket(s, t, bucketMask)]; i != EV_UNDEF; i = nextEdge[i])
 	{
 		const int* e = &edges[i*4];
 		if ((e[0] == s && e[1] == t) || (e[0] == t && e[1] == s))
@@ -297,7 +322,8 @@ static int findEdge(const int* edges, int nedges, int s, int t)
 	return EV_UNDEF;
 }
 
-static int addEdge(rcContext* ctx, int* edges, int& nedges, const int maxEdges, int s, int t, int l, int r)
+static int addEdge(rcContext* ctx, int* edges, int& nedges, const int maxEdges, int* edgeHash, const int bucketMask,
+				   int s, int t, int l, int r)
 {
 	if (nedges >= maxEdges)
 	{
@@ -306,7 +332,7 @@ static int addEdge(rcContext* ctx, int* edges, int& nedges, const int maxEdges,
 	}
 	
 	// Add edge if not already in the triangulation.
-	int e = findEdge(edges, nedges, s, t);
+	int e = findEdge(edges, edgeHash, bucketMask, s, t);
 	if (e == EV_UNDEF)
 	{
 		int* edge = &edges[nedges*4];
@@ -314,6 +340,9 @@ static int addEdge(rcContext* ctx, int* edges, int& nedges, const int maxEdges,
 		edge[1] = t;
 		edge[2] = l;
 		edge[3] = r;
+		const int bucket = getEdgeBucket(s, t, bucketMask);
+		edgeHash[bucketMask+1+nedges] = edgeHash[bucket];
+		edgeHash[bucket] = nedges;
 		return nedges++;
 	}
 	else
@@ -359,7 +388,8 @@ static bool overlapEdges(const float* pts, const int* edges, int nedges, int s1,
 	return false;
 }
 
-static void completeFacet(rcContext* ctx, const float* pts, int npts, int* edges, int& nedges, const int maxEdges, int& nfaces, int e)
+static void completeFacet(rcContext* ctx, const float* pts, int npts, int* edges, int& nedges, const int maxEdges,
+						  int* edgeHash, const int bucketMask, int& nfaces, int e)
 {
 	static const float EPS = 1e-5f;
 	
@@ -434,16 +464,16 @@ static void completeFacet(rcContext* ctx, const float* pts, int npts, int* edges
 		updateLeftFace(&edges[e*4], s, t, nfaces);
 		
 		// Add new edge or update face info of old edge.
-		e = findEdge(edges, nedges, pt, s);
+		e = findEdge(edges, edgeHash, bucketMask, pt, s);
 		if (e == EV_UNDEF)
-		    addEdge(ctx, edges, nedges, maxEdges, pt, s, nfaces, EV_UNDEF);
+		    addEdge(ctx, edges, nedges, maxEdges, edgeHash, bucketMask, pt, s, nfaces, EV_UNDEF);
 		else
 		    updateLeftFace(&edges[e*4], pt, s, nfaces);
 		
 		// Add new edge or update face info of old edge.
-		e = findEdge(edges, nedges, t, pt);
+		e = findEdge(edges, edgeHash, bucketMask, t, pt);
 		if (e == EV_UNDEF)
-		    addEdge(ctx, edges, nedges, maxEdges, t, pt, nfaces, EV_UNDEF);
+		    addEdge(ctx, edges, nedges, maxEdges, edgeHash, bucketMask, t, pt, nfaces, EV_UNDEF);
 		else
 		    updateLeftFace(&edges[e*4], t, pt, nfaces);
 		
@@ -457,23 +487,31 @@ static void completeFacet(rcContext* ctx, const float* pts, int npts, int* edges
 
 static void delaunayHull(rcContext* ctx, const int npts, const float* pts,
 						 const int nhull, const int* hull,
-						 rcTempVector<int>& tris, rcTempVector<int>& edges)
+						 rcTempVector<int>& tris, rcTempVector<int>& edges, rcTempVector<int>& edgeHash)
 {
 	int nfaces = 0;
 	int nedges = 0;
 	const int maxEdges = npts*10;
 	edges.resize(maxEdges*4);
 	
+	int bucketCount = 1;
+	while (bucketCount < maxEdges)
+		bucketCount <<= 1;
+	const int bucketMask = bucketCount-1;
+	edgeHash.resize(bucketCount+maxEdges);
+	for (int i = 0; i < bucketCount; ++i)
+		edgeHash[i] = EV_UNDEF;
+	
 	for (int i = 0, j = nhull-1; i < nhull; j=i++)
-		addEdge(ctx, &edges[0], nedges, maxEdges, hull[j],hull[i], EV_HULL, EV_UNDEF);
+		addEdge(ctx, &edges[0], nedges, maxEdges, &edgeHash[0], bucketMask, hull[j],hull[i], EV_HULL, EV_UNDEF);
 	
 	int currentEdge = 0;
 	while (currentEdge < nedges)
 	{
 		if (edges[currentEdge*4+2] == EV_UNDEF)
-			completeFacet(ctx, pts, npts, &edges[0], nedges, maxEdges, nfaces, currentEdge);
+			completeFacet(ctx, pts, npts, &edges[0], nedges, maxEdges, &edgeHash[0], bucketMask, nfaces, currentEdge);
 		if (edges[currentEdge*4+3] == EV_UNDEF)
-			completeFacet(ctx, pts, npts, &edges[0], nedges, maxEdges, nfaces, currentEdge);
+			completeFacet(ctx, pts, npts, &edges[0], nedges, maxEdges, &edgeHash[0], bucketMask, nfaces, currentEdge);
 		currentEdge++;
 	}
 	
@@ -668,11 +706,136 @@ static void setTriFlags(rcTempVector<int>& tris, int nhull, int* hull)
 	}
 }
 
+/// Scratch buffers for refining the detail mesh of a polygon with height samples.
+struct rcDetailRefineData
+{
+	rcTempVector<int> edgeHash;		///< The edge hash of the triangulation. (See: #delaunayHull)
+	rcTempVector<int> grid;			///< The sample in each sample grid cell, or -1 if none.
+	rcTempVector<float> points;		///< The jittered location of each sample.
+	rcTempVector<float> errors;		///< The height error of each sample against the current triangulation.
+	rcTempVector<int> stamps;		///< The refinement step that last marked each sample for update.
+	rcTempVector<rcPtTriSetup> triSetups;	///< The setup of each triangle for distPtTri.
+	rcTempVector<int> triKeys;		///< The sorted triangles of the previous triangulation.
+	rcTempVector<int> newTriKeys;	///< The sorted triangles of the current triangulation.
+};
+
+static int compareTriKeys(const void* va, const void* vb)
+{
+	const int a = *(const int*)va;
+	const int b = *(const int*)vb;
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Stores the triangles as sorted keys of their vertices, in triangle vertex order.
+// The detail vertices of a polygon fit in 8 bits.
+static void getTriKeys(const rcTempVector<int>& tris, rcTempVector<int>& keys)
+{
+	const int ntris = static_cast<int>(tris.size()) / 4;
+	keys.resize(ntris);
+	for (int i = 0; i < ntris; ++i)
+		keys[i] = (tris[i*4+0] << 16) | (tris[i*4+1] << 8) | tris[i*4+2];
+	if (ntris > 1)
+		qsort(&keys[0], ntris, sizeof(int), compareTriKeys);
+}
+
+// Finds the range of sample grid cells whose samples the triangle may cover,
+// accounting for the sample jitter and the tolerance of distPtTri, which scales with the triangle.
+static bool getTriSampleCells(const float* va, const float* vb, const float* vc,
+							  const float sampleDist, const float cs,
+							  const int x0, const int x1, const int z0, const int z1, int* cells)
+{
+	float bmin[3], bmax[3];
+	rcVcopy(bmin, va);
+	rcVcopy(bmax, va);
+	rcVmin(bmin, vb);
+	rcVmax(bmax, vb);
+	rcVmin(bmin, vc);
+	rcVmax(bmax, vc);
+	const float pad = (bmax[0]-bmin[0] + bmax[2]-bmin[2])*0.01f + cs*0.1f;
+	cells[0] = rcMax(x0, (int)floorf((bmin[0]-pad)/sampleDist));
+	cells[1] = rcMin(x1-1, (int)ceilf((bmax[0]+pad)/sampleDist));
+	cells[2] = rcMax(z0, (int)floorf((bmin[2]-pad)/sampleDist));
+	cells[3] = rcMin(z1-1, (int)ceilf((bmax[2]+pad)/sampleDist));
+	return cells[0] <= cells[1] && cells[2] <= cells[3];
+}
+
+// Stamps the samples that the triangles in only one of the previous and the current
+// triangulation may cover, and finds the range of cells that contain them.
+static void markChangedSamples(const float* verts, const rcTempVector<int>& samples, const int step,
+							   const int x0, const int x1, const int z0, const int z1,
+							   const float sampleDist, const float cs, rcDetailRefineData& refine, int* dirty)
+{
+	const int gw = x1-x0;
+	dirty[0] = x1;
+	dirty[1] = x0-1;
+	dirty[2] = z1;
+	dirty[3] = z0-1;
+	
+	const rcTempVector<int>& oldKeys = refine.triKeys;
+	const rcTempVector<int>& newKeys = refine.newTriKeys;
+	const int nold = static_cast<int>(oldKeys.size());
+	const int nnew = static_cast<int>(newKeys.size());
+	for (int i = 0, j = 0; i < nold || j < nnew; )
+	{
+		int key;
+		if (j == nnew || (i < nold && oldKeys[i] < newKeys[j]))
+			key = oldKeys[i++];
+		else if (i == nold || newKeys[j] < oldKeys[i])
+			key = newKeys[j++];
+		else
+		{
+			// Unchanged triangle.
+			i++;
+			j++;
+			continue;
+		}
+		int cells[4];
+		if (!getTriSampleCells(&verts[(key >> 16)*3], &verts[((key >> 8) & 0xff)*3], &verts[(key & 0xff)*3],
+							   sampleDist, cs, x0, x1, z0, z1, cells))
+			continue;
+		for (int z = cells[2]; z <= cells[3]; ++z)
+		{
+			for (int x = cells[0]; x <= cells[1]; ++x)
+			{
+				const int k = refine.grid[(x-x0)+(z-z0)*gw];
+				if (k != -1 && !samples[k*4+3])
+					refine.stamps[k] = step;
+			}
+		}
+		dirty[0] = rcMin(dirty[0], cells[0]);
+		dirty[1] = rcMax(dirty[1], cells[1]);
+		dirty[2] = rcMin(dirty[2], cells[2]);
+		dirty[3] = rcMax(dirty[3], cells[3]);
+	}
+}
+
+// Updates the errors of the samples in the dirty cells that are stamped with the current step.
+static void updateSampleErrors(const int* dirty, const int step, const int x0, const int z0, const int gw,
+							   const float* verts, const rcTempVector<int>& tris, rcDetailRefineData& refine)
+{
+	const int ntris = static_cast<int>(tris.size()) / 4;
+	refine.triSetups.resize(ntris);
+	for (int i = 0; i < ntris; ++i)
+		setupPtTri(&verts[tris[i*4+0]*3], &verts[tris[i*4+1]*3], &verts[tris[i*4+2]*3], refine.triSetups[i]);
+	
+	for (int z = dirty[2]; z <= dirty[3]; ++z)
+	{
+		for (int x = dirty[0]; x <= dirty[1]; ++x)
+		{
+			const int j = refine.grid[(x-x0)+(z-z0)*gw];
+			if (j == -1 || refine.stamps[j] != step)
+				continue;
+			refine.errors[j] = distToTriMesh(&refine.points[j*3], refine.triSetups.data(), ntris);
+		}
+	}
+}
+
 static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 							const float sampleDist, const float sampleMaxError,
 							const int heightSearchRadius, const rcCompactHeightfield& chf,
 							const rcHeightPatch& hp, float* verts, int& nverts,
-							rcTempVector<int>& tris, rcTempVector<int>& edges, rcTempVector<int>& samples)
+							rcTempVector<int>& tris, rcTempVector<int>& edges, rcTempVector<int>& samples,
+							rcDetailRefineData& refine)
 {
 	static const int MAX_VERTS = 127;
 	static const int MAX_TRIS = 255;	// Max tris for delaunay is 2n-2-k (n=num verts, k=num hull verts).
@@ -837,17 +1000,22 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 		int x1 = (int)ceilf(bmax[0]/sampleDist);
 		int z0 = (int)floorf(bmin[2]/sampleDist);
 		int z1 = (int)ceilf(bmax[2]/sampleDist);
+		const int gw = rcMax(x1-x0, 0);
 		samples.clear();
+		refine.grid.resize(gw*rcMax(z1-z0, 0));
 		for (int z = z0; z < z1; ++z)
 		{
 			for (int x = x0; x < x1; ++x)
 			{
+				int& cell = refine.grid[(x-x0)+(z-z0)*gw];
+				cell = -1;
 				float pt[3];
 				pt[0] = x*sampleDist;
 				pt[1] = (bmax[1]+bmin[1])*0.5f;
 				pt[2] = z*sampleDist;
 				// Make sure the samples are not too close to the edges.
 				if (distToPoly(nin,in,pt) > -sampleDist/2) continue;
+				cell = static_cast<int>(samples.size()) / 4;
 				samples.push_back(x);
 				samples.push_back(getHeight(pt[0], pt[1], pt[2], cs, ics, chf.ch, heightSearchRadius, hp));
 				samples.push_back(z);
@@ -855,37 +1023,48 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 			}
 		}
 		
+		// Cache the error of each sample against the current triangulation.
+		// Adding a point only changes the triangles around it, so after each
+		// step only the samples covered by the changed triangles are updated.
+		const int nsamples = static_cast<int>(samples.size()) / 4;
+		refine.points.resize(nsamples*3);
+		refine.errors.resize(nsamples);
+		refine.stamps.resize(nsamples);
+		for (int i = 0; i < nsamples; ++i)
+		{
+			const int* s = &samples[i*4];
+			float* pt = &refine.points[i*3];
+			// The sample location is jittered to get rid of some bad triangulations
+			// which are cause by symmetrical data from the grid structure.
+			pt[0] = s[0]*sampleDist + getJitterX(i)*cs*0.1f;
+			pt[1] = s[1]*chf.ch;
+			pt[2] = s[2]*sampleDist + getJitterY(i)*cs*0.1f;
+			refine.stamps[i] = 0;
+		}
+		const int allCells[4] = { x0, x1-1, z0, z1-1 };
+		updateSampleErrors(allCells, 0, x0, z0, gw, verts, tris, refine);
+		getTriKeys(tris, refine.triKeys);
+		
 		// Add the samples starting from the one that has the most
 		// error. The procedure stops when all samples are added
 		// or when the max error is within treshold.
-		const int nsamples = static_cast<int>(samples.size()) / 4;
 		for (int iter = 0; iter < nsamples; ++iter)
 		{
 			if (nverts >= MAX_VERTS)
 				break;
 			
 			// Find sample with most error.
-			float bestpt[3] = {0,0,0};
 			float bestd = 0;
 			int besti = -1;
 			for (int i = 0; i < nsamples; ++i)
 			{
-				const int* s = &samples[i*4];
-				if (s[3]) continue; // skip added.
-				float pt[3];
-				// The sample location is jittered to get rid of some bad triangulations
-				// which are cause by symmetrical data from the grid structure.
-				pt[0] = s[0]*sampleDist + getJitterX(i)*cs*0.1f;
-				pt[1] = s[1]*chf.ch;
-				pt[2] = s[2]*sampleDist + getJitterY(i)*cs*0.1f;
-				if (tris.size() == 0) continue;
-				float d = distToTriMesh(pt, verts, nverts, &tris[0], static_cast<int>(tris.size()) / 4);
+				if (samples[i*4+3]) continue; // skip added.
+				const float d = refine.errors[i];
 				if (d < 0) continue; // did not hit the mesh.
 				if (d > bestd)
 				{
 					bestd = d;
 					besti = i;
-					rcVcopy(bestpt,pt);
 				}
 			}
 			// If the max error is within accepted threshold, stop tesselating.
@@ -894,14 +1073,21 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 			// Mark sample as added.
 			samples[besti*4+3] = 1;
 			// Add the new sample point.
-			rcVcopy(&verts[nverts*3],bestpt);
+			rcVcopy(&verts[nverts*3], &refine.points[besti*3]);
 			nverts++;
 			
 			// Create new triangulation.
-			// TODO: Incremental add instead of full rebuild.
 			edges.clear();
 			tris.clear();
-			delaunayHull(ctx, nverts, verts, nhull, hull, tris, edges);
+			delaunayHull(ctx, nverts, verts, nhull, hull, tris, edges, refine.edgeHash);
+			
+			// Update the samples covered by the triangles that were removed or added.
+			const int step = iter+1;
+			int dirty[4];
+			getTriKeys(tris, refine.newTriKeys);
+			markChangedSamples(verts, samples, step, x0, x1, z0, z1, sampleDist, cs, refine, dirty);
+			refine.triKeys.swap(refine.newTriKeys);
+			updateSampleErrors(dirty, step, x0, z0, gw, verts, tris, refine);
 		}
 	}
 	
@@ -1011,11 +1197,11 @@ static void seedArrayWithPolyCenter(rcContext* ctx, const rcCompactHeightfield&
 		// Push the direct dir last so we start with this on next iteration
 		rcSwap(dirs[directDir], dirs[3]);
 
-		const rcCompactSpan& cs = chf.spans[ci];
 		for (int i = 0; i < 4; i++)
 		{
 			int dir = dirs[i];
-			if (rcGetCon(cs, dir) == RC_NOT_CONNECTED)
+			const int ai = rcGetNeighborSpan(chf, cx+bs, cy+bs, ci, dir);
+			if (ai < 0)
 				continue;
 
 			int newX = cx + rcGetDirOffsetX(dir);
@@ -1032,7 +1218,7 @@ static void seedArrayWithPolyCenter(rcContext* ctx, const rcCompactHeightfield&
 			hp.data[hpx+hpy*hp.width] = 1;
 			array.push_back(newX);
 			array.push_back(newY);
-			array.push_back((int)chf.cells[(newX+bs)+(newY+bs)*chf.width].index + rcGetCon(cs, dir));
+			array.push_back(ai);
 		}
 
 		rcSwap(dirs[directDir], dirs[3]);
@@ -1101,11 +1287,9 @@ static void getHeightData(rcContext* ctx, const rcCompactHeightfield& chf,
 						bool border = false;
 						for (int dir = 0; dir < 4; ++dir)
 						{
-							if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+							const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+							if (ai >= 0)
 							{
-								const int ax = x + rcGetDirOffsetX(dir);
-								const int ay = y + rcGetDirOffsetY(dir);
-								const int ai = (int)chf.cells[ax + ay*chf.width].index + rcGetCon(s, dir);
 								const rcCompactSpan& as = chf.spans[ai];
 								if (as.reg != region)
 								{
@@ -1149,10 +1333,10 @@ static void getHeightData(rcContext* ctx, const rcCompactHeightfield& chf,
 			queue.resize(queue.size()-RETRACT_SIZE*3);
 		}
 		
-		const rcCompactSpan& cs = chf.spans[ci];
 		for (int dir = 0; dir < 4; ++dir)
 		{
-			if (rcGetCon(cs, dir) == RC_NOT_CONNECTED) continue;
+			const int ai = rcGetNeighborSpan(chf, cx, cy, ci, dir);
+			if (ai < 0) continue;
 			
 			const int ax = cx + rcGetDirOffsetX(dir);
 			const int ay = cy + rcGetDirOffsetY(dir);
@@ -1165,7 +1349,6 @@ static void getHeightData(rcContext* ctx, const rcCompactHeightfield& chf,
 			if (hp.data[hx + hy*hp.width] != RC_UNSET_HEIGHT)
 				continue;
 			
-			const int ai = (int)chf.cells[ax + ay*chf.width].index + rcGetCon(cs, dir);
 			const rcCompactSpan& as = chf.spans[ai];
 			
 			hp.data[hx + hy*hp.width] = as.y;
@@ -1175,10 +1358,197 @@ static void getHeightData(rcContext* ctx, const rcCompactHeightfield& chf,
 	}
 }
 
+struct rcDetailLogMessage
+{
+	int poly;					///< The polygon that was being processed.
+	int index;					///< The order of the message among the messages of the thread.
+	rcLogCategory category;
+	int text;					///< The start of the message in the text buffer of the thread.
+};
+
+/// Collects the messages logged while processing polygons on one thread,
+/// so that they can be passed on to the build context in polygon order.
+class rcDetailLogBuffer : public rcContext
+{
+public:
+	rcDetailLogBuffer() : m_poly(0) {}
+
+	void setPoly(const int poly) { m_poly = poly; }
+	int getMessageCount() const { return m_messages.size(); }
+	const rcDetailLogMessage& getMessage(const int i) const { return m_messages[i]; }
+	const char* getText(const rcDetailLogMessage& msg) const { return &m_text[msg.text]; }
+
+protected:
+	virtual void doLog(const rcLogCategory category, const char* msg, const int len)
+	{
+		rcDetailLogMessage message;
+		message.poly = m_poly;
+		message.index = m_messages.size();
+		message.category = category;
+		message.text = m_text.size();
+		m_messages.push_back(message);
+		for (int i = 0; i < len; ++i)
+			m_text.push_back(msg[i]);
+		m_text.push_back('\0');
+	}
+
+private:
+	int m_poly;
+	rcTempVector<rcDetailLogMessage> m_messages;
+	rcTempVector<char> m_text;
+};
+
+struct rcDetailThreadData
+{
+	rcTempVector<int> edges;
+	rcTempVector<int> tris;
+	rcTempVector<int> arr;
+	rcTempVector<int> samples;
+	rcDetailRefineData refine;
+	rcTempVector<float> poly;
+	rcTempVector<unsigned short> heights;
+	rcTempVector<float> detailVerts;			///< The detail vertices of the polygons processed by the thread.
+	rcTempVector<unsigned char> detailTris;		///< The detail triangles of the polygons processed by the thread.
+	rcDetailLogBuffer log;
+};
+
+struct rcDetailPolyResult
+{
+	bool ok;
+	int thread;			///< The thread that built the detail mesh.
+	int vertBase;		///< The first vertex in the thread detail vertices.
+	int nverts;
+	int triBase;		///< The first triangle in the thread detail triangles.
+	int ntris;
+};
+
+struct rcDetailLogRef
+{
+	int thread;
+	const rcDetailLogMessage* msg;
+};
+
+static int compareDetailLogRefs(const void* va, const void* vb)
+{
+	const rcDetailLogRef* a = (const rcDetailLogRef*)va;
+	const rcDetailLogRef* b = (const rcDetailLogRef*)vb;
+	if (a->msg->poly != b->msg->poly)
+		return a->msg->poly < b->msg->poly ? -1 : 1;
+	// All messages of a polygon come from the same thread.
+	if (a->msg->index != b->msg->index)
+		return a->msg->index < b->msg->index ? -1 : 1;
+	return 0;
+}
+
+/// Builds the detail mesh of one polygon per item, into the buffers of the thread.
+class rcBuildPolyDetailTask : public rcParallelTask
+{
+public:
+	rcBuildPolyDetailTask(const rcPolyMesh& mesh, const rcCompactHeightfield& chf, const int* bounds,
+						  const float sampleDist, const float sampleMaxError,
+						  rcDetailThreadData* threads, rcDetailPolyResult* results)
+	: m_mesh(mesh)
+	, m_chf(chf)
+	, m_bounds(bounds)
+	, m_sampleDist(sampleDist)
+	, m_sampleMaxError(sampleMaxError)
+	, m_heightSearchRadius(rcMax(1, (int)ceilf(mesh.maxEdgeError)))
+	, m_threads(threads)
+	, m_results(results)
+	{
+	}
+
+	virtual void execute(int itemIndex, int threadIndex);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcBuildPolyDetailTask(const rcBuildPolyDetailTask&);
+	rcBuildPolyDetailTask& operator=(const rcBuildPolyDetailTask&);
+
+	const rcPolyMesh& m_mesh;
+	const rcCompactHeightfield& m_chf;
+	const int* m_bounds;
+	const float m_sampleDist;
+	const float m_sampleMaxError;
+	const int m_heightSearchRadius;
+	rcDetailThreadData* m_threads;
+	rcDetailPolyResult* m_results;
+};
+
+void rcBuildPolyDetailTask::execute(int itemIndex, int threadIndex)
+{
+	const int i = itemIndex;
+	const int nvp = m_mesh.nvp;
+	const float cs = m_mesh.cs;
+	const float ch = m_mesh.ch;
+	const float* orig = m_mesh.bmin;
+	const unsigned short* p = &m_mesh.polys[i*nvp*2];
+	rcDetailThreadData& thread = m_threads[threadIndex];
+	rcDetailPolyResult& result = m_results[i];
+	thread.log.setPoly(i);
+	
+	// Store polygon vertices for processing.
+	float* poly = &thread.poly[0];
+	int npoly = 0;
+	for (int j = 0; j < nvp; ++j)
+	{
+		if(p[j] == RC_MESH_NULL_IDX) break;
+		const unsigned short* v = &m_mesh.verts[p[j]*3];
+		poly[j*3+0] = v[0]*cs;
+		poly[j*3+1] = v[1]*ch;
+		poly[j*3+2] = v[2]*cs;
+		npoly++;
+	}
+	
+	// Get the height data from the area of the polygon.
+	rcHeightPatch hp;
+	hp.data = &thread.heights[0];
+	hp.xmin = m_bounds[i*4+0];
+	hp.ymin = m_bounds[i*4+2];
+	hp.width = m_bounds[i*4+1]-m_bounds[i*4+0];
+	hp.height = m_bounds[i*4+3]-m_bounds[i*4+2];
+	getHeightData(&thread.log, m_chf, p, npoly, m_mesh.verts, m_mesh.borderSize, hp, thread.arr, m_mesh.regs[i]);
+	
+	// Build detail mesh.
+	float verts[256*3];
+	int nverts = 0;
+	result.ok = buildPolyDetail(&thread.log, poly, npoly,
+								m_sampleDist, m_sampleMaxError,
+								m_heightSearchRadius, m_chf, hp,
+								verts, nverts, thread.tris,
+								thread.edges, thread.samples, thread.refine);
+	if (!result.ok)
+		return;
+	
+	// Store detail submesh, with the verts in world space.
+	const int ntris = static_cast<int>(thread.tris.size()) / 4;
+	result.thread = threadIndex;
+	result.vertBase = static_cast<int>(thread.detailVerts.size()) / 3;
+	result.nverts = nverts;
+	result.triBase = static_cast<int>(thread.detailTris.size()) / 4;
+	result.ntris = ntris;
+	
+	thread.detailVerts.resize((result.vertBase+nverts)*3);
+	float* dverts = &thread.detailVerts[result.vertBase*3];
+	for (int j = 0; j < nverts; ++j)
+	{
+		dverts[j*3+0] = verts[j*3+0] + orig[0];
+		dverts[j*3+1] = verts[j*3+1] + (orig[1] + m_chf.ch); // Is this offset necessary?
+		dverts[j*3+2] = verts[j*3+2] + orig[2];
+	}
+	thread.detailTris.resize((result.triBase+ntris)*4);
+	unsigned char* dtris = &thread.detailTris[result.triBase*4];
+	for (int j = 0; j < ntris*4; ++j)
+		dtris[j] = (unsigned char)thread.tris[j];
+}
+
 /// @par
 ///
 /// See the #rcConfig documentation for more information on the configuration parameters.
 ///
+/// The polygons are processed in parallel if the context has a task scheduler, see rcContext::setTaskScheduler.
+/// The result and the log messages are the same as when processing the polygons in order.
+///
 /// @see rcAllocPolyMeshDetail, rcPolyMesh, rcCompactHeightfield, rcPolyMeshDetail, rcConfig
 bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompactHeightfield& chf,
 						   const float sampleDist, const float sampleMaxError,
@@ -1187,24 +1557,12 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_POLYMESHDETAIL);
+	rcScopedTempArena tempArena(ctx);
 	
 	if (mesh.nverts == 0 || mesh.npolys == 0)
 		return true;
 	
 	const int nvp = mesh.nvp;
-	const float cs = mesh.cs;
-	const float ch = mesh.ch;
-	const float* orig = mesh.bmin;
-	const int borderSize = mesh.borderSize;
-	const int heightSearchRadius = rcMax(1, (int)ceilf(mesh.maxEdgeError));
-	
-	rcTempVector<int> edges(64);
-	rcTempVector<int> tris(512);
-	rcTempVector<int> arr(512);
-	rcTempVector<int> samples(512);
-	float verts[256*3];
-	rcHeightPatch hp;
-	int nPolyVerts = 0;
 	int maxhw = 0, maxhh = 0;
 	
 	rcScopedDelete<int> bounds((int*)rcAlloc(sizeof(int)*mesh.npolys*4, RC_ALLOC_TEMP));
@@ -1213,12 +1571,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'bounds' (%d).", mesh.npolys*4);
 		return false;
 	}
-	rcScopedDelete<float> poly((float*)rcAlloc(sizeof(float)*nvp*3, RC_ALLOC_TEMP));
-	if (!poly)
-	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'poly' (%d).", nvp*3);
-		return false;
-	}
 	
 	// Find max size for a polygon area.
 	for (int i = 0; i < mesh.npolys; ++i)
@@ -1240,7 +1592,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 			xmax = rcMax(xmax, (int)v[0]);
 			ymin = rcMin(ymin, (int)v[2]);
 			ymax = rcMax(ymax, (int)v[2]);
-			nPolyVerts++;
 		}
 		xmin = rcMax(0,xmin-1);
 		xmax = rcMin(chf.width,xmax+1);
@@ -1251,13 +1602,68 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		maxhh = rcMax(maxhh, ymax-ymin);
 	}
 	
-	hp.data = (unsigned short*)rcAlloc(sizeof(unsigned short)*maxhw*maxhh, RC_ALLOC_TEMP);
-	if (!hp.data)
+	rcTaskScheduler* scheduler = ctx->getTaskScheduler();
+	const int threadCount = rcGetThreadCount(scheduler);
+	rcTempVector<rcDetailThreadData> threads(threadCount);
+	for (int i = 0; i < threadCount; ++i)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'hp.data' (%d).", maxhw*maxhh);
-		return false;
+		rcDetailThreadData& thread = threads[i];
+		if (!thread.heights.reserve(rcMax(maxhw*maxhh, 1)))
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'hp.data' (%d).", maxhw*maxhh);
+			return false;
+		}
+		thread.heights.resize(rcMax(maxhw*maxhh, 1));
+		thread.poly.resize(nvp*3);
+		thread.edges.resize(64);
+		thread.tris.resize(512);
+		thread.arr.resize(512);
+		thread.samples.resize(512);
+	}
+	
+	rcTempVector<rcDetailPolyResult> results(mesh.npolys);
+	rcBuildPolyDetailTask task(mesh, chf, bounds, sampleDist, sampleMaxError, &threads[0], &results[0]);
+	rcParallelFor(scheduler, task, mesh.npolys);
+	
+	// Stop at the first polygon that failed, like when processing the polygons in order.
+	int failedPoly = -1;
+	for (int i = 0; i < mesh.npolys; ++i)
+	{
+		if (!results[i].ok)
+		{
+			failedPoly = i;
+			break;
+		}
+	}
+	const int npolys = failedPoly != -1 ? failedPoly+1 : mesh.npolys;
+	
+	// Pass on the log messages in polygon order.
+	rcTempVector<rcDetailLogRef> logRefs;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		const rcDetailLogBuffer& log = threads[i].log;
+		for (int j = 0; j < log.getMessageCount(); ++j)
+		{
+			rcDetailLogRef ref;
+			ref.thread = i;
+			ref.msg = &log.getMessage(j);
+			if (ref.msg->poly < npolys)
+				logRefs.push_back(ref);
+		}
+	}
+	if (!logRefs.empty())
+	{
+		qsort(&logRefs[0], logRefs.size(), sizeof(rcDetailLogRef), compareDetailLogRefs);
+		for (int i = 0; i < logRefs.size(); ++i)
+		{
+			const rcDetailLogRef& ref = logRefs[i];
+			ctx->log(ref.msg->category, "%s", threads[ref.thread].log.getText(*ref.msg));
+		}
 	}
 	
+	if (failedPoly != -1)
+		return false;
+	
 	dmesh.nmeshes = mesh.npolys;
 	dmesh.nverts = 0;
 	dmesh.ntris = 0;
@@ -1268,131 +1674,42 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		return false;
 	}
 	
-	int vcap = nPolyVerts+nPolyVerts/2;
-	int tcap = vcap*2;
+	// Place the submeshes in polygon order.
+	int totalVerts = 0;
+	int totalTris = 0;
+	for (int i = 0; i < mesh.npolys; ++i)
+	{
+		dmesh.meshes[i*4+0] = (unsigned int)totalVerts;
+		dmesh.meshes[i*4+1] = (unsigned int)results[i].nverts;
+		dmesh.meshes[i*4+2] = (unsigned int)totalTris;
+		dmesh.meshes[i*4+3] = (unsigned int)results[i].ntris;
+		totalVerts += results[i].nverts;
+		totalTris += results[i].ntris;
+	}
 	
-	dmesh.nverts = 0;
-	dmesh.verts = (float*)rcAlloc(sizeof(float)*vcap*3, RC_ALLOC_PERM);
+	dmesh.verts = (float*)rcAlloc(sizeof(float)*totalVerts*3, RC_ALLOC_PERM);
 	if (!dmesh.verts)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.verts' (%d).", vcap*3);
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.verts' (%d).", totalVerts*3);
 		return false;
 	}
-	dmesh.ntris = 0;
-	dmesh.tris = (unsigned char*)rcAlloc(sizeof(unsigned char)*tcap*4, RC_ALLOC_PERM);
+	dmesh.tris = (unsigned char*)rcAlloc(sizeof(unsigned char)*totalTris*4, RC_ALLOC_PERM);
 	if (!dmesh.tris)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.tris' (%d).", tcap*4);
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.tris' (%d).", totalTris*4);
 		return false;
 	}
 	
 	for (int i = 0; i < mesh.npolys; ++i)
 	{
-		const unsigned short* p = &mesh.polys[i*nvp*2];
-		
-		// Store polygon vertices for processing.
-		int npoly = 0;
-		for (int j = 0; j < nvp; ++j)
-		{
-			if(p[j] == RC_MESH_NULL_IDX) break;
-			const unsigned short* v = &mesh.verts[p[j]*3];
-			poly[j*3+0] = v[0]*cs;
-			poly[j*3+1] = v[1]*ch;
-			poly[j*3+2] = v[2]*cs;
-			npoly++;
-		}
-		
-		// Get the height data from the area of the polygon.
-		hp.xmin = bounds[i*4+0];
-		hp.ymin = bounds[i*4+2];
-		hp.width = bounds[i*4+1]-bounds[i*4+0];
-		hp.height = bounds[i*4+3]-bounds[i*4+2];
-		getHeightData(ctx, chf, p, npoly, mesh.verts, borderSize, hp, arr, mesh.regs[i]);
-		
-		// Build detail mesh.
-		int nverts = 0;
-		if (!buildPolyDetail(ctx, poly, npoly,
-							 sampleDist, sampleMaxError,
-							 heightSearchRadius, chf, hp,
-							 verts, nverts, tris,
-							 edges, samples))
-		{
-			return false;
-		}
-		
-		// Move detail verts to world space.
-		for (int j = 0; j < nverts; ++j)
-		{
-			verts[j*3+0] += orig[0];
-			verts[j*3+1] += orig[1] + chf.ch; // Is this offset necessary?
-			verts[j*3+2] += orig[2];
-		}
-		// Offset poly too, will be used to flag checking.
-		for (int j = 0; j < npoly; ++j)
-		{
-			poly[j*3+0] += orig[0];
-			poly[j*3+1] += orig[1];
-			poly[j*3+2] += orig[2];
-		}
-		
-		// Store detail submesh.
-		const int ntris = static_cast<int>(tris.size()) / 4;
-		
-		dmesh.meshes[i*4+0] = (unsigned int)dmesh.nverts;
-		dmesh.meshes[i*4+1] = (unsigned int)nverts;
-		dmesh.meshes[i*4+2] = (unsigned int)dmesh.ntris;
-		dmesh.meshes[i*4+3] = (unsigned int)ntris;
-		
-		// Store vertices, allocate more memory if necessary.
-		if (dmesh.nverts+nverts > vcap)
-		{
-			while (dmesh.nverts+nverts > vcap)
-				vcap += 256;
-			
-			float* newv = (float*)rcAlloc(sizeof(float)*vcap*3, RC_ALLOC_PERM);
-			if (!newv)
-			{
-				ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newv' (%d).", vcap*3);
-				return false;
-			}
-			if (dmesh.nverts)
-				memcpy(newv, dmesh.verts, sizeof(float)*3*dmesh.nverts);
-			rcFree(dmesh.verts);
-			dmesh.verts = newv;
-		}
-		for (int j = 0; j < nverts; ++j)
-		{
-			dmesh.verts[dmesh.nverts*3+0] = verts[j*3+0];
-			dmesh.verts[dmesh.nverts*3+1] = verts[j*3+1];
-			dmesh.verts[dmesh.nverts*3+2] = verts[j*3+2];
-			dmesh.nverts++;
-		}
-		
-		// Store triangles, allocate more memory if necessary.
-		if (dmesh.ntris+ntris > tcap)
-		{
-			while (dmesh.ntris+ntris > tcap)
-				tcap += 256;
-			unsigned char* newt = (unsigned char*)rcAlloc(sizeof(unsigned char)*tcap*4, RC_ALLOC_PERM);
-			if (!newt)
-			{
-				ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newt' (%d).", tcap*4);
-				return false;
-			}
-			if (dmesh.ntris)
-				memcpy(newt, dmesh.tris, sizeof(unsigned char)*4*dmesh.ntris);
-			rcFree(dmesh.tris);
-			dmesh.tris = newt;
-		}
-		for (int j = 0; j < ntris; ++j)
-		{
-			const int* t = &tris[j*4];
-			dmesh.tris[dmesh.ntris*4+0] = (unsigned char)t[0];
-			dmesh.tris[dmesh.ntris*4+1] = (unsigned char)t[1];
-			dmesh.tris[dmesh.ntris*4+2] = (unsigned char)t[2];
-			dmesh.tris[dmesh.ntris*4+3] = (unsigned char)t[3];
-			dmesh.ntris++;
-		}
+		const rcDetailPolyResult& result = results[i];
+		const rcDetailThreadData& thread = threads[result.thread];
+		if (result.nverts)
+			memcpy(&dmesh.verts[dmesh.nverts*3], &thread.detailVerts[result.vertBase*3], sizeof(float)*3*result.nverts);
+		if (result.ntris)
+			memcpy(&dmesh.tris[dmesh.ntris*4], &thread.detailTris[result.triBase*4], sizeof(unsigned char)*4*result.ntris);
+		dmesh.nverts += result.nverts;
+		dmesh.ntris += result.ntris;
 	}
 	
 	return true;
@@ -1404,6 +1721,7 @@ bool rcMergePolyMeshDetails(rcContext* ctx, rcPolyMeshDetail** meshes, const int
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_MERGE_POLYMESHDETAIL);
+	rcScopedTempArena tempArena(ctx);
 	
 	int maxVerts = 0;
 	int maxTris = 0;
@@ -0,0 +1,372 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "RecastParallel.h"
+#include "RecastAlloc.h"
+#include "RecastAssert.h"
+
+#ifdef _WIN32
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+typedef HANDLE ThreadHandle;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Condition;
+
+inline void mutexInit(Mutex& m) { InitializeCriticalSection(&m); }
+inline void mutexDestroy(Mutex& m) { DeleteCriticalSection(&m); }
+inline void mutexLock(Mutex& m) { EnterCriticalSection(&m); }
+inline void mutexUnlock(Mutex& m) { LeaveCriticalSection(&m); }
+inline void condInit(Condition& c) { InitializeConditionVariable(&c); }
+inline void condDestroy(Condition&) {}
+inline void condWait(Condition& c, Mutex& m) { SleepConditionVariableCS(&c, &m, INFINITE); }
+inline void condSignal(Condition& c) { WakeConditionVariable(&c); }
+inline void condBroadcast(Condition& c) { WakeAllConditionVariable(&c); }
+
+/// Returns the value of @p value before it was incremented.
+inline int atomicFetchIncrement(volatile long* value) { return (int)InterlockedIncrement(value) - 1; }
+#else
+typedef pthread_t ThreadHandle;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+
+inline void mutexInit(Mutex& m) { pthread_mutex_init(&m, NULL); }
+inline void mutexDestroy(Mutex& m) { pthread_mutex_destroy(&m); }
+inline void mutexLock(Mutex& m) { pthread_mutex_lock(&m); }
+inline void mutexUnlock(Mutex& m) { pthread_mutex_unlock(&m); }
+inline void condInit(Condition& c) { pthread_cond_init(&c, NULL); }
+inline void condDestroy(Condition& c) { pthread_cond_destroy(&c); }
+inline void condWait(Condition& c, Mutex& m) { pthread_cond_wait(&c, &m); }
+inline void condSignal(Condition& c) { pthread_cond_signal(&c); }
+inline void condBroadcast(Condition& c) { pthread_cond_broadcast(&c); }
+
+/// Returns the value of @p value before it was incremented.
+inline int atomicFetchIncrement(volatile long* value) { return (int)__sync_fetch_and_add(value, 1L); }
+#endif
+
+class rcThreadPool;
+
+struct WorkerStart
+{
+	rcThreadPool* pool;
+	int threadIndex;
+};
+
+#ifdef _WIN32
+DWORD WINAPI workerMain(LPVOID arg);
+#else
+void* workerMain(void* arg);
+#endif
+
+class rcThreadPool : public rcTaskScheduler
+{
+public:
+	rcThreadPool()
+	: m_numThreads(1)
+	, m_numWorkers(0)
+	, m_threads(0)
+	, m_starts(0)
+	, m_task(0)
+	, m_itemCount(0)
+	, m_nextItem(0)
+	, m_generation(0)
+	, m_activeWorkers(0)
+	, m_busy(false)
+	, m_quit(false)
+	{
+		mutexInit(m_mutex);
+		condInit(m_workCond);
+		condInit(m_doneCond);
+	}
+
+	virtual ~rcThreadPool()
+	{
+		mutexLock(m_mutex);
+		m_quit = true;
+		condBroadcast(m_workCond);
+		mutexUnlock(m_mutex);
+
+		for (int i = 0; i < m_numWorkers; ++i)
+		{
+#ifdef _WIN32
+			WaitForSingleObject(m_threads[i], INFINITE);
+			CloseHandle(m_threads[i]);
+#else
+			pthread_join(m_threads[i], NULL);
+#endif
+		}
+		rcFree(m_threads);
+		rcFree(m_starts);
+
+		condDestroy(m_doneCond);
+		condDestroy(m_workCond);
+		mutexDestroy(m_mutex);
+	}
+
+	bool init(const int numThreads)
+	{
+		const int maxWorkers = numThreads - 1;
+		if (maxWorkers <= 0)
+		{
+			return true;
+		}
+
+		m_threads = (ThreadHandle*)rcAlloc(sizeof(ThreadHandle) * maxWorkers, RC_ALLOC_PERM);
+		m_starts = (WorkerStart*)rcAlloc(sizeof(WorkerStart) * maxWorkers, RC_ALLOC_PERM);
+		if (!m_threads || !m_starts)
+		{
+			return false;
+		}
+
+		// If the system refuses to create more threads, run with the ones we got.
+		for (int i = 0; i < maxWorkers; ++i)
+		{
+			m_starts[i].pool = this;
+			m_starts[i].threadIndex = i + 1;
+#ifdef _WIN32
+			m_threads[i] = CreateThread(NULL, 0, workerMain, &m_starts[i], 0, NULL);
+			if (m_threads[i] == NULL)
+			{
+				break;
+			}
+#else
+			if (pthread_create(&m_threads[i], NULL, workerMain, &m_starts[i]) != 0)
+			{
+				break;
+			}
+#endif
+			m_numWorkers++;
+		}
+		m_numThreads = m_numWorkers + 1;
+		return true;
+	}
+
+	virtual int getThreadCount() const { return m_numThreads; }
+
+	virtual void parallelFor(rcParallelTask& task, const int itemCount)
+	{
+		if (itemCount <= 0)
+		{
+			return;
+		}
+
+		mutexLock(m_mutex);
+		if (m_numWorkers == 0 || itemCount == 1 || m_busy)
+		{
+			// Nothing to gain from waking the workers, or they are already
+			// busy with the loop that is calling us.
+			mutexUnlock(m_mutex);
+			for (int i = 0; i < itemCount; ++i)
+			{
+				task.execute(i, 0);
+			}
+			return;
+		}
+
+		m_busy = true;
+		m_task = &task;
+		m_itemCount = itemCount;
+		m_nextItem = 0;
+		m_activeWorkers = m_numWorkers;
+		m_generation++;
+		condBroadcast(m_workCond);
+		mutexUnlock(m_mutex);
+
+		runItems(0);
+
+		mutexLock(m_mutex);
+		while (m_activeWorkers > 0)
+		{
+			condWait(m_doneCond, m_mutex);
+		}
+		m_task = 0;
+		m_busy = false;
+		mutexUnlock(m_mutex);
+	}
+
+	void workerLoop(const int threadIndex)
+	{
+		unsigned int seenGeneration = 0;
+
+		mutexLock(m_mutex);
+		for (;;)
+		{
+			while (!m_quit && m_generation == seenGeneration)
+			{
+				condWait(m_workCond, m_mutex);
+			}
+			if (m_quit)
+			{
+				break;
+			}
+			seenGeneration = m_generation;
+			mutexUnlock(m_mutex);
+
+			runItems(threadIndex);
+
+			mutexLock(m_mutex);
+			m_activeWorkers--;
+			if (m_activeWorkers == 0)
+			{
+				condSignal(m_doneCond);
+			}
+		}
+		mutexUnlock(m_mutex);
+	}
+
+private:
+	void runItems(const int threadIndex)
+	{
+		for (;;)
+		{
+			const int item = atomicFetchIncrement(&m_nextItem);
+			if (item >= m_itemCount)
+			{
+				break;
+			}
+			m_task->execute(item, threadIndex);
+		}
+	}
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcThreadPool(const rcThreadPool&);
+	rcThreadPool& operator=(const rcThreadPool&);
+
+	int m_numThreads;
+	int m_numWorkers;
+	ThreadHandle* m_threads;
+	WorkerStart* m_starts;
+
+	Mutex m_mutex;
+	Condition m_workCond;
+	Condition m_doneCond;
+
+	rcParallelTask* m_task;
+	int m_itemCount;
+	volatile long m_nextItem;
+	unsigned int m_generation;
+	int m_activeWorkers;
+	bool m_busy;
+	bool m_quit;
+};
+
+#ifdef _WIN32
+DWORD WINAPI workerMain(LPVOID arg)
+{
+	WorkerStart* start = (WorkerStart*)arg;
+	start->pool->workerLoop(start->threadIndex);
+	return 0;
+}
+#else
+void* workerMain(void* arg)
+{
+	WorkerStart* start = (WorkerStart*)arg;
+	start->pool->workerLoop(start->threadIndex);
+	return NULL;
+}
+#endif
+
+/// Runs a task with the temporary arena of the thread that started the loop
+/// current on the threads that run its items.
+class rcTempArenaTask : public rcParallelTask
+{
+public:
+	rcTempArenaTask(rcParallelTask& task, rcTempArena* arena) : m_task(task), m_arena(arena) {}
+
+	virtual void execute(int itemIndex, int threadIndex)
+	{
+		int prevIndex = 0;
+		rcTempArena* prevArena = rcGetThreadTempArena(&prevIndex);
+		if (prevArena == m_arena)
+		{
+			// The calling thread, or a thread of an enclosing loop, keeps its block.
+			m_task.execute(itemIndex, threadIndex);
+			return;
+		}
+		rcSetThreadTempArena(m_arena, threadIndex);
+		m_task.execute(itemIndex, threadIndex);
+		rcSetThreadTempArena(prevArena, prevIndex);
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcTempArenaTask(const rcTempArenaTask&);
+	rcTempArenaTask& operator=(const rcTempArenaTask&);
+
+	rcParallelTask& m_task;
+	rcTempArena* m_arena;
+};
+} // anonymous namespace
+
+rcTaskScheduler* rcAllocThreadPool(const int numThreads)
+{
+	rcAssert(numThreads >= 1);
+
+	void* mem = rcAlloc(sizeof(rcThreadPool), RC_ALLOC_PERM);
+	if (!mem)
+	{
+		return 0;
+	}
+	rcThreadPool* pool = ::new(rcNewTag(), mem) rcThreadPool;
+	if (!pool->init(numThreads))
+	{
+		rcFreeThreadPool(pool);
+		return 0;
+	}
+	return pool;
+}
+
+void rcFreeThreadPool(rcTaskScheduler* threadPool)
+{
+	if (!threadPool)
+	{
+		return;
+	}
+	threadPool->~rcTaskScheduler();
+	rcFree(threadPool);
+}
+
+void rcParallelFor(rcTaskScheduler* scheduler, rcParallelTask& task, const int itemCount)
+{
+	if (scheduler)
+	{
+		rcTempArena* arena = rcGetThreadTempArena();
+		if (arena)
+		{
+			rcTempArenaTask arenaTask(task, arena);
+			scheduler->parallelFor(arenaTask, itemCount);
+		}
+		else
+		{
+			scheduler->parallelFor(task, itemCount);
+		}
+		return;
+	}
+	for (int i = 0; i < itemCount; ++i)
+	{
+		task.execute(i, 0);
+	}
+}
@@ -17,9 +17,12 @@
 //
 
 #include <math.h>
+#include <string.h>
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
+#include "RecastParallel.h"
+#include "RecastSimd.h"
 
 /// Check whether two bounding boxes overlap
 ///
@@ -36,6 +39,81 @@ static bool overlapBounds(const float* aMin, const float* aMax, const float* bMi
 		aMin[2] <= bMax[2] && aMax[2] >= bMin[2];
 }
 
+#ifdef RC_SPAN_INDEX32
+/// The value stored in a span column or rcSpan::next to link to a span.
+typedef unsigned int rcSpanLink;
+
+/// Returns the link to a span of the heightfield, or the end of list marker for null.
+static inline rcSpanLink spanLink(const rcHeightfield& heightfield, const rcSpan* span)
+{
+	return span ? (rcSpanLink)(span - heightfield.spanArena) : RC_NULL_SPAN;
+}
+
+/// Allocates a new span in the heightfield.
+/// Re-uses freed spans first, and grows the contiguous span storage when it is full.
+/// Growing the storage moves the spans, so any span pointers are invalidated by this call.
+/// 
+/// @param[in]	heightfield		The heightfield
+/// @returns A pointer to the allocated or re-used span memory. 
+static rcSpan* allocSpan(rcHeightfield& heightfield)
+{
+	// Pop item from the front of the free list.
+	if (heightfield.freelist != RC_NULL_SPAN)
+	{
+		rcSpan* newSpan = &heightfield.spanArena[heightfield.freelist];
+		heightfield.freelist = newSpan->next;
+		return newSpan;
+	}
+
+	if (heightfield.spanArenaCount == heightfield.spanArenaSize)
+	{
+		// The span indices must stay below RC_NULL_SPAN and the storage size must fit an int.
+		static const int MAX_SPANS = 0x7fffffff / (int)sizeof(rcSpan);
+		if (heightfield.spanArenaSize >= MAX_SPANS)
+		{
+			return NULL;
+		}
+		const int newSize = heightfield.spanArenaSize == 0 ? RC_SPANS_PER_POOL : rcMin(heightfield.spanArenaSize * 2, MAX_SPANS);
+		rcSpan* newArena = (rcSpan*)rcAlloc(sizeof(rcSpan) * newSize, RC_ALLOC_PERM);
+		if (newArena == NULL)
+		{
+			return NULL;
+		}
+		if (heightfield.spanArenaCount > 0)
+		{
+			memcpy(newArena, heightfield.spanArena, sizeof(rcSpan) * heightfield.spanArenaCount);
+		}
+		rcFree(heightfield.spanArena);
+		heightfield.spanArena = newArena;
+		heightfield.spanArenaSize = newSize;
+	}
+
+	return &heightfield.spanArena[heightfield.spanArenaCount++];
+}
+
+/// Releases the memory used by the span back to the heightfield, so it can be re-used for new spans.
+/// @param[in]	heightfield		The heightfield.
+/// @param[in]	span	A pointer to the span to free
+static void freeSpan(rcHeightfield& heightfield, rcSpan* span)
+{
+	if (span == NULL)
+	{
+		return;
+	}
+	// Add the span to the front of the free list.
+	span->next = heightfield.freelist;
+	heightfield.freelist = spanLink(heightfield, span);
+}
+#else
+/// The value stored in a span column or rcSpan::next to link to a span.
+typedef rcSpan* rcSpanLink;
+
+/// Returns the link to a span of the heightfield.
+static inline rcSpanLink spanLink(const rcHeightfield& /*heightfield*/, rcSpan* span)
+{
+	return span;
+}
+
 /// Allocates a new span in the heightfield.
 /// Use a memory pool and free list to minimize actual allocations.
 /// 
@@ -91,6 +169,7 @@ static void freeSpan(rcHeightfield& heightfield, rcSpan* span)
 	span->next = heightfield.freelist;
 	heightfield.freelist = span;
 }
+#endif
 
 /// Adds a span to the heightfield.  If the new span overlaps existing spans,
 /// it will merge the new span with the existing ones.
@@ -116,11 +195,11 @@ static bool addSpan(rcHeightfield& heightfield,
 	newSpan->smin = min;
 	newSpan->smax = max;
 	newSpan->area = areaID;
-	newSpan->next = NULL;
+	newSpan->next = spanLink(heightfield, NULL);
 	
 	const int columnIndex = x + z * heightfield.width;
 	rcSpan* previousSpan = NULL;
-	rcSpan* currentSpan = heightfield.spans[columnIndex];
+	rcSpan* currentSpan = rcGetFirstSpan(heightfield, columnIndex);
 	
 	// Insert the new span, possibly merging it with existing spans.
 	while (currentSpan != NULL)
@@ -135,7 +214,7 @@ static bool addSpan(rcHeightfield& heightfield,
 		{
 			// Current span is completely before the new span.  Keep going.
 			previousSpan = currentSpan;
-			currentSpan = currentSpan->next;
+			currentSpan = rcGetNextSpan(heightfield, currentSpan);
 		}
 		else
 		{
@@ -158,15 +237,15 @@ static bool addSpan(rcHeightfield& heightfield,
 			
 			// Remove the current span since it's now merged with newSpan.
 			// Keep going because there might be other overlapping spans that also need to be merged.
-			rcSpan* next = currentSpan->next;
+			rcSpan* next = rcGetNextSpan(heightfield, currentSpan);
 			freeSpan(heightfield, currentSpan);
 			if (previousSpan)
 			{
-				previousSpan->next = next;
+				previousSpan->next = spanLink(heightfield, next);
 			}
 			else
 			{
-				heightfield.spans[columnIndex] = next;
+				heightfield.spans[columnIndex] = spanLink(heightfield, next);
 			}
 			currentSpan = next;
 		}
@@ -176,13 +255,13 @@ static bool addSpan(rcHeightfield& heightfield,
 	if (previousSpan != NULL)
 	{
 		newSpan->next = previousSpan->next;
-		previousSpan->next = newSpan;
+		previousSpan->next = spanLink(heightfield, newSpan);
 	}
 	else
 	{
 		// This span should go before the others in the list
 		newSpan->next = heightfield.spans[columnIndex];
-		heightfield.spans[columnIndex] = newSpan;
+		heightfield.spans[columnIndex] = spanLink(heightfield, newSpan);
 	}
 
 	return true;
@@ -294,6 +373,55 @@ static void dividePoly(const float* inVerts, int inVertsCount,
 	*outVerts2Count = poly2Vert;
 }
 
+/// Clamps the height range of a polygon clipped to a grid cell to the heightfield bounding box,
+/// snaps it to the height grid and adds the resulting span.
+///
+/// @param[in,out]	heightfield			Heightfield to add the span to
+/// @param[in]		x					The column x index
+/// @param[in]		z					The column z index
+/// @param[in]		spanMin				The minimum height of the clipped polygon
+/// @param[in]		spanMax				The maximum height of the clipped polygon
+/// @param[in]		heightfieldBBMinY	The min y extent of the heightfield bounding box
+/// @param[in]		by					The height of the heightfield bounding box
+/// @param[in]		inverseCellHeight	1 / cellHeight
+/// @param[in]		areaID				The area ID to assign to the span
+/// @param[in]		flagMergeThreshold	The threshold in which area flags will be merged
+/// @returns false if there was an error adding the span to the heightfield.
+static inline bool addClippedSpan(rcHeightfield& heightfield, const int x, const int z,
+                                  float spanMin, float spanMax,
+                                  const float heightfieldBBMinY, const float by, const float inverseCellHeight,
+                                  const unsigned char areaID, const int flagMergeThreshold)
+{
+	spanMin -= heightfieldBBMinY;
+	spanMax -= heightfieldBBMinY;
+
+	// Skip the span if it's completely outside the heightfield bounding box
+	if (spanMax < 0.0f)
+	{
+		return true;
+	}
+	if (spanMin > by)
+	{
+		return true;
+	}
+
+	// Clamp the span to the heightfield bounding box.
+	if (spanMin < 0.0f)
+	{
+		spanMin = 0;
+	}
+	if (spanMax > by)
+	{
+		spanMax = by;
+	}
+
+	// Snap the span to the heightfield height grid.
+	unsigned short spanMinCellIndex = (unsigned short)rcClamp((int)floorf(spanMin * inverseCellHeight), 0, RC_SPAN_MAX_HEIGHT);
+	unsigned short spanMaxCellIndex = (unsigned short)rcClamp((int)ceilf(spanMax * inverseCellHeight), (int)spanMinCellIndex + 1, RC_SPAN_MAX_HEIGHT);
+
+	return addSpan(heightfield, x, z, spanMinCellIndex, spanMaxCellIndex, areaID, flagMergeThreshold);
+}
+
 ///	Rasterize a single triangle to the heightfield.
 ///
 ///	This code is extremely hot, so much care should be given to maintaining maximum perf here.
@@ -309,12 +437,14 @@ static void dividePoly(const float* inVerts, int inVertsCount,
 /// @param[in] 	inverseCellSize		1 / cellSize
 /// @param[in] 	inverseCellHeight	1 / cellHeight
 /// @param[in] 	flagMergeThreshold	The threshold in which area flags will be merged 
+/// @param[in] 	rowMin				The first heightfield row (z) to add spans to. [Limit: >= 0]
+/// @param[in] 	rowMax				The last heightfield row (z) to add spans to. [Limit: < heightfield.height]
 /// @returns true if the operation completes successfully.  false if there was an error adding spans to the heightfield.
 static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
                          const unsigned char areaID, rcHeightfield& heightfield,
                          const float* heightfieldBBMin, const float* heightfieldBBMax,
                          const float cellSize, const float inverseCellSize, const float inverseCellHeight,
-                         const int flagMergeThreshold)
+                         const int flagMergeThreshold, const int rowMin, const int rowMax)
 {
 	// Calculate the bounding box of the triangle.
 	float triBBMin[3];
@@ -345,6 +475,14 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 	z0 = rcClamp(z0, -1, h - 1);
 	z1 = rcClamp(z1, 0, h - 1);
 
+	// Only add spans to the requested rows. The rows before them are still clipped
+	// so that the polygon is cut exactly the same way regardless of the row range.
+	z1 = rcMin(z1, rowMax);
+	if (z1 < rowMin)
+	{
+		return true;
+	}
+
 	// Clip the triangle into all grid cells it touches.
 	float buf[7 * 3 * 4];
 	float* in = buf;
@@ -369,7 +507,7 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 		{
 			continue;
 		}
-		if (z < 0)
+		if (z < rowMin)
 		{
 			continue;
 		}
@@ -424,42 +562,627 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 				spanMin = rcMin(spanMin, p1[vert * 3 + 1]);
 				spanMax = rcMax(spanMax, p1[vert * 3 + 1]);
 			}
-			spanMin -= heightfieldBBMin[1];
-			spanMax -= heightfieldBBMin[1];
-			
-			// Skip the span if it's completely outside the heightfield bounding box
-			if (spanMax < 0.0f)
+			if (!addClippedSpan(heightfield, x, z, spanMin, spanMax, heightfieldBBMin[1], by, inverseCellHeight, areaID, flagMergeThreshold))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+#ifdef RC_SIMD_SSE2
+/// SSE2 version of #dividePoly. Each vertex is stored in a single register as (x, y, z, 0), so a
+/// vertex is interpolated or copied with one operation instead of three.
+/// The interpolation performs the same operations in the same order as the scalar version,
+/// so the resulting vertices are bit-identical.
+static void dividePolySSE2(const __m128* inVerts, int inVertsCount,
+                           __m128* outVerts1, int* outVerts1Count,
+                           __m128* outVerts2, int* outVerts2Count,
+                           float axisOffset, rcAxis axis)
+{
+	rcAssert(inVertsCount <= 12);
+
+	// How far positive or negative away from the separating axis is each vertex.
+	const __m128 offset = _mm_set1_ps(axisOffset);
+	float inVertAxisDelta[12];
+	for (int inVert = 0; inVert < inVertsCount; ++inVert)
+	{
+		const __m128 delta = _mm_sub_ps(offset, inVerts[inVert]);
+		inVertAxisDelta[inVert] = _mm_cvtss_f32(axis == RC_AXIS_X ? delta : _mm_shuffle_ps(delta, delta, _MM_SHUFFLE(2, 2, 2, 2)));
+	}
+
+	int poly1Vert = 0;
+	int poly2Vert = 0;
+	for (int inVertA = 0, inVertB = inVertsCount - 1; inVertA < inVertsCount; inVertB = inVertA, ++inVertA)
+	{
+		// If the two vertices are on the same side of the separating axis
+		bool sameSide = (inVertAxisDelta[inVertA] >= 0) == (inVertAxisDelta[inVertB] >= 0);
+
+		if (!sameSide)
+		{
+			const __m128 s = _mm_set1_ps(inVertAxisDelta[inVertB] / (inVertAxisDelta[inVertB] - inVertAxisDelta[inVertA]));
+			const __m128 intersection = _mm_add_ps(inVerts[inVertB], _mm_mul_ps(_mm_sub_ps(inVerts[inVertA], inVerts[inVertB]), s));
+			outVerts1[poly1Vert++] = intersection;
+			outVerts2[poly2Vert++] = intersection;
+
+			// add the inVertA point to the right polygon. Do NOT add points that are on the dividing line
+			// since these were already added above
+			if (inVertAxisDelta[inVertA] > 0)
+			{
+				outVerts1[poly1Vert++] = inVerts[inVertA];
+			}
+			else if (inVertAxisDelta[inVertA] < 0)
+			{
+				outVerts2[poly2Vert++] = inVerts[inVertA];
+			}
+		}
+		else
+		{
+			// add the inVertA point to the right polygon. Addition is done even for points on the dividing line
+			if (inVertAxisDelta[inVertA] >= 0)
+			{
+				outVerts1[poly1Vert++] = inVerts[inVertA];
+				if (inVertAxisDelta[inVertA] != 0)
+				{
+					continue;
+				}
+			}
+			outVerts2[poly2Vert++] = inVerts[inVertA];
+		}
+	}
+
+	*outVerts1Count = poly1Vert;
+	*outVerts2Count = poly2Vert;
+}
+
+/// SSE2 version of #rasterizeTri.
+///
+/// Produces exactly the same spans as the scalar version. The min and max reductions pass their
+/// operands in the order that matches the comparisons of the scalar code, which keeps the results
+/// identical even for signed zeros.
+static bool rasterizeTriSSE2(const float* v0, const float* v1, const float* v2,
+                             const unsigned char areaID, rcHeightfield& heightfield,
+                             const float* heightfieldBBMin, const float* heightfieldBBMax,
+                             const float cellSize, const float inverseCellSize, const float inverseCellHeight,
+                             const int flagMergeThreshold, const int rowMin, const int rowMax)
+{
+	const __m128 vert0 = _mm_set_ps(0.0f, v0[2], v0[1], v0[0]);
+	const __m128 vert1 = _mm_set_ps(0.0f, v1[2], v1[1], v1[0]);
+	const __m128 vert2 = _mm_set_ps(0.0f, v2[2], v2[1], v2[0]);
+
+	// Calculate the bounding box of the triangle.
+	float triBBMin[4];
+	float triBBMax[4];
+	_mm_storeu_ps(triBBMin, _mm_min_ps(_mm_min_ps(vert0, vert1), vert2));
+	_mm_storeu_ps(triBBMax, _mm_max_ps(_mm_max_ps(vert0, vert1), vert2));
+
+	// If the triangle does not touch the bounding box of the heightfield, skip the triangle.
+	if (!overlapBounds(triBBMin, triBBMax, heightfieldBBMin, heightfieldBBMax))
+	{
+		return true;
+	}
+
+	const int w = heightfield.width;
+	const int h = heightfield.height;
+	const float by = heightfieldBBMax[1] - heightfieldBBMin[1];
+
+	// Calculate the footprint of the triangle on the grid's z-axis
+	int z0 = (int)((triBBMin[2] - heightfieldBBMin[2]) * inverseCellSize);
+	int z1 = (int)((triBBMax[2] - heightfieldBBMin[2]) * inverseCellSize);
+
+	// use -1 rather than 0 to cut the polygon properly at the start of the tile
+	z0 = rcClamp(z0, -1, h - 1);
+	z1 = rcClamp(z1, 0, h - 1);
+
+	// Only add spans to the requested rows. The rows before them are still clipped
+	// so that the polygon is cut exactly the same way regardless of the row range.
+	z1 = rcMin(z1, rowMax);
+	if (z1 < rowMin)
+	{
+		return true;
+	}
+
+	// Clip the triangle into all grid cells it touches.
+	__m128 buf[7 * 4];
+	__m128* in = buf;
+	__m128* inRow = buf + 7;
+	__m128* p1 = inRow + 7;
+	__m128* p2 = p1 + 7;
+
+	in[0] = vert0;
+	in[1] = vert1;
+	in[2] = vert2;
+	int nvRow;
+	int nvIn = 3;
+
+	for (int z = z0; z <= z1; ++z)
+	{
+		// Clip polygon to row. Store the remaining polygon as well
+		const float cellZ = heightfieldBBMin[2] + (float)z * cellSize;
+		dividePolySSE2(in, nvIn, inRow, &nvRow, p1, &nvIn, cellZ + cellSize, RC_AXIS_Z);
+		rcSwap(in, p1);
+
+		if (nvRow < 3)
+		{
+			continue;
+		}
+		if (z < rowMin)
+		{
+			continue;
+		}
+
+		// find X-axis bounds of the row
+		__m128 rowMin = inRow[0];
+		__m128 rowMax = inRow[0];
+		for (int vert = 1; vert < nvRow; ++vert)
+		{
+			rowMin = _mm_min_ps(inRow[vert], rowMin);
+			rowMax = _mm_max_ps(inRow[vert], rowMax);
+		}
+		int x0 = (int)((_mm_cvtss_f32(rowMin) - heightfieldBBMin[0]) * inverseCellSize);
+		int x1 = (int)((_mm_cvtss_f32(rowMax) - heightfieldBBMin[0]) * inverseCellSize);
+		if (x1 < 0 || x0 >= w)
+		{
+			continue;
+		}
+		x0 = rcClamp(x0, -1, w - 1);
+		x1 = rcClamp(x1, 0, w - 1);
+
+		int nv;
+		int nv2 = nvRow;
+
+		for (int x = x0; x <= x1; ++x)
+		{
+			// Clip polygon to column. store the remaining polygon as well
+			const float cx = heightfieldBBMin[0] + (float)x * cellSize;
+			dividePolySSE2(inRow, nv2, p1, &nv, p2, &nv2, cx + cellSize, RC_AXIS_X);
+			rcSwap(inRow, p2);
+
+			if (nv < 3)
 			{
 				continue;
 			}
-			if (spanMin > by)
+			if (x < 0)
 			{
 				continue;
 			}
-			
-			// Clamp the span to the heightfield bounding box.
-			if (spanMin < 0.0f)
+
+			// Calculate min and max of the span.
+			__m128 spanMin = p1[0];
+			__m128 spanMax = p1[0];
+			for (int vert = 1; vert < nv; ++vert)
 			{
-				spanMin = 0;
+				spanMin = _mm_min_ps(spanMin, p1[vert]);
+				spanMax = _mm_max_ps(spanMax, p1[vert]);
 			}
-			if (spanMax > by)
+			spanMin = _mm_shuffle_ps(spanMin, spanMin, _MM_SHUFFLE(1, 1, 1, 1));
+			spanMax = _mm_shuffle_ps(spanMax, spanMax, _MM_SHUFFLE(1, 1, 1, 1));
+
+			if (!addClippedSpan(heightfield, x, z, _mm_cvtss_f32(spanMin), _mm_cvtss_f32(spanMax), heightfieldBBMin[1], by, inverseCellHeight, areaID, flagMergeThreshold))
 			{
-				spanMax = by;
+				return false;
 			}
+		}
+	}
+
+	return true;
+}
+#endif // RC_SIMD_SSE2
+
+/// The signature shared by the scalar and SIMD triangle rasterizers.
+typedef bool (*rcRasterizeTriFunc)(const float* v0, const float* v1, const float* v2,
+                                   const unsigned char areaID, rcHeightfield& heightfield,
+                                   const float* heightfieldBBMin, const float* heightfieldBBMax,
+                                   const float cellSize, const float inverseCellSize, const float inverseCellHeight,
+                                   const int flagMergeThreshold, const int rowMin, const int rowMax);
+
+/// Returns the fastest triangle rasterizer that is enabled.
+static rcRasterizeTriFunc getRasterizeTriFunc()
+{
+#ifdef RC_SIMD_SSE2
+	if (rcIsSimdEnabled())
+	{
+		return rasterizeTriSSE2;
+	}
+#endif
+	return rasterizeTri;
+}
 
-			// Snap the span to the heightfield height grid.
-			unsigned short spanMinCellIndex = (unsigned short)rcClamp((int)floorf(spanMin * inverseCellHeight), 0, RC_SPAN_MAX_HEIGHT);
-			unsigned short spanMaxCellIndex = (unsigned short)rcClamp((int)ceilf(spanMax * inverseCellHeight), (int)spanMinCellIndex + 1, RC_SPAN_MAX_HEIGHT);
+/// Gives access to the vertices of an indexed triangle mesh.
+template<typename IndexType>
+struct rcIndexedTris
+{
+	rcIndexedTris(const float* verts, const IndexType* tris) : m_verts(verts), m_tris(tris) {}
+	const float* vert(const int triIndex, const int corner) const { return &m_verts[m_tris[triIndex * 3 + corner] * 3]; }
+
+	const float* m_verts;
+	const IndexType* m_tris;
+};
+
+/// Gives access to the vertices of a triangle list with three sequential vertices per triangle.
+struct rcTriList
+{
+	explicit rcTriList(const float* verts) : m_verts(verts) {}
+	const float* vert(const int triIndex, const int corner) const { return &m_verts[(triIndex * 3 + corner) * 3]; }
+
+	const float* m_verts;
+};
 
-			if (!addSpan(heightfield, x, z, spanMinCellIndex, spanMaxCellIndex, areaID, flagMergeThreshold))
+/// Rasterizes the triangles into the rows [@p rowMin, @p rowMax] of the heightfield.
+/// @param[in]	triIndices	The indices of the triangles to rasterize, or null to rasterize the
+///							first @p numTris triangles. [Size: @p numTris]
+/// @returns false if there was an error adding spans to the heightfield.
+template<class Tris>
+static bool rasterizeTris(const Tris& tris, const unsigned char* triAreaIDs, const int* triIndices, const int numTris,
+                          rcHeightfield& heightfield, const int flagMergeThreshold, const int rowMin, const int rowMax)
+{
+	const float inverseCellSize = 1.0f / heightfield.cs;
+	const float inverseCellHeight = 1.0f / heightfield.ch;
+	const rcRasterizeTriFunc rasterize = getRasterizeTriFunc();
+	for (int i = 0; i < numTris; ++i)
+	{
+		const int triIndex = triIndices ? triIndices[i] : i;
+		if (!rasterize(tris.vert(triIndex, 0), tris.vert(triIndex, 1), tris.vert(triIndex, 2), triAreaIDs[triIndex],
+		               heightfield, heightfield.bmin, heightfield.bmax, heightfield.cs, inverseCellSize, inverseCellHeight,
+		               flagMergeThreshold, rowMin, rowMax))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Calculates the heightfield rows covered by the bounds of a triangle, the same way the
+/// triangle rasterizers do. The triangle does not add spans outside of these rows.
+template<class Tris>
+static void getTriRows(const Tris& tris, const int triIndex, const rcHeightfield& heightfield, const float inverseCellSize,
+                       int& rowMin, int& rowMax)
+{
+	const float* v0 = tris.vert(triIndex, 0);
+	const float* v1 = tris.vert(triIndex, 1);
+	const float* v2 = tris.vert(triIndex, 2);
+	const float zMin = rcMin(rcMin(v0[2], v1[2]), v2[2]);
+	const float zMax = rcMax(rcMax(v0[2], v1[2]), v2[2]);
+	rowMin = rcClamp((int)((zMin - heightfield.bmin[2]) * inverseCellSize), 0, heightfield.height - 1);
+	rowMax = rcClamp((int)((zMax - heightfield.bmin[2]) * inverseCellSize), 0, heightfield.height - 1);
+}
+
+/// Sorts the triangles into the bands of rows they cover, keeping their original order within
+/// each band. The triangles of band @p b are bandTris[bandStart[b]] to bandTris[bandStart[b + 1] - 1].
+/// @returns false if the bins could not be allocated.
+template<class Tris>
+static bool binTrisByBand(const Tris& tris, const int numTris, const rcHeightfield& heightfield, const int bandHeight,
+                          const int bandCount, rcTempVector<int>& bandStart, rcTempVector<int>& bandTris)
+{
+	const float inverseCellSize = 1.0f / heightfield.cs;
+	if (!bandStart.reserve(bandCount + 1))
+	{
+		return false;
+	}
+	bandStart.resize(bandCount + 1, 0);
+
+	// Count the triangles of each band.
+	for (int triIndex = 0; triIndex < numTris; ++triIndex)
+	{
+		int rowMin;
+		int rowMax;
+		getTriRows(tris, triIndex, heightfield, inverseCellSize, rowMin, rowMax);
+		for (int band = rowMin / bandHeight; band <= rowMax / bandHeight; ++band)
+		{
+			bandStart[band + 1]++;
+		}
+	}
+	for (int band = 0; band < bandCount; ++band)
+	{
+		bandStart[band + 1] += bandStart[band];
+	}
+
+	if (!bandTris.reserve(bandStart[bandCount]))
+	{
+		return false;
+	}
+	bandTris.resize(bandStart[bandCount]);
+	rcTempVector<int> bandFill(bandCount, 0);
+	for (int triIndex = 0; triIndex < numTris; ++triIndex)
+	{
+		int rowMin;
+		int rowMax;
+		getTriRows(tris, triIndex, heightfield, inverseCellSize, rowMin, rowMax);
+		for (int band = rowMin / bandHeight; band <= rowMax / bandHeight; ++band)
+		{
+			bandTris[bandStart[band] + bandFill[band]++] = triIndex;
+		}
+	}
+	return true;
+}
+
+#ifdef RC_SPAN_INDEX32
+/// Copies the spans of the columns in the rows [@p rowMin, @p rowMax] from the heightfield to the
+/// span storage of a per-thread heightfield that shares its span columns, and relinks the columns.
+/// @returns false if the per-thread heightfield ran out of memory.
+static bool copyBandSpans(const rcHeightfield& heightfield, rcHeightfield& threadHeightfield, const int rowMin, const int rowMax)
+{
+	for (int columnIndex = rowMin * heightfield.width; columnIndex < (rowMax + 1) * heightfield.width; ++columnIndex)
+	{
+		// The column is shared, so its first span has to be read before it is relinked.
+		unsigned int lastCopy = RC_NULL_SPAN;
+		for (const rcSpan* span = rcGetFirstSpan(heightfield, columnIndex); span != NULL; span = rcGetNextSpan(heightfield, span))
+		{
+			rcSpan* copy = allocSpan(threadHeightfield);
+			if (copy == NULL)
 			{
 				return false;
 			}
+			copy->smin = span->smin;
+			copy->smax = span->smax;
+			copy->area = span->area;
+			copy->next = RC_NULL_SPAN;
+
+			const unsigned int copyIndex = spanLink(threadHeightfield, copy);
+			if (lastCopy == RC_NULL_SPAN)
+			{
+				threadHeightfield.spans[columnIndex] = copyIndex;
+			}
+			else
+			{
+				threadHeightfield.spanArena[lastCopy].next = copyIndex;
+			}
+			lastCopy = copyIndex;
+		}
+	}
+	return true;
+}
+#endif
+
+/// Rasterizes the triangles of a band into its heightfield rows.
+///
+/// The bands don't share any columns, so each thread can add spans to the shared span columns
+/// of the heightfield. The spans are allocated from a per-thread heightfield that only
+/// owns span storage, and the storage is moved to the heightfield afterwards.
+template<class Tris>
+class rcRasterizeBandTask : public rcParallelTask
+{
+public:
+	rcRasterizeBandTask(const rcHeightfield& heightfield, const Tris& tris, const unsigned char* triAreaIDs,
+	                    const int* bandStart, const int* bandTris, const int flagMergeThreshold, const int bandHeight,
+	                    rcHeightfield** threadHeightfields, int* bandThreads, bool* bandFailed)
+	: m_heightfield(heightfield)
+	, m_tris(tris)
+	, m_triAreaIDs(triAreaIDs)
+	, m_bandStart(bandStart)
+	, m_bandTris(bandTris)
+	, m_flagMergeThreshold(flagMergeThreshold)
+	, m_bandHeight(bandHeight)
+	, m_threadHeightfields(threadHeightfields)
+	, m_bandThreads(bandThreads)
+	, m_bandFailed(bandFailed)
+	{
+	}
+
+	virtual void execute(int itemIndex, int threadIndex)
+	{
+		rcHeightfield& threadHeightfield = *m_threadHeightfields[threadIndex];
+		const int rowMin = itemIndex * m_bandHeight;
+		const int rowMax = rcMin(rowMin + m_bandHeight, threadHeightfield.height) - 1;
+		m_bandThreads[itemIndex] = threadIndex;
+#ifdef RC_SPAN_INDEX32
+		// The spans already in the band must be addressable with the thread's span indices.
+		if (!copyBandSpans(m_heightfield, threadHeightfield, rowMin, rowMax))
+		{
+			m_bandFailed[itemIndex] = true;
+			return;
 		}
+#endif
+		const int numTris = m_bandStart[itemIndex + 1] - m_bandStart[itemIndex];
+		m_bandFailed[itemIndex] = numTris > 0 &&
+		                          !rasterizeTris(m_tris, m_triAreaIDs, m_bandTris + m_bandStart[itemIndex], numTris, threadHeightfield,
+		                                         m_flagMergeThreshold, rowMin, rowMax);
 	}
 
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcRasterizeBandTask(const rcRasterizeBandTask&);
+	rcRasterizeBandTask& operator=(const rcRasterizeBandTask&);
+
+	const rcHeightfield& m_heightfield;
+	const Tris m_tris;
+	const unsigned char* m_triAreaIDs;
+	const int* m_bandStart;
+	const int* m_bandTris;
+	const int m_flagMergeThreshold;
+	const int m_bandHeight;
+	rcHeightfield** m_threadHeightfields;
+	int* m_bandThreads;
+	bool* m_bandFailed;
+};
+
+#ifdef RC_SPAN_INDEX32
+/// Concatenates the span storage of the per-thread heightfields into the heightfield and
+/// offsets the span indices of each band by the position of its thread's storage.
+/// @returns false if the combined span storage could not be allocated.
+static bool mergeThreadHeightfields(rcHeightfield& heightfield, rcHeightfield** threadHeightfields, const int threadCount,
+                                    const int* bandThreads, const int bandHeight, const int bandCount)
+{
+	rcTempVector<unsigned int> offsets(threadCount, 0);
+	int spanCount = 0;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		offsets[i] = (unsigned int)spanCount;
+		spanCount += threadHeightfields[i]->spanArenaCount;
+	}
+
+	const int arenaSize = rcMax(spanCount, RC_SPANS_PER_POOL);
+	rcSpan* arena = (rcSpan*)rcAlloc(sizeof(rcSpan) * arenaSize, RC_ALLOC_PERM);
+	if (arena == NULL)
+	{
+		return false;
+	}
+
+	unsigned int freelist = RC_NULL_SPAN;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		const rcHeightfield& threadHeightfield = *threadHeightfields[i];
+		rcSpan* spans = &arena[offsets[i]];
+		for (int j = 0; j < threadHeightfield.spanArenaCount; ++j)
+		{
+			spans[j] = threadHeightfield.spanArena[j];
+			if (spans[j].next != RC_NULL_SPAN)
+			{
+				spans[j].next += offsets[i];
+			}
+		}
+
+		// Prepend the free spans of the thread.
+		if (threadHeightfield.freelist != RC_NULL_SPAN)
+		{
+			const unsigned int first = threadHeightfield.freelist + offsets[i];
+			unsigned int last = first;
+			while (arena[last].next != RC_NULL_SPAN)
+			{
+				last = arena[last].next;
+			}
+			arena[last].next = freelist;
+			freelist = first;
+		}
+	}
+
+	for (int band = 0; band < bandCount; ++band)
+	{
+		const unsigned int offset = offsets[bandThreads[band]];
+		const int rowMin = band * bandHeight;
+		const int rowMax = rcMin(rowMin + bandHeight, heightfield.height) - 1;
+		for (int columnIndex = rowMin * heightfield.width; columnIndex < (rowMax + 1) * heightfield.width; ++columnIndex)
+		{
+			if (heightfield.spans[columnIndex] != RC_NULL_SPAN)
+			{
+				heightfield.spans[columnIndex] += offset;
+			}
+		}
+	}
+
+	rcFree(heightfield.spanArena);
+	heightfield.spanArena = arena;
+	heightfield.spanArenaSize = arenaSize;
+	heightfield.spanArenaCount = spanCount;
+	heightfield.freelist = freelist;
 	return true;
 }
+#else
+/// Moves the span pools and free spans of a per-thread heightfield to the heightfield.
+static void mergeThreadHeightfield(rcHeightfield& heightfield, rcHeightfield* threadHeightfield)
+{
+	if (threadHeightfield->pools)
+	{
+		rcSpanPool* lastPool = threadHeightfield->pools;
+		while (lastPool->next)
+		{
+			lastPool = lastPool->next;
+		}
+		lastPool->next = heightfield.pools;
+		heightfield.pools = threadHeightfield->pools;
+		threadHeightfield->pools = NULL;
+	}
+	if (threadHeightfield->freelist)
+	{
+		rcSpan* lastFree = threadHeightfield->freelist;
+		while (lastFree->next)
+		{
+			lastFree = lastFree->next;
+		}
+		lastFree->next = heightfield.freelist;
+		heightfield.freelist = threadHeightfield->freelist;
+		threadHeightfield->freelist = NULL;
+	}
+}
+#endif
+
+/// Rasterizes the triangles, in parallel if the context has a task scheduler.
+///
+/// Every band of rows receives the triangles that cover it in the original order and each triangle
+/// is clipped exactly like in a serial build, so the result does not depend on the number of threads.
+/// @returns false if the heightfield ran out of memory.
+template<class Tris>
+static bool rasterizeTriangles(rcContext* context, const Tris& tris, const unsigned char* triAreaIDs, const int numTris,
+                               rcHeightfield& heightfield, const int flagMergeThreshold)
+{
+	rcTaskScheduler* scheduler = context->getTaskScheduler();
+	const int threadCount = rcGetThreadCount(scheduler);
+	if (threadCount <= 1 || heightfield.height <= 1)
+	{
+		return rasterizeTris(tris, triAreaIDs, NULL, numTris, heightfield, flagMergeThreshold, 0, heightfield.height - 1);
+	}
+
+	// Use a few bands per thread to balance uneven triangle density.
+	static const int BANDS_PER_THREAD = 4;
+	const int bandHeight = rcMax(1, (heightfield.height + threadCount * BANDS_PER_THREAD - 1) / (threadCount * BANDS_PER_THREAD));
+	const int bandCount = (heightfield.height + bandHeight - 1) / bandHeight;
+
+	rcTempVector<int> bandStart;
+	rcTempVector<int> bandTris;
+	if (!binTrisByBand(tris, numTris, heightfield, bandHeight, bandCount, bandStart, bandTris))
+	{
+		return false;
+	}
+
+	rcTempVector<rcHeightfield*> threadHeightfields(threadCount, NULL);
+	rcTempVector<int> bandThreads(bandCount, 0);
+	rcTempVector<bool> bandFailed(bandCount, false);
+	bool ok = true;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		rcHeightfield* threadHeightfield = rcAllocHeightfield();
+		if (!threadHeightfield)
+		{
+			ok = false;
+			break;
+		}
+		threadHeightfield->width = heightfield.width;
+		threadHeightfield->height = heightfield.height;
+		rcVcopy(threadHeightfield->bmin, heightfield.bmin);
+		rcVcopy(threadHeightfield->bmax, heightfield.bmax);
+		threadHeightfield->cs = heightfield.cs;
+		threadHeightfield->ch = heightfield.ch;
+		threadHeightfield->spans = heightfield.spans;
+		threadHeightfields[i] = threadHeightfield;
+	}
+
+	if (ok)
+	{
+		rcRasterizeBandTask<Tris> task(heightfield, tris, triAreaIDs, bandStart.data(), bandTris.data(), flagMergeThreshold,
+		                               bandHeight, threadHeightfields.data(), bandThreads.data(), bandFailed.data());
+		rcParallelFor(scheduler, task, bandCount);
+		for (int i = 0; i < bandCount; ++i)
+		{
+			ok &= !bandFailed[i];
+		}
+#ifdef RC_SPAN_INDEX32
+		// If a band failed, some of its columns may still refer to the spans of the heightfield.
+		// The columns can't be merged consistently then, so the heightfield is cleared instead.
+		if (!ok || !mergeThreadHeightfields(heightfield, threadHeightfields.data(), threadCount, bandThreads.data(), bandHeight, bandCount))
+		{
+			memset(heightfield.spans, 0xff, sizeof(unsigned int) * heightfield.width * heightfield.height);
+			ok = false;
+		}
+#endif
+	}
+
+	for (int i = 0; i < threadCount; ++i)
+	{
+		if (threadHeightfields[i])
+		{
+#ifndef RC_SPAN_INDEX32
+			mergeThreadHeightfield(heightfield, threadHeightfields[i]);
+#endif
+			// The span columns are shared with the heightfield.
+			threadHeightfields[i]->spans = NULL;
+			rcFreeHeightField(threadHeightfields[i]);
+		}
+	}
+
+	return ok;
+}
 
 bool rcRasterizeTriangle(rcContext* context,
                          const float* v0, const float* v1, const float* v2,
@@ -468,11 +1191,13 @@ bool rcRasterizeTriangle(rcContext* context,
 	rcAssert(context != NULL);
 
 	rcScopedTimer timer(context, RC_TIMER_RASTERIZE_TRIANGLES);
+	rcScopedTempArena tempArena(context);
 
 	// Rasterize the single triangle.
 	const float inverseCellSize = 1.0f / heightfield.cs;
 	const float inverseCellHeight = 1.0f / heightfield.ch;
-	if (!rasterizeTri(v0, v1, v2, areaID, heightfield, heightfield.bmin, heightfield.bmax, heightfield.cs, inverseCellSize, inverseCellHeight, flagMergeThreshold))
+	const rcRasterizeTriFunc rasterize = getRasterizeTriFunc();
+	if (!rasterize(v0, v1, v2, areaID, heightfield, heightfield.bmin, heightfield.bmax, heightfield.cs, inverseCellSize, inverseCellHeight, flagMergeThreshold, 0, heightfield.height - 1))
 	{
 		context->log(RC_LOG_ERROR, "rcRasterizeTriangle: Out of memory.");
 		return false;
@@ -489,20 +1214,13 @@ bool rcRasterizeTriangles(rcContext* context,
 	rcAssert(context != NULL);
 
 	rcScopedTimer timer(context, RC_TIMER_RASTERIZE_TRIANGLES);
+	rcScopedTempArena tempArena(context);
 	
 	// Rasterize the triangles.
-	const float inverseCellSize = 1.0f / heightfield.cs;
-	const float inverseCellHeight = 1.0f / heightfield.ch;
-	for (int triIndex = 0; triIndex < numTris; ++triIndex)
+	if (!rasterizeTriangles(context, rcIndexedTris<int>(verts, tris), triAreaIDs, numTris, heightfield, flagMergeThreshold))
 	{
-		const float* v0 = &verts[tris[triIndex * 3 + 0] * 3];
-		const float* v1 = &verts[tris[triIndex * 3 + 1] * 3];
-		const float* v2 = &verts[tris[triIndex * 3 + 2] * 3];
-		if (!rasterizeTri(v0, v1, v2, triAreaIDs[triIndex], heightfield, heightfield.bmin, heightfield.bmax, heightfield.cs, inverseCellSize, inverseCellHeight, flagMergeThreshold))
-		{
-			context->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
-			return false;
-		}
+		context->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
+		return false;
 	}
 
 	return true;
@@ -516,20 +1234,13 @@ bool rcRasterizeTriangles(rcContext* context,
 	rcAssert(context != NULL);
 
 	rcScopedTimer timer(context, RC_TIMER_RASTERIZE_TRIANGLES);
+	rcScopedTempArena tempArena(context);
 
 	// Rasterize the triangles.
-	const float inverseCellSize = 1.0f / heightfield.cs;
-	const float inverseCellHeight = 1.0f / heightfield.ch;
-	for (int triIndex = 0; triIndex < numTris; ++triIndex)
+	if (!rasterizeTriangles(context, rcIndexedTris<unsigned short>(verts, tris), triAreaIDs, numTris, heightfield, flagMergeThreshold))
 	{
-		const float* v0 = &verts[tris[triIndex * 3 + 0] * 3];
-		const float* v1 = &verts[tris[triIndex * 3 + 1] * 3];
-		const float* v2 = &verts[tris[triIndex * 3 + 2] * 3];
-		if (!rasterizeTri(v0, v1, v2, triAreaIDs[triIndex], heightfield, heightfield.bmin, heightfield.bmax, heightfield.cs, inverseCellSize, inverseCellHeight, flagMergeThreshold))
-		{
-			context->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
-			return false;
-		}
+		context->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
+		return false;
 	}
 
 	return true;
@@ -542,20 +1253,13 @@ bool rcRasterizeTriangles(rcContext* context,
 	rcAssert(context != NULL);
 
 	rcScopedTimer timer(context, RC_TIMER_RASTERIZE_TRIANGLES);
+	rcScopedTempArena tempArena(context);
 	
 	// Rasterize the triangles.
-	const float inverseCellSize = 1.0f / heightfield.cs;
-	const float inverseCellHeight = 1.0f / heightfield.ch;
-	for (int triIndex = 0; triIndex < numTris; ++triIndex)
+	if (!rasterizeTriangles(context, rcTriList(verts), triAreaIDs, numTris, heightfield, flagMergeThreshold))
 	{
-		const float* v0 = &verts[(triIndex * 3 + 0) * 3];
-		const float* v1 = &verts[(triIndex * 3 + 1) * 3];
-		const float* v2 = &verts[(triIndex * 3 + 2) * 3];
-		if (!rasterizeTri(v0, v1, v2, triAreaIDs[triIndex], heightfield, heightfield.bmin, heightfield.bmax, heightfield.cs, inverseCellSize, inverseCellHeight, flagMergeThreshold))
-		{
-			context->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
-			return false;
-		}
+		context->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
+		return false;
 	}
 
 	return true;
@@ -24,6 +24,7 @@
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
+#include "RecastParallel.h"
 
 namespace
 {
@@ -36,168 +37,97 @@ struct LevelStackEntry
 };
 }  // namespace
 
-static void calculateDistanceField(rcCompactHeightfield& chf, unsigned short* src, unsigned short& maxDist)
+/// Sets the distance of the spans that border a different area or a missing neighbour to zero.
+static void markBoundarySpans(const rcCompactHeightfield& chf, unsigned short* src, const int y0, const int y1)
 {
 	const int w = chf.width;
-	const int h = chf.height;
-	
-	// Init distance and points.
-	for (int i = 0; i < chf.spanCount; ++i)
-		src[i] = 0xffff;
-	
-	// Mark boundary cells.
-	for (int y = 0; y < h; ++y)
+
+	for (int y = y0; y < y1; ++y)
 	{
 		for (int x = 0; x < w; ++x)
 		{
 			const rcCompactCell& c = chf.cells[x+y*w];
 			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 			{
-				const rcCompactSpan& s = chf.spans[i];
 				const unsigned char area = chf.areas[i];
 				
 				int nc = 0;
 				for (int dir = 0; dir < 4; ++dir)
 				{
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						if (area == chf.areas[ai])
-							nc++;
-					}
+					const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+					if (ai >= 0 && area == chf.areas[ai])
+						nc++;
 				}
 				if (nc != 4)
 					src[i] = 0;
 			}
 		}
 	}
-	
-			
-	// Pass 1
-	for (int y = 0; y < h; ++y)
+}
+
+/// Lowers the distance of span i to the distance of its neighbour in the direction, plus 2,
+/// and to the distance of the diagonal neighbour one step further in the previous direction, plus 3.
+static void lowerDistance(const rcCompactHeightfield& chf, unsigned short* src, const int x, const int y, const int i, const int dir)
+{
+	const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+	if (ai < 0)
+		return;
+	if (src[ai]+2 < src[i])
+		src[i] = src[ai]+2;
+	
+	const int ax = x + rcGetDirOffsetX(dir);
+	const int ay = y + rcGetDirOffsetY(dir);
+	const int aai = rcGetNeighborSpan(chf, ax, ay, ai, (dir+3) & 0x3);
+	if (aai >= 0 && src[aai]+3 < src[i])
+		src[i] = src[aai]+3;
+}
+
+/// Propagates the distances from the (-1,0), (-1,-1), (0,-1) and (1,-1) neighbours
+/// to the cells [x0, x1) of row y, in increasing x order.
+static void sweepDistanceForward(const rcCompactHeightfield& chf, unsigned short* src, const int y, const int x0, const int x1)
+{
+	const int w = chf.width;
+
+	for (int x = x0; x < x1; ++x)
 	{
-		for (int x = 0; x < w; ++x)
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				const rcCompactSpan& s = chf.spans[i];
-				
-				if (rcGetCon(s, 0) != RC_NOT_CONNECTED)
-				{
-					// (-1,0)
-					const int ax = x + rcGetDirOffsetX(0);
-					const int ay = y + rcGetDirOffsetY(0);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 0);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (-1,-1)
-					if (rcGetCon(as, 3) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(3);
-						const int aay = ay + rcGetDirOffsetY(3);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 3);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
-				if (rcGetCon(s, 3) != RC_NOT_CONNECTED)
-				{
-					// (0,-1)
-					const int ax = x + rcGetDirOffsetX(3);
-					const int ay = y + rcGetDirOffsetY(3);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 3);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (1,-1)
-					if (rcGetCon(as, 2) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(2);
-						const int aay = ay + rcGetDirOffsetY(2);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 2);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
-			}
+			// (-1,0) and (-1,-1)
+			lowerDistance(chf, src, x, y, i, 0);
+			// (0,-1) and (1,-1)
+			lowerDistance(chf, src, x, y, i, 3);
 		}
 	}
-	
-	// Pass 2
-	for (int y = h-1; y >= 0; --y)
+}
+
+/// Propagates the distances from the (1,0), (1,1), (0,1) and (-1,1) neighbours
+/// to the cells [x0, x1) of row y, in decreasing x order.
+static void sweepDistanceBackward(const rcCompactHeightfield& chf, unsigned short* src, const int y, const int x0, const int x1)
+{
+	const int w = chf.width;
+
+	for (int x = x1-1; x >= x0; --x)
 	{
-		for (int x = w-1; x >= 0; --x)
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				const rcCompactSpan& s = chf.spans[i];
-				
-				if (rcGetCon(s, 2) != RC_NOT_CONNECTED)
-				{
-					// (1,0)
-					const int ax = x + rcGetDirOffsetX(2);
-					const int ay = y + rcGetDirOffsetY(2);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 2);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (1,1)
-					if (rcGetCon(as, 1) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(1);
-						const int aay = ay + rcGetDirOffsetY(1);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 1);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
-				if (rcGetCon(s, 1) != RC_NOT_CONNECTED)
-				{
-					// (0,1)
-					const int ax = x + rcGetDirOffsetX(1);
-					const int ay = y + rcGetDirOffsetY(1);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 1);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (-1,1)
-					if (rcGetCon(as, 0) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(0);
-						const int aay = ay + rcGetDirOffsetY(0);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 0);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
-			}
+			// (1,0) and (1,1)
+			lowerDistance(chf, src, x, y, i, 2);
+			// (0,1) and (-1,1)
+			lowerDistance(chf, src, x, y, i, 1);
 		}
-	}	
-	
-	maxDist = 0;
-	for (int i = 0; i < chf.spanCount; ++i)
-		maxDist = rcMax(src[i], maxDist);
-	
+	}
 }
 
-static unsigned short* boxBlur(rcCompactHeightfield& chf, int thr,
-							   unsigned short* src, unsigned short* dst)
+static void boxBlurRows(const rcCompactHeightfield& chf, int thr,
+						const unsigned short* src, unsigned short* dst, const int y0, const int y1)
 {
 	const int w = chf.width;
-	const int h = chf.height;
 	
 	thr *= 2;
 	
-	for (int y = 0; y < h; ++y)
+	for (int y = y0; y < y1; ++y)
 	{
 		for (int x = 0; x < w; ++x)
 		{
@@ -245,6 +175,235 @@ static unsigned short* boxBlur(rcCompactHeightfield& chf, int thr,
 			}
 		}
 	}
+}
+
+/// The number of row bands each thread processes in the parallel distance field passes.
+static const int DISTANCE_BANDS_PER_THREAD = 4;
+
+/// The size of the tiles of the parallel distance sweeps. [Units: vx]
+static const int DISTANCE_SWEEP_TILE_SIZE = 64;
+
+/// Marks the boundary spans of a band of rows.
+class rcMarkBoundaryTask : public rcParallelTask
+{
+public:
+	rcMarkBoundaryTask(const rcCompactHeightfield& chf, unsigned short* src, const int bandHeight)
+	: m_chf(chf)
+	, m_src(src)
+	, m_bandHeight(bandHeight)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		const int y0 = itemIndex * m_bandHeight;
+		markBoundarySpans(m_chf, m_src, y0, rcMin(y0 + m_bandHeight, m_chf.height));
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcMarkBoundaryTask(const rcMarkBoundaryTask&);
+	rcMarkBoundaryTask& operator=(const rcMarkBoundaryTask&);
+
+	const rcCompactHeightfield& m_chf;
+	unsigned short* m_src;
+	const int m_bandHeight;
+};
+
+/// Runs one step of a distance sweep over the field split into tiles.
+///
+/// Every cell of a sweep depends on the cells before it in the same row and on three cells of
+/// the previous row, up to one cell ahead. The tiles are bands of rows that are sheared by one
+/// cell per row, so that a tile only depends on the tile before it in the same band, and on
+/// the tile above it and the one after that in the previous band. Tile (band, column) is
+/// processed in step 2 * band + column, after all of those, which visits every cell after the
+/// cells it depends on, and gives the same result as the serial sweep.
+class rcDistanceSweepTask : public rcParallelTask
+{
+public:
+	rcDistanceSweepTask(const rcCompactHeightfield& chf, unsigned short* src, const bool backward,
+						const int step, const int firstBand)
+	: m_chf(chf)
+	, m_src(src)
+	, m_backward(backward)
+	, m_step(step)
+	, m_firstBand(firstBand)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		const int w = m_chf.width;
+		const int h = m_chf.height;
+		const int band = m_firstBand + itemIndex;
+		const int column = m_step - 2 * band;
+
+		// Rows and columns are counted in sweep order.
+		const int row0 = band * DISTANCE_SWEEP_TILE_SIZE;
+		const int row1 = rcMin(row0 + DISTANCE_SWEEP_TILE_SIZE, h);
+		for (int row = row0; row < row1; ++row)
+		{
+			const int shear = row - row0;
+			const int col0 = rcMax(column * DISTANCE_SWEEP_TILE_SIZE - shear, 0);
+			const int col1 = rcMin((column + 1) * DISTANCE_SWEEP_TILE_SIZE - shear, w);
+			if (col0 >= col1)
+				continue;
+			if (m_backward)
+				sweepDistanceBackward(m_chf, m_src, h - 1 - row, w - col1, w - col0);
+			else
+				sweepDistanceForward(m_chf, m_src, row, col0, col1);
+		}
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcDistanceSweepTask(const rcDistanceSweepTask&);
+	rcDistanceSweepTask& operator=(const rcDistanceSweepTask&);
+
+	const rcCompactHeightfield& m_chf;
+	unsigned short* m_src;
+	const bool m_backward;
+	const int m_step;
+	const int m_firstBand;
+};
+
+/// Runs a distance sweep in parallel, one diagonal of tiles at a time.
+static void sweepDistanceTiles(rcTaskScheduler* scheduler, const rcCompactHeightfield& chf, unsigned short* src, const bool backward)
+{
+	const int bandCount = (chf.height + DISTANCE_SWEEP_TILE_SIZE - 1) / DISTANCE_SWEEP_TILE_SIZE;
+	// The last band is sheared by up to a tile size minus one.
+	const int columnCount = (chf.width + DISTANCE_SWEEP_TILE_SIZE - 1) / DISTANCE_SWEEP_TILE_SIZE + 1;
+	const int stepCount = 2 * (bandCount - 1) + columnCount;
+	for (int step = 0; step < stepCount; ++step)
+	{
+		// The bands that have a tile at this step.
+		const int firstBand = rcMax(0, (step - columnCount + 2) / 2);
+		const int lastBand = rcMin(bandCount - 1, step / 2);
+		rcDistanceSweepTask task(chf, src, backward, step, firstBand);
+		rcParallelFor(scheduler, task, lastBand - firstBand + 1);
+	}
+}
+
+/// Finds the maximum distance of a range of spans.
+class rcMaxDistanceTask : public rcParallelTask
+{
+public:
+	rcMaxDistanceTask(const unsigned short* src, const int spanCount, const int blockSize, unsigned short* blockMaxDist)
+	: m_src(src)
+	, m_spanCount(spanCount)
+	, m_blockSize(blockSize)
+	, m_blockMaxDist(blockMaxDist)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		const int i0 = itemIndex * m_blockSize;
+		const int i1 = rcMin(i0 + m_blockSize, m_spanCount);
+		unsigned short maxDist = 0;
+		for (int i = i0; i < i1; ++i)
+			maxDist = rcMax(m_src[i], maxDist);
+		m_blockMaxDist[itemIndex] = maxDist;
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcMaxDistanceTask(const rcMaxDistanceTask&);
+	rcMaxDistanceTask& operator=(const rcMaxDistanceTask&);
+
+	const unsigned short* m_src;
+	const int m_spanCount;
+	const int m_blockSize;
+	unsigned short* m_blockMaxDist;
+};
+
+static void calculateDistanceField(rcTaskScheduler* scheduler, rcCompactHeightfield& chf, unsigned short* src, unsigned short& maxDist)
+{
+	const int w = chf.width;
+	const int h = chf.height;
+	const int threadCount = rcGetThreadCount(scheduler);
+	const int bandCount = rcMin(h, threadCount * DISTANCE_BANDS_PER_THREAD);
+	
+	// Init distance and points.
+	for (int i = 0; i < chf.spanCount; ++i)
+		src[i] = 0xffff;
+	
+	// Mark boundary cells.
+	if (bandCount > 0)
+	{
+		rcMarkBoundaryTask task(chf, src, (h + bandCount - 1) / bandCount);
+		rcParallelFor(scheduler, task, bandCount);
+	}
+	
+	if (threadCount > 1 && w > DISTANCE_SWEEP_TILE_SIZE && h > DISTANCE_SWEEP_TILE_SIZE)
+	{
+		sweepDistanceTiles(scheduler, chf, src, false);
+		sweepDistanceTiles(scheduler, chf, src, true);
+	}
+	else
+	{
+		// Pass 1
+		for (int y = 0; y < h; ++y)
+			sweepDistanceForward(chf, src, y, 0, w);
+		
+		// Pass 2
+		for (int y = h-1; y >= 0; --y)
+			sweepDistanceBackward(chf, src, y, 0, w);
+	}
+	
+	const int blockCount = rcMin(chf.spanCount, threadCount * DISTANCE_BANDS_PER_THREAD);
+	maxDist = 0;
+	if (blockCount > 0)
+	{
+		rcTempVector<unsigned short> blockMaxDist(blockCount, 0);
+		rcMaxDistanceTask task(src, chf.spanCount, (chf.spanCount + blockCount - 1) / blockCount, blockMaxDist.data());
+		rcParallelFor(scheduler, task, blockCount);
+		for (int i = 0; i < blockCount; ++i)
+			maxDist = rcMax(blockMaxDist[i], maxDist);
+	}
+}
+
+/// Blurs a band of rows.
+class rcBoxBlurTask : public rcParallelTask
+{
+public:
+	rcBoxBlurTask(const rcCompactHeightfield& chf, const int thr, const unsigned short* src, unsigned short* dst, const int bandHeight)
+	: m_chf(chf)
+	, m_thr(thr)
+	, m_src(src)
+	, m_dst(dst)
+	, m_bandHeight(bandHeight)
+	{
+	}
+
+	virtual void execute(int itemIndex, int /*threadIndex*/)
+	{
+		const int y0 = itemIndex * m_bandHeight;
+		boxBlurRows(m_chf, m_thr, m_src, m_dst, y0, rcMin(y0 + m_bandHeight, m_chf.height));
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcBoxBlurTask(const rcBoxBlurTask&);
+	rcBoxBlurTask& operator=(const rcBoxBlurTask&);
+
+	const rcCompactHeightfield& m_chf;
+	const int m_thr;
+	const unsigned short* m_src;
+	unsigned short* m_dst;
+	const int m_bandHeight;
+};
+
+static unsigned short* boxBlur(rcTaskScheduler* scheduler, rcCompactHeightfield& chf, int thr,
+							   unsigned short* src, unsigned short* dst)
+{
+	const int h = chf.height;
+	const int bandCount = rcMin(h, rcGetThreadCount(scheduler) * DISTANCE_BANDS_PER_THREAD);
+	if (bandCount > 0)
+	{
+		rcBoxBlurTask task(chf, thr, src, dst, (h + bandCount - 1) / bandCount);
+		rcParallelFor(scheduler, task, bandCount);
+	}
 	return dst;
 }
 
@@ -352,17 +511,25 @@ static bool floodRegion(int x, int y, int i,
 // Struct to keep track of entries in the region table that have been changed.
 struct DirtyEntry
 {
-	DirtyEntry(int index_, unsigned short region_, unsigned short distance2_)
-		: index(index_), region(region_), distance2(distance2_) {}
+	DirtyEntry(int index_, int entry_, unsigned short region_, unsigned short distance2_)
+		: index(index_), entry(entry_), region(region_), distance2(distance2_) {}
 	int index;
+	int entry;	// The index of the cell in the stack.
 	unsigned short region;
 	unsigned short distance2;
 };
+
+/// Expands the regions into the empty cells of the stack, one ring of cells per iteration.
+///
+/// A cell can only get a region in the iteration after one of its neighbours did, so only the
+/// first iteration visits the whole stack and later ones visit the cells next to the cells
+/// filled in by the previous iteration. @p stackIndices maps spans to their entry in the stack.
+/// It must be -1 for all spans on entry and is -1 for all spans again on return.
 static void expandRegions(int maxIter, unsigned short level,
 					      rcCompactHeightfield& chf,
 					      unsigned short* srcReg, unsigned short* srcDist,
 					      rcTempVector<LevelStackEntry>& stack,
-					      bool fillStack)
+					      bool fillStack, int* stackIndices)
 {
 	const int w = chf.width;
 	const int h = chf.height;
@@ -397,34 +564,37 @@ static void expandRegions(int maxIter, unsigned short level,
 		}
 	}
 
+	for (int j = 0; j < stack.size(); j++)
+	{
+		if (stack[j].index >= 0)
+			stackIndices[stack[j].index] = j;
+	}
+
 	rcTempVector<DirtyEntry> dirtyEntries;
+	rcTempVector<int> visits;
 	int iter = 0;
+	bool firstIteration = true;
 	while (stack.size() > 0)
 	{
-		int failed = 0;
 		dirtyEntries.clear();
 		
-		for (int j = 0; j < stack.size(); j++)
+		const int visitCount = firstIteration ? (int)stack.size() : (int)visits.size();
+		for (int v = 0; v < visitCount; v++)
 		{
+			const int j = firstIteration ? v : visits[v];
 			int x = stack[j].x;
 			int y = stack[j].y;
 			int i = stack[j].index;
 			if (i < 0)
-			{
-				failed++;
 				continue;
-			}
 			
 			unsigned short r = srcReg[i];
 			unsigned short d2 = 0xffff;
 			const unsigned char area = chf.areas[i];
-			const rcCompactSpan& s = chf.spans[i];
 			for (int dir = 0; dir < 4; ++dir)
 			{
-				if (rcGetCon(s, dir) == RC_NOT_CONNECTED) continue;
-				const int ax = x + rcGetDirOffsetX(dir);
-				const int ay = y + rcGetDirOffsetY(dir);
-				const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+				const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+				if (ai < 0) continue;
 				if (chf.areas[ai] != area) continue;
 				if (srcReg[ai] > 0 && (srcReg[ai] & RC_BORDER_REG) == 0)
 				{
@@ -438,13 +608,11 @@ static void expandRegions(int maxIter, unsigned short level,
 			if (r)
 			{
 				stack[j].index = -1; // mark as used
-				dirtyEntries.push_back(DirtyEntry(i, r, d2));
-			}
-			else
-			{
-				failed++;
+				stackIndices[i] = -1;
+				dirtyEntries.push_back(DirtyEntry(i, j, r, d2));
 			}
 		}
+		firstIteration = false;
 		
 		// Copy entries that differ between src and dst to keep them in sync.
 		for (int i = 0; i < dirtyEntries.size(); i++) {
@@ -453,7 +621,7 @@ static void expandRegions(int maxIter, unsigned short level,
 			srcDist[idx] = dirtyEntries[i].distance2;
 		}
 		
-		if (failed == stack.size())
+		if (dirtyEntries.size() == 0)
 			break;
 		
 		if (level > 0)
@@ -462,6 +630,36 @@ static void expandRegions(int maxIter, unsigned short level,
 			if (iter >= maxIter)
 				break;
 		}
+
+		// Find the empty cells that are connected to the cells that got a region.
+		visits.clear();
+		for (int k = 0; k < dirtyEntries.size(); k++)
+		{
+			const int i = dirtyEntries[k].index;
+			const int x = stack[dirtyEntries[k].entry].x;
+			const int y = stack[dirtyEntries[k].entry].y;
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				const int nx = x - rcGetDirOffsetX(dir);
+				const int ny = y - rcGetDirOffsetY(dir);
+				if (nx < 0 || ny < 0 || nx >= w || ny >= h)
+					continue;
+				const rcCompactCell& nc = chf.cells[nx+ny*w];
+				for (int ni = (int)nc.index, nni = (int)(nc.index+nc.count); ni < nni; ++ni)
+				{
+					if (stackIndices[ni] >= 0 && rcGetNeighborSpan(chf, nx, ny, ni, dir) == i)
+					{
+						visits.push_back(stackIndices[ni]);
+					}
+				}
+			}
+		}
+	}
+
+	for (int j = 0; j < stack.size(); j++)
+	{
+		if (stack[j].index >= 0)
+			stackIndices[stack[j].index] = -1;
 	}
 }
 
@@ -544,6 +742,44 @@ struct rcRegion
 	rcTempVector<int> floors;
 };
 
+/// Lists of region indices that can be concatenated in constant time.
+/// Used to find the regions affected by a merge without visiting all regions.
+struct rcRegionLists
+{
+	explicit rcRegionLists(int listCount) : first(listCount, -1), last(listCount, -1) {}
+
+	void add(int list, int region)
+	{
+		const int node = (int)regions.size();
+		regions.push_back(region);
+		next.push_back(-1);
+		if (last[list] == -1)
+			first[list] = node;
+		else
+			next[last[list]] = node;
+		last[list] = node;
+	}
+
+	/// Moves the items of list @p src to the end of list @p dst.
+	void moveTo(int src, int dst)
+	{
+		if (first[src] == -1)
+			return;
+		if (last[dst] == -1)
+			first[dst] = first[src];
+		else
+			next[last[dst]] = first[src];
+		last[dst] = last[src];
+		first[src] = -1;
+		last[src] = -1;
+	}
+
+	rcTempVector<int> first;
+	rcTempVector<int> last;
+	rcTempVector<int> next;
+	rcTempVector<int> regions;
+};
+
 static void removeAdjacentNeighbours(rcRegion& reg)
 {
 	// Remove adjacent duplicates.
@@ -686,15 +922,10 @@ static bool isRegionConnectedToBorder(const rcRegion& reg)
 static bool isSolidEdge(rcCompactHeightfield& chf, const unsigned short* srcReg,
 						int x, int y, int i, int dir)
 {
-	const rcCompactSpan& s = chf.spans[i];
 	unsigned short r = 0;
-	if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-	{
-		const int ax = x + rcGetDirOffsetX(dir);
-		const int ay = y + rcGetDirOffsetY(dir);
-		const int ai = (int)chf.cells[ax+ay*chf.width].index + rcGetCon(s, dir);
+	const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+	if (ai >= 0)
 		r = srcReg[ai];
-	}
 	if (r == srcReg[i])
 		return false;
 	return true;
@@ -708,33 +939,21 @@ static void walkContour(int x, int y, int i, int dir,
 	int startDir = dir;
 	int starti = i;
 
-	const rcCompactSpan& ss = chf.spans[i];
 	unsigned short curReg = 0;
-	if (rcGetCon(ss, dir) != RC_NOT_CONNECTED)
-	{
-		const int ax = x + rcGetDirOffsetX(dir);
-		const int ay = y + rcGetDirOffsetY(dir);
-		const int ai = (int)chf.cells[ax+ay*chf.width].index + rcGetCon(ss, dir);
-		curReg = srcReg[ai];
-	}
+	const int starta = rcGetNeighborSpan(chf, x, y, i, dir);
+	if (starta >= 0)
+		curReg = srcReg[starta];
 	cont.push_back(curReg);
 			
 	int iter = 0;
 	while (++iter < 40000)
 	{
-		const rcCompactSpan& s = chf.spans[i];
+		const int ai = rcGetNeighborSpan(chf, x, y, i, dir);
+		const unsigned short r = ai >= 0 ? srcReg[ai] : 0;
 		
-		if (isSolidEdge(chf, srcReg, x, y, i, dir))
+		if (r != srcReg[i])
 		{
 			// Choose the edge corner
-			unsigned short r = 0;
-			if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-			{
-				const int ax = x + rcGetDirOffsetX(dir);
-				const int ay = y + rcGetDirOffsetY(dir);
-				const int ai = (int)chf.cells[ax+ay*chf.width].index + rcGetCon(s, dir);
-				r = srcReg[ai];
-			}
 			if (r != curReg)
 			{
 				curReg = r;
@@ -745,22 +964,14 @@ static void walkContour(int x, int y, int i, int dir,
 		}
 		else
 		{
-			int ni = -1;
-			const int nx = x + rcGetDirOffsetX(dir);
-			const int ny = y + rcGetDirOffsetY(dir);
-			if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-			{
-				const rcCompactCell& nc = chf.cells[nx+ny*chf.width];
-				ni = (int)nc.index + rcGetCon(s, dir);
-			}
-			if (ni == -1)
+			if (ai == -1)
 			{
 				// Should not happen.
 				return;
 			}
-			x = nx;
-			y = ny;
-			i = ni;
+			x += rcGetDirOffsetX(dir);
+			y += rcGetDirOffsetY(dir);
+			i = ai;
 			dir = (dir+3) & 0x3;	// Rotate CCW
 		}
 		
@@ -928,6 +1139,24 @@ static bool mergeAndFilterRegions(rcContext* ctx, int minRegionArea, int mergeRe
 		}
 	}
 	
+	// The regions that carry each id, and the regions that have each id as a neighbour or floor.
+	rcRegionLists members(nreg);
+	rcRegionLists referrers(nreg);
+	for (int i = 0; i < nreg; ++i)
+	{
+		const rcRegion& reg = regions[i];
+		if (reg.id == 0 || (reg.id & RC_BORDER_REG))
+			continue;
+		members.add(reg.id, i);
+		for (int j = 0; j < reg.connections.size(); ++j)
+		{
+			if ((reg.connections[j] & RC_BORDER_REG) == 0)
+				referrers.add(reg.connections[j], i);
+		}
+		for (int j = 0; j < reg.floors.size(); ++j)
+			referrers.add(reg.floors[j], i);
+	}
+
 	// Merge too small regions to neighbour regions.
 	int mergeCount = 0 ;
 	do
@@ -971,21 +1200,33 @@ static bool mergeAndFilterRegions(rcContext* ctx, int minRegionArea, int mergeRe
 				unsigned short oldId = reg.id;
 				rcRegion& target = regions[mergeId];
 				
+				// The target inherits the neighbours and floors of the current region.
+				for (int j = 0; j < reg.connections.size(); ++j)
+				{
+					if ((reg.connections[j] & RC_BORDER_REG) == 0)
+						referrers.add(reg.connections[j], mergeId);
+				}
+				for (int j = 0; j < reg.floors.size(); ++j)
+					referrers.add(reg.floors[j], mergeId);
+
 				// Merge neighbours.
 				if (mergeRegions(target, reg))
 				{
-					// Fixup regions pointing to current region.
-					for (int j = 0; j < nreg; ++j)
+					// If another region was already merged into current region
+					// change the nid of the previous region too.
+					for (int node = members.first[oldId]; node != -1; node = members.next[node])
+						regions[members.regions[node]].id = mergeId;
+					members.moveTo(oldId, mergeId);
+
+					// Replace the current region with the new one in the regions
+					// that have it as a neighbour or floor.
+					for (int node = referrers.first[oldId]; node != -1; node = referrers.next[node])
 					{
-						if (regions[j].id == 0 || (regions[j].id & RC_BORDER_REG)) continue;
-						// If another region was already merged into current region
-						// change the nid of the previous region too.
-						if (regions[j].id == oldId)
-							regions[j].id = mergeId;
-						// Replace the current region with the new one if the
-						// current regions is neighbour.
-						replaceNeighbour(regions[j], oldId, mergeId);
+						rcRegion& refReg = regions[referrers.regions[node]];
+						if (refReg.id == 0 || (refReg.id & RC_BORDER_REG)) continue;
+						replaceNeighbour(refReg, oldId, mergeId);
 					}
+					referrers.moveTo(oldId, mergeId);
 					mergeCount++;
 				}
 			}
@@ -1002,21 +1243,18 @@ static bool mergeAndFilterRegions(rcContext* ctx, int minRegionArea, int mergeRe
 		regions[i].remap = true;
 	}
 	
+	// Ids are numbered in the order their first region appears.
+	rcTempVector<unsigned short> newIds(nreg, 0);
 	unsigned short regIdGen = 0;
 	for (int i = 0; i < nreg; ++i)
 	{
 		if (!regions[i].remap)
 			continue;
 		unsigned short oldId = regions[i].id;
-		unsigned short newId = ++regIdGen;
-		for (int j = i; j < nreg; ++j)
-		{
-			if (regions[j].id == oldId)
-			{
-				regions[j].id = newId;
-				regions[j].remap = false;
-			}
-		}
+		if (newIds[oldId] == 0)
+			newIds[oldId] = ++regIdGen;
+		regions[i].id = newIds[oldId];
+		regions[i].remap = false;
 	}
 	maxRegionId = regIdGen;
 	
@@ -1264,6 +1502,7 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_DISTANCEFIELD);
+	rcScopedTempArena tempArena(ctx);
 	
 	if (chf.dist)
 	{
@@ -1271,13 +1510,14 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 		chf.dist = 0;
 	}
 	
-	unsigned short* src = (unsigned short*)rcAlloc(sizeof(unsigned short)*chf.spanCount, RC_ALLOC_TEMP);
+	// Either buffer may end up as the distance field of the heightfield.
+	unsigned short* src = (unsigned short*)rcAlloc(sizeof(unsigned short)*chf.spanCount, RC_ALLOC_PERM);
 	if (!src)
 	{
 		ctx->log(RC_LOG_ERROR, "rcBuildDistanceField: Out of memory 'src' (%d).", chf.spanCount);
 		return false;
 	}
-	unsigned short* dst = (unsigned short*)rcAlloc(sizeof(unsigned short)*chf.spanCount, RC_ALLOC_TEMP);
+	unsigned short* dst = (unsigned short*)rcAlloc(sizeof(unsigned short)*chf.spanCount, RC_ALLOC_PERM);
 	if (!dst)
 	{
 		ctx->log(RC_LOG_ERROR, "rcBuildDistanceField: Out of memory 'dst' (%d).", chf.spanCount);
@@ -1290,7 +1530,7 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 	{
 		rcScopedTimer timerDist(ctx, RC_TIMER_BUILD_DISTANCEFIELD_DIST);
 
-		calculateDistanceField(chf, src, maxDist);
+		calculateDistanceField(ctx->getTaskScheduler(), chf, src, maxDist);
 		chf.maxDistance = maxDist;
 	}
 
@@ -1298,7 +1538,7 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 		rcScopedTimer timerBlur(ctx, RC_TIMER_BUILD_DISTANCEFIELD_BLUR);
 
 		// Blur
-		if (boxBlur(chf, 1, src, dst) != src)
+		if (boxBlur(ctx->getTaskScheduler(), chf, 1, src, dst) != src)
 			rcSwap(src, dst);
 
 		// Store distance.
@@ -1364,6 +1604,7 @@ bool rcBuildRegionsMonotone(rcContext* ctx, rcCompactHeightfield& chf,
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_REGIONS);
+	rcScopedTempArena tempArena(ctx);
 	
 	const int w = chf.width;
 	const int h = chf.height;
@@ -1537,6 +1778,7 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_REGIONS);
+	rcScopedTempArena tempArena(ctx);
 	
 	const int w = chf.width;
 	const int h = chf.height;
@@ -1558,6 +1800,14 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 
 	rcTempVector<LevelStackEntry> stack;
 	stack.reserve(256);
+
+	rcTempVector<int> stackIndices;
+	if (!stackIndices.reserve(chf.spanCount))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildRegions: Out of memory 'stackIndices' (%d).", chf.spanCount);
+		return false;
+	}
+	stackIndices.resize(chf.spanCount, -1);
 	
 	unsigned short* srcReg = buf;
 	unsigned short* srcDist = buf+chf.spanCount;
@@ -1608,7 +1858,7 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 			rcScopedTimer timerExpand(ctx, RC_TIMER_BUILD_REGIONS_EXPAND);
 
 			// Expand current regions until no empty connected cells found.
-			expandRegions(expandIters, level, chf, srcReg, srcDist, lvlStacks[sId], false);
+			expandRegions(expandIters, level, chf, srcReg, srcDist, lvlStacks[sId], false, stackIndices.data());
 		}
 		
 		{
@@ -1639,7 +1889,7 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 	}
 	
 	// Expand current regions until no empty connected cells found.
-	expandRegions(expandIters*8, 0, chf, srcReg, srcDist, stack, true);
+	expandRegions(expandIters*8, 0, chf, srcReg, srcDist, stack, true, stackIndices.data());
 	
 	ctx->stopTimer(RC_TIMER_BUILD_REGIONS_WATERSHED);
 	
@@ -1673,6 +1923,7 @@ bool rcBuildLayerRegions(rcContext* ctx, rcCompactHeightfield& chf,
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_BUILD_REGIONS);
+	rcScopedTempArena tempArena(ctx);
 	
 	const int w = chf.width;
 	const int h = chf.height;
@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef RECASTSIMD_H
+#define RECASTSIMD_H
+
+// Internal to the Recast sources, so that the build configuration of the SIMD
+// code paths does not leak into the public headers.
+
+// Use the SSE2 code paths when the compiler targets SSE2 for its scalar float math too,
+// so that both paths round the same way and produce identical results.
+#if !defined(RC_DISABLE_SIMD) && ((defined(__SSE2__) && defined(__SSE2_MATH__)) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RC_SIMD_SSE2
+#endif
+
+#ifdef RC_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#endif // RECASTSIMD_H
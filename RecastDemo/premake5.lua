@@ -79,6 +79,7 @@ libproject("Detour", {})
 libproject("DetourCrowd", {"Detour", "Recast"})
 libproject("DetourTileCache", {"Detour", "Recast"})
 libproject("DebugUtils", {"Detour", "DetourTileCache", "Recast"})
+libproject("RecastTileBuilder", {"Detour", "Recast"})
 
 project "Contrib"
 	language "C++"
@@ -154,7 +155,8 @@ project "RecastDemo"
 		linkoptions {
 			"`pkg-config --libs sdl2`",
 			"`pkg-config --libs gl`",
-			"`pkg-config --libs glu`"
+			"`pkg-config --libs glu`",
+			"-lpthread"
 		}
 
 	filter "system:windows"
@@ -206,6 +208,7 @@ project "Tests"
 		"../DetourTileCache/Include",
 		"../Recast/Include",
 		"../Recast/Source",
+		"../RecastTileBuilder/Include",
 		"../Tests/Recast",
 		"../Tests",
 		"../Tests/Contrib"
@@ -221,6 +224,7 @@ project "Tests"
 		"DetourCrowd",
 		"Detour",
 		"DetourTileCache",
+		"RecastTileBuilder",
 		"Recast",
 	}
 
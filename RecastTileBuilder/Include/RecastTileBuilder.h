@@ -0,0 +1,189 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef RECASTTILEBUILDER_H
+#define RECASTTILEBUILDER_H
+
+#include <stddef.h>
+
+#include "Recast.h"
+
+struct dtNavMeshCreateParams;
+
+/// The region partitioning method used for each tile.
+/// @see rcBuildRegions, rcBuildRegionsMonotone, rcBuildLayerRegions
+enum rcTilePartitionType
+{
+	RC_TILE_PARTITION_WATERSHED,	///< Watershed partitioning. (See: #rcBuildRegions)
+	RC_TILE_PARTITION_MONOTONE,		///< Monotone partitioning. (See: #rcBuildRegionsMonotone)
+	RC_TILE_PARTITION_LAYERS		///< Layer partitioning. (See: #rcBuildLayerRegions)
+};
+
+/// Heightfield filters applied to each tile after rasterization with #rcFilterHeightfield.
+/// @see rcTileBuildParams::filterFlags
+enum rcTileFilterFlags
+{
+	RC_TILE_FILTER_LOW_HANGING_OBSTACLES = RC_FILTER_LOW_HANGING_OBSTACLES,			///< Apply #rcFilterLowHangingWalkableObstacles.
+	RC_TILE_FILTER_LEDGE_SPANS = RC_FILTER_LEDGE_SPANS,								///< Apply #rcFilterLedgeSpans.
+	RC_TILE_FILTER_WALKABLE_LOW_HEIGHT_SPANS = RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS,	///< Apply #rcFilterWalkableLowHeightSpans.
+	RC_TILE_FILTER_ALL = RC_FILTER_ALL												///< Apply all of the filters.
+};
+
+/// Assigns polygon areas and flags to a tile before its Detour data is created.
+/// @note The tile builder calls this concurrently from all of its threads.
+struct rcTileMeshProcess
+{
+	virtual ~rcTileMeshProcess();
+
+	/// Updates the polygon areas and flags of a tile.
+	///  @param[in,out]	params		The tile creation parameters.
+	///  @param[in,out]	polyAreas	The area ids of the polygons. [Size: params->polyCount]
+	///  @param[in,out]	polyFlags	The flags of the polygons. [Size: params->polyCount]
+	virtual void process(dtNavMeshCreateParams* params, unsigned char* polyAreas, unsigned short* polyFlags) = 0;
+};
+
+/// Specifies the input geometry and options for #rcBuildNavMeshTiles.
+/// @ingroup recast
+struct rcTileBuildParams
+{
+	rcTileBuildParams();
+
+	/// @name Input Geometry
+	/// @{
+
+	const float* verts;				///< The mesh vertices. [(x, y, z) * #nverts] [Unit: wu]
+	int nverts;						///< The number of vertices.
+	const int* tris;				///< The triangle vertex indices. [(vertA, vertB, vertC) * #ntris]
+	/// The area ids of the triangles, or null to mark triangles below rcConfig::walkableSlopeAngle
+	/// as #RC_WALKABLE_AREA. [Size: #ntris]
+	const unsigned char* triAreas;
+	int ntris;						///< The number of triangles.
+
+	/// @}
+	/// @name Off-Mesh Connections (Optional)
+	/// See #dtNavMeshCreateParams for details related to these attributes.
+	/// @{
+
+	const float* offMeshConVerts;			///< Off-mesh connection vertices. [(ax, ay, az, bx, by, bz) * #offMeshConCount]
+	const float* offMeshConRad;				///< Off-mesh connection radii. [Size: #offMeshConCount]
+	const unsigned short* offMeshConFlags;	///< Off-mesh connection flags. [Size: #offMeshConCount]
+	const unsigned char* offMeshConAreas;	///< Off-mesh connection area ids. [Size: #offMeshConCount]
+	const unsigned char* offMeshConDir;		///< Off-mesh connection directions. [Size: #offMeshConCount]
+	const unsigned int* offMeshConUserID;	///< Off-mesh connection user ids. [Size: #offMeshConCount]
+	int offMeshConCount;					///< The number of off-mesh connections.
+
+	/// @}
+	/// @name Build Options
+	/// @{
+
+	rcTilePartitionType partitionType;	///< The partitioning method. [Default: #RC_TILE_PARTITION_WATERSHED]
+	int filterFlags;					///< The heightfield filters to apply. (See: #rcTileFilterFlags) [Default: #RC_TILE_FILTER_ALL]
+
+	/// True to build the neighbor span indices of the compact heightfield of each tile, which
+	/// speeds up the later build steps at the cost of 16 bytes per span. (See: #rcBuildNeighborIndices) [Default: false]
+	bool buildNeighborIndices;
+
+	/// Assigns polygon areas and flags, or null to give every walkable polygon a flag of 1.
+	rcTileMeshProcess* meshProcess;
+
+	/// The size of the arena that serves the temporary allocations of each thread, or zero
+	/// to allocate them from the heap. The arena is reset after every tile, and allocations
+	/// that do not fit fall back to the heap. (See: #rcTempArena) [Units: bytes] [Default: 0]
+	size_t tempArenaSize;
+
+	/// The build contexts to use on each thread, or null to build the tiles without
+	/// logging and timers. The first context is used by the calling thread and may be the
+	/// context passed to #rcBuildNavMeshTiles. [Size: numThreads]
+	rcContext** threadContexts;
+
+	/// @}
+};
+
+/// Navigation mesh data built for a single tile.
+struct rcNavMeshTileData
+{
+	int tx;				///< The x-position of the tile within the tile grid.
+	int ty;				///< The y-position of the tile within the tile grid. (Along the z-axis.)
+	unsigned char* data;	///< The tile data created by #dtCreateNavMeshData.
+	int dataSize;		///< The size of the tile data.
+};
+
+/// The tiles built by #rcBuildNavMeshTiles.
+///
+/// The set owns the tile data and frees it with #dtFree when destroyed.
+/// To hand a tile over to a navigation mesh, pass it to dtNavMesh::addTile
+/// with the #DT_TILE_FREE_DATA flag and set rcNavMeshTileData::data to null.
+/// @ingroup recast
+struct rcNavMeshTileSet
+{
+	rcNavMeshTileSet();
+	~rcNavMeshTileSet();
+
+	rcNavMeshTileData* tiles;	///< The non-empty tiles, ordered by row. [Size: #ntiles]
+	int ntiles;					///< The number of tiles in the set.
+	int tileWidth;				///< The width of the tile grid. (Along the x-axis.)
+	int tileHeight;				///< The height of the tile grid. (Along the z-axis.)
+
+private:
+	// Explicitly-disabled copy constructor and copy assignment operator.
+	rcNavMeshTileSet(const rcNavMeshTileSet&);
+	rcNavMeshTileSet& operator=(const rcNavMeshTileSet&);
+};
+
+/// Allocates a tile set object using the Recast allocator.
+/// @return A tile set that is ready for use, or null on failure.
+/// @ingroup recast
+/// @see rcBuildNavMeshTiles, rcFreeNavMeshTileSet
+rcNavMeshTileSet* rcAllocNavMeshTileSet();
+
+/// Frees the specified tile set, including any tile data it still owns.
+///  @param[in]		tileSet		A tile set allocated using #rcAllocNavMeshTileSet
+/// @ingroup recast
+/// @see rcAllocNavMeshTileSet
+void rcFreeNavMeshTileSet(rcNavMeshTileSet* tileSet);
+
+/// Calculates the size of the tile grid covering the bounds of the configuration.
+///  @param[in]		cfg			The build configuration. (Uses #rcConfig::bmin, #rcConfig::bmax, #rcConfig::cs
+///  							and #rcConfig::tileSize.)
+///  @param[out]	tileWidth	The width of the tile grid. (Along the x-axis.)
+///  @param[out]	tileHeight	The height of the tile grid. (Along the z-axis.)
+void rcCalcTileGridSize(const rcConfig& cfg, int* tileWidth, int* tileHeight);
+
+/// Builds the navigation mesh data for every tile of a tiled navigation mesh.
+///
+/// The tiles are built on a pool of @p numThreads threads. Every thread
+/// reuses its own scratch buffers and heightfields between tiles and logs to its own
+/// context. (See: rcTileBuildParams::threadContexts)
+/// The resulting tile data is independent of the thread count.
+///
+/// Only the shared configuration fields are used from @p cfg; rcConfig::width,
+/// rcConfig::height and the per-tile bounds are derived from rcConfig::tileSize and
+/// rcConfig::borderSize. The tile grid starts at rcConfig::bmin.
+///
+/// @ingroup recast
+///  @param[in,out]	ctx			The build context to use before and after the parallel build.
+///  @param[in]		cfg			The build configuration.
+///  @param[in]		params		The input geometry and build options.
+///  @param[in]		numThreads	The number of threads to build the tiles on. [Limit: >= 1]
+///  @param[out]	tileSet		The resulting tiles. (Must be pre-allocated.)
+///  @returns True if all tiles were built successfully. On failure the tile set
+///  	contains the tiles that did build.
+bool rcBuildNavMeshTiles(rcContext* ctx, const rcConfig& cfg, const rcTileBuildParams& params,
+						 int numThreads, rcNavMeshTileSet& tileSet);
+
+#endif // RECASTTILEBUILDER_H
@@ -0,0 +1,724 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "RecastTileBuilder.h"
+#include "Recast.h"
+#include "RecastAlloc.h"
+#include "RecastAssert.h"
+#include "RecastParallel.h"
+#include "DetourAlloc.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+
+#include <math.h>
+#include <string.h>
+
+rcTileMeshProcess::~rcTileMeshProcess()
+{
+	// Defined out of line to fix the weak v-tables warning
+}
+
+rcTileBuildParams::rcTileBuildParams()
+: verts()
+, nverts()
+, tris()
+, triAreas()
+, ntris()
+, offMeshConVerts()
+, offMeshConRad()
+, offMeshConFlags()
+, offMeshConAreas()
+, offMeshConDir()
+, offMeshConUserID()
+, offMeshConCount()
+, partitionType(RC_TILE_PARTITION_WATERSHED)
+, filterFlags(RC_TILE_FILTER_ALL)
+, buildNeighborIndices()
+, meshProcess()
+, tempArenaSize()
+, threadContexts()
+{
+}
+
+rcNavMeshTileSet* rcAllocNavMeshTileSet()
+{
+	void* mem = rcAlloc(sizeof(rcNavMeshTileSet), RC_ALLOC_PERM);
+	if (!mem)
+	{
+		return 0;
+	}
+	return ::new(rcNewTag(), mem) rcNavMeshTileSet;
+}
+
+void rcFreeNavMeshTileSet(rcNavMeshTileSet* tileSet)
+{
+	if (!tileSet)
+	{
+		return;
+	}
+	tileSet->~rcNavMeshTileSet();
+	rcFree(tileSet);
+}
+
+rcNavMeshTileSet::rcNavMeshTileSet()
+: tiles()
+, ntiles()
+, tileWidth()
+, tileHeight()
+{
+}
+
+rcNavMeshTileSet::~rcNavMeshTileSet()
+{
+	for (int i = 0; i < ntiles; ++i)
+	{
+		dtFree(tiles[i].data);
+	}
+	rcFree(tiles);
+}
+
+void rcCalcTileGridSize(const rcConfig& cfg, int* tileWidth, int* tileHeight)
+{
+	int gridWidth = 0;
+	int gridHeight = 0;
+	rcCalcGridSize(cfg.bmin, cfg.bmax, cfg.cs, &gridWidth, &gridHeight);
+	*tileWidth = (gridWidth + cfg.tileSize - 1) / cfg.tileSize;
+	*tileHeight = (gridHeight + cfg.tileSize - 1) / cfg.tileSize;
+}
+
+namespace
+{
+/// Scratch memory kept by each thread between tile builds.
+/// The heightfields are reused by the following tile builds of the thread.
+struct TileScratch
+{
+	TileScratch() : solid(0), chf(0), arena(0) {}
+	~TileScratch()
+	{
+		rcFreeHeightField(solid);
+		rcFreeCompactHeightfield(chf);
+		if (arena)
+		{
+			arena->~rcTempArena();
+			rcFree(arena);
+		}
+	}
+
+	rcTempVector<int> tris;
+	rcTempVector<unsigned char> areas;
+	rcHeightfield* solid;
+	rcCompactHeightfield* chf;
+
+	/// Serves the temporary allocations of the tile builds, or null. (See: rcTileBuildParams::tempArenaSize)
+	rcTempArena* arena;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	TileScratch(const TileScratch&);
+	TileScratch& operator=(const TileScratch&);
+};
+
+/// The scratch memory of all build threads, constructed in place.
+class TileScratchArray
+{
+public:
+	TileScratchArray() : m_data(0), m_count(0) {}
+	~TileScratchArray()
+	{
+		for (int i = 0; i < m_count; ++i)
+		{
+			m_data[i].~TileScratch();
+		}
+		rcFree(m_data);
+	}
+
+	/// Allocates and constructs the scratch memory of the threads.
+	///  @param[in]		count	The number of threads.
+	///  @return True if the memory was allocated.
+	bool init(const int count)
+	{
+		m_data = (TileScratch*)rcAlloc(sizeof(TileScratch) * count, RC_ALLOC_TEMP);
+		if (!m_data)
+		{
+			return false;
+		}
+		for (; m_count < count; ++m_count)
+		{
+			::new(rcNewTag(), &m_data[m_count]) TileScratch;
+		}
+		return true;
+	}
+
+	TileScratch& operator[](const int i) { return m_data[i]; }
+	TileScratch* data() { return m_data; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	TileScratchArray(const TileScratchArray&);
+	TileScratchArray& operator=(const TileScratchArray&);
+
+	TileScratch* m_data;
+	int m_count;
+};
+
+/// The result of building a single tile.
+struct TileResult
+{
+	unsigned char* data;
+	int dataSize;
+	bool failed;
+};
+
+/// Owns the intermediate Recast objects of a single tile build.
+struct TileObjects
+{
+	TileObjects() : cset(0), pmesh(0), dmesh(0) {}
+	~TileObjects()
+	{
+		rcFreeContourSet(cset);
+		rcFreePolyMesh(pmesh);
+		rcFreePolyMeshDetail(dmesh);
+	}
+
+	rcContourSet* cset;
+	rcPolyMesh* pmesh;
+	rcPolyMeshDetail* dmesh;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	TileObjects(const TileObjects&);
+	TileObjects& operator=(const TileObjects&);
+};
+
+/// Sorts the triangles into the tiles whose (border expanded) bounds they overlap.
+/// @param[out]	tileFirst	The index of the first triangle of each tile in @p tileTris. [Size: tw * th + 1]
+/// @param[out]	tileTris	The triangle indices, grouped by tile.
+bool binTrianglesByTile(const rcConfig& cfg, const rcTileBuildParams& params, const int tw, const int th,
+						rcTempVector<int>& tileFirst, rcTempVector<int>& tileTris)
+{
+	const float tcs = (float)cfg.tileSize * cfg.cs;
+	const float border = (float)cfg.borderSize * cfg.cs;
+	const int numTiles = tw * th;
+
+	// Tile ranges are stored as (minx, minz, maxx, maxz) per triangle, or minx = -1 if outside the grid.
+	rcTempVector<int> ranges;
+	if (!ranges.reserve(params.ntris * 4) || !tileFirst.reserve(numTiles + 1))
+	{
+		return false;
+	}
+	ranges.resize(params.ntris * 4);
+	tileFirst.resize(numTiles + 1, 0);
+
+	for (int i = 0; i < params.ntris; ++i)
+	{
+		const float* v0 = &params.verts[params.tris[i * 3 + 0] * 3];
+		const float* v1 = &params.verts[params.tris[i * 3 + 1] * 3];
+		const float* v2 = &params.verts[params.tris[i * 3 + 2] * 3];
+		const float minx = rcMin(v0[0], rcMin(v1[0], v2[0]));
+		const float minz = rcMin(v0[2], rcMin(v1[2], v2[2]));
+		const float maxx = rcMax(v0[0], rcMax(v1[0], v2[0]));
+		const float maxz = rcMax(v0[2], rcMax(v1[2], v2[2]));
+
+		int* range = &ranges[i * 4];
+		range[0] = (int)floorf((minx - cfg.bmin[0] - border) / tcs);
+		range[1] = (int)floorf((minz - cfg.bmin[2] - border) / tcs);
+		range[2] = (int)floorf((maxx - cfg.bmin[0] + border) / tcs);
+		range[3] = (int)floorf((maxz - cfg.bmin[2] + border) / tcs);
+		if (range[2] < 0 || range[3] < 0 || range[0] >= tw || range[1] >= th)
+		{
+			range[0] = -1;
+			continue;
+		}
+		range[0] = rcMax(range[0], 0);
+		range[1] = rcMax(range[1], 0);
+		range[2] = rcMin(range[2], tw - 1);
+		range[3] = rcMin(range[3], th - 1);
+
+		for (int z = range[1]; z <= range[3]; ++z)
+		{
+			for (int x = range[0]; x <= range[2]; ++x)
+			{
+				tileFirst[x + z * tw + 1]++;
+			}
+		}
+	}
+
+	for (int i = 0; i < numTiles; ++i)
+	{
+		tileFirst[i + 1] += tileFirst[i];
+	}
+
+	if (!tileTris.reserve(tileFirst[numTiles]))
+	{
+		return false;
+	}
+	tileTris.resize(tileFirst[numTiles]);
+
+	// Fill in triangle order so that each tile rasterizes its triangles in input order.
+	rcTempVector<int> fill(tileFirst.begin(), tileFirst.end() - 1);
+	for (int i = 0; i < params.ntris; ++i)
+	{
+		const int* range = &ranges[i * 4];
+		if (range[0] < 0)
+		{
+			continue;
+		}
+		for (int z = range[1]; z <= range[3]; ++z)
+		{
+			for (int x = range[0]; x <= range[2]; ++x)
+			{
+				tileTris[fill[x + z * tw]++] = i;
+			}
+		}
+	}
+
+	return true;
+}
+
+/// Builds the navigation mesh data of a single tile.
+/// @returns False if the build failed. An empty tile is not a failure and leaves @p outData null.
+bool buildTile(rcContext* ctx, const rcConfig& baseCfg, const rcTileBuildParams& params,
+			   const int tx, const int ty, const int* tileTris, const int numTileTris,
+			   TileScratch& scratch, unsigned char** outData, int* outDataSize)
+{
+	*outData = 0;
+	*outDataSize = 0;
+
+	if (numTileTris == 0)
+	{
+		return true;
+	}
+
+	rcConfig cfg = baseCfg;
+	const float tcs = (float)cfg.tileSize * cfg.cs;
+	cfg.width = cfg.tileSize + cfg.borderSize * 2;
+	cfg.height = cfg.tileSize + cfg.borderSize * 2;
+	cfg.bmin[0] = baseCfg.bmin[0] + (float)tx * tcs - (float)cfg.borderSize * cfg.cs;
+	cfg.bmin[2] = baseCfg.bmin[2] + (float)ty * tcs - (float)cfg.borderSize * cfg.cs;
+	cfg.bmax[0] = baseCfg.bmin[0] + (float)(tx + 1) * tcs + (float)cfg.borderSize * cfg.cs;
+	cfg.bmax[2] = baseCfg.bmin[2] + (float)(ty + 1) * tcs + (float)cfg.borderSize * cfg.cs;
+
+	ctx->setTimerTile(tx, ty);
+	rcScopedTimer timer(ctx, RC_TIMER_BUILD_TILE);
+
+	// Gather the triangles overlapping the tile.
+	if (!scratch.tris.reserve(numTileTris * 3) || !scratch.areas.reserve(numTileTris))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'tris' (%d).", numTileTris);
+		return false;
+	}
+	scratch.tris.resize(numTileTris * 3);
+	scratch.areas.resize(numTileTris);
+	for (int i = 0; i < numTileTris; ++i)
+	{
+		const int* tri = &params.tris[tileTris[i] * 3];
+		scratch.tris[i * 3 + 0] = tri[0];
+		scratch.tris[i * 3 + 1] = tri[1];
+		scratch.tris[i * 3 + 2] = tri[2];
+		scratch.areas[i] = params.triAreas ? params.triAreas[tileTris[i]] : RC_NULL_AREA;
+	}
+	if (!params.triAreas)
+	{
+		rcMarkWalkableTriangles(ctx, cfg.walkableSlopeAngle, params.verts, params.nverts,
+								scratch.tris.data(), numTileTris, scratch.areas.data());
+	}
+
+	TileObjects objs;
+
+	if (!scratch.solid)
+	{
+		scratch.solid = rcAllocHeightfield();
+		if (!scratch.solid)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'solid'.");
+			return false;
+		}
+	}
+	rcHeightfield& solid = *scratch.solid;
+	if (!rcCreateHeightfield(ctx, solid, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not create solid heightfield.");
+		return false;
+	}
+	if (!rcRasterizeTriangles(ctx, params.verts, params.nverts, scratch.tris.data(), scratch.areas.data(),
+							  numTileTris, solid, cfg.walkableClimb))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not rasterize tile (%d,%d).", tx, ty);
+		return false;
+	}
+
+	if (params.filterFlags & RC_TILE_FILTER_ALL)
+	{
+		rcFilterHeightfield(ctx, params.filterFlags & RC_TILE_FILTER_ALL, cfg.walkableHeight, cfg.walkableClimb, solid);
+	}
+
+	if (!scratch.chf)
+	{
+		scratch.chf = rcAllocCompactHeightfield();
+		if (!scratch.chf)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'chf'.");
+			return false;
+		}
+	}
+	rcCompactHeightfield& chf = *scratch.chf;
+	if (!rcBuildCompactHeightfield(ctx, cfg.walkableHeight, cfg.walkableClimb, solid, chf))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build compact data.");
+		return false;
+	}
+
+	if (params.buildNeighborIndices && !rcBuildNeighborIndices(ctx, chf))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build neighbor indices.");
+		return false;
+	}
+
+	if (!rcErodeWalkableArea(ctx, cfg.walkableRadius, chf))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not erode.");
+		return false;
+	}
+
+	if (params.partitionType == RC_TILE_PARTITION_WATERSHED)
+	{
+		if (!rcBuildDistanceField(ctx, chf))
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build distance field.");
+			return false;
+		}
+		if (!rcBuildRegions(ctx, chf, cfg.borderSize, cfg.minRegionArea, cfg.mergeRegionArea))
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build watershed regions.");
+			return false;
+		}
+	}
+	else if (params.partitionType == RC_TILE_PARTITION_MONOTONE)
+	{
+		if (!rcBuildRegionsMonotone(ctx, chf, cfg.borderSize, cfg.minRegionArea, cfg.mergeRegionArea))
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build monotone regions.");
+			return false;
+		}
+	}
+	else
+	{
+		if (!rcBuildLayerRegions(ctx, chf, cfg.borderSize, cfg.minRegionArea))
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build layer regions.");
+			return false;
+		}
+	}
+
+	objs.cset = rcAllocContourSet();
+	if (!objs.cset)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'cset'.");
+		return false;
+	}
+	if (!rcBuildContours(ctx, chf, cfg.maxSimplificationError, cfg.maxEdgeLen, *objs.cset))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not create contours.");
+		return false;
+	}
+	if (objs.cset->nconts == 0)
+	{
+		return true;
+	}
+
+	objs.pmesh = rcAllocPolyMesh();
+	if (!objs.pmesh)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'pmesh'.");
+		return false;
+	}
+	if (!rcBuildPolyMesh(ctx, *objs.cset, cfg.maxVertsPerPoly, *objs.pmesh))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not triangulate contours.");
+		return false;
+	}
+
+	objs.dmesh = rcAllocPolyMeshDetail();
+	if (!objs.dmesh)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'dmesh'.");
+		return false;
+	}
+	if (!rcBuildPolyMeshDetail(ctx, *objs.pmesh, chf, cfg.detailSampleDist, cfg.detailSampleMaxError, *objs.dmesh))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build detail mesh.");
+		return false;
+	}
+
+	if (objs.pmesh->npolys == 0)
+	{
+		return true;
+	}
+	if (objs.pmesh->nverts >= 0xffff)
+	{
+		// The vertex indices are ushorts, and cannot point to more than 0xffff vertices.
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Too many vertices per tile %d (max: %d).", objs.pmesh->nverts, 0xffff);
+		return false;
+	}
+
+	dtNavMeshCreateParams createParams;
+	memset(&createParams, 0, sizeof(createParams));
+	createParams.verts = objs.pmesh->verts;
+	createParams.vertCount = objs.pmesh->nverts;
+	createParams.polys = objs.pmesh->polys;
+	createParams.polyAreas = objs.pmesh->areas;
+	createParams.polyFlags = objs.pmesh->flags;
+	createParams.polyCount = objs.pmesh->npolys;
+	createParams.nvp = objs.pmesh->nvp;
+	createParams.detailMeshes = objs.dmesh->meshes;
+	createParams.detailVerts = objs.dmesh->verts;
+	createParams.detailVertsCount = objs.dmesh->nverts;
+	createParams.detailTris = objs.dmesh->tris;
+	createParams.detailTriCount = objs.dmesh->ntris;
+	createParams.offMeshConVerts = params.offMeshConVerts;
+	createParams.offMeshConRad = params.offMeshConRad;
+	createParams.offMeshConDir = params.offMeshConDir;
+	createParams.offMeshConAreas = params.offMeshConAreas;
+	createParams.offMeshConFlags = params.offMeshConFlags;
+	createParams.offMeshConUserID = params.offMeshConUserID;
+	createParams.offMeshConCount = params.offMeshConCount;
+	createParams.walkableHeight = (float)cfg.walkableHeight * cfg.ch;
+	createParams.walkableRadius = (float)cfg.walkableRadius * cfg.cs;
+	createParams.walkableClimb = (float)cfg.walkableClimb * cfg.ch;
+	createParams.tileX = tx;
+	createParams.tileY = ty;
+	createParams.tileLayer = 0;
+	rcVcopy(createParams.bmin, objs.pmesh->bmin);
+	rcVcopy(createParams.bmax, objs.pmesh->bmax);
+	createParams.cs = cfg.cs;
+	createParams.ch = cfg.ch;
+	createParams.buildBvTree = true;
+
+	if (params.meshProcess)
+	{
+		params.meshProcess->process(&createParams, objs.pmesh->areas, objs.pmesh->flags);
+	}
+	else
+	{
+		for (int i = 0; i < objs.pmesh->npolys; ++i)
+		{
+			objs.pmesh->flags[i] = objs.pmesh->areas[i] != RC_NULL_AREA ? 1 : 0;
+		}
+	}
+
+	if (!dtCreateNavMeshData(&createParams, outData, outDataSize))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Could not build Detour tile (%d,%d).", tx, ty);
+		return false;
+	}
+
+	return true;
+}
+
+/// Builds one tile per item on the thread pool.
+class TileBuildTask : public rcParallelTask
+{
+public:
+	TileBuildTask(const rcConfig& cfg, const rcTileBuildParams& params, const int tw,
+				  const int* tileFirst, const int* tileTris,
+				  rcContext** contexts, TileScratch* scratch, TileResult* results)
+	: m_cfg(cfg)
+	, m_params(params)
+	, m_tw(tw)
+	, m_tileFirst(tileFirst)
+	, m_tileTris(tileTris)
+	, m_contexts(contexts)
+	, m_scratch(scratch)
+	, m_results(results)
+	{
+	}
+
+	virtual void execute(int itemIndex, int threadIndex)
+	{
+		TileResult& result = m_results[itemIndex];
+		const int first = m_tileFirst[itemIndex];
+		const int count = m_tileFirst[itemIndex + 1] - first;
+		rcContext* ctx = m_contexts[threadIndex];
+		TileScratch& scratch = m_scratch[threadIndex];
+
+		rcTempArena* prevArena = ctx->getTempArena();
+		if (scratch.arena)
+		{
+			ctx->setTempArena(scratch.arena);
+		}
+		result.failed = !buildTile(ctx, m_cfg, m_params,
+								   itemIndex % m_tw, itemIndex / m_tw, &m_tileTris[first], count,
+								   scratch, &result.data, &result.dataSize);
+		ctx->setTimerTile(-1, -1);
+		if (scratch.arena)
+		{
+			ctx->setTempArena(prevArena);
+			// Nothing allocated from the arena outlives the tile.
+			scratch.arena->reset();
+		}
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	TileBuildTask(const TileBuildTask&);
+	TileBuildTask& operator=(const TileBuildTask&);
+
+	const rcConfig& m_cfg;
+	const rcTileBuildParams& m_params;
+	const int m_tw;
+	const int* m_tileFirst;
+	const int* m_tileTris;
+	rcContext** m_contexts;
+	TileScratch* m_scratch;
+	TileResult* m_results;
+};
+} // anonymous namespace
+
+bool rcBuildNavMeshTiles(rcContext* ctx, const rcConfig& cfg, const rcTileBuildParams& params,
+						 int numThreads, rcNavMeshTileSet& tileSet)
+{
+	rcAssert(ctx);
+	rcAssert(numThreads >= 1);
+
+	rcScopedTimer timer(ctx, RC_TIMER_TOTAL);
+
+	if (cfg.tileSize <= 0 || cfg.maxVertsPerPoly > DT_VERTS_PER_POLYGON)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Invalid tile size %d or verts per poly %d (max: %d).",
+				 cfg.tileSize, cfg.maxVertsPerPoly, DT_VERTS_PER_POLYGON);
+		return false;
+	}
+
+	int tw = 0;
+	int th = 0;
+	rcCalcTileGridSize(cfg, &tw, &th);
+	const int numTiles = tw * th;
+
+	tileSet.tileWidth = tw;
+	tileSet.tileHeight = th;
+
+	rcTempVector<int> tileFirst;
+	rcTempVector<int> tileTris;
+	if (!binTrianglesByTile(cfg, params, tw, th, tileFirst, tileTris))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'tileTris'.");
+		return false;
+	}
+
+	rcTaskScheduler* pool = numThreads > 1 ? rcAllocThreadPool(numThreads) : 0;
+	const int threadCount = rcGetThreadCount(pool);
+
+	// Threads without a user context build silently.
+	rcTempVector<rcContext> defaultContexts(threadCount, rcContext(false));
+	rcTempVector<rcContext*> contexts(threadCount);
+	for (int i = 0; i < threadCount; ++i)
+	{
+		contexts[i] = params.threadContexts ? params.threadContexts[i] : &defaultContexts[i];
+	}
+
+	TileScratchArray scratch;
+	if (!scratch.init(threadCount))
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'scratch' (%d).", threadCount);
+		rcFreeThreadPool(pool);
+		return false;
+	}
+	if (params.tempArenaSize > 0)
+	{
+		for (int i = 0; i < threadCount; ++i)
+		{
+			void* mem = rcAlloc(sizeof(rcTempArena), RC_ALLOC_PERM);
+			if (mem)
+			{
+				scratch[i].arena = ::new(rcNewTag(), mem) rcTempArena;
+			}
+			if (!scratch[i].arena || !scratch[i].arena->init(1, params.tempArenaSize))
+			{
+				ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'arena' (%d).", (int)params.tempArenaSize);
+				rcFreeThreadPool(pool);
+				return false;
+			}
+		}
+	}
+	TileResult emptyResult = { 0, 0, false };
+	rcTempVector<TileResult> results(numTiles, emptyResult);
+
+	TileBuildTask task(cfg, params, tw, tileFirst.data(), tileTris.data(), contexts.data(), scratch.data(), results.data());
+	rcParallelFor(pool, task, numTiles);
+
+	rcFreeThreadPool(pool);
+
+	// Collect the tiles in row order, so that the output does not depend on the thread count.
+	int numBuilt = 0;
+	int numFailed = 0;
+	for (int i = 0; i < numTiles; ++i)
+	{
+		if (results[i].data)
+		{
+			numBuilt++;
+		}
+		if (results[i].failed)
+		{
+			numFailed++;
+		}
+	}
+
+	for (int i = 0; i < tileSet.ntiles; ++i)
+	{
+		dtFree(tileSet.tiles[i].data);
+	}
+	rcFree(tileSet.tiles);
+	tileSet.tiles = 0;
+	tileSet.ntiles = 0;
+
+	if (numBuilt > 0)
+	{
+		tileSet.tiles = (rcNavMeshTileData*)rcAlloc(sizeof(rcNavMeshTileData) * numBuilt, RC_ALLOC_PERM);
+		if (!tileSet.tiles)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: Out of memory 'tileSet.tiles' (%d).", numBuilt);
+			for (int i = 0; i < numTiles; ++i)
+			{
+				dtFree(results[i].data);
+			}
+			return false;
+		}
+		for (int i = 0; i < numTiles; ++i)
+		{
+			if (!results[i].data)
+			{
+				continue;
+			}
+			rcNavMeshTileData& tile = tileSet.tiles[tileSet.ntiles++];
+			tile.tx = i % tw;
+			tile.ty = i / tw;
+			tile.data = results[i].data;
+			tile.dataSize = results[i].dataSize;
+		}
+	}
+
+	if (numFailed > 0)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildNavMeshTiles: %d of %d tiles failed to build.", numFailed, numTiles);
+		return false;
+	}
+
+	ctx->log(RC_LOG_PROGRESS, "rcBuildNavMeshTiles: Built %d tiles of %d x %d on %d threads.", numBuilt, tw, th, threadCount);
+
+	return true;
+}
@@ -0,0 +1,214 @@
+#include <string>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "Recast.h"
+#include "RecastDump.h"
+#include "RecastProfiler.h"
+#include "RecastTileBuilder.h"
+#include "TestGeometry.h"
+
+namespace
+{
+/// Collects the written data in a string.
+struct StringFileIO : public duFileIO
+{
+	std::string data;
+
+	virtual bool isWriting() const { return true; }
+	virtual bool isReading() const { return false; }
+	virtual bool write(const void* ptr, const size_t size)
+	{
+		data.append((const char*)ptr, size);
+		return true;
+	}
+	virtual bool read(void*, const size_t) { return false; }
+};
+
+int countOccurrences(const std::string& str, const char* pattern)
+{
+	int count = 0;
+	for (size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + 1))
+	{
+		count++;
+	}
+	return count;
+}
+
+/// Builds the tiles of a flat square with a thread for each context of the profiler.
+bool buildSquareTiles(rcContext* ctx, duBuildProfiler& profiler, int& tileWidth, int& tileHeight)
+{
+	TestGeometry geom;
+	geom.addQuad(0.0f, 0.0f, 30.0f, 30.0f, 0.0f);
+	const rcConfig cfg = makeTestConfig(geom);
+
+	rcTileBuildParams params = makeTileBuildParams(geom);
+	params.tempArenaSize = 1024 * 1024;
+	params.threadContexts = profiler.getThreadContexts();
+
+	rcCalcTileGridSize(cfg, &tileWidth, &tileHeight);
+
+	rcNavMeshTileSet* tileSet = rcAllocNavMeshTileSet();
+	const bool ok = rcBuildNavMeshTiles(ctx, cfg, params, profiler.getThreadCount(), *tileSet) && tileSet->ntiles > 0;
+	rcFreeNavMeshTileSet(tileSet);
+	return ok;
+}
+}
+
+TEST_CASE("duBuildProfiler", "[recast, profiler]")
+{
+	duBuildProfiler profiler;
+	REQUIRE(profiler.init(2));
+	REQUIRE(profiler.getThreadCount() == 2);
+
+	SECTION("Timers nest into frames")
+	{
+		duProfilerContext* ctx = profiler.getThreadContext(1);
+		REQUIRE(ctx->getThreadIndex() == 1);
+
+		ctx->setTimerTile(2, 3);
+		ctx->startTimer(RC_TIMER_TOTAL);
+		ctx->startTimer(RC_TIMER_BUILD_REGIONS);
+		ctx->startTimer(RC_TIMER_BUILD_REGIONS_FILTER);
+		ctx->stopTimer(RC_TIMER_BUILD_REGIONS_FILTER);
+		ctx->stopTimer(RC_TIMER_BUILD_REGIONS);
+		ctx->startTimer(RC_TIMER_BUILD_CONTOURS);
+		ctx->stopTimer(RC_TIMER_BUILD_CONTOURS);
+		ctx->stopTimer(RC_TIMER_TOTAL);
+		ctx->setTimerTile(-1, -1);
+		ctx->startTimer(RC_TIMER_TOTAL);
+		ctx->startTimer(RC_TIMER_TOTAL);
+		ctx->stopTimer(RC_TIMER_TOTAL);
+		ctx->stopTimer(RC_TIMER_TOTAL);
+
+		REQUIRE(ctx->getEventCount() == 6);
+		const int expectedParents[6] = { -1, 0, 1, 0, -1, 4 };
+		const int expectedDepths[6] = { 0, 1, 2, 1, 0, 1 };
+		const int expectedFrames[6] = { 0, 0, 0, 0, 1, 1 };
+		for (int i = 0; i < ctx->getEventCount(); ++i)
+		{
+			const duProfileEvent& event = ctx->getEvent(i);
+			REQUIRE(event.parent == expectedParents[i]);
+			REQUIRE(event.depth == expectedDepths[i]);
+			REQUIRE(event.frame == expectedFrames[i]);
+			REQUIRE(event.duration >= 0);
+			REQUIRE(event.tx == (i < 4 ? 2 : -1));
+			REQUIRE(event.ty == (i < 4 ? 3 : -1));
+			REQUIRE(event.nested == (i == 5));
+		}
+		REQUIRE(ctx->getEvent(1).start >= ctx->getEvent(0).start);
+		REQUIRE(ctx->getEvent(0).duration >= ctx->getEvent(1).duration + ctx->getEvent(3).duration);
+		REQUIRE(ctx->getAccumulatedTime(RC_TIMER_TOTAL) >= 0);
+		REQUIRE(ctx->getAccumulatedTime(RC_TIMER_RASTERIZE_TRIANGLES) == -1);
+
+		duProfileStats stats;
+		REQUIRE(profiler.getStats(RC_TIMER_TOTAL, stats));
+		REQUIRE(stats.count == 2);
+		REQUIRE(stats.p50 <= stats.max);
+		REQUIRE(stats.total >= stats.max);
+		REQUIRE(profiler.getStats(RC_TIMER_BUILD_REGIONS_FILTER, stats));
+		REQUIRE(stats.count == 1);
+		REQUIRE(!profiler.getStats(RC_TIMER_RASTERIZE_TRIANGLES, stats));
+
+		profiler.reset();
+		REQUIRE(ctx->getEventCount() == 0);
+	}
+
+	SECTION("A scope that is not stopped ends with its parent")
+	{
+		duProfilerContext* ctx = profiler.getThreadContext(0);
+		ctx->startTimer(RC_TIMER_TOTAL);
+		ctx->startTimer(RC_TIMER_TEMP);
+		ctx->stopTimer(RC_TIMER_BUILD_LAYERS);
+		ctx->stopTimer(RC_TIMER_TOTAL);
+		REQUIRE(ctx->getEventCount() == 2);
+		REQUIRE(ctx->getEvent(1).duration >= 0);
+		REQUIRE(ctx->getEvent(0).duration >= ctx->getEvent(1).duration);
+	}
+
+	SECTION("Tile builds are profiled per thread and tile")
+	{
+		int tileWidth = 0;
+		int tileHeight = 0;
+		rcContext ctx(false);
+		REQUIRE(buildSquareTiles(&ctx, profiler, tileWidth, tileHeight));
+
+		duProfileStats stats;
+		REQUIRE(profiler.getStats(RC_TIMER_BUILD_TILE, stats));
+		REQUIRE(stats.count == tileWidth * tileHeight);
+		duProfileStats totalStats;
+		REQUIRE(!profiler.getStats(RC_TIMER_TOTAL, totalStats));
+		// Tiles without walkable triangles end before the regions are built.
+		duProfileStats regionStats;
+		REQUIRE(profiler.getStats(RC_TIMER_BUILD_REGIONS, regionStats));
+		REQUIRE(regionStats.count > 0);
+		REQUIRE(regionStats.count <= stats.count);
+		REQUIRE(regionStats.maxTempMemory > 0);
+
+		int numEvents = 0;
+		std::vector<int> tileFrames(tileWidth * tileHeight, 0);
+		for (int i = 0; i < profiler.getThreadCount(); ++i)
+		{
+			const duProfilerContext* threadCtx = profiler.getThreadContext(i);
+			for (int j = 0; j < threadCtx->getEventCount(); ++j)
+			{
+				const duProfileEvent& event = threadCtx->getEvent(j);
+				REQUIRE(event.tx >= 0);
+				REQUIRE(event.tx < tileWidth);
+				REQUIRE(event.ty >= 0);
+				REQUIRE(event.ty < tileHeight);
+				if (event.parent == -1)
+				{
+					tileFrames[event.tx + event.ty * tileWidth]++;
+				}
+				numEvents++;
+			}
+		}
+		for (int i = 0; i < tileWidth * tileHeight; ++i)
+		{
+			REQUIRE(tileFrames[i] == 1);
+		}
+
+		StringFileIO io;
+		REQUIRE(profiler.writeChromeTrace(&io));
+		REQUIRE(io.data.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[") == 0);
+		REQUIRE(io.data.substr(io.data.size() - 4) == "\n]}\n");
+		REQUIRE(countOccurrences(io.data, "\"ph\":\"X\"") == numEvents);
+		REQUIRE(countOccurrences(io.data, "\"ph\":\"M\"") == profiler.getThreadCount());
+		REQUIRE(countOccurrences(io.data, "\"name\":\"Build Regions\"") == regionStats.count);
+	}
+
+	SECTION("The calling thread can share its context with the tile builds")
+	{
+		duProfilerContext* ctx = profiler.getThreadContext(0);
+		int tileWidth = 0;
+		int tileHeight = 0;
+		REQUIRE(buildSquareTiles(ctx, profiler, tileWidth, tileHeight));
+
+		// The tiles of the calling thread are nested in the total build time.
+		duProfileStats stats;
+		REQUIRE(profiler.getStats(RC_TIMER_TOTAL, stats));
+		REQUIRE(stats.count == 1);
+		REQUIRE(ctx->getEventCount() > 0);
+		const duProfileEvent& total = ctx->getEvent(0);
+		REQUIRE(total.label == RC_TIMER_TOTAL);
+		REQUIRE(total.parent == -1);
+		int numTiles = 0;
+		for (int i = 0; i < profiler.getThreadCount(); ++i)
+		{
+			const duProfilerContext* threadCtx = profiler.getThreadContext(i);
+			for (int j = 0; j < threadCtx->getEventCount(); ++j)
+			{
+				const duProfileEvent& event = threadCtx->getEvent(j);
+				if (event.label != RC_TIMER_BUILD_TILE)
+				{
+					continue;
+				}
+				REQUIRE(event.parent == (i == 0 ? 0 : -1));
+				numTiles++;
+			}
+		}
+		REQUIRE(numTiles == tileWidth * tileHeight);
+	}
+}
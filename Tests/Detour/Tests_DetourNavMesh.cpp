@@ -0,0 +1,81 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "TestNavMesh.h"
+
+TEST_CASE("dtNavMesh shared tiles", "[detour]")
+{
+	dtNavMesh* source = buildGapNavMesh();
+	REQUIRE(source != NULL);
+
+	std::vector<dtPolyRef> expectedPath;
+	const std::vector<float> expectedStraightPath = findGapPath(source, expectedPath);
+
+	dtNavMesh* shared = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(shared->initShared(source)));
+
+	SECTION("Geometry is shared and links are not")
+	{
+		const dtNavMesh* constSource = source;
+		const dtNavMesh* constShared = shared;
+		int tileCount = 0;
+		for (int i = 0; i < source->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = constSource->getTile(i);
+			if (!tile->header)
+			{
+				continue;
+			}
+			tileCount++;
+			const dtMeshTile* sharedTile = constShared->getTile(i);
+			REQUIRE(shared->getTileRef(sharedTile) == source->getTileRef(tile));
+			REQUIRE(sharedTile->data == tile->data);
+			REQUIRE(sharedTile->header == tile->header);
+			REQUIRE(sharedTile->detailMeshes == tile->detailMeshes);
+			REQUIRE(sharedTile->detailVerts == tile->detailVerts);
+			REQUIRE(sharedTile->bvTree == tile->bvTree);
+			REQUIRE(sharedTile->links != tile->links);
+			REQUIRE(sharedTile->polys != tile->polys);
+			REQUIRE(sharedTile->dynamicData != NULL);
+			if (tile->header->offMeshConCount == 0)
+			{
+				REQUIRE(sharedTile->verts == tile->verts);
+			}
+		}
+		REQUIRE(tileCount > 1);
+
+		std::vector<dtPolyRef> sharedPath;
+		REQUIRE(findGapPath(shared, sharedPath) == expectedStraightPath);
+		REQUIRE(sharedPath == expectedPath);
+	}
+
+	SECTION("Tiles can be modified independently")
+	{
+		// Exclude the polygons of the start tile in the shared mesh only.
+		const dtMeshTile* tile = NULL;
+		const dtPoly* poly = NULL;
+		REQUIRE(dtStatusSucceed(shared->getTileAndPolyByRef(expectedPath[0], &tile, &poly)));
+		const dtPolyRef base = shared->getPolyRefBase(tile);
+		for (int i = 0; i < tile->header->polyCount; ++i)
+		{
+			REQUIRE(dtStatusSucceed(shared->setPolyFlags(base | (dtPolyRef)i, 0)));
+		}
+		unsigned short flags = 0;
+		REQUIRE(dtStatusSucceed(source->getPolyFlags(expectedPath[0], &flags)));
+		REQUIRE(flags != 0);
+
+		// Removing the tile from the shared mesh keeps it in the source.
+		REQUIRE(dtStatusSucceed(shared->removeTile(shared->getTileRef(tile), NULL, NULL)));
+		std::vector<dtPolyRef> sourcePath;
+		REQUIRE(findGapPath(source, sourcePath) == expectedStraightPath);
+		REQUIRE(sourcePath == expectedPath);
+	}
+
+	dtFreeNavMesh(shared);
+	dtFreeNavMesh(source);
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshFile.h"
+#include "DetourNavMeshQuery.h"
+#include "TestNavMesh.h"
+
+TEST_CASE("dtNavMesh file", "[detour, file]")
+{
+	dtNavMesh* navMesh = buildGapNavMesh();
+	REQUIRE(navMesh != NULL);
+
+	std::vector<dtPolyRef> expectedPath;
+	const std::vector<float> expectedStraightPath = findGapPath(navMesh, expectedPath);
+
+	const char* path = "Tests_DetourNavMeshFile.bin";
+	REQUIRE(dtStatusSucceed(dtSaveNavMeshFile(navMesh, path)));
+
+	dtNavMeshFileMapping mapping;
+	REQUIRE(dtStatusSucceed(dtMapNavMeshFile(path, &mapping)));
+
+	SECTION("Tiles are used in place from the read-only mapping")
+	{
+		dtNavMesh* mapped = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(dtInitNavMeshFromFile(mapped, mapping.data, mapping.dataSize)));
+
+		const dtNavMesh* constNavMesh = navMesh;
+		const dtNavMesh* constMapped = mapped;
+		int tileCount = 0;
+		for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = constNavMesh->getTile(i);
+			if (!tile->header)
+			{
+				continue;
+			}
+			tileCount++;
+			const dtMeshTile* mappedTile = constMapped->getTileAt(tile->header->x, tile->header->y, tile->header->layer);
+			REQUIRE(mappedTile != NULL);
+			REQUIRE(mapped->getTileRef(mappedTile) == navMesh->getTileRef(tile));
+			REQUIRE((mappedTile->flags & DT_TILE_READONLY_DATA) != 0);
+			REQUIRE(mappedTile->data >= mapping.data);
+			REQUIRE(mappedTile->data < mapping.data + mapping.dataSize);
+			REQUIRE(memcmp(mappedTile->verts, tile->verts, sizeof(float) * 3 * tile->header->vertCount) == 0);
+		}
+		REQUIRE(tileCount > 1);
+
+		// The same paths are found, including the off-mesh connection across the gap.
+		std::vector<dtPolyRef> mappedPath;
+		REQUIRE(findGapPath(mapped, mappedPath) == expectedStraightPath);
+		REQUIRE(mappedPath == expectedPath);
+
+		dtFreeNavMesh(mapped);
+	}
+
+	SECTION("Several navmeshes can share the mapping")
+	{
+		dtNavMesh* first = dtAllocNavMesh();
+		dtNavMesh* second = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(dtInitNavMeshFromFile(first, mapping.data, mapping.dataSize)));
+		REQUIRE(dtStatusSucceed(dtInitNavMeshFromFile(second, mapping.data, mapping.dataSize)));
+
+		// Removing a tile from one navmesh does not affect the other.
+		const dtTileRef tileRef = first->getTileRefAt(0, 0, 0);
+		REQUIRE(tileRef != 0);
+		REQUIRE(dtStatusSucceed(first->removeTile(tileRef, NULL, NULL)));
+		dtFreeNavMesh(first);
+
+		std::vector<dtPolyRef> secondPath;
+		REQUIRE(findGapPath(second, secondPath) == expectedStraightPath);
+		dtFreeNavMesh(second);
+	}
+
+	SECTION("Rejects invalid data")
+	{
+		std::vector<unsigned char> data(mapping.data, mapping.data + mapping.dataSize);
+
+		// Loads the data into a new navmesh and returns the number of tiles left in it.
+		const auto load = [&](const size_t dataSize, dtStatus* status) {
+			dtNavMesh* mesh = dtAllocNavMesh();
+			*status = dtInitNavMeshFromFile(mesh, data.data(), dataSize);
+			const dtNavMesh* constMesh = mesh;
+			int tileCount = 0;
+			for (int i = 0; i < constMesh->getMaxTiles(); ++i)
+			{
+				if (constMesh->getTile(i)->header)
+				{
+					tileCount++;
+				}
+			}
+			dtFreeNavMesh(mesh);
+			return tileCount;
+		};
+
+		dtStatus status = 0;
+		load(sizeof(dtNavMeshFileHeader) - 1, &status);
+		REQUIRE(dtStatusDetail(status, DT_INVALID_PARAM));
+
+		// Truncated tile data. The tiles added before the bad tile are removed again.
+		REQUIRE(load(data.size() - 1, &status) == 0);
+		REQUIRE(dtStatusFailed(status));
+
+		// A tile offset outside of the data.
+		const dtNavMeshFileHeader* header = (const dtNavMeshFileHeader*)data.data();
+		REQUIRE(header->tileCount > 1);
+		dtNavMeshFileTile* index = (dtNavMeshFileTile*)(data.data() + sizeof(dtNavMeshFileHeader));
+		const unsigned int dataOffsetHigh = index[header->tileCount - 1].dataOffsetHigh;
+		index[header->tileCount - 1].dataOffsetHigh = 0xffffffff;
+		REQUIRE(load(data.size(), &status) == 0);
+		REQUIRE(dtStatusDetail(status, DT_INVALID_PARAM));
+		index[header->tileCount - 1].dataOffsetHigh = dataOffsetHigh;
+		REQUIRE(load(data.size(), &status) == header->tileCount);
+		REQUIRE(dtStatusSucceed(status));
+
+		data[0] ^= 0xff;
+		load(data.size(), &status);
+		REQUIRE(dtStatusDetail(status, DT_WRONG_MAGIC));
+	}
+
+	dtUnmapNavMeshFile(&mapping);
+	REQUIRE(mapping.data == NULL);
+	remove(path);
+	dtFreeNavMesh(navMesh);
+}
@@ -0,0 +1,160 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshHierarchy.h"
+#include "DetourNavMeshQuery.h"
+#include "TestNavMesh.h"
+
+namespace
+{
+/// A flat square with a wall across it that has a gap at one end.
+TestGeometry makeWall()
+{
+	TestGeometry geom;
+	geom.addBox(0.0f, 0.0f, 60.0f, 60.0f, -0.5f, 0.0f);
+	geom.addBox(0.0f, 29.0f, 52.0f, 31.0f, -0.5f, 3.0f);
+	return geom;
+}
+
+bool arePolysConnected(const dtNavMesh* navMesh, dtPolyRef from, dtPolyRef to)
+{
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	navMesh->getTileAndPolyByRefUnsafe(from, &tile, &poly);
+	for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+	{
+		if (tile->links[i].ref == to)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+}
+
+TEST_CASE("dtNavMeshHierarchy", "[detour, hierarchy]")
+{
+	dtNavMesh* navMesh = buildTestNavMesh(makeWall());
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(dtStatusSucceed(query->init(navMesh, 4096)));
+
+	dtQueryFilter filter;
+	dtNavMeshHierarchy* hierarchy = dtAllocNavMeshHierarchy();
+	REQUIRE(dtStatusSucceed(hierarchy->init(navMesh, &filter, 4096)));
+	REQUIRE(hierarchy->getPortalCount() > 0);
+
+	const float halfExtents[3] = { 2.0f, 4.0f, 2.0f };
+	const float startQuery[3] = { 5.0f, 0.0f, 55.0f };
+	const float endQuery[3] = { 5.0f, 0.0f, 5.0f };
+	dtPolyRef startRef = 0;
+	dtPolyRef endRef = 0;
+	float startPos[3];
+	float endPos[3];
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(startQuery, halfExtents, &filter, &startRef, startPos)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(endQuery, halfExtents, &filter, &endRef, endPos)));
+	REQUIRE(startRef != 0);
+	REQUIRE(endRef != 0);
+
+	const int maxPath = 512;
+	dtPolyRef path[maxPath];
+	int pathCount = 0;
+
+	SECTION("Finds a connected path around the wall")
+	{
+		int routeCount = 0;
+		const dtStatus status = hierarchy->findPath(query, startRef, endRef, startPos, endPos, path, &pathCount, maxPath, &routeCount);
+		REQUIRE(dtStatusSucceed(status));
+		REQUIRE(!dtStatusDetail(status, DT_PARTIAL_RESULT));
+		REQUIRE(routeCount > 1);
+		REQUIRE(pathCount > 1);
+		REQUIRE(path[0] == startRef);
+		REQUIRE(path[pathCount - 1] == endRef);
+		for (int i = 0; i + 1 < pathCount; ++i)
+		{
+			REQUIRE(arePolysConnected(navMesh, path[i], path[i + 1]));
+		}
+
+		// The path has to go through the gap at the end of the wall.
+		float pathMaxX = 0.0f;
+		for (int i = 0; i < pathCount; ++i)
+		{
+			float center[3] = { 0, 0, 0 };
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			navMesh->getTileAndPolyByRefUnsafe(path[i], &tile, &poly);
+			for (int j = 0; j < (int)poly->vertCount; ++j)
+			{
+				dtVadd(center, center, &tile->verts[poly->verts[j] * 3]);
+			}
+			pathMaxX = dtMax(pathMaxX, center[0] / (float)poly->vertCount);
+		}
+		REQUIRE(pathMaxX > 50.0f);
+	}
+
+	SECTION("Only rebuilds tiles that changed")
+	{
+		int updatedTileCount = -1;
+		REQUIRE(dtStatusSucceed(hierarchy->update(&updatedTileCount)));
+		REQUIRE(updatedTileCount == 0);
+
+		const int portalCount = hierarchy->getPortalCount();
+
+		// Remove the start tile and put it back.
+		int tx = 0;
+		int ty = 0;
+		navMesh->calcTileLoc(startPos, &tx, &ty);
+		const dtMeshTile* tile = navMesh->getTileAt(tx, ty, 0);
+		REQUIRE(tile != NULL);
+		const dtTileRef tileRef = navMesh->getTileRef(tile);
+
+		// The navmesh frees the tile data on removal, so keep a copy.
+		const int dataSize = tile->dataSize;
+		unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+		memcpy(data, tile->data, dataSize);
+		REQUIRE(dtStatusSucceed(navMesh->removeTile(tileRef, NULL, NULL)));
+		REQUIRE(dtStatusSucceed(hierarchy->update(&updatedTileCount)));
+		REQUIRE(updatedTileCount == 1);
+		REQUIRE(hierarchy->getPortalCount() < portalCount);
+
+		REQUIRE(dtStatusSucceed(navMesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		REQUIRE(dtStatusSucceed(hierarchy->update(&updatedTileCount)));
+		REQUIRE(updatedTileCount == 1);
+		REQUIRE(hierarchy->getPortalCount() == portalCount);
+
+		// The start polygon has a new reference after the tile was added again.
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(startQuery, halfExtents, &filter, &startRef, startPos)));
+		int routeCount = 0;
+		const dtStatus status = hierarchy->findPath(query, startRef, endRef, startPos, endPos, path, &pathCount, maxPath, &routeCount);
+		REQUIRE(dtStatusSucceed(status));
+		REQUIRE(!dtStatusDetail(status, DT_PARTIAL_RESULT));
+		REQUIRE(routeCount > 1);
+		REQUIRE(path[0] == startRef);
+		REQUIRE(path[pathCount - 1] == endRef);
+	}
+
+	SECTION("Searches paths within a tile directly")
+	{
+		const float nearQuery[3] = { 8.0f, 0.0f, 52.0f };
+		dtPolyRef nearRef = 0;
+		float nearPos[3];
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(nearQuery, halfExtents, &filter, &nearRef, nearPos)));
+		REQUIRE(navMesh->decodePolyIdTile(nearRef) == navMesh->decodePolyIdTile(startRef));
+
+		int routeCount = -1;
+		const dtStatus status = hierarchy->findPath(query, startRef, nearRef, startPos, nearPos, path, &pathCount, maxPath, &routeCount);
+		REQUIRE(dtStatusSucceed(status));
+		REQUIRE(routeCount == 0);
+		REQUIRE(path[0] == startRef);
+		REQUIRE(path[pathCount - 1] == nearRef);
+	}
+
+	dtFreeNavMeshHierarchy(hierarchy);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navMesh);
+}
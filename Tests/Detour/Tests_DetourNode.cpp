@@ -0,0 +1,110 @@
+#include "DetourNode.h"
+#include "DetourNavMeshQuery.h"
+#include "catch2/catch_amalgamated.hpp"
+
+TEST_CASE("dtNodeQueue")
+{
+	const int numNodes = 200;
+	dtNodePool pool(numNodes, 64);
+	dtNodeQueue queue(numNodes);
+
+	for (int i = 0; i < numNodes; ++i)
+	{
+		dtNode* node = pool.getNode((dtPolyRef)(i + 1));
+		REQUIRE(node);
+		// Scatter the costs so the heap has to reorder them.
+		node->total = (float)((i * 7919) % numNodes) + 1000.0f;
+		node->flags = DT_NODE_OPEN;
+		queue.push(node);
+	}
+
+	SECTION("Pops nodes in order of total cost")
+	{
+		float last = 0.0f;
+		while (!queue.empty())
+		{
+			dtNode* node = queue.pop();
+			REQUIRE(node->total >= last);
+			last = node->total;
+		}
+	}
+
+	SECTION("Decreasing the cost of queued nodes moves them to the front")
+	{
+		// Lower the cost of every third node below any existing cost, in reverse order.
+		for (int i = numNodes - 1; i >= 0; i -= 3)
+		{
+			dtNode* node = pool.findNode((dtPolyRef)(i + 1), 0);
+			REQUIRE(node);
+			node->total = (float)i;
+			queue.modify(node);
+		}
+
+		float last = -1.0f;
+		int count = 0;
+		while (!queue.empty())
+		{
+			dtNode* node = queue.pop();
+			REQUIRE(node->total >= last);
+			last = node->total;
+			count++;
+		}
+		REQUIRE(count == numNodes);
+	}
+}
+
+TEST_CASE("dtNodePool")
+{
+	const int numNodes = 64;
+	dtNodePool pool(numNodes, 16);
+
+	SECTION("Nodes are not found after clearing the pool")
+	{
+		for (int round = 0; round < 3; ++round)
+		{
+			for (int i = 0; i < numNodes; ++i)
+			{
+				REQUIRE(pool.findNode((dtPolyRef)(i + 1), 0) == NULL);
+				dtNode* node = pool.getNode((dtPolyRef)(i + 1));
+				REQUIRE(node);
+				REQUIRE(pool.getNode((dtPolyRef)(i + 1)) == node);
+			}
+			REQUIRE(pool.getNodeCount() == numNodes);
+			REQUIRE(pool.getNode((dtPolyRef)(numNodes + 1)) == NULL);
+
+			pool.clear();
+			REQUIRE(pool.getNodeCount() == 0);
+			for (int i = 0; i < pool.getHashSize(); ++i)
+			{
+				REQUIRE(pool.getFirst(i) == DT_NULL_IDX);
+			}
+		}
+	}
+}
+
+TEST_CASE("dtNavMeshQuery node limit")
+{
+	dtNavMeshQuery query;
+
+	SECTION("Rejects pools larger than the node index type can address")
+	{
+		REQUIRE(dtStatusFailed(query.init(NULL, 0)));
+		REQUIRE(dtStatusFailed(query.init(NULL, DT_MAX_NODES + 1)));
+	}
+
+#ifdef DT_NODEINDEX32
+	SECTION("Supports more than 65535 nodes with 32bit node indices")
+	{
+		const int numNodes = 100000;
+		REQUIRE(dtStatusSucceed(query.init(NULL, numNodes)));
+
+		dtNodePool* pool = query.getNodePool();
+		for (int i = 0; i < numNodes; ++i)
+		{
+			REQUIRE(pool->getNode((dtPolyRef)(i + 1)));
+		}
+		REQUIRE(pool->getNodeCount() == numNodes);
+		REQUIRE(pool->findNode((dtPolyRef)numNodes, 0) == pool->getNodeAtIdx(numNodes));
+	}
+#endif
+}
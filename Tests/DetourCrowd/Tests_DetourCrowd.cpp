@@ -0,0 +1,144 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourCommon.h"
+#include "DetourCrowd.h"
+#include "DetourNavMesh.h"
+#include "DetourObstacleAvoidance.h"
+#include "TestAlloc.h"
+#include "TestNavMesh.h"
+#include "TestParallel.h"
+
+namespace
+{
+/// A flat square with a pillar in the middle.
+TestGeometry makePillar()
+{
+	TestGeometry geom;
+	geom.addBox(0.0f, 0.0f, 30.0f, 30.0f, -0.5f, 0.0f);
+	geom.addBox(13.0f, 13.0f, 17.0f, 17.0f, -0.5f, 3.0f);
+	return geom;
+}
+
+/// A scheduler change that fails because of a failed allocation.
+struct FailedScheduler
+{
+	dtTaskScheduler* scheduler;
+	int allocCount;		///< The number of allocations of @p allocSize that succeed before one fails.
+	size_t allocSize;
+};
+
+/// Runs a crowd of agents that cross the pillar and returns their positions and velocities.
+std::vector<float> simulateCrowd(dtNavMesh* navMesh, dtTaskScheduler* scheduler, int* velocitySampleCount,
+								 const FailedScheduler* failedScheduler = NULL)
+{
+	const int gridSize = 8;
+	const int maxAgents = gridSize * gridSize;
+
+	dtCrowd* crowd = dtAllocCrowd();
+	REQUIRE(crowd->init(maxAgents, 0.6f, navMesh));
+	REQUIRE(crowd->setTaskScheduler(scheduler));
+	if (failedScheduler)
+	{
+		TestFailingDetourAlloc failingAlloc(failedScheduler->allocCount, failedScheduler->allocSize);
+		REQUIRE(!crowd->setTaskScheduler(failedScheduler->scheduler));
+		REQUIRE(TestFailingDetourAlloc::hasFailed());
+	}
+	REQUIRE(crowd->getTaskScheduler() == scheduler);
+
+	dtCrowdAgentParams params;
+	memset(&params, 0, sizeof(params));
+	params.radius = 0.6f;
+	params.height = 2.0f;
+	params.maxAcceleration = 8.0f;
+	params.maxSpeed = 3.5f;
+	params.collisionQueryRange = params.radius * 12.0f;
+	params.pathOptimizationRange = params.radius * 30.0f;
+	params.separationWeight = 2.0f;
+	params.updateFlags = DT_CROWD_ANTICIPATE_TURNS | DT_CROWD_OPTIMIZE_VIS | DT_CROWD_OPTIMIZE_TOPO |
+		DT_CROWD_OBSTACLE_AVOIDANCE | DT_CROWD_SEPARATION;
+
+	const dtNavMeshQuery* navQuery = crowd->getNavMeshQuery();
+	const dtQueryFilter* filter = crowd->getFilter(0);
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			const float pos[3] = { 3.0f + x * 1.5f, 0.0f, 3.0f + z * 1.5f };
+			const int idx = crowd->addAgent(pos, &params);
+			REQUIRE(idx != -1);
+
+			const float target[3] = { 27.0f - z * 1.5f, 0.0f, 27.0f - x * 1.5f };
+			dtPolyRef targetRef = 0;
+			float targetPos[3];
+			navQuery->findNearestPoly(target, crowd->getQueryHalfExtents(), filter, &targetRef, targetPos);
+			REQUIRE(targetRef != 0);
+			REQUIRE(crowd->requestMoveTarget(idx, targetRef, targetPos));
+		}
+	}
+
+	*velocitySampleCount = 0;
+	for (int i = 0; i < 100; ++i)
+	{
+		crowd->update(0.05f, NULL);
+		*velocitySampleCount += crowd->getVelocitySampleCount();
+	}
+
+	std::vector<float> state;
+	for (int i = 0; i < crowd->getAgentCount(); ++i)
+	{
+		const dtCrowdAgent* ag = crowd->getAgent(i);
+		state.insert(state.end(), ag->npos, ag->npos + 3);
+		state.insert(state.end(), ag->vel, ag->vel + 3);
+	}
+
+	dtFreeCrowd(crowd);
+	return state;
+}
+}
+
+TEST_CASE("dtCrowd parallel update", "[crowd]")
+{
+	dtNavMesh* navMesh = buildTestNavMesh(makePillar());
+
+	int serialSampleCount = 0;
+	const std::vector<float> serial = simulateCrowd(navMesh, NULL, &serialSampleCount);
+	REQUIRE(serialSampleCount > 0);
+
+	SECTION("Agents move the same way regardless of the thread count")
+	{
+		forEachThreadPool(NULL, [&](TestThreadPool& pool) {
+			int parallelSampleCount = 0;
+			const std::vector<float> parallel = simulateCrowd(navMesh, pool.getDetourScheduler(), &parallelSampleCount);
+			REQUIRE(parallelSampleCount == serialSampleCount);
+			REQUIRE(parallel.size() == serial.size());
+			REQUIRE(sameData(parallel.data(), serial.data(), (int)serial.size()));
+		});
+	}
+
+	SECTION("A failed scheduler change keeps the previous scheduler")
+	{
+		TestThreadPool pool(2);
+		TestThreadPool failedPool(4);
+		// The per-thread queries of the crowd and of its path queue, then the obstacle avoidance queries.
+		const size_t allocSizes[3] = { sizeof(dtNavMeshQuery), sizeof(dtObstacleAvoidanceQuery), sizeof(dtObstacleCircle) * 6 };
+		const int allocCounts[3] = { 5, 3, 3 };
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int allocCount = 0; allocCount < allocCounts[i]; ++allocCount)
+			{
+				CAPTURE(i, allocCount);
+				const FailedScheduler failedScheduler = { failedPool.getDetourScheduler(), allocCount, allocSizes[i] };
+				int parallelSampleCount = 0;
+				const std::vector<float> parallel = simulateCrowd(navMesh, pool.getDetourScheduler(), &parallelSampleCount,
+																  &failedScheduler);
+				REQUIRE(parallelSampleCount == serialSampleCount);
+				REQUIRE(sameData(parallel.data(), serial.data(), (int)serial.size()));
+			}
+		}
+	}
+
+	dtFreeNavMesh(navMesh);
+}
@@ -0,0 +1,240 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourPathQueue.h"
+#include "TestAlloc.h"
+#include "TestNavMesh.h"
+#include "TestParallel.h"
+
+namespace
+{
+dtNavMesh* buildPlaneNavMesh()
+{
+	TestGeometry geom;
+	geom.addQuad(0.0f, 0.0f, 40.0f, 40.0f, 0.0f);
+	return buildTestNavMesh(geom);
+}
+
+struct PathRequest
+{
+	dtPolyRef startRef;
+	dtPolyRef endRef;
+	float startPos[3];
+	float endPos[3];
+};
+
+std::vector<PathRequest> makeRequests(const dtNavMeshQuery* query, const dtQueryFilter* filter, const int count)
+{
+	const float halfExtents[3] = { 2.0f, 4.0f, 2.0f };
+	std::vector<PathRequest> requests;
+	for (int i = 0; i < count; ++i)
+	{
+		const float start[3] = { 2.0f + (float)(i % 10) * 0.5f, 0.0f, 2.0f + (float)(i / 10) * 0.5f };
+		const float end[3] = { 38.0f - (float)(i / 10) * 0.5f, 0.0f, 38.0f - (float)(i % 10) * 0.5f };
+		PathRequest request;
+		query->findNearestPoly(start, halfExtents, filter, &request.startRef, request.startPos);
+		query->findNearestPoly(end, halfExtents, filter, &request.endRef, request.endPos);
+		REQUIRE(request.startRef != 0);
+		REQUIRE(request.endRef != 0);
+		requests.push_back(request);
+	}
+	return requests;
+}
+
+/// Updates the queue until all requests are completed, and returns the paths with their sizes.
+std::vector<dtPolyRef> readPaths(dtPathQueue& pathq, const std::vector<dtPathQueueRef>& refs,
+								 const int maxIters, dtTaskScheduler* scheduler)
+{
+	const int maxPath = 256;
+	std::vector<std::vector<dtPolyRef> > paths(refs.size());
+	int completed = 0;
+	for (int iter = 0; iter < 1000 && completed < (int)refs.size(); ++iter)
+	{
+		pathq.update(maxIters, scheduler);
+
+		// Results that are not read within a few updates are freed.
+		for (size_t i = 0; i < refs.size(); ++i)
+		{
+			if (!paths[i].empty() || !dtStatusSucceed(pathq.getRequestStatus(refs[i])))
+			{
+				continue;
+			}
+			dtPolyRef path[maxPath];
+			int pathCount = 0;
+			REQUIRE(dtStatusSucceed(pathq.getPathResult(refs[i], path, &pathCount, maxPath)));
+			REQUIRE(pathCount > 0);
+			paths[i].push_back((dtPolyRef)pathCount);
+			paths[i].insert(paths[i].end(), path, path + pathCount);
+			completed++;
+		}
+	}
+	REQUIRE(completed == (int)refs.size());
+
+	std::vector<dtPolyRef> result;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		result.insert(result.end(), paths[i].begin(), paths[i].end());
+	}
+	return result;
+}
+}
+
+TEST_CASE("dtPathQueue", "[crowd]")
+{
+	dtNavMesh* navMesh = buildPlaneNavMesh();
+	REQUIRE(navMesh != NULL);
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(dtStatusSucceed(query->init(navMesh, 2048)));
+	dtQueryFilter filter;
+
+	const int requestCount = 100;
+	const std::vector<PathRequest> requests = makeRequests(query, &filter, requestCount);
+
+	const int maxPath = 256;
+	dtPathQueue pathq;
+
+	SECTION("Accepts more requests than it was initialized with")
+	{
+		REQUIRE(pathq.init(maxPath, 2048, navMesh));
+
+		std::vector<dtPathQueueRef> refs;
+		for (int i = 0; i < requestCount; ++i)
+		{
+			const PathRequest& r = requests[i];
+			const dtPathQueueRef ref = pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter);
+			REQUIRE(ref != DT_PATHQ_INVALID);
+			refs.push_back(ref);
+		}
+
+		const std::vector<dtPolyRef> paths = readPaths(pathq, refs, 100, NULL);
+		REQUIRE(paths[1] == requests[0].startRef);
+		REQUIRE(paths[paths[0]] == requests[0].endRef);
+
+		// The request is freed once the result has been read.
+		dtPolyRef path[maxPath];
+		int pathCount = 0;
+		REQUIRE(dtStatusFailed(pathq.getRequestStatus(refs[0])));
+		REQUIRE(dtStatusFailed(pathq.getPathResult(refs[0], path, &pathCount, maxPath)));
+	}
+
+	SECTION("Services requests in order of priority")
+	{
+		REQUIRE(pathq.init(maxPath, 2048, navMesh));
+
+		const PathRequest& r = requests[0];
+		const dtPathQueueRef low = pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter, 0.0f);
+		const dtPathQueueRef high = pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter, 1.0f);
+		const dtPathQueueRef lowLater = pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter, 0.0f);
+
+		// A single iteration is not enough to complete any of the requests.
+		pathq.update(1);
+		REQUIRE(dtStatusInProgress(pathq.getRequestStatus(high)));
+		REQUIRE(pathq.getRequestStatus(low) == 0);
+		REQUIRE(pathq.getRequestStatus(lowLater) == 0);
+
+		while (!dtStatusSucceed(pathq.getRequestStatus(high)))
+		{
+			pathq.update(1);
+		}
+		pathq.update(1);
+		REQUIRE(dtStatusInProgress(pathq.getRequestStatus(low)));
+		REQUIRE(pathq.getRequestStatus(lowLater) == 0);
+	}
+
+	SECTION("Multiple queries return the same paths")
+	{
+		std::vector<dtPathQueueRef> refs;
+		REQUIRE(pathq.init(maxPath, 2048, navMesh));
+		for (int i = 0; i < requestCount; ++i)
+		{
+			const PathRequest& r = requests[i];
+			refs.push_back(pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter));
+		}
+		const std::vector<dtPolyRef> expected = readPaths(pathq, refs, 100, NULL);
+
+		forEachThreadPool(NULL, [&](TestThreadPool& pool) {
+			dtTaskScheduler* scheduler = pool.getDetourScheduler();
+			REQUIRE(pathq.init(maxPath, 2048, navMesh, 3));
+			REQUIRE(pathq.getQueryCount() == 3);
+
+			refs.clear();
+			for (int i = 0; i < requestCount; ++i)
+			{
+				const PathRequest& r = requests[i];
+				refs.push_back(pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter));
+			}
+
+			// Removing a query restarts its request.
+			pathq.update(1, scheduler);
+			REQUIRE(pathq.setQueryCount(2));
+			REQUIRE(pathq.getQueryCount() == 2);
+
+			REQUIRE(readPaths(pathq, refs, 50, scheduler) == expected);
+		});
+	}
+
+	SECTION("Failed allocations leave the queue unchanged")
+	{
+		std::vector<dtPathQueueRef> refs;
+		REQUIRE(pathq.init(maxPath, 2048, navMesh));
+		for (int i = 0; i < requestCount; ++i)
+		{
+			const PathRequest& r = requests[i];
+			refs.push_back(pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter));
+		}
+		const std::vector<dtPolyRef> expected = readPaths(pathq, refs, 100, NULL);
+
+		// Fails an allocation while adding queries and growing the queue, and checks
+		// that the queue still returns all the paths afterwards.
+		const auto requestWithFailure = [&](const int allocCount, const size_t size, const bool addQueries) {
+			CAPTURE(allocCount, size, addQueries);
+			REQUIRE(pathq.init(maxPath, 2048, navMesh));
+			refs.clear();
+			{
+				TestFailingDetourAlloc failingAlloc(allocCount, size);
+				if (addQueries && !pathq.setQueryCount(3))
+				{
+					REQUIRE(pathq.getQueryCount() == 1);
+				}
+				for (int i = 0; i < requestCount; ++i)
+				{
+					const PathRequest& r = requests[i];
+					const dtPathQueueRef ref = pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter);
+					if (ref == DT_PATHQ_INVALID)
+					{
+						break;
+					}
+					refs.push_back(ref);
+				}
+				REQUIRE(TestFailingDetourAlloc::hasFailed());
+			}
+			for (int i = (int)refs.size(); i < requestCount; ++i)
+			{
+				const PathRequest& r = requests[i];
+				refs.push_back(pathq.request(r.startRef, r.endRef, r.startPos, r.endPos, &filter));
+				REQUIRE(refs.back() != DT_PATHQ_INVALID);
+			}
+			REQUIRE(readPaths(pathq, refs, 100, NULL) == expected);
+		};
+
+		// The query arrays, then each of the new queries.
+		requestWithFailure(0, 0, true);
+		requestWithFailure(1, 0, true);
+		requestWithFailure(0, sizeof(dtNavMeshQuery), true);
+		requestWithFailure(1, sizeof(dtNavMeshQuery), true);
+		// The path of each of the slots added when the queue first grows.
+		for (int i = 0; i < 8; ++i)
+		{
+			requestWithFailure(i, sizeof(dtPolyRef) * maxPath, false);
+		}
+	}
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(navMesh);
+}
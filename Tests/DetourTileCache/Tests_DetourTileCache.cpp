@@ -0,0 +1,240 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
+#include "Recast.h"
+#include "TestGeometry.h"
+#include "TestParallel.h"
+
+namespace
+{
+/// Stores the layers uncompressed.
+struct CopyCompressor : public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize) { return bufferSize; }
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int maxCompressedSize, int* compressedSize)
+	{
+		if (bufferSize > maxCompressedSize)
+		{
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		}
+		memcpy(compressed, buffer, bufferSize);
+		*compressedSize = bufferSize;
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	{
+		if (compressedSize > maxBufferSize)
+		{
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		}
+		memcpy(buffer, compressed, compressedSize);
+		*bufferSize = compressedSize;
+		return DT_SUCCESS;
+	}
+};
+
+/// Rasterizes a flat plane into compressed tile cache layers.
+std::vector<std::vector<unsigned char> > buildLayers(CopyCompressor& comp, rcConfig& cfg, int* tileCount)
+{
+	TestGeometry geom;
+	geom.addQuad(0.0f, 0.0f, 40.0f, 40.0f, 0.0f);
+	const float* verts = geom.verts.data();
+	const int nverts = geom.getVertCount();
+	const int* tris = geom.tris.data();
+	const int ntris = geom.getTriCount();
+	std::vector<unsigned char> triAreas(ntris);
+
+	cfg = makeTestConfig(geom);
+	cfg.width = cfg.tileSize + cfg.borderSize * 2;
+	cfg.height = cfg.tileSize + cfg.borderSize * 2;
+
+	int gw = 0;
+	int gh = 0;
+	rcCalcGridSize(cfg.bmin, cfg.bmax, cfg.cs, &gw, &gh);
+	*tileCount = (gw + cfg.tileSize - 1) / cfg.tileSize;
+
+	rcContext ctx(false);
+	std::vector<std::vector<unsigned char> > layers;
+	const float tcs = cfg.tileSize * cfg.cs;
+	for (int ty = 0; ty < *tileCount; ++ty)
+	{
+		for (int tx = 0; tx < *tileCount; ++tx)
+		{
+			rcConfig tcfg = cfg;
+			tcfg.bmin[0] = cfg.bmin[0] + tx * tcs - tcfg.borderSize * tcfg.cs;
+			tcfg.bmin[2] = cfg.bmin[2] + ty * tcs - tcfg.borderSize * tcfg.cs;
+			tcfg.bmax[0] = cfg.bmin[0] + (tx + 1) * tcs + tcfg.borderSize * tcfg.cs;
+			tcfg.bmax[2] = cfg.bmin[2] + (ty + 1) * tcs + tcfg.borderSize * tcfg.cs;
+
+			rcHeightfield* solid = rcAllocHeightfield();
+			REQUIRE(rcCreateHeightfield(&ctx, *solid, tcfg.width, tcfg.height, tcfg.bmin, tcfg.bmax, tcfg.cs, tcfg.ch));
+			memset(triAreas.data(), 0, triAreas.size());
+			rcMarkWalkableTriangles(&ctx, tcfg.walkableSlopeAngle, verts, nverts, tris, ntris, triAreas.data());
+			REQUIRE(rcRasterizeTriangles(&ctx, verts, nverts, tris, triAreas.data(), ntris, *solid, tcfg.walkableClimb));
+
+			rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+			REQUIRE(rcBuildCompactHeightfield(&ctx, tcfg.walkableHeight, tcfg.walkableClimb, *solid, *chf));
+			rcFreeHeightField(solid);
+			REQUIRE(rcErodeWalkableArea(&ctx, tcfg.walkableRadius, *chf));
+
+			rcHeightfieldLayerSet* lset = rcAllocHeightfieldLayerSet();
+			REQUIRE(rcBuildHeightfieldLayers(&ctx, *chf, tcfg.borderSize, tcfg.walkableHeight, *lset));
+			rcFreeCompactHeightfield(chf);
+
+			for (int i = 0; i < lset->nlayers; ++i)
+			{
+				const rcHeightfieldLayer* layer = &lset->layers[i];
+
+				dtTileCacheLayerHeader header;
+				header.magic = DT_TILECACHE_MAGIC;
+				header.version = DT_TILECACHE_VERSION;
+				header.tx = tx;
+				header.ty = ty;
+				header.tlayer = i;
+				dtVcopy(header.bmin, layer->bmin);
+				dtVcopy(header.bmax, layer->bmax);
+				header.width = (unsigned char)layer->width;
+				header.height = (unsigned char)layer->height;
+				header.minx = (unsigned char)layer->minx;
+				header.maxx = (unsigned char)layer->maxx;
+				header.miny = (unsigned char)layer->miny;
+				header.maxy = (unsigned char)layer->maxy;
+				header.hmin = (unsigned short)layer->hmin;
+				header.hmax = (unsigned short)layer->hmax;
+
+				unsigned char* data = 0;
+				int dataSize = 0;
+				REQUIRE(dtStatusSucceed(dtBuildTileCacheLayer(&comp, &header, layer->heights, layer->areas, layer->cons, &data, &dataSize)));
+				layers.push_back(std::vector<unsigned char>(data, data + dataSize));
+				dtFree(data);
+			}
+			rcFreeHeightfieldLayerSet(lset);
+		}
+	}
+	return layers;
+}
+
+/// Builds a navmesh from the layers, adds obstacles and returns the tile data after the tile cache is up to date.
+std::vector<unsigned char> buildWithObstacles(const std::vector<std::vector<unsigned char> >& layers,
+											  CopyCompressor& comp, const rcConfig& cfg, const int tileCount,
+											  dtTaskScheduler* scheduler, int* updateCount)
+{
+	dtTileCacheParams tcparams;
+	memset(&tcparams, 0, sizeof(tcparams));
+	dtVcopy(tcparams.orig, cfg.bmin);
+	tcparams.cs = cfg.cs;
+	tcparams.ch = cfg.ch;
+	tcparams.width = cfg.tileSize;
+	tcparams.height = cfg.tileSize;
+	tcparams.walkableHeight = 2.0f;
+	tcparams.walkableRadius = 0.6f;
+	tcparams.walkableClimb = 0.9f;
+	tcparams.maxSimplificationError = 1.3f;
+	tcparams.maxTiles = tileCount * tileCount * 4;
+	tcparams.maxObstacles = 64;
+
+	dtTileCacheAlloc talloc;
+	dtTileCache* tileCache = dtAllocTileCache();
+	REQUIRE(dtStatusSucceed(tileCache->init(&tcparams, &talloc, &comp, NULL)));
+
+	std::vector<dtTileCacheAlloc> threadAllocs(dtGetThreadCount(scheduler));
+	std::vector<dtTileCacheAlloc*> threadAllocPtrs;
+	for (size_t i = 0; i < threadAllocs.size(); ++i)
+	{
+		threadAllocPtrs.push_back(&threadAllocs[i]);
+	}
+	REQUIRE(dtStatusSucceed(tileCache->setTaskScheduler(scheduler, threadAllocPtrs.data())));
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	dtVcopy(params.orig, cfg.bmin);
+	params.tileWidth = cfg.tileSize * cfg.cs;
+	params.tileHeight = cfg.tileSize * cfg.cs;
+	params.maxTiles = tcparams.maxTiles;
+	params.maxPolys = 1 << 10;
+	dtNavMesh* navMesh = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(navMesh->init(&params)));
+
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		unsigned char* data = (unsigned char*)dtAlloc(layers[i].size(), DT_ALLOC_PERM);
+		memcpy(data, layers[i].data(), layers[i].size());
+		REQUIRE(dtStatusSucceed(tileCache->addTile(data, (int)layers[i].size(), DT_COMPRESSEDTILE_FREE_DATA, 0)));
+	}
+	for (int ty = 0; ty < tileCount; ++ty)
+	{
+		for (int tx = 0; tx < tileCount; ++tx)
+		{
+			REQUIRE(dtStatusSucceed(tileCache->buildNavMeshTilesAt(tx, ty, navMesh)));
+		}
+	}
+
+	// Obstacles along the diagonal touch most of the tiles.
+	for (int i = 0; i < 8; ++i)
+	{
+		const float pos[3] = { 3.0f + i * 4.8f, 0.0f, 3.0f + i * 4.8f };
+		REQUIRE(dtStatusSucceed(tileCache->addObstacle(pos, 1.5f, 2.0f, 0)));
+	}
+
+	*updateCount = 0;
+	bool upToDate = false;
+	while (!upToDate)
+	{
+		REQUIRE(dtStatusSucceed(tileCache->update(0.0f, navMesh, &upToDate)));
+		(*updateCount)++;
+	}
+
+	std::vector<unsigned char> result;
+	const dtNavMesh* constNavMesh = navMesh;
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = constNavMesh->getTile(i);
+		if (!tile->header)
+		{
+			continue;
+		}
+		const dtTileRef ref = navMesh->getTileRef(tile);
+		result.insert(result.end(), (const unsigned char*)&ref, (const unsigned char*)&ref + sizeof(ref));
+		result.insert(result.end(), tile->data, tile->data + tile->dataSize);
+	}
+
+	dtFreeNavMesh(navMesh);
+	dtFreeTileCache(tileCache);
+	return result;
+}
+}
+
+TEST_CASE("dtTileCache parallel update", "[tilecache]")
+{
+	CopyCompressor comp;
+	rcConfig cfg;
+	int tileCount = 0;
+	const std::vector<std::vector<unsigned char> > layers = buildLayers(comp, cfg, &tileCount);
+	REQUIRE(tileCount > 1);
+	REQUIRE(!layers.empty());
+
+	int serialUpdateCount = 0;
+	const std::vector<unsigned char> serial = buildWithObstacles(layers, comp, cfg, tileCount, NULL, &serialUpdateCount);
+	REQUIRE(serialUpdateCount > 2);
+
+	SECTION("Rebuilds all pending tiles in one update with the same result")
+	{
+		forEachThreadPool(NULL, [&](TestThreadPool& pool) {
+			int parallelUpdateCount = 0;
+			const std::vector<unsigned char> parallel = buildWithObstacles(layers, comp, cfg, tileCount, pool.getDetourScheduler(), &parallelUpdateCount);
+			REQUIRE(parallelUpdateCount == 1);
+			REQUIRE(parallel == serial);
+		});
+	}
+}
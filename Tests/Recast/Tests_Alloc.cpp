@@ -258,3 +258,83 @@ TEST_CASE("rcVector", "[recast, alloc]")
 		v.clear();
 	}
 }
+
+TEST_CASE("rcTempArena", "[recast, alloc]")
+{
+	rcTempArena arena;
+	REQUIRE(arena.init(2, 1000));
+	REQUIRE(arena.getThreadCount() == 2);
+	REQUIRE(arena.getBlockSize() >= 1000);
+
+	SECTION("Allocations are aligned and come from the block of the thread")
+	{
+		unsigned char* a = (unsigned char*)arena.alloc(3, 0);
+		unsigned char* b = (unsigned char*)arena.alloc(5, 0);
+		unsigned char* c = (unsigned char*)arena.alloc(5, 1);
+		REQUIRE(a != NULL);
+		REQUIRE(b != NULL);
+		REQUIRE(c != NULL);
+		REQUIRE(arena.owns(a));
+		REQUIRE(arena.owns(b));
+		REQUIRE(arena.owns(c));
+		REQUIRE(b > a);
+		REQUIRE((size_t)(c - a) >= arena.getBlockSize());
+		REQUIRE(((size_t)a & 15) == 0);
+		REQUIRE(((size_t)b & 15) == 0);
+		REQUIRE(arena.alloc(1, 2) == NULL);
+		REQUIRE(arena.alloc(1, -1) == NULL);
+	}
+
+	SECTION("A full block returns null until the arena is reset")
+	{
+		void* first = arena.alloc(600, 0);
+		REQUIRE(first != NULL);
+		REQUIRE(arena.alloc(600, 0) == NULL);
+		REQUIRE(arena.getPeakSize() >= 600);
+		arena.reset();
+		REQUIRE(arena.alloc(600, 0) == first);
+		REQUIRE(arena.getPeakSize() >= 600);
+	}
+
+	SECTION("The current arena serves temporary allocations only")
+	{
+		rcSetThreadTempArena(&arena, 1);
+		int threadIndex = 0;
+		REQUIRE(rcGetThreadTempArena(&threadIndex) == &arena);
+		REQUIRE(threadIndex == 1);
+
+		void* temp = rcAlloc(100, RC_ALLOC_TEMP);
+		void* perm = rcAlloc(100, RC_ALLOC_PERM);
+		void* large = rcAlloc(2000, RC_ALLOC_TEMP);
+		REQUIRE(arena.owns(temp));
+		REQUIRE(!arena.owns(perm));
+		REQUIRE(!arena.owns(large));
+		rcFree(temp);
+		rcFree(perm);
+		rcFree(large);
+
+		rcSetThreadTempArena(NULL, 0);
+		REQUIRE(rcGetThreadTempArena() == NULL);
+		void* heap = rcAlloc(100, RC_ALLOC_TEMP);
+		REQUIRE(!arena.owns(heap));
+		rcFree(heap);
+	}
+
+	SECTION("Vectors grow within the arena")
+	{
+		rcSetThreadTempArena(&arena, 0);
+		{
+			rcTempVector<int> vec;
+			for (int i = 0; i < 50; ++i)
+			{
+				vec.push_back(i);
+			}
+			REQUIRE(arena.owns(vec.data()));
+			for (int i = 0; i < 50; ++i)
+			{
+				REQUIRE(vec[i] == i);
+			}
+		}
+		rcSetThreadTempArena(NULL, 0);
+	}
+}
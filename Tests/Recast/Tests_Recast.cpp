@@ -4,6 +4,7 @@
 #include "catch2/catch_amalgamated.hpp"
 
 #include "Recast.h"
+#include "TestParallel.h"
 
 TEST_CASE("rcSwap", "[recast]")
 {
@@ -429,8 +430,247 @@ TEST_CASE("rcCreateHeightfield", "[recast]")
 		REQUIRE(heightfield.ch == Catch::Approx(cellHeight));
 
 		REQUIRE(heightfield.spans != 0);
+#ifdef RC_SPAN_INDEX32
+		REQUIRE(heightfield.spanArena == 0);
+		REQUIRE(heightfield.spanArenaCount == 0);
+		REQUIRE(heightfield.freelist == RC_NULL_SPAN);
+		for (int i = 0; i < width * height; ++i)
+		{
+			REQUIRE(rcGetFirstSpan(heightfield, i) == 0);
+		}
+#else
 		REQUIRE(heightfield.pools == 0);
 		REQUIRE(heightfield.freelist == 0);
+#endif
+	}
+}
+
+TEST_CASE("Heightfield reuse", "[recast]")
+{
+	rcContext ctx;
+	// A floor with a ramp leaning on it.
+	float verts[] = {
+		0, 0, 0,
+		8, 0, 0,
+		8, 0, 8,
+		0, 0, 8,
+		2, 0, 2,
+		6, 3, 2,
+		6, 3, 6
+	};
+	int tris[] = {
+		0, 3, 2,
+		0, 2, 1,
+		4, 6, 5
+	};
+	unsigned char areas[] = { RC_WALKABLE_AREA, RC_WALKABLE_AREA, RC_WALKABLE_AREA };
+
+	float bmin[3];
+	float bmax[3];
+	rcCalcBounds(verts, 7, bmin, bmax);
+	const float cellSize = 0.5f;
+	const float cellHeight = 0.25f;
+	int width;
+	int height;
+	rcCalcGridSize(bmin, bmax, cellSize, &width, &height);
+
+	rcHeightfield expected;
+	REQUIRE(rcCreateHeightfield(&ctx, expected, width, height, bmin, bmax, cellSize, cellHeight));
+	REQUIRE(rcRasterizeTriangles(&ctx, verts, 7, tris, areas, 3, expected, 1));
+
+	// Fill the reused heightfield with a larger field first.
+	float largeBmax[3] = { bmax[0] + 4.0f, bmax[1], bmax[2] + 4.0f };
+	int largeWidth;
+	int largeHeight;
+	rcCalcGridSize(bmin, largeBmax, cellSize, &largeWidth, &largeHeight);
+
+	rcHeightfield heightfield;
+	REQUIRE(rcCreateHeightfield(&ctx, heightfield, largeWidth, largeHeight, bmin, largeBmax, cellSize, cellHeight));
+	REQUIRE(rcRasterizeTriangles(&ctx, verts, 7, tris, areas, 3, heightfield, 1));
+
+	SECTION("Recreating a heightfield keeps its memory")
+	{
+		const void* columns = heightfield.spans;
+#ifdef RC_SPAN_INDEX32
+		const rcSpan* spanStorage = heightfield.spanArena;
+#else
+		const rcSpanPool* spanStorage = heightfield.pools;
+#endif
+		REQUIRE(spanStorage != 0);
+
+		REQUIRE(rcCreateHeightfield(&ctx, heightfield, width, height, bmin, bmax, cellSize, cellHeight));
+		REQUIRE(heightfield.width == width);
+		REQUIRE(heightfield.height == height);
+		REQUIRE(rcGetHeightFieldSpanCount(&ctx, heightfield) == 0);
+
+		REQUIRE(rcRasterizeTriangles(&ctx, verts, 7, tris, areas, 3, heightfield, 1));
+		REQUIRE(heightfield.spans == columns);
+#ifdef RC_SPAN_INDEX32
+		REQUIRE(heightfield.spanArena == spanStorage);
+#else
+		REQUIRE(heightfield.pools == spanStorage);
+#endif
+
+		for (int i = 0; i < width * height; ++i)
+		{
+			const rcSpan* a = rcGetFirstSpan(heightfield, i);
+			const rcSpan* b = rcGetFirstSpan(expected, i);
+			for (; a != 0 && b != 0; a = rcGetNextSpan(heightfield, a), b = rcGetNextSpan(expected, b))
+			{
+				REQUIRE(a->smin == b->smin);
+				REQUIRE(a->smax == b->smax);
+				REQUIRE(a->area == b->area);
+			}
+			REQUIRE(a == 0);
+			REQUIRE(b == 0);
+		}
+	}
+
+	SECTION("Rebuilding a compact heightfield keeps its memory")
+	{
+		rcCompactHeightfield expectedChf;
+		REQUIRE(rcBuildCompactHeightfield(&ctx, 2, 1, expected, expectedChf));
+		REQUIRE(expectedChf.spanCount > 0);
+
+		rcCompactHeightfield chf;
+		REQUIRE(rcBuildCompactHeightfield(&ctx, 2, 1, heightfield, chf));
+		REQUIRE(rcBuildDistanceField(&ctx, chf));
+		REQUIRE(chf.maxSpans == chf.spanCount);
+		const rcCompactCell* cells = chf.cells;
+		const rcCompactSpan* spans = chf.spans;
+		const unsigned char* chfAreas = chf.areas;
+
+		REQUIRE(rcBuildCompactHeightfield(&ctx, 2, 1, expected, chf));
+		REQUIRE(chf.cells == cells);
+		REQUIRE(chf.spans == spans);
+		REQUIRE(chf.areas == chfAreas);
+		REQUIRE(chf.dist == 0);
+		REQUIRE(chf.width == expectedChf.width);
+		REQUIRE(chf.height == expectedChf.height);
+		REQUIRE(chf.spanCount == expectedChf.spanCount);
+		REQUIRE(chf.maxSpans >= chf.spanCount);
+		REQUIRE(sameData(chf.cells, expectedChf.cells, chf.width * chf.height));
+		REQUIRE(sameData(chf.spans, expectedChf.spans, chf.spanCount));
+		REQUIRE(sameData(chf.areas, expectedChf.areas, chf.spanCount));
+	}
+}
+
+TEST_CASE("rcBuildCompactHeightfield", "[recast]")
+{
+	rcContext ctx(false);
+	const int width = 45;
+	const int height = 31;
+	const int walkableHeight = 4;
+	const int walkableClimb = 2;
+	const float bmin[3] = { 0.0f, 0.0f, 0.0f };
+	const float bmax[3] = { 45.0f, 20.0f, 31.0f };
+
+	// Random columns of up to three spans, some of them unwalkable.
+	rcHeightfield heightfield;
+	REQUIRE(rcCreateHeightfield(&ctx, heightfield, width, height, bmin, bmax, 1.0f, 0.2f));
+	unsigned int seed = 3;
+	for (int z = 0; z < height; ++z)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			int top = 0;
+			const int numSpans = 1 + (int)((seed >> 16) % 3);
+			for (int i = 0; i < numSpans; ++i)
+			{
+				seed = seed * 1103515245u + 12345u;
+				const int smin = top + (int)((seed >> 16) % 8);
+				const int smax = smin + 1 + (int)((seed >> 20) % 4);
+				const unsigned char area = (seed >> 24) % 5 == 0 ? RC_NULL_AREA : RC_WALKABLE_AREA;
+				REQUIRE(rcAddSpan(&ctx, heightfield, x, z, (unsigned short)smin, (unsigned short)smax, area, 0));
+				top = smax;
+			}
+		}
+	}
+
+	rcCompactHeightfield expected;
+	REQUIRE(rcBuildCompactHeightfield(&ctx, walkableHeight, walkableClimb, heightfield, expected));
+	REQUIRE(expected.spanCount > width * height);
+
+	SECTION("Spans connect to the first reachable span of each neighbour column")
+	{
+		int numConnections = 0;
+		for (int z = 0; z < height; ++z)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const rcCompactCell& cell = expected.cells[x + z * width];
+				for (int i = (int)cell.index; i < (int)(cell.index + cell.count); ++i)
+				{
+					const rcCompactSpan& span = expected.spans[i];
+					for (int dir = 0; dir < 4; ++dir)
+					{
+						int expectedCon = RC_NOT_CONNECTED;
+						const int nx = x + rcGetDirOffsetX(dir);
+						const int nz = z + rcGetDirOffsetY(dir);
+						if (nx >= 0 && nz >= 0 && nx < width && nz < height)
+						{
+							const rcCompactCell& neighborCell = expected.cells[nx + nz * width];
+							for (int k = 0; k < (int)neighborCell.count; ++k)
+							{
+								const rcCompactSpan& neighborSpan = expected.spans[neighborCell.index + k];
+								const int bot = rcMax(span.y, neighborSpan.y);
+								const int top = rcMin(span.y + span.h, neighborSpan.y + neighborSpan.h);
+								if (top - bot >= walkableHeight && rcAbs((int)neighborSpan.y - (int)span.y) <= walkableClimb)
+								{
+									expectedCon = k;
+									break;
+								}
+							}
+						}
+						REQUIRE(rcGetCon(span, dir) == expectedCon);
+						numConnections += expectedCon != RC_NOT_CONNECTED ? 1 : 0;
+					}
+				}
+			}
+		}
+		REQUIRE(numConnections > 0);
+	}
+
+	SECTION("Neighbor indices match the connections")
+	{
+		REQUIRE(expected.neighbors == NULL);
+		REQUIRE(rcBuildNeighborIndices(&ctx, expected));
+		REQUIRE(expected.neighbors != NULL);
+		for (int z = 0; z < height; ++z)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				const rcCompactCell& cell = expected.cells[x + z * width];
+				for (int i = (int)cell.index; i < (int)(cell.index + cell.count); ++i)
+				{
+					for (int dir = 0; dir < 4; ++dir)
+					{
+						const int con = rcGetCon(expected.spans[i], dir);
+						const int nx = x + rcGetDirOffsetX(dir);
+						const int nz = z + rcGetDirOffsetY(dir);
+						const int neighbor = con == RC_NOT_CONNECTED ? -1 : (int)expected.cells[nx + nz * width].index + con;
+						REQUIRE(expected.neighbors[i * 4 + dir] == neighbor);
+						REQUIRE(rcGetNeighborSpan(expected, x, z, i, dir) == neighbor);
+					}
+				}
+			}
+		}
+
+		// The indices belong to the field they were built for.
+		REQUIRE(rcBuildCompactHeightfield(&ctx, walkableHeight, walkableClimb, heightfield, expected));
+		REQUIRE(expected.neighbors == NULL);
+	}
+
+	SECTION("The thread count does not change the output")
+	{
+		forEachThreadPool(&ctx, [&](TestThreadPool&) {
+			rcCompactHeightfield chf;
+			REQUIRE(rcBuildCompactHeightfield(&ctx, walkableHeight, walkableClimb, heightfield, chf));
+			REQUIRE(chf.spanCount == expected.spanCount);
+			REQUIRE(sameData(chf.cells, expected.cells, width * height));
+			REQUIRE(sameData(chf.spans, expected.spans, chf.spanCount));
+			REQUIRE(sameData(chf.areas, expected.areas, chf.spanCount));
+		});
 	}
 }
 
@@ -549,44 +789,44 @@ TEST_CASE("rcRasterizeTriangles", "[recast]")
 	{
 		REQUIRE(rcRasterizeTriangles(&ctx, verts, 4, tris, areas, 2, solid, flagMergeThr));
 
-		REQUIRE(solid.spans[0 + 0 * width]);
-		REQUIRE(solid.spans[0 + 1 * width]);
-		REQUIRE(solid.spans[0 + 2 * width]);
-		REQUIRE(solid.spans[0 + 3 * width]);
-		REQUIRE(!solid.spans[1 + 0 * width]);
-		REQUIRE(solid.spans[1 + 1 * width]);
-		REQUIRE(solid.spans[1 + 2 * width]);
-		REQUIRE(!solid.spans[1 + 3 * width]);
-
-		REQUIRE(solid.spans[0 + 0 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 0 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 0 * width]->area == 1);
-		REQUIRE(!solid.spans[0 + 0 * width]->next);
-
-		REQUIRE(solid.spans[0 + 1 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 1 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 1 * width]->area == 1);
-		REQUIRE(!solid.spans[0 + 1 * width]->next);
-
-		REQUIRE(solid.spans[0 + 2 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 2 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 2 * width]->area == 2);
-		REQUIRE(!solid.spans[0 + 2 * width]->next);
-
-		REQUIRE(solid.spans[0 + 3 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 3 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 3 * width]->area == 2);
-		REQUIRE(!solid.spans[0 + 3 * width]->next);
-
-		REQUIRE(solid.spans[1 + 1 * width]->smin == 0);
-		REQUIRE(solid.spans[1 + 1 * width]->smax == 1);
-		REQUIRE(solid.spans[1 + 1 * width]->area == 1);
-		REQUIRE(!solid.spans[1 + 1 * width]->next);
-
-		REQUIRE(solid.spans[1 + 2 * width]->smin == 0);
-		REQUIRE(solid.spans[1 + 2 * width]->smax == 1);
-		REQUIRE(solid.spans[1 + 2 * width]->area == 2);
-		REQUIRE(!solid.spans[1 + 2 * width]->next);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width));
+		REQUIRE(!rcGetFirstSpan(solid, 1 + 0 * width));
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width));
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width));
+		REQUIRE(!rcGetFirstSpan(solid, 1 + 3 * width));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 0 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 1 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 2 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 3 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 1 + 1 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 1 + 2 * width)));
 	}
 
 	SECTION("Unsigned short overload")
@@ -597,44 +837,44 @@ TEST_CASE("rcRasterizeTriangles", "[recast]")
 		};
 		REQUIRE(rcRasterizeTriangles(&ctx, verts, 4, utris, areas, 2, solid, flagMergeThr));
 
-		REQUIRE(solid.spans[0 + 0 * width]);
-		REQUIRE(solid.spans[0 + 1 * width]);
-		REQUIRE(solid.spans[0 + 2 * width]);
-		REQUIRE(solid.spans[0 + 3 * width]);
-		REQUIRE(!solid.spans[1 + 0 * width]);
-		REQUIRE(solid.spans[1 + 1 * width]);
-		REQUIRE(solid.spans[1 + 2 * width]);
-		REQUIRE(!solid.spans[1 + 3 * width]);
-
-		REQUIRE(solid.spans[0 + 0 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 0 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 0 * width]->area == 1);
-		REQUIRE(!solid.spans[0 + 0 * width]->next);
-
-		REQUIRE(solid.spans[0 + 1 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 1 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 1 * width]->area == 1);
-		REQUIRE(!solid.spans[0 + 1 * width]->next);
-
-		REQUIRE(solid.spans[0 + 2 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 2 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 2 * width]->area == 2);
-		REQUIRE(!solid.spans[0 + 2 * width]->next);
-
-		REQUIRE(solid.spans[0 + 3 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 3 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 3 * width]->area == 2);
-		REQUIRE(!solid.spans[0 + 3 * width]->next);
-
-		REQUIRE(solid.spans[1 + 1 * width]->smin == 0);
-		REQUIRE(solid.spans[1 + 1 * width]->smax == 1);
-		REQUIRE(solid.spans[1 + 1 * width]->area == 1);
-		REQUIRE(!solid.spans[1 + 1 * width]->next);
-
-		REQUIRE(solid.spans[1 + 2 * width]->smin == 0);
-		REQUIRE(solid.spans[1 + 2 * width]->smax == 1);
-		REQUIRE(solid.spans[1 + 2 * width]->area == 2);
-		REQUIRE(!solid.spans[1 + 2 * width]->next);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width));
+		REQUIRE(!rcGetFirstSpan(solid, 1 + 0 * width));
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width));
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width));
+		REQUIRE(!rcGetFirstSpan(solid, 1 + 3 * width));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 0 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 1 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 2 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 3 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 1 + 1 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 1 + 2 * width)));
 	}
 
 	SECTION("Triangle list overload")
@@ -650,43 +890,43 @@ TEST_CASE("rcRasterizeTriangles", "[recast]")
 
 		REQUIRE(rcRasterizeTriangles(&ctx, vertsList, areas, 2, solid, flagMergeThr));
 
-		REQUIRE(solid.spans[0 + 0 * width]);
-		REQUIRE(solid.spans[0 + 1 * width]);
-		REQUIRE(solid.spans[0 + 2 * width]);
-		REQUIRE(solid.spans[0 + 3 * width]);
-		REQUIRE(!solid.spans[1 + 0 * width]);
-		REQUIRE(solid.spans[1 + 1 * width]);
-		REQUIRE(solid.spans[1 + 2 * width]);
-		REQUIRE(!solid.spans[1 + 3 * width]);
-
-		REQUIRE(solid.spans[0 + 0 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 0 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 0 * width]->area == 1);
-		REQUIRE(!solid.spans[0 + 0 * width]->next);
-
-		REQUIRE(solid.spans[0 + 1 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 1 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 1 * width]->area == 1);
-		REQUIRE(!solid.spans[0 + 1 * width]->next);
-
-		REQUIRE(solid.spans[0 + 2 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 2 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 2 * width]->area == 2);
-		REQUIRE(!solid.spans[0 + 2 * width]->next);
-
-		REQUIRE(solid.spans[0 + 3 * width]->smin == 0);
-		REQUIRE(solid.spans[0 + 3 * width]->smax == 1);
-		REQUIRE(solid.spans[0 + 3 * width]->area == 2);
-		REQUIRE(!solid.spans[0 + 3 * width]->next);
-
-		REQUIRE(solid.spans[1 + 1 * width]->smin == 0);
-		REQUIRE(solid.spans[1 + 1 * width]->smax == 1);
-		REQUIRE(solid.spans[1 + 1 * width]->area == 1);
-		REQUIRE(!solid.spans[1 + 1 * width]->next);
-
-		REQUIRE(solid.spans[1 + 2 * width]->smin == 0);
-		REQUIRE(solid.spans[1 + 2 * width]->smax == 1);
-		REQUIRE(solid.spans[1 + 2 * width]->area == 2);
-		REQUIRE(!solid.spans[1 + 2 * width]->next);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width));
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width));
+		REQUIRE(!rcGetFirstSpan(solid, 1 + 0 * width));
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width));
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width));
+		REQUIRE(!rcGetFirstSpan(solid, 1 + 3 * width));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 0 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 0 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 1 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 1 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 2 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 2 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 0 + 3 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 0 + 3 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 1 * width)->area == 1);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 1 + 1 * width)));
+
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->smin == 0);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->smax == 1);
+		REQUIRE(rcGetFirstSpan(solid, 1 + 2 * width)->area == 2);
+		REQUIRE(!rcGetNextSpan(solid, rcGetFirstSpan(solid, 1 + 2 * width)));
 	}
 }
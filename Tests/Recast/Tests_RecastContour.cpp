@@ -0,0 +1,150 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "Recast.h"
+#include "TestGeometry.h"
+#include "TestParallel.h"
+
+namespace
+{
+constexpr int fieldSize = 120;
+constexpr float fieldCellSize = 0.5f;
+constexpr float fieldCellHeight = 0.2f;
+
+/// A flat square with a grid of pillars, which leaves holes in the regions.
+TestGeometry makePillarField()
+{
+	TestGeometry geom;
+	const float size = fieldSize * fieldCellSize;
+	geom.addBox(0.0f, 0.0f, size, size, -0.5f, 0.0f);
+	for (int z = 0; z < 8; ++z)
+	{
+		for (int x = 0; x < 8; ++x)
+		{
+			const float x0 = 4.0f + x * 7.0f + (z % 3) * 0.7f;
+			const float z0 = 4.0f + z * 7.0f + (x % 2) * 0.9f;
+			geom.addBox(x0, z0, x0 + 1.5f, z0 + 1.5f, -0.5f, 3.0f);
+		}
+	}
+	return geom;
+}
+
+void buildGroundRegions(rcContext& ctx, const TestGeometry& geom, rcCompactHeightfield& chf)
+{
+	const float bmin[3] = { 0.0f, -1.0f, 0.0f };
+	const float bmax[3] = { fieldSize * fieldCellSize, 5.0f, fieldSize * fieldCellSize };
+
+	rcHeightfield solid;
+	REQUIRE(rcCreateHeightfield(&ctx, solid, fieldSize, fieldSize, bmin, bmax, fieldCellSize, fieldCellHeight));
+	REQUIRE(rcRasterizeTriangles(&ctx, geom.verts.data(), geom.getVertCount(), geom.tris.data(), geom.areas.data(),
+								 geom.getTriCount(), solid, 2));
+	rcFilterWalkableLowHeightSpans(&ctx, 5, solid);
+	REQUIRE(rcBuildCompactHeightfield(&ctx, 5, 2, solid, chf));
+	REQUIRE(rcErodeWalkableArea(&ctx, 1, chf));
+
+	// Split the ground into two regions, so that every pillar is a hole in one of them.
+	for (int y = 0; y < chf.height; ++y)
+	{
+		for (int x = 0; x < chf.width; ++x)
+		{
+			const rcCompactCell& c = chf.cells[x + y * chf.width];
+			for (int i = (int)c.index, ni = (int)(c.index + c.count); i < ni; ++i)
+			{
+				const bool ground = chf.areas[i] != RC_NULL_AREA && chf.spans[i].y < 10;
+				chf.spans[i].reg = ground ? (x < chf.width / 2 ? 1 : 2) : 0;
+			}
+		}
+	}
+	chf.maxRegions = 2;
+}
+
+bool hasDuplicateVertex(const rcContour& cont)
+{
+	for (int i = 0; i < cont.nverts; ++i)
+	{
+		for (int j = i + 1; j < cont.nverts; ++j)
+		{
+			if (cont.verts[i * 4 + 0] == cont.verts[j * 4 + 0] && cont.verts[i * 4 + 2] == cont.verts[j * 4 + 2])
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+}
+
+TEST_CASE("rcBuildContours", "[recast, contour]")
+{
+	const TestGeometry geom = makePillarField();
+	rcContext ctx(false);
+
+	rcCompactHeightfield chf;
+	buildGroundRegions(ctx, geom, chf);
+
+	const int buildFlags = RC_CONTOUR_TESS_WALL_EDGES;
+	rcContourSet expected;
+	REQUIRE(rcBuildContours(&ctx, chf, 1.3f, 12, expected, buildFlags));
+	REQUIRE(expected.nconts > 0);
+
+	SECTION("Holes are merged into the region outlines")
+	{
+		// Merging a hole connects it to the outline through a pair of duplicated vertices.
+		int mergedCount = 0;
+		std::vector<int> regionContours(chf.maxRegions + 1, 0);
+		for (int i = 0; i < expected.nconts; ++i)
+		{
+			const rcContour& cont = expected.conts[i];
+			REQUIRE(cont.reg <= chf.maxRegions);
+			if (cont.nverts == 0)
+			{
+				continue;
+			}
+			REQUIRE(cont.nverts >= 3);
+			regionContours[cont.reg]++;
+			if (hasDuplicateVertex(cont))
+			{
+				mergedCount++;
+			}
+		}
+		REQUIRE(mergedCount == 2);
+		for (int i = 0; i <= chf.maxRegions; ++i)
+		{
+			REQUIRE(regionContours[i] == (i == 0 ? 0 : 1));
+		}
+	}
+
+	SECTION("A field without regions has no contours")
+	{
+		TestThreadPool pool(4, &ctx);
+		for (int i = 0; i < chf.spanCount; ++i)
+		{
+			chf.spans[i].reg = 0;
+		}
+		rcContourSet cset;
+		REQUIRE(rcBuildContours(&ctx, chf, 1.3f, 12, cset, buildFlags));
+		REQUIRE(cset.nconts == 0);
+	}
+
+	SECTION("The contours do not depend on the thread count")
+	{
+		forEachThreadPool(&ctx, [&](TestThreadPool&) {
+			rcContourSet cset;
+			REQUIRE(rcBuildContours(&ctx, chf, 1.3f, 12, cset, buildFlags));
+			REQUIRE(cset.nconts == expected.nconts);
+			for (int i = 0; i < cset.nconts; ++i)
+			{
+				const rcContour& cont = cset.conts[i];
+				const rcContour& expectedCont = expected.conts[i];
+				REQUIRE(cont.reg == expectedCont.reg);
+				REQUIRE(cont.area == expectedCont.area);
+				REQUIRE(cont.nverts == expectedCont.nverts);
+				REQUIRE(cont.nrverts == expectedCont.nrverts);
+				REQUIRE(sameData(cont.verts, expectedCont.verts, 4 * cont.nverts));
+				REQUIRE(sameData(cont.rverts, expectedCont.rverts, 4 * cont.nrverts));
+			}
+		});
+	}
+}
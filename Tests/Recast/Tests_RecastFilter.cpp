@@ -6,65 +6,40 @@
 
 #include "Recast.h"
 #include "RecastAlloc.h"
+#include "TestParallel.h"
 
 TEST_CASE("rcFilterLowHangingWalkableObstacles", "[recast, filtering]")
 {
 	rcContext context;
 	int walkableHeight = 5;
 
+	const float bmin[3] = { 0, 0, 0 };
+	const float bmax[3] = { 1, 1, 1 };
 	rcHeightfield heightfield;
-	heightfield.width = 1;
-	heightfield.height = 1;
-	heightfield.bmin[0] = 0;
-	heightfield.bmin[1] = 0;
-	heightfield.bmin[2] = 0;
-	heightfield.bmax[0] = 1;
-	heightfield.bmax[1] = 1;
-	heightfield.bmax[2] = 1;
-	heightfield.cs = 1;
-	heightfield.ch = 1;
-	heightfield.spans = (rcSpan**)rcAlloc(heightfield.width * heightfield.height * sizeof(rcSpan*), RC_ALLOC_PERM);
-	heightfield.pools = NULL;
-	heightfield.freelist = NULL;
+	REQUIRE(rcCreateHeightfield(&context, heightfield, 1, 1, bmin, bmax, 1, 1));
 
 	SECTION("Span with no spans above it is unchanged")
 	{
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = NULL;
-		span->smin = 0;
-		span->smax = 1;
-		heightfield.spans[0] = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
 
 		rcFilterLowHangingWalkableObstacles(&context, walkableHeight, heightfield);
 
-		REQUIRE(heightfield.spans[0]->area == 1);
-
-		rcFree(span);
+		REQUIRE(rcGetFirstSpan(heightfield, 0)->area == 1);
 	}
 
 	SECTION("Span with span above that is higher than walkableHeight is unchanged")
 	{
 		// Put the second span just above the first one.
-		rcSpan* secondSpan = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		secondSpan->area = RC_NULL_AREA;
-		secondSpan->next = NULL;
-		secondSpan->smin = 1 + walkableHeight;
-		secondSpan->smax = secondSpan->smin + 1;
-
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = secondSpan;
-		span->smin = 0;
-		span->smax = 1;
-
-		heightfield.spans[0] = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 1 + walkableHeight, 2 + walkableHeight, RC_NULL_AREA, 1));
 
 		rcFilterLowHangingWalkableObstacles(&context, walkableHeight, heightfield);
 
 		// Check that nothing has changed.
-		REQUIRE(heightfield.spans[0]->area == 1);
-		REQUIRE(heightfield.spans[0]->next->area == RC_NULL_AREA);
+		rcSpan* span = rcGetFirstSpan(heightfield, 0);
+		rcSpan* secondSpan = rcGetNextSpan(heightfield, span);
+		REQUIRE(span->area == 1);
+		REQUIRE(secondSpan->area == RC_NULL_AREA);
 
 		// Check again but with a more clearance
 		secondSpan->smin += 10;
@@ -73,111 +48,61 @@ TEST_CASE("rcFilterLowHangingWalkableObstacles", "[recast, filtering]")
 		rcFilterLowHangingWalkableObstacles(&context, walkableHeight, heightfield);
 
 		// Check that nothing has changed.
-		REQUIRE(heightfield.spans[0]->area == 1);
-		REQUIRE(heightfield.spans[0]->next->area == RC_NULL_AREA);
-
-		rcFree(span);
-		rcFree(secondSpan);
+		REQUIRE(span->area == 1);
+		REQUIRE(secondSpan->area == RC_NULL_AREA);
 	}
 
 	SECTION("Marks low obstacles walkable if they're below the walkableClimb")
 	{
 		// Put the second span just above the first one.
-		rcSpan* secondSpan = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		secondSpan->area = RC_NULL_AREA;
-		secondSpan->next = NULL;
-		secondSpan->smin = 1 + (walkableHeight - 1);
-		secondSpan->smax = secondSpan->smin + 1;
-
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = secondSpan;
-		span->smin = 0;
-		span->smax = 1;
-
-		heightfield.spans[0] = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, walkableHeight, 1 + walkableHeight, RC_NULL_AREA, 1));
 
 		rcFilterLowHangingWalkableObstacles(&context, walkableHeight, heightfield);
 
 		// Check that the second span was changed to walkable.
-		REQUIRE(heightfield.spans[0]->area == 1);
-		REQUIRE(heightfield.spans[0]->next->area == 1);
-
-		rcFree(span);
-		rcFree(secondSpan);
+		rcSpan* span = rcGetFirstSpan(heightfield, 0);
+		REQUIRE(span->area == 1);
+		REQUIRE(rcGetNextSpan(heightfield, span)->area == 1);
 	}
 
 	SECTION("Low obstacle that overlaps the walkableClimb distance is not changed")
 	{
 		// Put the second span just above the first one.
-		rcSpan* secondSpan = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		secondSpan->area = RC_NULL_AREA;
-		secondSpan->next = NULL;
-		secondSpan->smin = 2 + (walkableHeight - 1);
-		secondSpan->smax = secondSpan->smin + 1;
-
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = secondSpan;
-		span->smin = 0;
-		span->smax = 1;
-
-		heightfield.spans[0] = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 1 + walkableHeight, 2 + walkableHeight, RC_NULL_AREA, 1));
 
 		rcFilterLowHangingWalkableObstacles(&context, walkableHeight, heightfield);
 
-		// Check that the second span was changed to walkable.
-		REQUIRE(heightfield.spans[0]->area == 1);
-		REQUIRE(heightfield.spans[0]->next->area == RC_NULL_AREA);
-
-		rcFree(span);
-		rcFree(secondSpan);
+		// Check that the second span was not changed.
+		rcSpan* span = rcGetFirstSpan(heightfield, 0);
+		REQUIRE(span->area == 1);
+		REQUIRE(rcGetNextSpan(heightfield, span)->area == RC_NULL_AREA);
 	}
 
 	SECTION("Only the first of multiple, low obstacles are marked walkable")
 	{
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = NULL;
-		span->smin = 0;
-		span->smax = 1;
-		heightfield.spans[0] = span;
-
-		rcSpan* previousSpan = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
+
+		int previousMax = 1;
 		for (int i = 0; i < 9; ++i)
 		{
-			rcSpan* nextSpan = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-			nextSpan->area = RC_NULL_AREA;
-			nextSpan->next = NULL;
-			nextSpan->smin = previousSpan->smax + (walkableHeight - 1);
-			nextSpan->smax = nextSpan->smin + 1;
-			previousSpan->next = nextSpan;
-			previousSpan = nextSpan;
+			const int smin = previousMax + (walkableHeight - 1);
+			REQUIRE(rcAddSpan(&context, heightfield, 0, 0, (unsigned short)smin, (unsigned short)(smin + 1), RC_NULL_AREA, 1));
+			previousMax = smin + 1;
 		}
 
 		rcFilterLowHangingWalkableObstacles(&context, walkableHeight, heightfield);
 
-		rcSpan* currentSpan = heightfield.spans[0];
+		rcSpan* currentSpan = rcGetFirstSpan(heightfield, 0);
 		for (int i = 0; i < 10; ++i)
 		{
 			REQUIRE(currentSpan != NULL);
 			// only the first and second spans should be marked as walkabl
 			REQUIRE(currentSpan->area == (i <= 1 ? 1 : RC_NULL_AREA));
-			currentSpan = currentSpan->next;
-		}
-
-		std::vector<rcSpan*> toFree;
-		span = heightfield.spans[0];
-		for (int i = 0; i < 10; ++i)
-		{
-			toFree.push_back(span);
-			span = span->next;
-		}
-
-		for (int i = 0; i < 10; ++i)
-		{
-			rcFree(toFree[i]);
+			currentSpan = rcGetNextSpan(heightfield, currentSpan);
 		}
+		REQUIRE(currentSpan == NULL);
 	}
 }
 
@@ -187,20 +112,10 @@ TEST_CASE("rcFilterLedgeSpans", "[recast, filtering]")
 	int walkableClimb = 5;
 	int walkableHeight = 10;
 
+	const float bmin[3] = { 0, 0, 0 };
+	const float bmax[3] = { 10, 1, 10 };
 	rcHeightfield heightfield;
-	heightfield.width = 10;
-	heightfield.height = 10;
-	heightfield.bmin[0] = 0;
-	heightfield.bmin[1] = 0;
-	heightfield.bmin[2] = 0;
-	heightfield.bmax[0] = 10;
-	heightfield.bmax[1] = 1;
-	heightfield.bmax[2] = 10;
-	heightfield.cs = 1;
-	heightfield.ch = 1;
-	heightfield.spans = (rcSpan**)rcAlloc(heightfield.width * heightfield.height * sizeof(rcSpan*), RC_ALLOC_PERM);
-	heightfield.pools = NULL;
-	heightfield.freelist = NULL;
+	REQUIRE(rcCreateHeightfield(&context, heightfield, 10, 10, bmin, bmax, 1, 1));
 
 	SECTION("Edge spans are marked unwalkable")
 	{
@@ -209,12 +124,7 @@ TEST_CASE("rcFilterLedgeSpans", "[recast, filtering]")
 		{
 			for (int z = 0; z < heightfield.height; ++z)
 			{
-				rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-				span->area = 1;
-				span->next = NULL;
-				span->smin = 0;
-				span->smax = 1;
-				heightfield.spans[x + z * heightfield.width] = span;
+				REQUIRE(rcAddSpan(&context, heightfield, x, z, 0, 1, 1, 1));
 			}
 		}
 
@@ -224,7 +134,7 @@ TEST_CASE("rcFilterLedgeSpans", "[recast, filtering]")
 		{
 			for (int z = 0; z < heightfield.height; ++z)
 			{
-				rcSpan* span = heightfield.spans[x + z * heightfield.width];
+				rcSpan* span = rcGetFirstSpan(heightfield, x + z * heightfield.width);
 				REQUIRE(span != NULL);
 
 				if (x == 0 || z == 0 || x == 9 || z == 9)
@@ -236,20 +146,11 @@ TEST_CASE("rcFilterLedgeSpans", "[recast, filtering]")
 					REQUIRE(span->area == 1);
 				}
 
-				REQUIRE(span->next == NULL);
+				REQUIRE(rcGetNextSpan(heightfield, span) == NULL);
 				REQUIRE(span->smin == 0);
 				REQUIRE(span->smax == 1);
 			}
 		}
-
-		// Free all the heightfield spans
-		for (int x = 0; x < heightfield.width; ++x)
-		{
-			for (int z = 0; z < heightfield.height; ++z)
-			{
-				rcFree(heightfield.spans[x + z * heightfield.width]);
-			}
-		}
 	}
 }
 
@@ -258,82 +159,124 @@ TEST_CASE("rcFilterWalkableLowHeightSpans", "[recast, filtering]")
 	rcContext context;
 	int walkableHeight = 5;
 
+	const float bmin[3] = { 0, 0, 0 };
+	const float bmax[3] = { 1, 1, 1 };
 	rcHeightfield heightfield;
-	heightfield.width = 1;
-	heightfield.height = 1;
-	heightfield.bmin[0] = 0;
-	heightfield.bmin[1] = 0;
-	heightfield.bmin[2] = 0;
-	heightfield.bmax[0] = 1;
-	heightfield.bmax[1] = 1;
-	heightfield.bmax[2] = 1;
-	heightfield.cs = 1;
-	heightfield.ch = 1;
-	heightfield.spans = (rcSpan**)rcAlloc(heightfield.width * heightfield.height * sizeof(rcSpan*), RC_ALLOC_PERM);
-	heightfield.pools = NULL;
-	heightfield.freelist = NULL;
+	REQUIRE(rcCreateHeightfield(&context, heightfield, 1, 1, bmin, bmax, 1, 1));
 
 	SECTION("span nothing above is unchanged")
 	{
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = NULL;
-		span->smin = 0;
-		span->smax = 1;
-		heightfield.spans[0] = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
 
 		rcFilterWalkableLowHeightSpans(&context, walkableHeight, heightfield);
 
-		REQUIRE(heightfield.spans[0]->area == 1);
-
-		rcFree(span);
+		REQUIRE(rcGetFirstSpan(heightfield, 0)->area == 1);
 	}
 
 	SECTION("span with lots of room above is unchanged")
 	{
-		rcSpan* overheadSpan = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		overheadSpan->area = RC_NULL_AREA;
-		overheadSpan->next = NULL;
-		overheadSpan->smin = 10;
-		overheadSpan->smax = 11;
-
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = overheadSpan;
-		span->smin = 0;
-		span->smax = 1;
-		heightfield.spans[0] = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 10, 11, RC_NULL_AREA, 1));
 
 		rcFilterWalkableLowHeightSpans(&context, walkableHeight, heightfield);
 
-		REQUIRE(heightfield.spans[0]->area == 1);
-		REQUIRE(heightfield.spans[0]->next->area == RC_NULL_AREA);
-
-		rcFree(overheadSpan);
-		rcFree(span);
+		rcSpan* span = rcGetFirstSpan(heightfield, 0);
+		REQUIRE(span->area == 1);
+		REQUIRE(rcGetNextSpan(heightfield, span)->area == RC_NULL_AREA);
 	}
 
 	SECTION("Span with low hanging obstacle is marked as unwalkable")
 	{
-		rcSpan* overheadSpan = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		overheadSpan->area = RC_NULL_AREA;
-		overheadSpan->next = NULL;
-		overheadSpan->smin = 3;
-		overheadSpan->smax = 4;
-
-		rcSpan* span = (rcSpan*)rcAlloc(sizeof(rcSpan), RC_ALLOC_PERM);
-		span->area = 1;
-		span->next = overheadSpan;
-		span->smin = 0;
-		span->smax = 1;
-		heightfield.spans[0] = span;
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 0, 1, 1, 1));
+		REQUIRE(rcAddSpan(&context, heightfield, 0, 0, 3, 4, RC_NULL_AREA, 1));
 
 		rcFilterWalkableLowHeightSpans(&context, walkableHeight, heightfield);
 
-		REQUIRE(heightfield.spans[0]->area == RC_NULL_AREA);
-		REQUIRE(heightfield.spans[0]->next->area == RC_NULL_AREA);
+		rcSpan* span = rcGetFirstSpan(heightfield, 0);
+		REQUIRE(span->area == RC_NULL_AREA);
+		REQUIRE(rcGetNextSpan(heightfield, span)->area == RC_NULL_AREA);
+	}
+}
+
+namespace
+{
+/// Fills the heightfield with random columns of up to four spans with random areas.
+void addRandomSpans(rcContext& context, rcHeightfield& heightfield, unsigned int seed)
+{
+	for (int z = 0; z < heightfield.height; ++z)
+	{
+		for (int x = 0; x < heightfield.width; ++x)
+		{
+			int top = 0;
+			const int numSpans = 1 + (int)((seed >> 16) % 4);
+			for (int i = 0; i < numSpans; ++i)
+			{
+				seed = seed * 1103515245u + 12345u;
+				const int smin = top + (int)((seed >> 16) % 12);
+				const int smax = smin + 1 + (int)((seed >> 20) % 6);
+				const unsigned char area = (seed >> 24) % 3 == 0 ? RC_NULL_AREA : (unsigned char)(1 + (seed >> 26) % 2);
+				REQUIRE(rcAddSpan(&context, heightfield, x, z, (unsigned short)smin, (unsigned short)smax, area, 0));
+				top = smax;
+			}
+		}
+	}
+}
+
+std::vector<unsigned char> getSpanAreas(const rcHeightfield& heightfield)
+{
+	std::vector<unsigned char> areas;
+	for (int i = 0; i < heightfield.width * heightfield.height; ++i)
+	{
+		for (const rcSpan* span = rcGetFirstSpan(heightfield, i); span; span = rcGetNextSpan(heightfield, span))
+		{
+			areas.push_back((unsigned char)span->area);
+		}
+	}
+	return areas;
+}
+}
+
+TEST_CASE("rcFilterHeightfield", "[recast, filtering]")
+{
+	rcContext context(false);
+	const int walkableHeight = 5;
+	const int walkableClimb = 2;
+	const float bmin[3] = { 0.0f, 0.0f, 0.0f };
+	const float bmax[3] = { 50.0f, 20.0f, 37.0f };
 
-		rcFree(overheadSpan);
-		rcFree(span);
+	for (int filterFlags = 1; filterFlags <= RC_FILTER_ALL; ++filterFlags)
+	{
+		rcHeightfield expected;
+		REQUIRE(rcCreateHeightfield(&context, expected, 50, 37, bmin, bmax, 1.0f, 0.2f));
+		addRandomSpans(context, expected, 7);
+		const std::vector<unsigned char> unfilteredAreas = getSpanAreas(expected);
+		if (filterFlags & RC_FILTER_LOW_HANGING_OBSTACLES)
+		{
+			rcFilterLowHangingWalkableObstacles(&context, walkableClimb, expected);
+		}
+		if (filterFlags & RC_FILTER_LEDGE_SPANS)
+		{
+			rcFilterLedgeSpans(&context, walkableHeight, walkableClimb, expected);
+		}
+		if (filterFlags & RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS)
+		{
+			rcFilterWalkableLowHeightSpans(&context, walkableHeight, expected);
+		}
+		const std::vector<unsigned char> expectedAreas = getSpanAreas(expected);
+		REQUIRE(expectedAreas != unfilteredAreas);
+
+		rcHeightfield serial;
+		REQUIRE(rcCreateHeightfield(&context, serial, 50, 37, bmin, bmax, 1.0f, 0.2f));
+		addRandomSpans(context, serial, 7);
+		rcFilterHeightfield(&context, filterFlags, walkableHeight, walkableClimb, serial);
+		REQUIRE(getSpanAreas(serial) == expectedAreas);
+
+		forEachThreadPool(&context, [&](TestThreadPool&) {
+			rcHeightfield heightfield;
+			REQUIRE(rcCreateHeightfield(&context, heightfield, 50, 37, bmin, bmax, 1.0f, 0.2f));
+			addRandomSpans(context, heightfield, 7);
+			rcFilterHeightfield(&context, filterFlags, walkableHeight, walkableClimb, heightfield);
+			REQUIRE(getSpanAreas(heightfield) == expectedAreas);
+		});
 	}
-}
\ No newline at end of file
+}
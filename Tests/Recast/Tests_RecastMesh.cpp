@@ -0,0 +1,157 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "Recast.h"
+#include "RecastAlloc.h"
+
+namespace
+{
+/// Adds a contour with the given (x, z) vertices to the set, which must have room for it.
+void addContour(rcContourSet& cset, const std::vector<int>& xz, unsigned short reg)
+{
+	rcContour& cont = cset.conts[cset.nconts++];
+	cont.nverts = (int)xz.size() / 2;
+	cont.verts = (int*)rcAlloc(sizeof(int) * 4 * cont.nverts, RC_ALLOC_PERM);
+	for (int i = 0; i < cont.nverts; ++i)
+	{
+		cont.verts[i * 4 + 0] = xz[i * 2 + 0];
+		cont.verts[i * 4 + 1] = 0;
+		cont.verts[i * 4 + 2] = xz[i * 2 + 1];
+		cont.verts[i * 4 + 3] = 0;
+	}
+	cont.rverts = NULL;
+	cont.nrverts = 0;
+	cont.reg = reg;
+	cont.area = RC_WALKABLE_AREA;
+}
+
+void initContourSet(rcContourSet& cset, int maxContours)
+{
+	cset.conts = (rcContour*)rcAlloc(sizeof(rcContour) * maxContours, RC_ALLOC_PERM);
+	cset.nconts = 0;
+	const float bmin[3] = { 0.0f, 0.0f, 0.0f };
+	const float bmax[3] = { 1000.0f, 1.0f, 1000.0f };
+	rcVcopy(cset.bmin, bmin);
+	rcVcopy(cset.bmax, bmax);
+	cset.cs = 1.0f;
+	cset.ch = 1.0f;
+}
+
+/// A comb with the given number of teeth, which has many reflex vertices and a known area.
+std::vector<int> makeComb(int teeth)
+{
+	std::vector<int> xz;
+	xz.push_back(0);
+	xz.push_back(0);
+	for (int i = 0; i < teeth; ++i)
+	{
+		const int x = i * 4;
+		const int tooth[8] = { x, 10, x, 20, x + 2, 20, x + 2, 10 };
+		xz.insert(xz.end(), tooth, tooth + 8);
+	}
+	xz.push_back(teeth * 4);
+	xz.push_back(10);
+	xz.push_back(teeth * 4);
+	xz.push_back(0);
+	return xz;
+}
+
+/// Returns twice the signed area of the polygon in the xz-plane.
+int polyArea2(const rcPolyMesh& mesh, const unsigned short* p)
+{
+	int area = 0;
+	for (int i = 0; i < mesh.nvp && p[i] != RC_MESH_NULL_IDX; ++i)
+	{
+		const int j = (i + 1 < mesh.nvp && p[i + 1] != RC_MESH_NULL_IDX) ? i + 1 : 0;
+		const unsigned short* a = &mesh.verts[p[i] * 3];
+		const unsigned short* b = &mesh.verts[p[j] * 3];
+		area += (int)a[0] * (int)b[2] - (int)b[0] * (int)a[2];
+	}
+	return area;
+}
+
+bool isConvex(const rcPolyMesh& mesh, const unsigned short* p)
+{
+	int nv = 0;
+	while (nv < mesh.nvp && p[nv] != RC_MESH_NULL_IDX)
+	{
+		nv++;
+	}
+	for (int i = 0; i < nv; ++i)
+	{
+		const unsigned short* a = &mesh.verts[p[i] * 3];
+		const unsigned short* b = &mesh.verts[p[(i + 1) % nv] * 3];
+		const unsigned short* c = &mesh.verts[p[(i + 2) % nv] * 3];
+		const int cross = ((int)b[0] - (int)a[0]) * ((int)c[2] - (int)a[2]) - ((int)c[0] - (int)a[0]) * ((int)b[2] - (int)a[2]);
+		if (cross > 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+}
+
+TEST_CASE("rcBuildPolyMesh", "[recast, mesh]")
+{
+	rcContext ctx(false);
+
+	SECTION("A contour with many vertices is covered by convex polygons")
+	{
+		const int teeth = 200;
+		const int nvp = 6;
+		rcContourSet cset;
+		initContourSet(cset, 1);
+		addContour(cset, makeComb(teeth), 1);
+
+		rcPolyMesh mesh;
+		REQUIRE(rcBuildPolyMesh(&ctx, cset, nvp, mesh));
+		REQUIRE(mesh.nverts == cset.conts[0].nverts);
+		REQUIRE(mesh.npolys > 0);
+		REQUIRE(mesh.npolys < cset.conts[0].nverts - 2);
+
+		int area2 = 0;
+		for (int i = 0; i < mesh.npolys; ++i)
+		{
+			const unsigned short* p = &mesh.polys[i * nvp * 2];
+			REQUIRE(p[2] != RC_MESH_NULL_IDX);
+			REQUIRE(isConvex(mesh, p));
+			area2 += polyArea2(mesh, p);
+		}
+		// The base and the teeth.
+		const int expectedArea = teeth * 4 * 10 + teeth * 2 * 10;
+		REQUIRE(rcAbs(area2) == expectedArea * 2);
+	}
+
+	SECTION("Contours that share an edge share the vertices and are connected")
+	{
+		const int nvp = 6;
+		rcContourSet cset;
+		initContourSet(cset, 2);
+		const int left[8] = { 0, 0, 0, 10, 10, 10, 10, 0 };
+		const int right[8] = { 10, 0, 10, 10, 20, 10, 20, 0 };
+		addContour(cset, std::vector<int>(left, left + 8), 1);
+		addContour(cset, std::vector<int>(right, right + 8), 2);
+
+		rcPolyMesh mesh;
+		REQUIRE(rcBuildPolyMesh(&ctx, cset, nvp, mesh));
+		REQUIRE(mesh.nverts == 6);
+		REQUIRE(mesh.npolys == 2);
+		for (int i = 0; i < mesh.npolys; ++i)
+		{
+			const unsigned short* p = &mesh.polys[i * nvp * 2];
+			int neighbours = 0;
+			for (int j = 0; j < nvp; ++j)
+			{
+				if (p[nvp + j] != RC_MESH_NULL_IDX && (p[nvp + j] & 0x8000) == 0)
+				{
+					REQUIRE(p[nvp + j] == 1 - i);
+					neighbours++;
+				}
+			}
+			REQUIRE(neighbours == 1);
+		}
+	}
+}
@@ -0,0 +1,203 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "Recast.h"
+#include "RecastAlloc.h"
+#include "TestGeometry.h"
+#include "TestParallel.h"
+
+namespace
+{
+constexpr int terrainSize = 120;
+constexpr float terrainCellSize = 0.5f;
+constexpr float terrainCellHeight = 0.2f;
+
+/// A bumpy terrain with a few sloped platforms, so that the detail meshes need height samples.
+TestGeometry makeTerrain()
+{
+	return makeBumpyTerrain(terrainSize / 3, 3.0f * terrainCellSize, 1.0f, 20, 11);
+}
+
+void buildPolyMesh(rcContext& ctx, const TestGeometry& geom, rcCompactHeightfield& chf, rcPolyMesh& mesh,
+				   bool neighborIndices = false)
+{
+	const float bmin[3] = { 0.0f, -1.0f, 0.0f };
+	const float bmax[3] = { terrainSize * terrainCellSize, 5.0f, terrainSize * terrainCellSize };
+
+	rcHeightfield solid;
+	REQUIRE(rcCreateHeightfield(&ctx, solid, terrainSize, terrainSize, bmin, bmax, terrainCellSize, terrainCellHeight));
+	REQUIRE(rcRasterizeTriangles(&ctx, geom.verts.data(), geom.getVertCount(), geom.tris.data(), geom.areas.data(),
+								 geom.getTriCount(), solid, 2));
+	rcFilterWalkableLowHeightSpans(&ctx, 5, solid);
+	REQUIRE(rcBuildCompactHeightfield(&ctx, 5, 2, solid, chf));
+	if (neighborIndices)
+	{
+		REQUIRE(rcBuildNeighborIndices(&ctx, chf));
+	}
+	REQUIRE(rcErodeWalkableArea(&ctx, 1, chf));
+	REQUIRE(rcBuildDistanceField(&ctx, chf));
+	REQUIRE(rcBuildRegions(&ctx, chf, 0, 8, 20));
+
+	rcContourSet cset;
+	REQUIRE(rcBuildContours(&ctx, chf, 1.3f, 12, cset));
+	REQUIRE(rcBuildPolyMesh(&ctx, cset, 6, mesh));
+	REQUIRE(mesh.npolys > 0);
+}
+}
+
+TEST_CASE("rcBuildPolyMeshDetail", "[recast, detail]")
+{
+	const TestGeometry geom = makeTerrain();
+	rcContext ctx(false);
+
+	rcCompactHeightfield chf;
+	rcPolyMesh mesh;
+	buildPolyMesh(ctx, geom, chf, mesh);
+
+	const float sampleDist = terrainCellSize * 6.0f;
+	const float sampleMaxError = terrainCellHeight;
+	rcPolyMeshDetail* detail = rcAllocPolyMeshDetail();
+	REQUIRE(detail != NULL);
+	const rcPolyMeshDetail& expected = *detail;
+	REQUIRE(rcBuildPolyMeshDetail(&ctx, mesh, chf, sampleDist, sampleMaxError, *detail));
+	REQUIRE(expected.nmeshes == mesh.npolys);
+
+	SECTION("Every polygon has a detail mesh starting with the polygon vertices")
+	{
+		int nverts = 0;
+		int ntris = 0;
+		for (int i = 0; i < expected.nmeshes; ++i)
+		{
+			const unsigned int* m = &expected.meshes[i * 4];
+			REQUIRE(m[0] == (unsigned int)nverts);
+			REQUIRE(m[2] == (unsigned int)ntris);
+			REQUIRE(m[3] > 0);
+			nverts += (int)m[1];
+			ntris += (int)m[3];
+
+			const unsigned short* p = &mesh.polys[i * mesh.nvp * 2];
+			for (int j = 0; j < mesh.nvp && p[j] != RC_MESH_NULL_IDX; ++j)
+			{
+				const float* v = &expected.verts[(m[0] + j) * 3];
+				REQUIRE(v[0] == Catch::Approx(mesh.bmin[0] + mesh.verts[p[j] * 3 + 0] * mesh.cs));
+				REQUIRE(v[2] == Catch::Approx(mesh.bmin[2] + mesh.verts[p[j] * 3 + 2] * mesh.cs));
+			}
+		}
+		REQUIRE(nverts == expected.nverts);
+		REQUIRE(ntris == expected.ntris);
+	}
+
+	SECTION("The detail meshes do not depend on the thread count")
+	{
+		forEachThreadPool(&ctx, [&](TestThreadPool&) {
+			rcPolyMeshDetail* built = rcAllocPolyMeshDetail();
+			REQUIRE(built != NULL);
+			const bool ok = rcBuildPolyMeshDetail(&ctx, mesh, chf, sampleDist, sampleMaxError, *built);
+			const rcPolyMeshDetail& dmesh = *built;
+			REQUIRE(ok);
+			REQUIRE(dmesh.nmeshes == expected.nmeshes);
+			REQUIRE(dmesh.nverts == expected.nverts);
+			REQUIRE(dmesh.ntris == expected.ntris);
+			REQUIRE(sameData(dmesh.meshes, expected.meshes, 4 * dmesh.nmeshes));
+			REQUIRE(sameData(dmesh.verts, expected.verts, 3 * dmesh.nverts));
+			REQUIRE(sameData(dmesh.tris, expected.tris, 4 * dmesh.ntris));
+			rcFreePolyMeshDetail(built);
+		});
+	}
+
+	SECTION("A temporary arena does not change the output")
+	{
+		rcContext arenaCtx(false);
+		rcCompactHeightfield arenaChf;
+		rcPolyMesh arenaMesh;
+		rcPolyMeshDetail* built = rcAllocPolyMeshDetail();
+		REQUIRE(built != NULL);
+		rcTempArena arena;
+		{
+			TestThreadPool pool(4, &arenaCtx);
+			REQUIRE(arena.init(pool.getThreadCount(), 4 * 1024 * 1024));
+			arenaCtx.setTempArena(&arena);
+
+			buildPolyMesh(arenaCtx, geom, arenaChf, arenaMesh);
+			REQUIRE(rcBuildPolyMeshDetail(&arenaCtx, arenaMesh, arenaChf, sampleDist, sampleMaxError, *built));
+		}
+		REQUIRE(arena.getPeakSize() > 0);
+		REQUIRE(rcGetThreadTempArena() == NULL);
+
+		// Nothing that the build returned may live in the arena.
+		arena.reset();
+		for (int i = 0; i < arena.getThreadCount(); ++i)
+		{
+			memset(arena.alloc(arena.getBlockSize(), i), 0xcd, arena.getBlockSize());
+		}
+
+		REQUIRE(arenaMesh.npolys == mesh.npolys);
+		REQUIRE(arenaMesh.nverts == mesh.nverts);
+		REQUIRE(sameData(arenaMesh.polys, mesh.polys, 2 * mesh.nvp * mesh.npolys));
+		REQUIRE(sameData(arenaMesh.verts, mesh.verts, 3 * mesh.nverts));
+		REQUIRE(sameData(arenaChf.dist, chf.dist, chf.spanCount));
+
+		const rcPolyMeshDetail& dmesh = *built;
+		REQUIRE(dmesh.nverts == expected.nverts);
+		REQUIRE(dmesh.ntris == expected.ntris);
+		REQUIRE(sameData(dmesh.meshes, expected.meshes, 4 * dmesh.nmeshes));
+		REQUIRE(sameData(dmesh.verts, expected.verts, 3 * dmesh.nverts));
+		REQUIRE(sameData(dmesh.tris, expected.tris, 4 * dmesh.ntris));
+		rcFreePolyMeshDetail(built);
+	}
+
+	SECTION("Neighbor indices do not change the output")
+	{
+		rcCompactHeightfield neighborChf;
+		rcPolyMesh neighborMesh;
+		buildPolyMesh(ctx, geom, neighborChf, neighborMesh, true);
+		REQUIRE(neighborChf.neighbors != NULL);
+		rcPolyMeshDetail* built = rcAllocPolyMeshDetail();
+		REQUIRE(built != NULL);
+		REQUIRE(rcBuildPolyMeshDetail(&ctx, neighborMesh, neighborChf, sampleDist, sampleMaxError, *built));
+
+		REQUIRE(neighborChf.spanCount == chf.spanCount);
+		REQUIRE(sameData(neighborChf.areas, chf.areas, chf.spanCount));
+		REQUIRE(sameData(neighborChf.dist, chf.dist, chf.spanCount));
+		REQUIRE(sameData(neighborChf.spans, chf.spans, chf.spanCount));
+		REQUIRE(neighborMesh.npolys == mesh.npolys);
+		REQUIRE(neighborMesh.nverts == mesh.nverts);
+		REQUIRE(sameData(neighborMesh.polys, mesh.polys, 2 * mesh.nvp * mesh.npolys));
+		REQUIRE(sameData(neighborMesh.verts, mesh.verts, 3 * mesh.nverts));
+
+		const rcPolyMeshDetail& dmesh = *built;
+		REQUIRE(dmesh.nverts == expected.nverts);
+		REQUIRE(dmesh.ntris == expected.ntris);
+		REQUIRE(sameData(dmesh.meshes, expected.meshes, 4 * dmesh.nmeshes));
+		REQUIRE(sameData(dmesh.verts, expected.verts, 3 * dmesh.nverts));
+		REQUIRE(sameData(dmesh.tris, expected.tris, 4 * dmesh.ntris));
+		rcFreePolyMeshDetail(built);
+	}
+
+	SECTION("Dense sampling refines the detail meshes")
+	{
+		rcPolyMeshDetail* built = rcAllocPolyMeshDetail();
+		REQUIRE(built != NULL);
+		const rcPolyMeshDetail& dmesh = *built;
+		REQUIRE(rcBuildPolyMeshDetail(&ctx, mesh, chf, terrainCellSize, sampleMaxError, *built));
+		REQUIRE(dmesh.nmeshes == mesh.npolys);
+		REQUIRE(dmesh.nverts > expected.nverts);
+		for (int i = 0; i < dmesh.nmeshes; ++i)
+		{
+			const unsigned int* m = &dmesh.meshes[i * 4];
+			REQUIRE(m[1] <= 127);
+			for (unsigned int j = 0; j < m[3]; ++j)
+			{
+				const unsigned char* t = &dmesh.tris[(m[2] + j) * 4];
+				REQUIRE(t[0] < m[1]);
+				REQUIRE(t[1] < m[1]);
+				REQUIRE(t[2] < m[1]);
+			}
+		}
+		rcFreePolyMeshDetail(built);
+	}
+
+	rcFreePolyMeshDetail(detail);
+}
@@ -0,0 +1,68 @@
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "RecastParallel.h"
+
+namespace
+{
+/// Counts how many times each item was visited, and by which threads.
+class CountingTask : public rcParallelTask
+{
+public:
+	CountingTask(int itemCount, int threadCount) : visits(itemCount, 0), threadUsed(threadCount, 0) {}
+
+	void execute(int itemIndex, int threadIndex) override
+	{
+		visits[itemIndex]++;
+		threadUsed[threadIndex] = 1;
+	}
+
+	std::vector<int> visits;
+	std::vector<int> threadUsed;
+};
+}
+
+TEST_CASE("rcParallelFor", "[recast, parallel]")
+{
+	const int itemCount = 1000;
+
+	SECTION("Runs every item once without a scheduler")
+	{
+		CountingTask task(itemCount, 1);
+		rcParallelFor(NULL, task, itemCount);
+		for (int i = 0; i < itemCount; ++i)
+		{
+			REQUIRE(task.visits[i] == 1);
+		}
+	}
+
+	SECTION("Runs every item once on a thread pool")
+	{
+		rcTaskScheduler* pool = rcAllocThreadPool(4);
+		REQUIRE(pool != NULL);
+		REQUIRE(rcGetThreadCount(pool) >= 1);
+		REQUIRE(rcGetThreadCount(pool) <= 4);
+
+		// Run a few loops to make sure the workers pick up every generation of work.
+		for (int loop = 0; loop < 10; ++loop)
+		{
+			CountingTask task(itemCount, rcGetThreadCount(pool));
+			rcParallelFor(pool, task, itemCount);
+			for (int i = 0; i < itemCount; ++i)
+			{
+				REQUIRE(task.visits[i] == 1);
+			}
+		}
+
+		rcFreeThreadPool(pool);
+	}
+
+	SECTION("Handles empty loops")
+	{
+		rcTaskScheduler* pool = rcAllocThreadPool(2);
+		CountingTask task(0, rcGetThreadCount(pool));
+		rcParallelFor(pool, task, 0);
+		rcFreeThreadPool(pool);
+	}
+}
@@ -1,4 +1,8 @@
+#include <random>
+#include <vector>
+
 #include "Recast.h"
+#include "TestParallel.h"
 #include "catch2/catch_amalgamated.hpp"
 
 TEST_CASE("rcAddSpan", "[recast][rasterization]")
@@ -24,116 +28,116 @@ TEST_CASE("rcAddSpan", "[recast][rasterization]")
 	SECTION("Add a span to an empty heightfield.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 1);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 1);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 	}
 
 	SECTION("Adding invalid or zero-size spans does nothing.")
 	{
 		// min == max
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 0, area, flagMergeThr));
-		REQUIRE(hf.spans[0] == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) == nullptr);
 
 		// min > maxs
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 1, 0, area, flagMergeThr));
-		REQUIRE(hf.spans[0] == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) == nullptr);
 	}
 
 	SECTION("Two spans that are not touching are not merged.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 1);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 1);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 2, 3, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->next != nullptr);
-		REQUIRE(hf.spans[0]->next->smin == 2);
-		REQUIRE(hf.spans[0]->next->smax == 3);
-		REQUIRE(hf.spans[0]->next->area == area);
-		REQUIRE(hf.spans[0]->next->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) != nullptr);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->smin == 2);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->smax == 3);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))) == nullptr);
 	}
 
 	SECTION("Two spans with different area ids within the flag merge threshold are merged and the highest area ID is used.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, 42, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 1);
-		REQUIRE(hf.spans[0]->area == 42);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 1);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == 42);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 1, 2, 24, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 2);
-		REQUIRE(hf.spans[0]->area == 42); // Higher area ID takes precedent
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 2);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == 42); // Higher area ID takes precedent
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 	}
 
 	SECTION("Two spans with different area ids outside the flag merge threshold are merged and the area ID of the last span added is used.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, 42, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 1);
-		REQUIRE(hf.spans[0]->area == 42);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 1);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == 42);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 1, 8, 24, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 8);
-		REQUIRE(hf.spans[0]->area == 24); // Area ID of the last-added span takes precedent
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 8);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == 24); // Area ID of the last-added span takes precedent
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 	}
 
 	SECTION("Add a span that gets merged with an existing span.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 1);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 1);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 1, 2, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 2);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 2);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 	}
 
 	SECTION("Add a span that merges with two spans above and below.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 1);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 1);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 2, 3, area, flagMergeThr));
-		REQUIRE(hf.spans[0]->next != nullptr);
-		REQUIRE(hf.spans[0]->next->smin == 2);
-		REQUIRE(hf.spans[0]->next->smax == 3);
-		REQUIRE(hf.spans[0]->next->area == area);
-		REQUIRE(hf.spans[0]->next->next == nullptr);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) != nullptr);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->smin == 2);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->smax == 3);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))) == nullptr);
 
 		// After adding the third span, they should all get merged into a single span.
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 1, 2, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 3);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 3);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 	}
 
 	SECTION("Spans are insertion-sorted in ascending order of Y value.")
@@ -142,55 +146,81 @@ TEST_CASE("rcAddSpan", "[recast][rasterization]")
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, area, flagMergeThr));
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 6, 7, area, flagMergeThr));
 
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 1);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next != nullptr);
-
-		REQUIRE(hf.spans[0]->next->smin == 2);
-		REQUIRE(hf.spans[0]->next->smax == 3);
-		REQUIRE(hf.spans[0]->next->area == area);
-		REQUIRE(hf.spans[0]->next->next != nullptr);
-
-		REQUIRE(hf.spans[0]->next->next->smin == 6);
-		REQUIRE(hf.spans[0]->next->next->smax == 7);
-		REQUIRE(hf.spans[0]->next->next->area == area);
-		REQUIRE(hf.spans[0]->next->next->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 1);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) != nullptr);
+
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->smin == 2);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->smax == 3);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetFirstSpan(hf, 0))) != nullptr);
+
+		REQUIRE(rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)))->smin == 6);
+		REQUIRE(rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)))->smax == 7);
+		REQUIRE(rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)))->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)))) == nullptr);
 	}
 
 	SECTION("Adding a span inside another span merges them.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 8, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 8);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 8);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 2, 3, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 8);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 8);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 	}
 
 	SECTION("Overlapping spans are merged.")
 	{
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 4, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 4);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 4);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
 
 		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 2, 6, area, flagMergeThr));
-		REQUIRE(hf.spans[0] != nullptr);
-		REQUIRE(hf.spans[0]->smin == 0);
-		REQUIRE(hf.spans[0]->smax == 6);
-		REQUIRE(hf.spans[0]->area == area);
-		REQUIRE(hf.spans[0]->next == nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0) != nullptr);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smin == 0);
+		REQUIRE(rcGetFirstSpan(hf, 0)->smax == 6);
+		REQUIRE(rcGetFirstSpan(hf, 0)->area == area);
+		REQUIRE(rcGetNextSpan(hf, rcGetFirstSpan(hf, 0)) == nullptr);
+	}
+
+	SECTION("Spans freed by merging are reused by the next spans added.")
+	{
+		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 0, 1, area, flagMergeThr));
+		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 2, 3, area, flagMergeThr));
+		const rcSpan* lower = rcGetFirstSpan(hf, 0);
+		const rcSpan* upper = rcGetNextSpan(hf, lower);
+
+		// Merging frees both existing spans of the column.
+		REQUIRE(rcAddSpan(&ctx, hf, 0, 0, 1, 2, area, flagMergeThr));
+		const rcSpan* merged = rcGetFirstSpan(hf, 0);
+		REQUIRE(merged != lower);
+		REQUIRE(merged != upper);
+		REQUIRE(merged->smin == 0);
+		REQUIRE(merged->smax == 3);
+		REQUIRE(rcGetNextSpan(hf, merged) == nullptr);
+
+		REQUIRE(rcAddSpan(&ctx, hf, 1, 0, 0, 1, area, flagMergeThr));
+		REQUIRE(rcAddSpan(&ctx, hf, 2, 0, 0, 1, area, flagMergeThr));
+		const rcSpan* first = rcGetFirstSpan(hf, 1);
+		const rcSpan* second = rcGetFirstSpan(hf, 2);
+		REQUIRE(first != second);
+		REQUIRE((first == lower || first == upper));
+		REQUIRE((second == lower || second == upper));
+		REQUIRE(rcGetFirstSpan(hf, 0) == merged);
 	}
 
 }
@@ -217,11 +247,27 @@ TEST_CASE("allocSpan", "[recast][rasterization]")
 
 	SECTION("Attempting to add more spans than the span pool size allocates a new page")
 	{
+		STATIC_REQUIRE(xSize * zSize > RC_SPANS_PER_POOL);
+		for (int x = 0; x < xSize; x++)
+		{
+			for (int z = 0; z < zSize; z++)
+			{
+				REQUIRE(rcAddSpan(&ctx, hf, x, z, (unsigned short)x, (unsigned short)(x + 1), area, flagMergeThr));
+			}
+		}
+		REQUIRE(rcGetHeightFieldSpanCount(&ctx, hf) == xSize * zSize);
+
+		// The spans added before the storage grew are still intact.
 		for (int x = 0; x < xSize; x++)
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				REQUIRE(rcAddSpan(&ctx, hf, x, z, 0, 1, area, flagMergeThr));
+				const rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
+				REQUIRE(span != nullptr);
+				REQUIRE(span->smin == x);
+				REQUIRE(span->smax == x + 1);
+				REQUIRE(span->area == area);
+				REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 			}
 		}
 	}
@@ -272,14 +318,14 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				rcSpan* span = hf.spans[x + z * hf.width];
+				rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 				if ((x == 0 && z == 0) || (x == 0 && z == 1) || (x == 1 && z == 0))
 				{
 					REQUIRE(span != nullptr);
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 1);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else
 				{
@@ -303,14 +349,14 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				rcSpan* span = hf.spans[x + z * hf.width];
+				rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 				if (x == 0 && z == 0)
 				{
 					REQUIRE(span != nullptr);
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 1);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else
 				{
@@ -337,14 +383,14 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				rcSpan* span = hf.spans[x + z * hf.width];
+				rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 				if ((x == 0 && z == 0) || (x == 0 && z == 1) || (x == 1 && z == 0))
 				{
 					REQUIRE(span != nullptr);
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 1);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else
 				{
@@ -367,7 +413,7 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 			{
 				for (int z = 0; z < zSize; z++)
 				{
-					REQUIRE(hf.spans[x + z * hf.width] == nullptr);
+					REQUIRE(rcGetFirstSpan(hf, x + z * hf.width) == nullptr);
 				}
 			}
 		}
@@ -383,7 +429,7 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 			{
 				for (int z = 0; z < zSize; z++)
 				{
-					REQUIRE(hf.spans[x + z * hf.width] == nullptr);
+					REQUIRE(rcGetFirstSpan(hf, x + z * hf.width) == nullptr);
 				}
 			}
 		}
@@ -399,7 +445,7 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 			{
 				for (int z = 0; z < zSize; z++)
 				{
-					REQUIRE(hf.spans[x + z * hf.width] == nullptr);
+					REQUIRE(rcGetFirstSpan(hf, x + z * hf.width) == nullptr);
 				}
 			}
 		}
@@ -421,14 +467,14 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				rcSpan* span = hf.spans[x + z * hf.width];
+				rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 				if (x == 0 && z == 0)
 				{
 					REQUIRE(span != nullptr);
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 1);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else
 				{
@@ -452,14 +498,14 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				rcSpan* span = hf.spans[x + z * hf.width];
+				rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 				if (x == 0 && z == 0)
 				{
 					REQUIRE(span != nullptr);
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 3);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else
 				{
@@ -501,14 +547,14 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				rcSpan* span = hf.spans[x + z * hf.width];
+				rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 				if ((x == 0 && z == 0) || (x == 3 && z == 0))
 				{
 					REQUIRE(span != nullptr);
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 1);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else if ((x == 1 && z == 0) || (x == 2 && z == 0))
 				{
@@ -516,7 +562,7 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 2);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else
 				{
@@ -540,14 +586,14 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				rcSpan* span = hf.spans[x + z * hf.width];
+				rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 				if (x == 0 && z == 0)
 				{
 					REQUIRE(span != nullptr);
 					REQUIRE(span->smin == 0);
 					REQUIRE(span->smax == 10);
 					REQUIRE(span->area == RC_WALKABLE_AREA);
-					REQUIRE(span->next == nullptr);
+					REQUIRE(rcGetNextSpan(hf, span) == nullptr);
 				}
 				else
 				{
@@ -571,7 +617,7 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 			{
 				for (int z = 0; z < zSize; z++)
 				{
-					rcSpan* span = hf.spans[x + z * hf.width];
+					rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 					REQUIRE(span == nullptr);
 				}
 			}
@@ -586,7 +632,7 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 			{
 				for (int z = 0; z < zSize; z++)
 				{
-					rcSpan* span = hf.spans[x + z * hf.width];
+					rcSpan* span = rcGetFirstSpan(hf, x + z * hf.width);
 					REQUIRE(span == nullptr);
 				}
 			}
@@ -606,8 +652,150 @@ TEST_CASE("rcRasterizeTriangle", "[recast][rasterization]")
 		{
 			for (int z = 0; z < zSize; z++)
 			{
-				REQUIRE(hf.spans[x + z * hf.width] == nullptr);
+				REQUIRE(rcGetFirstSpan(hf, x + z * hf.width) == nullptr);
 			}
 		}
 	}
 }
+
+namespace
+{
+constexpr int randomXSize = 32;
+constexpr int randomZSize = 32;
+constexpr float randomCellSize = 0.5f;
+constexpr float randomCellHeight = 0.25f;
+constexpr float randomMinBounds[3] {-1.0f, -2.0f, -1.0f};
+constexpr float randomMaxBounds[3] {randomMinBounds[0] + randomCellSize * randomXSize, 6.0f, randomMinBounds[2] + randomCellSize * randomZSize};
+
+/// Random triangles that overlap the heightfield bounds in all directions,
+/// plus some with vertices exactly on cell borders.
+void generateRandomTriangles(const int numTris, std::vector<float>& verts, std::vector<unsigned char>& areas)
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> posDist(-3.0f, 18.0f);
+	std::uniform_real_distribution<float> heightDist(-3.0f, 7.0f);
+	std::uniform_int_distribution<int> gridDist(-4, 36);
+	for (int i = 0; i < numTris * 3; ++i)
+	{
+		if (i < numTris * 3 / 4)
+		{
+			verts.push_back(posDist(rng));
+			verts.push_back(heightDist(rng));
+			verts.push_back(posDist(rng));
+		}
+		else
+		{
+			verts.push_back(randomMinBounds[0] + (float)gridDist(rng) * randomCellSize);
+			verts.push_back((float)gridDist(rng) * randomCellHeight - 2.0f);
+			verts.push_back(randomMinBounds[2] + (float)gridDist(rng) * randomCellSize);
+		}
+	}
+	for (int i = 0; i < numTris; ++i)
+	{
+		areas.push_back((unsigned char)(1 + i % RC_WALKABLE_AREA));
+	}
+}
+
+/// Requires both heightfields to have the same spans and returns the span count.
+int requireSameSpans(const rcHeightfield& a, const rcHeightfield& b)
+{
+	REQUIRE(a.width == b.width);
+	REQUIRE(a.height == b.height);
+	int spanCount = 0;
+	for (int i = 0; i < a.width * a.height; ++i)
+	{
+		const rcSpan* spanA = rcGetFirstSpan(a, i);
+		const rcSpan* spanB = rcGetFirstSpan(b, i);
+		for (; spanA != nullptr && spanB != nullptr; spanA = rcGetNextSpan(a, spanA), spanB = rcGetNextSpan(b, spanB))
+		{
+			REQUIRE(spanA->smin == spanB->smin);
+			REQUIRE(spanA->smax == spanB->smax);
+			REQUIRE(spanA->area == spanB->area);
+			spanCount++;
+		}
+		REQUIRE(spanA == nullptr);
+		REQUIRE(spanB == nullptr);
+	}
+	return spanCount;
+}
+}
+
+TEST_CASE("rcRasterizeTriangles SIMD", "[recast][rasterization]")
+{
+	rcContext ctx(false);
+
+	constexpr int numTris = 2000;
+	std::vector<float> verts;
+	std::vector<unsigned char> areas;
+	generateRandomTriangles(numTris, verts, areas);
+
+	// Rasterize each triangle on its own, so that span merging can't hide any differences.
+	const bool simdEnabled = rcIsSimdEnabled();
+	int spanCount = 0;
+	for (int tri = 0; tri < numTris; ++tri)
+	{
+		const float* v0 = &verts[(tri * 3 + 0) * 3];
+		const float* v1 = &verts[(tri * 3 + 1) * 3];
+		const float* v2 = &verts[(tri * 3 + 2) * 3];
+
+		rcHeightfield scalarHf;
+		REQUIRE(rcCreateHeightfield(&ctx, scalarHf, randomXSize, randomZSize, randomMinBounds, randomMaxBounds, randomCellSize, randomCellHeight));
+		rcSetSimdEnabled(false);
+		REQUIRE(rcRasterizeTriangle(&ctx, v0, v1, v2, areas[tri], scalarHf, 1));
+
+		rcHeightfield simdHf;
+		REQUIRE(rcCreateHeightfield(&ctx, simdHf, randomXSize, randomZSize, randomMinBounds, randomMaxBounds, randomCellSize, randomCellHeight));
+		rcSetSimdEnabled(true);
+		REQUIRE(rcRasterizeTriangle(&ctx, v0, v1, v2, areas[tri], simdHf, 1));
+
+		spanCount += requireSameSpans(scalarHf, simdHf);
+	}
+	rcSetSimdEnabled(simdEnabled);
+	REQUIRE(spanCount > 0);
+
+	// The batched version produces the same heightfield.
+	rcHeightfield scalarHf;
+	REQUIRE(rcCreateHeightfield(&ctx, scalarHf, randomXSize, randomZSize, randomMinBounds, randomMaxBounds, randomCellSize, randomCellHeight));
+	rcSetSimdEnabled(false);
+	REQUIRE(rcRasterizeTriangles(&ctx, verts.data(), areas.data(), numTris, scalarHf, 1));
+
+	rcHeightfield simdHf;
+	REQUIRE(rcCreateHeightfield(&ctx, simdHf, randomXSize, randomZSize, randomMinBounds, randomMaxBounds, randomCellSize, randomCellHeight));
+	rcSetSimdEnabled(true);
+	REQUIRE(rcRasterizeTriangles(&ctx, verts.data(), areas.data(), numTris, simdHf, 1));
+	rcSetSimdEnabled(simdEnabled);
+
+	requireSameSpans(scalarHf, simdHf);
+}
+
+TEST_CASE("rcRasterizeTriangles parallel", "[recast][rasterization]")
+{
+	constexpr int numTris = 2000;
+	std::vector<float> verts;
+	std::vector<unsigned char> areas;
+	generateRandomTriangles(numTris, verts, areas);
+
+	std::vector<int> tris(numTris * 3);
+	for (int i = 0; i < numTris * 3; ++i)
+	{
+		tris[i] = i;
+	}
+
+	// Rasterize in two batches, so that the second one merges with existing spans.
+	constexpr int firstBatch = numTris / 2;
+
+	rcContext serialCtx(false);
+	rcHeightfield serialHf;
+	REQUIRE(rcCreateHeightfield(&serialCtx, serialHf, randomXSize, randomZSize, randomMinBounds, randomMaxBounds, randomCellSize, randomCellHeight));
+	REQUIRE(rcRasterizeTriangles(&serialCtx, verts.data(), areas.data(), firstBatch, serialHf, 1));
+	REQUIRE(rcRasterizeTriangles(&serialCtx, verts.data(), (int)verts.size() / 3, tris.data() + firstBatch * 3, areas.data() + firstBatch, numTris - firstBatch, serialHf, 1));
+
+	rcContext ctx(false);
+	forEachThreadPool(&ctx, [&](TestThreadPool&) {
+		rcHeightfield hf;
+		REQUIRE(rcCreateHeightfield(&ctx, hf, randomXSize, randomZSize, randomMinBounds, randomMaxBounds, randomCellSize, randomCellHeight));
+		REQUIRE(rcRasterizeTriangles(&ctx, verts.data(), areas.data(), firstBatch, hf, 1));
+		REQUIRE(rcRasterizeTriangles(&ctx, verts.data(), (int)verts.size() / 3, tris.data() + firstBatch * 3, areas.data() + firstBatch, numTris - firstBatch, hf, 1));
+		REQUIRE(requireSameSpans(serialHf, hf) > 0);
+	});
+}
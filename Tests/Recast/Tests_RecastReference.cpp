@@ -0,0 +1,213 @@
+#include <string.h>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "Recast.h"
+#include "TestGeometry.h"
+#include "TestParallel.h"
+
+// The reference checksums were recorded with the single threaded build of Recast 1.6.0
+// on x86-64. They cover the output of each build stage bit by bit, so the optimized and
+// parallel code paths must produce exactly the output of the original implementation.
+
+namespace
+{
+constexpr int fieldSize = 120;
+constexpr float fieldCellSize = 0.5f;
+constexpr float fieldCellHeight = 0.2f;
+constexpr int walkableHeight = 5;
+constexpr int walkableClimb = 2;
+
+enum PartitionType
+{
+	PARTITION_WATERSHED,
+	PARTITION_MONOTONE,
+	PARTITION_LAYERS,
+};
+
+/// The checksums of the output of each build stage.
+struct BuildChecksums
+{
+	unsigned int compactHeightfield;
+	unsigned int distanceField;
+	unsigned int regions;
+	unsigned int contours;
+	unsigned int polyMesh;
+	unsigned int detailMesh;
+};
+
+/// The reference checksums for each partition type.
+const BuildChecksums referenceChecksums[3] = {
+	{ 0x4b770216u, 0x1fc1457cu, 0xdd4aeb40u, 0xd3c2250eu, 0xb3dfe0f2u, 0x31919397u },
+	{ 0x4b770216u, 0x00000000u, 0x5901a486u, 0x1c628e06u, 0x5ad60551u, 0x31f6c6ccu },
+	{ 0x4b770216u, 0x00000000u, 0xadb473ebu, 0xb98d1a3bu, 0xc306d8a4u, 0x5d1b29d3u },
+};
+
+const unsigned int hashSeed = 2166136261u;
+
+/// Adds the bytes to a 32-bit FNV-1a hash.
+unsigned int hashBytes(unsigned int hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+template<class T>
+unsigned int hashValue(unsigned int hash, const T& value)
+{
+	return hashBytes(hash, &value, sizeof(value));
+}
+
+template<class T>
+unsigned int hashArray(unsigned int hash, const T* data, int count)
+{
+	return count > 0 ? hashBytes(hash, data, sizeof(T) * count) : hash;
+}
+
+/// Hashes the span fields one by one, since the span layout may have padding.
+unsigned int hashSpans(unsigned int hash, const rcCompactHeightfield& chf)
+{
+	for (int i = 0; i < chf.spanCount; ++i)
+	{
+		const rcCompactSpan& s = chf.spans[i];
+		hash = hashValue(hash, (unsigned int)s.y);
+		hash = hashValue(hash, (unsigned int)s.reg);
+		hash = hashValue(hash, (unsigned int)s.con);
+		hash = hashValue(hash, (unsigned int)s.h);
+	}
+	return hash;
+}
+
+/// Builds the geometry into a detail mesh and returns the checksums of each stage.
+///  @param[in]	fusedFilter			Filter the heightfield with #rcFilterHeightfield instead of the separate filters.
+///  @param[in]	neighborIndices		Build the neighbor span indices of the compact heightfield.
+BuildChecksums buildChecksums(rcContext& ctx, const TestGeometry& geom, PartitionType partitionType,
+							  bool fusedFilter, bool neighborIndices)
+{
+	const float bmin[3] = { 0.0f, -1.0f, 0.0f };
+	const float bmax[3] = { fieldSize * fieldCellSize, 5.0f, fieldSize * fieldCellSize };
+	BuildChecksums checksums;
+	memset(&checksums, 0, sizeof(checksums));
+
+	rcHeightfield solid;
+	REQUIRE(rcCreateHeightfield(&ctx, solid, fieldSize, fieldSize, bmin, bmax, fieldCellSize, fieldCellHeight));
+	REQUIRE(rcRasterizeTriangles(&ctx, geom.verts.data(), geom.getVertCount(), geom.tris.data(), geom.areas.data(),
+								 geom.getTriCount(), solid, walkableClimb));
+	if (fusedFilter)
+	{
+		rcFilterHeightfield(&ctx, RC_FILTER_ALL, walkableHeight, walkableClimb, solid);
+	}
+	else
+	{
+		rcFilterLowHangingWalkableObstacles(&ctx, walkableClimb, solid);
+		rcFilterLedgeSpans(&ctx, walkableHeight, walkableClimb, solid);
+		rcFilterWalkableLowHeightSpans(&ctx, walkableHeight, solid);
+	}
+
+	rcCompactHeightfield chf;
+	REQUIRE(rcBuildCompactHeightfield(&ctx, walkableHeight, walkableClimb, solid, chf));
+	if (neighborIndices)
+	{
+		REQUIRE(rcBuildNeighborIndices(&ctx, chf));
+	}
+	REQUIRE(rcErodeWalkableArea(&ctx, 1, chf));
+	checksums.compactHeightfield = hashArray(hashSpans(hashArray(hashSeed, chf.cells, chf.width * chf.height), chf),
+											 chf.areas, chf.spanCount);
+
+	switch (partitionType)
+	{
+	case PARTITION_WATERSHED:
+		REQUIRE(rcBuildDistanceField(&ctx, chf));
+		checksums.distanceField = hashValue(hashArray(hashSeed, chf.dist, chf.spanCount), chf.maxDistance);
+		REQUIRE(rcBuildRegions(&ctx, chf, 0, 8, 20));
+		break;
+	case PARTITION_MONOTONE:
+		REQUIRE(rcBuildRegionsMonotone(&ctx, chf, 0, 8, 20));
+		break;
+	case PARTITION_LAYERS:
+		REQUIRE(rcBuildLayerRegions(&ctx, chf, 0, 8));
+		break;
+	}
+	checksums.regions = hashValue(hashSpans(hashSeed, chf), (unsigned int)chf.maxRegions);
+
+	rcContourSet cset;
+	REQUIRE(rcBuildContours(&ctx, chf, 1.3f, 12, cset, RC_CONTOUR_TESS_WALL_EDGES));
+	unsigned int hash = hashValue(hashSeed, cset.nconts);
+	for (int i = 0; i < cset.nconts; ++i)
+	{
+		const rcContour& cont = cset.conts[i];
+		hash = hashValue(hash, cont.nverts);
+		hash = hashArray(hash, cont.verts, cont.nverts * 4);
+		hash = hashValue(hash, cont.nrverts);
+		hash = hashArray(hash, cont.rverts, cont.nrverts * 4);
+		hash = hashValue(hash, (unsigned int)cont.reg);
+		hash = hashValue(hash, (unsigned int)cont.area);
+	}
+	checksums.contours = hash;
+
+	rcPolyMesh mesh;
+	REQUIRE(rcBuildPolyMesh(&ctx, cset, 6, mesh));
+	hash = hashValue(hashSeed, mesh.nverts);
+	hash = hashArray(hash, mesh.verts, mesh.nverts * 3);
+	hash = hashValue(hash, mesh.npolys);
+	hash = hashArray(hash, mesh.polys, mesh.npolys * mesh.nvp * 2);
+	hash = hashArray(hash, mesh.regs, mesh.npolys);
+	hash = hashArray(hash, mesh.areas, mesh.npolys);
+	checksums.polyMesh = hash;
+
+	rcPolyMeshDetail* detail = rcAllocPolyMeshDetail();
+	REQUIRE(detail != NULL);
+	const rcPolyMeshDetail& dmesh = *detail;
+	REQUIRE(rcBuildPolyMeshDetail(&ctx, mesh, chf, fieldCellSize * 6.0f, fieldCellHeight, *detail));
+	hash = hashValue(hashSeed, dmesh.nmeshes);
+	hash = hashArray(hash, dmesh.meshes, dmesh.nmeshes * 4);
+	hash = hashValue(hash, dmesh.nverts);
+	hash = hashArray(hash, dmesh.verts, dmesh.nverts * 3);
+	hash = hashValue(hash, dmesh.ntris);
+	hash = hashArray(hash, dmesh.tris, dmesh.ntris * 4);
+	checksums.detailMesh = hash;
+	rcFreePolyMeshDetail(detail);
+
+	return checksums;
+}
+}
+
+TEST_CASE("Build output matches the reference", "[recast, reference]")
+{
+#if !defined(__x86_64__) && !defined(_M_X64)
+	SKIP("The reference checksums depend on the x86-64 floating point behavior.");
+#endif
+
+	const TestGeometry geom = makeBumpyTerrain(fieldSize / 3, 3.0f * fieldCellSize, 1.0f, 20, 11);
+	unsigned int geomHash = hashArray(hashSeed, geom.verts.data(), (int)geom.verts.size());
+	geomHash = hashArray(geomHash, geom.tris.data(), (int)geom.tris.size());
+	geomHash = hashArray(geomHash, geom.areas.data(), (int)geom.areas.size());
+	REQUIRE(geomHash == 0x368dcc54u);
+
+	rcContext ctx(false);
+	for (int partitionType = PARTITION_WATERSHED; partitionType <= PARTITION_LAYERS; ++partitionType)
+	{
+		CAPTURE(partitionType);
+		const BuildChecksums& expected = referenceChecksums[partitionType];
+		forEachThreadPool(&ctx, [&](TestThreadPool&) {
+			for (int variant = 0; variant < 4; ++variant)
+			{
+				const bool fusedFilter = (variant & 1) != 0;
+				const bool neighborIndices = (variant & 2) != 0;
+				CAPTURE(fusedFilter, neighborIndices);
+				const BuildChecksums checksums = buildChecksums(ctx, geom, (PartitionType)partitionType,
+																fusedFilter, neighborIndices);
+				REQUIRE(checksums.compactHeightfield == expected.compactHeightfield);
+				REQUIRE(checksums.distanceField == expected.distanceField);
+				REQUIRE(checksums.regions == expected.regions);
+				REQUIRE(checksums.contours == expected.contours);
+				REQUIRE(checksums.polyMesh == expected.polyMesh);
+				REQUIRE(checksums.detailMesh == expected.detailMesh);
+			}
+		});
+	}
+}
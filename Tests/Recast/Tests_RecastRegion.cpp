@@ -0,0 +1,122 @@
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "Recast.h"
+#include "TestGeometry.h"
+#include "TestParallel.h"
+
+namespace
+{
+constexpr int terrainSize = 150;
+constexpr float terrainCellSize = 0.5f;
+constexpr float terrainCellHeight = 0.2f;
+
+/// A bumpy terrain with a few areas and overlapping platforms, large enough for the parallel code paths.
+TestGeometry makeTerrain()
+{
+	return makeBumpyTerrain(terrainSize / 2, 2.0f * terrainCellSize, 0.6f, 40, 7);
+}
+
+void buildCompactHeightfield(rcContext& ctx, const TestGeometry& geom, rcCompactHeightfield& chf)
+{
+	const float bmin[3] = { 0.0f, -1.0f, 0.0f };
+	const float bmax[3] = { terrainSize * terrainCellSize, 5.0f, terrainSize * terrainCellSize };
+
+	rcHeightfield solid;
+	REQUIRE(rcCreateHeightfield(&ctx, solid, terrainSize, terrainSize, bmin, bmax, terrainCellSize, terrainCellHeight));
+	REQUIRE(rcRasterizeTriangles(&ctx, geom.verts.data(), geom.getVertCount(), geom.tris.data(), geom.areas.data(),
+								 geom.getTriCount(), solid, 2));
+	rcFilterLowHangingWalkableObstacles(&ctx, 2, solid);
+	rcFilterLedgeSpans(&ctx, 5, 2, solid);
+	rcFilterWalkableLowHeightSpans(&ctx, 5, solid);
+	REQUIRE(rcBuildCompactHeightfield(&ctx, 5, 2, solid, chf));
+	REQUIRE(rcErodeWalkableArea(&ctx, 1, chf));
+}
+}
+
+TEST_CASE("rcBuildDistanceField parallel", "[recast, region, parallel]")
+{
+	const TestGeometry geom = makeTerrain();
+	rcContext ctx(false);
+
+	rcCompactHeightfield expected;
+	buildCompactHeightfield(ctx, geom, expected);
+	REQUIRE(rcBuildDistanceField(&ctx, expected));
+	REQUIRE(expected.maxDistance > 0);
+
+	SECTION("The distance field does not depend on the thread count")
+	{
+		forEachThreadPool(&ctx, [&](TestThreadPool&) {
+			rcCompactHeightfield chf;
+			buildCompactHeightfield(ctx, geom, chf);
+			REQUIRE(rcBuildDistanceField(&ctx, chf));
+			REQUIRE(chf.spanCount == expected.spanCount);
+			REQUIRE(chf.maxDistance == expected.maxDistance);
+			REQUIRE(sameData(chf.dist, expected.dist, chf.spanCount));
+		});
+	}
+}
+
+TEST_CASE("rcBuildRegions", "[recast, region]")
+{
+	const TestGeometry geom = makeTerrain();
+	rcContext ctx(false);
+
+	rcCompactHeightfield chf;
+	buildCompactHeightfield(ctx, geom, chf);
+	REQUIRE(rcBuildDistanceField(&ctx, chf));
+
+	const int borderSize = 4;
+	REQUIRE(rcBuildRegions(&ctx, chf, borderSize, 8, 20));
+	REQUIRE(chf.maxRegions > 1);
+
+	SECTION("Region ids are in range")
+	{
+		for (int i = 0; i < chf.spanCount; ++i)
+		{
+			const unsigned short reg = chf.spans[i].reg;
+			if ((reg & RC_BORDER_REG) == 0)
+			{
+				REQUIRE(reg <= chf.maxRegions);
+			}
+		}
+	}
+
+	SECTION("Border cells are in border regions")
+	{
+		for (int y = 0; y < chf.height; ++y)
+		{
+			for (int x = 0; x < chf.width; ++x)
+			{
+				const bool border = x < borderSize || y < borderSize || x >= chf.width - borderSize || y >= chf.height - borderSize;
+				const rcCompactCell& c = chf.cells[x + y * chf.width];
+				for (int i = (int)c.index, ni = (int)(c.index + c.count); i < ni; ++i)
+				{
+					if (chf.areas[i] != RC_NULL_AREA)
+					{
+						REQUIRE(((chf.spans[i].reg & RC_BORDER_REG) != 0) == border);
+					}
+				}
+			}
+		}
+	}
+
+	SECTION("Rebuilding gives the same regions")
+	{
+		std::vector<unsigned short> expected(chf.spanCount);
+		for (int i = 0; i < chf.spanCount; ++i)
+		{
+			expected[i] = chf.spans[i].reg;
+		}
+		const int maxRegions = chf.maxRegions;
+
+		REQUIRE(rcBuildRegions(&ctx, chf, borderSize, 8, 20));
+		REQUIRE(chf.maxRegions == maxRegions);
+		for (int i = 0; i < chf.spanCount; ++i)
+		{
+			REQUIRE(chf.spans[i].reg == expected[i]);
+		}
+	}
+}
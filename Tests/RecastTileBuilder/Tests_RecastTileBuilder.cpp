@@ -0,0 +1,119 @@
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourNavMesh.h"
+#include "Recast.h"
+#include "RecastTileBuilder.h"
+#include "TestNavMesh.h"
+#include "TestParallel.h"
+
+namespace
+{
+/// A bumpy square terrain with a few boxes on top.
+TestGeometry makeTerrain()
+{
+	const int size = 40;
+	std::vector<float> heights((size + 1) * (size + 1));
+	for (int z = 0; z <= size; ++z)
+	{
+		for (int x = 0; x <= size; ++x)
+		{
+			heights[x + z * (size + 1)] = (float)((x * 7 + z * 13) % 5) * 0.05f;
+		}
+	}
+	TestGeometry geom;
+	geom.addHeightGrid(size, 1.0f, heights.data());
+	geom.addBox(5.0f, 5.0f, 9.0f, 7.0f, -0.5f, 2.0f);
+	geom.addBox(18.0f, 12.0f, 20.0f, 30.0f, -0.5f, 3.0f);
+	geom.addBox(28.0f, 25.0f, 33.0f, 27.5f, -0.5f, 0.3f);
+	return geom;
+}
+}
+
+TEST_CASE("rcBuildNavMeshTiles", "[recast, tilebuilder]")
+{
+	const TestGeometry geom = makeTerrain();
+	const rcConfig cfg = makeTestConfig(geom);
+	const rcTileBuildParams params = makeTileBuildParams(geom);
+
+	rcContext ctx(false);
+
+	int tileWidth = 0;
+	int tileHeight = 0;
+	rcCalcTileGridSize(cfg, &tileWidth, &tileHeight);
+	REQUIRE(tileWidth == 5);
+	REQUIRE(tileHeight == 5);
+
+	rcNavMeshTileSet* serial = rcAllocNavMeshTileSet();
+	REQUIRE(rcBuildNavMeshTiles(&ctx, cfg, params, 1, *serial));
+	REQUIRE(serial->tileWidth == tileWidth);
+	REQUIRE(serial->tileHeight == tileHeight);
+	REQUIRE(serial->ntiles == tileWidth * tileHeight);
+
+	SECTION("Output does not depend on the thread count")
+	{
+		for (int numThreads = 2; numThreads <= 8; numThreads *= 2)
+		{
+			rcNavMeshTileSet* parallel = rcAllocNavMeshTileSet();
+			REQUIRE(rcBuildNavMeshTiles(&ctx, cfg, params, numThreads, *parallel));
+			REQUIRE(parallel->ntiles == serial->ntiles);
+			for (int i = 0; i < serial->ntiles; ++i)
+			{
+				REQUIRE(parallel->tiles[i].tx == serial->tiles[i].tx);
+				REQUIRE(parallel->tiles[i].ty == serial->tiles[i].ty);
+				REQUIRE(parallel->tiles[i].dataSize == serial->tiles[i].dataSize);
+				REQUIRE(sameData(parallel->tiles[i].data, serial->tiles[i].data, serial->tiles[i].dataSize));
+			}
+			rcFreeNavMeshTileSet(parallel);
+		}
+	}
+
+	SECTION("Output does not depend on the temporary arena")
+	{
+		// The small arena makes the larger allocations fall back to the heap.
+		const size_t arenaSizes[2] = { 16 * 1024, 16 * 1024 * 1024 };
+		for (int i = 0; i < 2; ++i)
+		{
+			rcTileBuildParams arenaParams = params;
+			arenaParams.tempArenaSize = arenaSizes[i];
+			rcNavMeshTileSet* built = rcAllocNavMeshTileSet();
+			REQUIRE(rcBuildNavMeshTiles(&ctx, cfg, arenaParams, 2, *built));
+			REQUIRE(built->ntiles == serial->ntiles);
+			for (int j = 0; j < serial->ntiles; ++j)
+			{
+				REQUIRE(built->tiles[j].dataSize == serial->tiles[j].dataSize);
+				REQUIRE(sameData(built->tiles[j].data, serial->tiles[j].data, serial->tiles[j].dataSize));
+			}
+			rcFreeNavMeshTileSet(built);
+		}
+	}
+
+	SECTION("Output does not depend on the neighbor indices")
+	{
+		rcTileBuildParams neighborParams = params;
+		neighborParams.buildNeighborIndices = true;
+		rcNavMeshTileSet* built = rcAllocNavMeshTileSet();
+		REQUIRE(rcBuildNavMeshTiles(&ctx, cfg, neighborParams, 2, *built));
+		REQUIRE(built->ntiles == serial->ntiles);
+		for (int i = 0; i < serial->ntiles; ++i)
+		{
+			REQUIRE(built->tiles[i].dataSize == serial->tiles[i].dataSize);
+			REQUIRE(sameData(built->tiles[i].data, serial->tiles[i].data, serial->tiles[i].dataSize));
+		}
+		rcFreeNavMeshTileSet(built);
+	}
+
+	SECTION("Tiles can be added to a navmesh")
+	{
+		dtNavMesh* navMesh = buildTestNavMesh(cfg, params);
+		for (int i = 0; i < serial->ntiles; ++i)
+		{
+			REQUIRE(navMesh->getTileAt(serial->tiles[i].tx, serial->tiles[i].ty, 0) != NULL);
+		}
+		dtFreeNavMesh(navMesh);
+	}
+
+	rcFreeNavMeshTileSet(serial);
+}
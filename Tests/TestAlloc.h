@@ -0,0 +1,52 @@
+#ifndef TESTALLOC_H
+#define TESTALLOC_H
+
+#include <stdlib.h>
+
+#include "DetourAlloc.h"
+
+/// Makes a Detour allocation fail after a number of successful allocations,
+/// for the duration of a test scope.
+class TestFailingDetourAlloc
+{
+public:
+	///  @param[in]	allocCount	The number of allocations that succeed before one fails.
+	///  @param[in]	size		The size of the allocations that are counted and may fail, or zero for all.
+	explicit TestFailingDetourAlloc(int allocCount, size_t size = 0)
+	{
+		s_remainingAllocs = allocCount;
+		s_size = size;
+		s_failed = false;
+		dtAllocSetCustom(alloc, NULL);
+	}
+
+	~TestFailingDetourAlloc()
+	{
+		dtAllocSetCustom(NULL, NULL);
+	}
+
+	/// Returns true if an allocation has failed.
+	static bool hasFailed() { return s_failed; }
+
+private:
+	static void* alloc(size_t size, dtAllocHint)
+	{
+		if (s_failed || (s_size != 0 && size != s_size))
+		{
+			return malloc(size);
+		}
+		if (s_remainingAllocs == 0)
+		{
+			s_failed = true;
+			return NULL;
+		}
+		s_remainingAllocs--;
+		return malloc(size);
+	}
+
+	static inline int s_remainingAllocs = 0;
+	static inline size_t s_size = 0;
+	static inline bool s_failed = false;
+};
+
+#endif // TESTALLOC_H
@@ -0,0 +1,210 @@
+#ifndef TESTGEOMETRY_H
+#define TESTGEOMETRY_H
+
+#include <string.h>
+#include <vector>
+
+#include "Recast.h"
+#include "RecastTileBuilder.h"
+
+/// A small random number generator that gives the same sequence with every standard library.
+class TestRandom
+{
+public:
+	explicit TestRandom(unsigned int seed) : m_state(seed) {}
+
+	/// Returns a random number in the range [0, 1).
+	float next()
+	{
+		m_state = m_state * 1103515245u + 12345u;
+		return (float)((m_state >> 8) & 0xffff) / 65536.0f;
+	}
+
+	/// Returns a random number in the range [@p min, @p max).
+	float range(float min, float max) { return min + next() * (max - min); }
+
+private:
+	unsigned int m_state;
+};
+
+/// A triangle mesh that the build tests rasterize.
+struct TestGeometry
+{
+	std::vector<float> verts;			///< The vertices. [(x, y, z) * getVertCount()]
+	std::vector<int> tris;				///< The triangle vertex indices. [(vertA, vertB, vertC) * getTriCount()]
+	std::vector<unsigned char> areas;	///< The area id of each triangle. [Size: getTriCount()]
+
+	int getVertCount() const { return (int)verts.size() / 3; }
+	int getTriCount() const { return (int)tris.size() / 3; }
+
+	int addVert(float x, float y, float z)
+	{
+		verts.push_back(x);
+		verts.push_back(y);
+		verts.push_back(z);
+		return getVertCount() - 1;
+	}
+
+	void addTri(int a, int b, int c, unsigned char area = RC_WALKABLE_AREA)
+	{
+		tris.push_back(a);
+		tris.push_back(b);
+		tris.push_back(c);
+		areas.push_back(area);
+	}
+
+	/// Adds an upward facing quad with the given heights at the corners
+	/// (x0, z0), (x1, z0), (x1, z1) and (x0, z1).
+	void addQuad(float x0, float z0, float x1, float z1, const float* heights, unsigned char area = RC_WALKABLE_AREA)
+	{
+		const int a = addVert(x0, heights[0], z0);
+		const int b = addVert(x1, heights[1], z0);
+		const int c = addVert(x1, heights[2], z1);
+		const int d = addVert(x0, heights[3], z1);
+		addTri(a, d, c, area);
+		addTri(a, c, b, area);
+	}
+
+	/// Adds a flat, upward facing quad at the height @p y.
+	void addQuad(float x0, float z0, float x1, float z1, float y, unsigned char area = RC_WALKABLE_AREA)
+	{
+		const float heights[4] = { y, y, y, y };
+		addQuad(x0, z0, x1, z1, heights, area);
+	}
+
+	/// Adds the top and the sides of a box from @p y0 to @p y1.
+	void addBox(float x0, float z0, float x1, float z1, float y0, float y1)
+	{
+		const int base = getVertCount();
+		const float xs[2] = { x0, x1 };
+		const float zs[2] = { z0, z1 };
+		for (int y = 0; y < 2; ++y)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				addVert(xs[(i == 1 || i == 2) ? 1 : 0], y ? y1 : y0, zs[i >= 2 ? 1 : 0]);
+			}
+		}
+		// Top
+		addTri(base + 4, base + 7, base + 6);
+		addTri(base + 4, base + 6, base + 5);
+		// Sides
+		for (int i = 0; i < 4; ++i)
+		{
+			const int j = (i + 1) % 4;
+			addTri(base + i, base + j, base + 4 + j);
+			addTri(base + i, base + 4 + j, base + 4 + i);
+		}
+	}
+
+	/// Adds a square grid of @p size x @p size quads that starts at the origin.
+	///  @param[in]	size		The number of quads along each axis.
+	///  @param[in]	spacing		The size of the quads.
+	///  @param[in]	heights		The vertex heights, row by row along the x-axis. [Size: (size + 1)^2]
+	///  @param[in]	quadAreas	The area ids of the quads, or null for walkable quads. [Size: size^2]
+	void addHeightGrid(int size, float spacing, const float* heights, const unsigned char* quadAreas = NULL)
+	{
+		const int base = getVertCount();
+		for (int z = 0; z <= size; ++z)
+		{
+			for (int x = 0; x <= size; ++x)
+			{
+				addVert((float)x * spacing, heights[x + z * (size + 1)], (float)z * spacing);
+			}
+		}
+		for (int z = 0; z < size; ++z)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				const int i = base + x + z * (size + 1);
+				const unsigned char area = quadAreas ? quadAreas[x + z * size] : RC_WALKABLE_AREA;
+				addTri(i, i + size + 1, i + size + 2, area);
+				addTri(i, i + size + 2, i + 1, area);
+			}
+		}
+	}
+};
+
+/// Creates a square terrain with random heights and random platforms above it, some of
+/// them overlapping. About one in eight terrain quads has an area id of 2.
+///  @param[in]	size			The number of terrain quads along each axis.
+///  @param[in]	spacing			The size of the terrain quads.
+///  @param[in]	maxHeight		The maximum height of the terrain.
+///  @param[in]	platformCount	The number of platforms.
+///  @param[in]	seed			The seed of the random numbers.
+inline TestGeometry makeBumpyTerrain(int size, float spacing, float maxHeight, int platformCount, unsigned int seed)
+{
+	TestRandom rng(seed);
+	TestGeometry geom;
+
+	std::vector<float> heights((size + 1) * (size + 1));
+	for (size_t i = 0; i < heights.size(); ++i)
+	{
+		heights[i] = rng.range(0.0f, maxHeight);
+	}
+	std::vector<unsigned char> quadAreas(size * size);
+	for (size_t i = 0; i < quadAreas.size(); ++i)
+	{
+		quadAreas[i] = rng.next() < 0.125f ? 2 : RC_WALKABLE_AREA;
+	}
+	geom.addHeightGrid(size, spacing, heights.data(), quadAreas.data());
+
+	const float extent = (float)size * spacing;
+	for (int i = 0; i < platformCount; ++i)
+	{
+		const float x0 = rng.range(0.0f, extent - 10.0f);
+		const float z0 = rng.range(0.0f, extent - 10.0f);
+		const float x1 = x0 + rng.range(2.0f, 10.0f);
+		const float z1 = z0 + rng.range(2.0f, 10.0f);
+		const float y = rng.range(1.5f, 4.0f);
+		float cornerHeights[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			cornerHeights[j] = y + rng.range(0.0f, 0.5f);
+		}
+		geom.addQuad(x0, z0, x1, z1, cornerHeights);
+	}
+	return geom;
+}
+
+/// Returns the build configuration of the navigation mesh tests, with a tile size
+/// of 32 cells and bounds that cover the geometry.
+inline rcConfig makeTestConfig(const TestGeometry& geom)
+{
+	rcConfig cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.cs = 0.3f;
+	cfg.ch = 0.2f;
+	cfg.walkableSlopeAngle = 45.0f;
+	cfg.walkableHeight = 10;
+	cfg.walkableClimb = 4;
+	cfg.walkableRadius = 2;
+	cfg.maxEdgeLen = 40;
+	cfg.maxSimplificationError = 1.3f;
+	cfg.minRegionArea = 8;
+	cfg.mergeRegionArea = 20;
+	cfg.maxVertsPerPoly = 6;
+	cfg.tileSize = 32;
+	cfg.borderSize = cfg.walkableRadius + 3;
+	cfg.detailSampleDist = 1.8f;
+	cfg.detailSampleMaxError = 0.2f;
+	rcCalcBounds(geom.verts.data(), geom.getVertCount(), cfg.bmin, cfg.bmax);
+	// Flat geometry needs room above and below it.
+	cfg.bmin[1] -= 1.0f;
+	cfg.bmax[1] += 1.0f;
+	return cfg;
+}
+
+/// Returns the tile build parameters for the geometry. The triangle areas are derived
+/// from rcConfig::walkableSlopeAngle.
+inline rcTileBuildParams makeTileBuildParams(const TestGeometry& geom)
+{
+	rcTileBuildParams params;
+	params.verts = geom.verts.data();
+	params.nverts = geom.getVertCount();
+	params.tris = geom.tris.data();
+	params.ntris = geom.getTriCount();
+	return params;
+}
+
+#endif // TESTGEOMETRY_H
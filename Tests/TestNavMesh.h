@@ -0,0 +1,117 @@
+#ifndef TESTNAVMESH_H
+#define TESTNAVMESH_H
+
+#include <string.h>
+#include <vector>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+#include "Recast.h"
+#include "RecastTileBuilder.h"
+#include "TestGeometry.h"
+
+/// Builds the tiles of a navigation mesh on a single thread and adds them to a new navigation mesh.
+/// The caller frees the navigation mesh with #dtFreeNavMesh.
+inline dtNavMesh* buildTestNavMesh(const rcConfig& cfg, const rcTileBuildParams& params)
+{
+	rcContext ctx(false);
+	rcNavMeshTileSet* tileSet = rcAllocNavMeshTileSet();
+	REQUIRE(tileSet != NULL);
+	const bool built = rcBuildNavMeshTiles(&ctx, cfg, params, 1, *tileSet);
+	if (!built)
+	{
+		rcFreeNavMeshTileSet(tileSet);
+	}
+	REQUIRE(built);
+
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	dtVcopy(navParams.orig, cfg.bmin);
+	navParams.tileWidth = (float)cfg.tileSize * cfg.cs;
+	navParams.tileHeight = (float)cfg.tileSize * cfg.cs;
+	navParams.maxTiles = 64;
+	navParams.maxPolys = 1 << 12;
+
+	dtNavMesh* navMesh = dtAllocNavMesh();
+	REQUIRE(navMesh != NULL);
+	REQUIRE(dtStatusSucceed(navMesh->init(&navParams)));
+	for (int i = 0; i < tileSet->ntiles; ++i)
+	{
+		rcNavMeshTileData& tile = tileSet->tiles[i];
+		REQUIRE(dtStatusSucceed(navMesh->addTile(tile.data, tile.dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		tile.data = NULL;
+	}
+	rcFreeNavMeshTileSet(tileSet);
+	return navMesh;
+}
+
+/// Builds a navigation mesh for the geometry with the default test configuration.
+inline dtNavMesh* buildTestNavMesh(const TestGeometry& geom)
+{
+	return buildTestNavMesh(makeTestConfig(geom), makeTileBuildParams(geom));
+}
+
+/// Builds two platforms separated by a gap, connected by an off-mesh connection.
+inline dtNavMesh* buildGapNavMesh()
+{
+	TestGeometry geom;
+	geom.addQuad(0.0f, 0.0f, 20.0f, 20.0f, 0.0f);
+	geom.addQuad(24.0f, 0.0f, 44.0f, 20.0f, 0.0f);
+
+	const float offMeshConVerts[] = { 19.0f, 0.0f, 10.0f, 25.0f, 0.0f, 10.0f };
+	const float offMeshConRad = 0.6f;
+	const unsigned short offMeshConFlags = 1;
+	const unsigned char offMeshConArea = RC_WALKABLE_AREA;
+	const unsigned char offMeshConDir = DT_OFFMESH_CON_BIDIR;
+	const unsigned int offMeshConUserID = 1;
+
+	rcTileBuildParams params = makeTileBuildParams(geom);
+	params.offMeshConVerts = offMeshConVerts;
+	params.offMeshConRad = &offMeshConRad;
+	params.offMeshConFlags = &offMeshConFlags;
+	params.offMeshConAreas = &offMeshConArea;
+	params.offMeshConDir = &offMeshConDir;
+	params.offMeshConUserID = &offMeshConUserID;
+	params.offMeshConCount = 1;
+	return buildTestNavMesh(makeTestConfig(geom), params);
+}
+
+/// Finds a path across the navigation mesh of #buildGapNavMesh, and returns its straight path.
+///  @param[in]		navMesh		The navigation mesh.
+///  @param[out]	path		The polygons of the path.
+inline std::vector<float> findGapPath(const dtNavMesh* navMesh, std::vector<dtPolyRef>& path)
+{
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(dtStatusSucceed(query->init(navMesh, 2048)));
+	dtQueryFilter filter;
+
+	const float halfExtents[3] = { 2.0f, 4.0f, 2.0f };
+	const float start[3] = { 2.0f, 0.0f, 2.0f };
+	const float end[3] = { 42.0f, 0.0f, 18.0f };
+	dtPolyRef startRef = 0;
+	dtPolyRef endRef = 0;
+	float startPos[3];
+	float endPos[3];
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(start, halfExtents, &filter, &startRef, startPos)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(end, halfExtents, &filter, &endRef, endPos)));
+
+	const int maxPath = 256;
+	dtPolyRef polys[maxPath];
+	int npolys = 0;
+	const dtStatus status = query->findPath(startRef, endRef, startPos, endPos, &filter, polys, &npolys, maxPath);
+	REQUIRE(dtStatusSucceed(status));
+	REQUIRE(!dtStatusDetail(status, DT_PARTIAL_RESULT));
+	path.assign(polys, polys + npolys);
+
+	float straight[maxPath * 3];
+	int nstraight = 0;
+	REQUIRE(dtStatusSucceed(query->findStraightPath(startPos, endPos, polys, npolys, straight, NULL, NULL, &nstraight, maxPath)));
+
+	dtFreeNavMeshQuery(query);
+	return std::vector<float>(straight, straight + nstraight * 3);
+}
+
+#endif // TESTNAVMESH_H
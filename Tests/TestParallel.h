@@ -0,0 +1,72 @@
+#ifndef TESTPARALLEL_H
+#define TESTPARALLEL_H
+
+#include <string.h>
+
+#include "catch2/catch_amalgamated.hpp"
+
+#include "DetourParallel.h"
+#include "Recast.h"
+#include "RecastParallel.h"
+
+/// A thread pool for the duration of a test scope, optionally set as the task
+/// scheduler of a build context meanwhile.
+class TestThreadPool
+{
+public:
+	explicit TestThreadPool(int numThreads, rcContext* ctx = NULL)
+		: m_pool(rcAllocThreadPool(numThreads))
+		, m_ctx(ctx)
+		, m_detourScheduler(m_pool)
+	{
+		REQUIRE(m_pool != NULL);
+		if (m_ctx)
+		{
+			m_ctx->setTaskScheduler(m_pool);
+		}
+	}
+
+	~TestThreadPool()
+	{
+		if (m_ctx)
+		{
+			m_ctx->setTaskScheduler(NULL);
+		}
+		rcFreeThreadPool(m_pool);
+	}
+
+	int getThreadCount() const { return m_pool->getThreadCount(); }
+	rcTaskScheduler* getScheduler() { return m_pool; }
+	dtTaskScheduler* getDetourScheduler() { return &m_detourScheduler; }
+
+private:
+	TestThreadPool(const TestThreadPool&) = delete;
+	TestThreadPool& operator=(const TestThreadPool&) = delete;
+
+	rcTaskScheduler* m_pool;
+	rcContext* m_ctx;
+	dtTaskSchedulerAdapter<rcTaskScheduler, rcParallelTask> m_detourScheduler;
+};
+
+/// Calls @p run with a thread pool of 1, 2, 4 and 8 threads, so that the output of a
+/// parallel build can be compared with its serial output. If @p ctx is not null,
+/// the pool is the task scheduler of the context during the call.
+template<class Run>
+void forEachThreadPool(rcContext* ctx, Run run)
+{
+	for (int numThreads = 1; numThreads <= 8; numThreads *= 2)
+	{
+		CAPTURE(numThreads);
+		TestThreadPool pool(numThreads, ctx);
+		run(pool);
+	}
+}
+
+/// Returns true if both arrays hold the same bytes.
+template<class T>
+bool sameData(const T* a, const T* b, int count)
+{
+	return count == 0 || memcmp(a, b, sizeof(T) * count) == 0;
+}
+
+#endif // TESTPARALLEL_H